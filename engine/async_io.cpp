@@ -0,0 +1,710 @@
+/* Copyright (c) The Grit Game Engine authors 2016
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifndef WIN32
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define ASYNC_IO_URING_AVAILABLE
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+#endif
+
+#include <centralised_log.h>
+
+#include "async_io.h"
+#include "metrics.h"
+
+static MetricCounter *metric_reads =
+    metrics_counter("grit_async_io_reads_total", "",
+                    "Files read in the background ahead of their resources being loaded.");
+static MetricCounter *metric_bytes =
+    metrics_counter("grit_async_io_bytes_total", "",
+                    "Size of the files read in the background.");
+static MetricCounter *metric_failed =
+    metrics_counter("grit_async_io_failed_total", "",
+                    "Background reads that failed, e.g. because the file is in a zip.");
+static MetricCounter *metric_cancelled =
+    metrics_counter("grit_async_io_cancelled_total", "",
+                    "Background reads dropped before they started, as no demand wanted them.");
+static MetricCounter *metric_hits =
+    metrics_counter("grit_async_io_hits_total", "",
+                    "Resource files opened from a background read.");
+static MetricCounter *metric_waits =
+    metrics_counter("grit_async_io_waits_total", "",
+                    "Resource files opened while their background read was in flight.");
+static MetricCounter *metric_skipped =
+    metrics_counter("grit_async_io_skipped_total", "",
+                    "Resource files opened before their background read had started.");
+
+// Ring size, and so the most reads that can be in flight.
+static const unsigned ASYNC_IO_MAX_DEPTH = 256;
+static const unsigned ASYNC_IO_MAX_THREADS = 16;
+
+namespace {
+
+    struct Read {
+        enum State { QUEUED, IN_FLIGHT, DONE, FAILED, SKIPPED };
+        Read (const std::string &name, float priority, unsigned long long seq)
+          : name(name), path(name.substr(1)), priority(priority), seq(seq), state(QUEUED),
+            fd(-1), offset(0)
+        { }
+        const std::string name;
+        // Resources are files relative to the game directory, which is the current directory.
+        const std::string path;
+        float priority;
+        unsigned long long seq;
+        State state;
+        std::map<const void*, float> owners;
+        std::shared_ptr<std::vector<unsigned char>> data;
+        // Only used by the io_uring thread, while in flight.
+        int fd;
+        size_t offset;
+        #ifdef ASYNC_IO_URING_AVAILABLE
+        struct iovec iov;
+        #endif
+    };
+
+    struct ByPriority {
+        bool operator() (const Read *a, const Read *b) const
+        {
+            if (a->priority != b->priority) return a->priority < b->priority;
+            return a->seq < b->seq;
+        }
+    };
+
+    std::mutex lock;
+    // Signalled when there may be reads to start, or to quit.
+    std::condition_variable cvar;
+    // Signalled when a read finishes.
+    std::condition_variable done_cvar;
+    std::map<std::string, Read*> reads;
+    std::set<Read*, ByPriority> queue;
+    std::map<const void*, std::vector<Read*>> owned;
+    unsigned long long next_seq = 0;
+    unsigned in_flight = 0;
+    unsigned long long bytes_held = 0;
+    unsigned depth = 64;
+    unsigned long long budget = 64 * 1024 * 1024;
+    AsyncIOBackend backend = ASYNC_IO_OFF;
+    std::vector<std::thread*> threads;
+    bool quit = false;
+
+    // Serialises switching backends.
+    std::mutex backend_lock;
+
+}
+
+#define SYNCHRONISED std::unique_lock<std::mutex> _scoped_lock(lock)
+
+const char *async_io_backend_name (AsyncIOBackend b)
+{
+    switch (b) {
+        case ASYNC_IO_OFF: return "off";
+        case ASYNC_IO_THREADS: return "threads";
+        case ASYNC_IO_URING: return "io_uring";
+    }
+    return "unknown";
+}
+
+// All of the following must hold the lock.
+
+static bool can_start_locked (void)
+{
+    return !queue.empty() && in_flight < depth && bytes_held < budget;
+}
+
+static Read *start_locked (void)
+{
+    Read *r = *queue.begin();
+    queue.erase(queue.begin());
+    r->state = Read::IN_FLIGHT;
+    in_flight++;
+    return r;
+}
+
+// Not in flight.
+static void drop_locked (Read *r)
+{
+    if (r->state == Read::QUEUED) queue.erase(r);
+    if (r->state == Read::DONE) bytes_held -= r->data->size();
+    reads.erase(r->name);
+    delete r;
+}
+
+static void finish_locked (Read *r, bool ok)
+{
+    in_flight--;
+    done_cvar.notify_all();
+    if (ok) {
+        r->state = Read::DONE;
+        bytes_held += r->data->size();
+        metric_reads->inc();
+        metric_bytes->inc(r->data->size());
+    } else {
+        r->state = Read::FAILED;
+        r->data.reset();
+        metric_failed->inc();
+    }
+    // Every owner cancelled while it was in flight.
+    if (r->owners.empty()) drop_locked(r);
+}
+
+
+// {{{ Thread pool backend
+
+static std::shared_ptr<std::vector<unsigned char>> read_file (const std::string &path)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) return nullptr;
+    FILE *f = fopen(path.c_str(), "rb");
+    if (f == nullptr) return nullptr;
+    auto data = std::make_shared<std::vector<unsigned char>>(size_t(st.st_size));
+    size_t got = data->empty() ? 0 : fread(&(*data)[0], 1, data->size(), f);
+    bool error = ferror(f) != 0;
+    fclose(f);
+    if (error) return nullptr;
+    // The file shrank.
+    data->resize(got);
+    return data;
+}
+
+static void pool_main (void)
+{
+    SYNCHRONISED;
+    while (true) {
+        while (!quit && !can_start_locked()) cvar.wait(_scoped_lock);
+        if (quit) return;
+        Read *r = start_locked();
+        // A read in flight is not deleted, and the path does not change.
+        _scoped_lock.unlock();
+        std::shared_ptr<std::vector<unsigned char>> data = read_file(r->path);
+        _scoped_lock.lock();
+        r->data = data;
+        finish_locked(r, data != nullptr);
+    }
+}
+
+// }}}
+
+
+// {{{ io_uring backend
+
+#ifdef ASYNC_IO_URING_AVAILABLE
+
+namespace {
+
+    // There is no liburing, so the rings are mapped and driven by hand.
+    struct Uring {
+        int fd;
+        void *sq;
+        size_t sqLen;
+        void *cq;
+        size_t cqLen;
+        io_uring_sqe *sqes;
+        size_t sqesLen;
+        unsigned *sqHead, *sqTail, *sqMask, *sqArray;
+        unsigned *cqHead, *cqTail, *cqMask;
+        io_uring_cqe *cqes;
+        // Cleared if the kernel is too old to open files through the ring (before 5.6).
+        bool asyncOpen;
+    } uring;
+
+}
+
+template<class T> static T *ring_ptr (void *ring, unsigned offset)
+{
+    return reinterpret_cast<T*>(static_cast<char*>(ring) + offset);
+}
+
+static bool uring_setup (unsigned entries)
+{
+    io_uring_params p;
+    memset(&p, 0, sizeof p);
+    int fd = syscall(__NR_io_uring_setup, entries, &p);
+    // E.g. ENOSYS, or EPERM in containers that forbid it.
+    if (fd < 0) return false;
+
+    uring.fd = fd;
+    uring.sqLen = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    uring.cqLen = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    bool single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single) uring.sqLen = uring.cqLen = std::max(uring.sqLen, uring.cqLen);
+
+    uring.sq = mmap(nullptr, uring.sqLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    fd, IORING_OFF_SQ_RING);
+    if (uring.sq == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+    uring.cq = uring.sq;
+    if (!single) {
+        uring.cq = mmap(nullptr, uring.cqLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        fd, IORING_OFF_CQ_RING);
+        if (uring.cq == MAP_FAILED) {
+            munmap(uring.sq, uring.sqLen);
+            close(fd);
+            return false;
+        }
+    }
+    uring.sqesLen = p.sq_entries * sizeof(io_uring_sqe);
+    void *sqes = mmap(nullptr, uring.sqesLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        if (!single) munmap(uring.cq, uring.cqLen);
+        munmap(uring.sq, uring.sqLen);
+        close(fd);
+        return false;
+    }
+    uring.sqes = static_cast<io_uring_sqe*>(sqes);
+
+    uring.sqHead = ring_ptr<unsigned>(uring.sq, p.sq_off.head);
+    uring.sqTail = ring_ptr<unsigned>(uring.sq, p.sq_off.tail);
+    uring.sqMask = ring_ptr<unsigned>(uring.sq, p.sq_off.ring_mask);
+    uring.sqArray = ring_ptr<unsigned>(uring.sq, p.sq_off.array);
+    uring.cqHead = ring_ptr<unsigned>(uring.cq, p.cq_off.head);
+    uring.cqTail = ring_ptr<unsigned>(uring.cq, p.cq_off.tail);
+    uring.cqMask = ring_ptr<unsigned>(uring.cq, p.cq_off.ring_mask);
+    uring.cqes = ring_ptr<io_uring_cqe>(uring.cq, p.cq_off.cqes);
+    uring.asyncOpen = true;
+    return true;
+}
+
+static void uring_teardown (void)
+{
+    munmap(uring.sqes, uring.sqesLen);
+    if (uring.cq != uring.sq) munmap(uring.cq, uring.cqLen);
+    munmap(uring.sq, uring.sqLen);
+    close(uring.fd);
+}
+
+// The entry at the tail, cleared.  It is not submitted until uring_push_sqe.
+static io_uring_sqe *uring_get_sqe (Read *r)
+{
+    unsigned idx = *uring.sqTail & *uring.sqMask;
+    io_uring_sqe *sqe = &uring.sqes[idx];
+    memset(sqe, 0, sizeof *sqe);
+    sqe->user_data = reinterpret_cast<uintptr_t>(r);
+    uring.sqArray[idx] = idx;
+    return sqe;
+}
+
+// Call once the entry from uring_get_sqe is filled in.  The kernel only looks at the entry once
+// the tail has moved past it, and the release orders the writes to the entry before the tail.
+static void uring_push_sqe (void)
+{
+    __atomic_store_n(uring.sqTail, *uring.sqTail + 1, __ATOMIC_RELEASE);
+}
+
+static void uring_queue_open (Read *r)
+{
+    io_uring_sqe *sqe = uring_get_sqe(r);
+    sqe->opcode = IORING_OP_OPENAT;
+    sqe->fd = AT_FDCWD;
+    sqe->addr = reinterpret_cast<uintptr_t>(r->path.c_str());
+    sqe->open_flags = O_RDONLY | O_CLOEXEC;
+    uring_push_sqe();
+}
+
+static void uring_queue_read (Read *r)
+{
+    std::vector<unsigned char> &data = *r->data;
+    r->iov.iov_base = &data[r->offset];
+    r->iov.iov_len = data.size() - r->offset;
+    io_uring_sqe *sqe = uring_get_sqe(r);
+    sqe->opcode = IORING_OP_READV;
+    sqe->fd = r->fd;
+    sqe->addr = reinterpret_cast<uintptr_t>(&r->iov);
+    sqe->len = 1;
+    sqe->off = r->offset;
+    uring_push_sqe();
+}
+
+// The file is open, so allocate the buffer and queue the read.  Returns false if the read has
+// already finished (the file is empty or fstat failed), leaving the result in ok.
+static bool uring_opened (Read *r, bool &ok)
+{
+    struct stat st;
+    if (fstat(r->fd, &st) != 0) {
+        ok = false;
+        return false;
+    }
+    r->data = std::make_shared<std::vector<unsigned char>>(size_t(st.st_size));
+    r->offset = 0;
+    if (r->data->empty()) {
+        ok = true;
+        return false;
+    }
+    uring_queue_read(r);
+    return true;
+}
+
+// Queue the first operation of a newly started read.  Returns false if it has already finished.
+static bool uring_begin (Read *r, bool &ok)
+{
+    r->fd = -1;
+    if (uring.asyncOpen) {
+        uring_queue_open(r);
+        return true;
+    }
+    r->fd = open(r->path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (r->fd < 0) {
+        ok = false;
+        return false;
+    }
+    return uring_opened(r, ok);
+}
+
+// Handle a completion.  Returns false if the read has finished, leaving the result in ok.
+static bool uring_complete (Read *r, int res, bool &ok)
+{
+    if (r->fd < 0) {
+        // The open finished.
+        if (res == -EINVAL || res == -EOPNOTSUPP) {
+            uring.asyncOpen = false;
+            return uring_begin(r, ok);
+        }
+        if (res < 0) {
+            ok = false;
+            return false;
+        }
+        r->fd = res;
+        return uring_opened(r, ok);
+    }
+    if (res == -EINTR || res == -EAGAIN) {
+        uring_queue_read(r);
+        return true;
+    }
+    if (res < 0) {
+        ok = false;
+        return false;
+    }
+    r->offset += res;
+    if (res == 0) {
+        // The file shrank.
+        r->data->resize(r->offset);
+    } else if (r->offset < r->data->size()) {
+        // Short read.
+        uring_queue_read(r);
+        return true;
+    }
+    ok = true;
+    return false;
+}
+
+static void uring_main (void)
+{
+    std::vector<Read*> started;
+    std::vector<std::pair<Read*, bool>> finished;
+    // Operations the kernel has not completed.
+    unsigned outstanding = 0;
+    SYNCHRONISED;
+    while (true) {
+        while (!quit && in_flight == 0 && !can_start_locked()) cvar.wait(_scoped_lock);
+        if (quit && in_flight == 0) break;
+        started.clear();
+        while (!quit && can_start_locked()) started.push_back(start_locked());
+        _scoped_lock.unlock();
+
+        finished.clear();
+        for (Read *r : started) {
+            bool ok;
+            if (uring_begin(r, ok)) {
+                outstanding++;
+            } else {
+                finished.emplace_back(r, ok);
+            }
+        }
+
+        if (outstanding > 0) {
+            // Submit whatever is queued, waiting for at least one completion.
+            unsigned to_submit = *uring.sqTail - __atomic_load_n(uring.sqHead, __ATOMIC_ACQUIRE);
+            if (syscall(__NR_io_uring_enter, uring.fd, to_submit, 1, IORING_ENTER_GETEVENTS,
+                        nullptr, 0) < 0) {
+                if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+                    CERR << "io_uring_enter: " << strerror(errno) << std::endl;
+            }
+
+            unsigned head = *uring.cqHead;
+            unsigned tail = __atomic_load_n(uring.cqTail, __ATOMIC_ACQUIRE);
+            for ( ; head != tail ; ++head) {
+                const io_uring_cqe &cqe = uring.cqes[head & *uring.cqMask];
+                Read *r = reinterpret_cast<Read*>(uintptr_t(cqe.user_data));
+                bool ok;
+                if (uring_complete(r, cqe.res, ok)) continue;
+                outstanding--;
+                finished.emplace_back(r, ok);
+            }
+            __atomic_store_n(uring.cqHead, head, __ATOMIC_RELEASE);
+        }
+
+        for (const auto &f : finished) {
+            if (f.first->fd >= 0) close(f.first->fd);
+        }
+        _scoped_lock.lock();
+        for (const auto &f : finished) finish_locked(f.first, f.second);
+    }
+}
+
+#endif
+
+// }}}
+
+
+// Must not hold the lock.
+static void stop (void)
+{
+    {
+        SYNCHRONISED;
+        quit = true;
+        cvar.notify_all();
+    }
+    for (std::thread *t : threads) {
+        t->join();
+        delete t;
+    }
+    threads.clear();
+    #ifdef ASYNC_IO_URING_AVAILABLE
+    if (backend == ASYNC_IO_URING) uring_teardown();
+    #endif
+
+    SYNCHRONISED;
+    // Nothing is in flight now.
+    while (!reads.empty()) drop_locked(reads.begin()->second);
+    owned.clear();
+    quit = false;
+    backend = ASYNC_IO_OFF;
+    done_cvar.notify_all();
+}
+
+// Must not hold the lock.
+static bool start (AsyncIOBackend b)
+{
+    switch (b) {
+        case ASYNC_IO_OFF:
+        break;
+
+        case ASYNC_IO_THREADS: {
+            unsigned n = std::min(depth, ASYNC_IO_MAX_THREADS);
+            for (unsigned i=0 ; i<n ; ++i) threads.push_back(new std::thread(pool_main));
+        }
+        break;
+
+        case ASYNC_IO_URING:
+        #ifdef ASYNC_IO_URING_AVAILABLE
+        if (!uring_setup(ASYNC_IO_MAX_DEPTH)) return false;
+        threads.push_back(new std::thread(uring_main));
+        break;
+        #else
+        return false;
+        #endif
+    }
+    SYNCHRONISED;
+    backend = b;
+    return true;
+}
+
+void async_io_init (void)
+{
+    std::lock_guard<std::mutex> guard(backend_lock);
+    if (!start(ASYNC_IO_URING)) start(ASYNC_IO_THREADS);
+}
+
+void async_io_shutdown (void)
+{
+    std::lock_guard<std::mutex> guard(backend_lock);
+    stop();
+}
+
+bool async_io_set_backend (AsyncIOBackend b)
+{
+    std::lock_guard<std::mutex> guard(backend_lock);
+    AsyncIOBackend old = backend;
+    stop();
+    if (start(b)) return true;
+    start(old);
+    return false;
+}
+
+AsyncIOBackend async_io_backend (void)
+{
+    SYNCHRONISED;
+    return backend;
+}
+
+bool async_io_enabled (void)
+{
+    return async_io_backend() != ASYNC_IO_OFF;
+}
+
+void async_io_set_depth (unsigned d)
+{
+    d = std::max(1u, std::min(d, ASYNC_IO_MAX_DEPTH));
+    {
+        SYNCHRONISED;
+        if (d == depth) return;
+        depth = d;
+        cvar.notify_all();
+    }
+    // The pool has a thread per read in flight.
+    if (async_io_backend() == ASYNC_IO_THREADS) async_io_set_backend(ASYNC_IO_THREADS);
+}
+
+unsigned async_io_get_depth (void)
+{
+    SYNCHRONISED;
+    return depth;
+}
+
+void async_io_set_budget (unsigned long long bytes)
+{
+    SYNCHRONISED;
+    budget = bytes;
+    cvar.notify_all();
+}
+
+unsigned long long async_io_get_budget (void)
+{
+    SYNCHRONISED;
+    return budget;
+}
+
+void async_io_read (const std::string &name, float priority, const void *owner)
+{
+    SYNCHRONISED;
+    if (backend == ASYNC_IO_OFF) return;
+    Read *&r = reads[name];
+    if (r == nullptr) {
+        r = new Read(name, priority, next_seq++);
+        queue.insert(r);
+        cvar.notify_one();
+    }
+    if (!r->owners.insert(std::make_pair(owner, priority)).second) return;
+    owned[owner].push_back(r);
+    if (r->state == Read::QUEUED && priority < r->priority) {
+        queue.erase(r);
+        r->priority = priority;
+        queue.insert(r);
+    }
+}
+
+void async_io_cancel (const void *owner)
+{
+    SYNCHRONISED;
+    auto it = owned.find(owner);
+    if (it == owned.end()) return;
+    for (Read *r : it->second) {
+        r->owners.erase(owner);
+        if (!r->owners.empty()) continue;
+        // Dropped when it finishes.
+        if (r->state == Read::IN_FLIGHT) continue;
+        if (r->state == Read::QUEUED) metric_cancelled->inc();
+        drop_locked(r);
+    }
+    owned.erase(it);
+    // Freeing buffers may have brought us back under the budget.
+    cvar.notify_all();
+}
+
+std::shared_ptr<const std::vector<unsigned char>> async_io_get (const std::string &name)
+{
+    SYNCHRONISED;
+    bool waited = false;
+    while (true) {
+        // Look it up again after waiting, as it may have been dropped.
+        auto it = reads.find(name);
+        if (it == reads.end()) return nullptr;
+        Read *r = it->second;
+        switch (r->state) {
+            case Read::QUEUED:
+            queue.erase(r);
+            r->state = Read::SKIPPED;
+            metric_skipped->inc();
+            return nullptr;
+
+            case Read::IN_FLIGHT:
+            if (!waited) metric_waits->inc();
+            waited = true;
+            done_cvar.wait(_scoped_lock);
+            break;
+
+            case Read::DONE:
+            metric_hits->inc();
+            return r->data;
+
+            case Read::FAILED:
+            case Read::SKIPPED:
+            return nullptr;
+        }
+    }
+}
+
+void async_io_wait (void)
+{
+    SYNCHRONISED;
+    while (in_flight > 0 || (backend != ASYNC_IO_OFF && can_start_locked()))
+        done_cvar.wait(_scoped_lock);
+}
+
+void async_io_stats (unsigned &queued_, unsigned &in_flight_, unsigned &done_,
+                     unsigned long long &bytes_)
+{
+    SYNCHRONISED;
+    queued_ = queue.size();
+    in_flight_ = in_flight;
+    done_ = 0;
+    for (const auto &r : reads) {
+        if (r.second->state == Read::DONE) done_++;
+    }
+    bytes_ = bytes_held;
+}
+
+bool async_io_drop_cache (const std::string &name)
+{
+    #ifdef POSIX_FADV_DONTNEED
+    int fd = open(name.substr(1).c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    bool r = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+    close(fd);
+    return r;
+    #else
+    (void) name;
+    return false;
+    #endif
+}
@@ -0,0 +1,114 @@
+/* Copyright (c) The Grit Game Engine authors 2016
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef AsyncIO_h
+#define AsyncIO_h
+
+#include <memory>
+#include <string>
+#include <vector>
+
+/** \file
+ *
+ * Reads whole resource files in the background, many at a time, so the background loader does
+ * not wait for the disk one file after another.  When demands are queued, the background loader
+ * asks for the files they need (from their manifests, or just the resources themselves) to be
+ * read, nearest demand first.  When a resource is then loaded, Ogre opens its file through an
+ * archive that takes the buffer that was read, or waits for it if it is still being read, and
+ * only goes to the disk itself if the read was never started.  Unsubmitted reads are dropped
+ * when the demand is retracted, and the buffers are freed when the demand has been loaded.
+ *
+ * Reads are identified by the resource name (an absolute Grit path), so reads of the same file
+ * by several demands are shared.  A read is kept until all of the demands ("owners") that asked
+ * for it have cancelled.  Reads are started in order of priority (lower first, the distance of
+ * the demand), and then the order they were asked for.  No more are started while the buffers
+ * read exceed a budget, so a large queue does not fill the memory.
+ *
+ * There are two backends.  On Linux, io_uring keeps all the reads in flight from one thread with
+ * no syscall per read.  Elsewhere, or if the kernel refuses io_uring, a pool of threads each
+ * reads one file at a time with blocking reads.  io_uring opens the files in the ring too
+ * (IORING_OP_OPENAT), while each thread of the pool opens its file itself before reading it.
+ * With the backend "off", nothing is read in the background and resources are read by Ogre as
+ * before.
+ *
+ * All the functions can be called from any thread.
+ */
+
+enum AsyncIOBackend {
+    ASYNC_IO_OFF,
+    ASYNC_IO_THREADS,
+    ASYNC_IO_URING
+};
+
+/** "off", "threads" or "io_uring". */
+const char *async_io_backend_name (AsyncIOBackend backend);
+
+/** Start the best available backend. */
+void async_io_init (void);
+
+/** Wait for the reads in flight and free everything. */
+void async_io_shutdown (void);
+
+/** Switch backend, waiting for the reads in flight and dropping all the buffers.  Returns false
+ * (and stays with the old one) if the backend is not available. */
+bool async_io_set_backend (AsyncIOBackend backend);
+
+AsyncIOBackend async_io_backend (void);
+
+/** Is a backend other than "off" running? */
+bool async_io_enabled (void);
+
+/** The maximum number of reads in flight, at most 256.  The thread pool has a thread for each,
+ * up to 16. */
+void async_io_set_depth (unsigned depth);
+unsigned async_io_get_depth (void);
+
+/** No new reads are started while the buffers exceed this many bytes. */
+void async_io_set_budget (unsigned long long bytes);
+unsigned long long async_io_get_budget (void);
+
+/** Ask for the file to be read on behalf of the owner.  If another owner already asked, the read
+ * is shared and takes the lower of the priorities. */
+void async_io_read (const std::string &name, float priority, const void *owner);
+
+/** Forget the owner's reads.  Reads no other owner wants are dropped if they have not started,
+ * discarded when they finish if they have, and otherwise their buffers are freed. */
+void async_io_cancel (const void *owner);
+
+/** The contents of the file if it was read, waiting if the read is in flight.  Returns null if
+ * nobody asked for it to be read, it could not be read, or it had not been started (in which case
+ * it is not started later, as the caller is about to read it anyway).  The buffer remains
+ * available to later calls until the owners cancel. */
+std::shared_ptr<const std::vector<unsigned char>> async_io_get (const std::string &name);
+
+/** Wait for all the reads that have been started or queued (e.g. for benchmarks). */
+void async_io_wait (void);
+
+/** Number of reads queued, in flight, and finished with buffers still held; and the bytes held. */
+void async_io_stats (unsigned &queued, unsigned &in_flight, unsigned &done,
+                     unsigned long long &bytes);
+
+/** Ask the OS to drop the file from its cache, for measuring cold reads.  Returns false if the
+ * OS cannot. */
+bool async_io_drop_cache (const std::string &name);
+
+#endif
@@ -129,7 +129,7 @@ void audio_option_reset (void);
 
 /** A sound emitter whose parameters can be modified while the sound is
  * playing.  Stereo sounds are implemented using two emitters. */
-class AudioBody : public DiskResource::ReloadWatcher
+class AudioBody : public DiskResource::ReloadWatcher, public SharedPtrCounted
 {
     private:
         DiskResourcePtr<AudioDiskResource> resource;
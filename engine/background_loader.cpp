@@ -24,12 +24,33 @@
 
 #include "gfx/gfx_disk_resource.h"
 
+#include "async_io.h"
 #include "background_loader.h"
+#include "frame_allocator.h"
+#include "host_cache.h"
 #include "main.h"
+#include "metrics.h"
+#include "resource_manifest.h"
 
 #define SYNCHRONISED std::unique_lock<std::recursive_mutex> _scoped_lock(lock)
 #define SYNCHRONISED2(bgl) std::unique_lock<std::recursive_mutex> _scoped_lock(bgl->lock)
 
+static MetricCounter *metric_load_errors =
+    metrics_counter("grit_background_loader_load_errors_total", "",
+                    "Resources that raised an error while loading in the background.");
+static MetricCounter *metric_evictions_host =
+    metrics_counter("grit_disk_resource_evictions_total", "memory=\"host\"",
+                    "Unused resources unloaded to stay within the memory budget.");
+static MetricCounter *metric_evictions_gpu =
+    metrics_counter("grit_disk_resource_evictions_total", "memory=\"gpu\"",
+                    "Unused resources unloaded to stay within the memory budget.");
+static MetricGauge *metric_ram_used_gpu =
+    metrics_gauge("grit_disk_resource_ram_used_megabytes", "memory=\"gpu\"",
+                  "Memory used by loaded resources.");
+static MetricGauge *metric_ram_budget_gpu =
+    metrics_gauge("grit_disk_resource_ram_budget_megabytes", "memory=\"gpu\"",
+                  "Memory that loaded resources may use before unused ones are unloaded.");
+
 bool Demand::requestLoad (float dist)
 {
     // called by main thread only
@@ -46,6 +67,7 @@ bool Demand::requestLoad (float dist)
             resources[i]->increment();
         }
         incremented = true;
+        requestTime = micros();
     }
 
     // if all the resources are in a loaded state then return true
@@ -81,9 +103,25 @@ void Demand::immediateLoad (void)
         }
         incremented = true;
     }
+    if (!manifestKey.empty() && !loaded()) {
+        std::vector<ResourceManifestRequest> req(1);
+        req[0].key = manifestKey;
+        req[0].roots = resource_manifest_names(resources);
+        req[0].owner = this;
+        resource_manifest_prefetch(req);
+    }
     for (unsigned i=0 ; i<resources.size() ; ++i) {
         if (!resources[i]->isLoaded()) resources[i]->load();
     }
+    recordManifest();
+    async_io_cancel(this);
+}
+
+void Demand::recordManifest (void)
+{
+    if (manifestKey.empty()) return;
+    if (resource_manifest_matches(manifestKey, resource_manifest_names(resources))) return;
+    resource_manifest_record(manifestKey, resources);
 }
 
 void Demand::immediateReload (void)
@@ -115,6 +153,7 @@ void Demand::finishedWith (void)
         }
         incremented = false;
     }
+    requestTime = 0;
 }
 
 
@@ -156,6 +195,7 @@ void BackgroundLoader::add (Demand *d)
     mDemands.push_back(d);
     d->mInBackgroundQueue = true;
     d->causedError = false;
+    d->prefetched = false;
     cVar.notify_one();
 }
 
@@ -165,6 +205,8 @@ void BackgroundLoader::remove (Demand *d)
     SYNCHRONISED;
     if (!d->mInBackgroundQueue) return;
     mDemands.erase(d);
+    // Drop its reads that have not started yet.
+    async_io_cancel(d);
     //CVERB << "Retracted demand." << std::endl;
     if (mCurrent == d) {
         //CVERB << "making a bastard..." << std::endl;
@@ -178,11 +220,12 @@ void BackgroundLoader::handleBastards (void)
     // access volatile field without taking lock first
     // worst case we return early, i.e. will pick up bastards next time
     if (mNumBastards == 0) return;
-    DiskResources s;
+    FrameVector<DiskResource*> s;
     {
         SYNCHRONISED;
         if (mNumBastards == 0) return;
-        s = mBastards;
+        // copy rather than swap, so mBastards keeps its storage
+        s.assign(mBastards.begin(), mBastards.end());
         mBastards.clear();
         mNumBastards = 0;
     }
@@ -202,6 +245,7 @@ void BackgroundLoader::thread_main (void)
 {
     //APP_VERBOSE("BackgroundLoader: thread started");
     DiskResources pending;
+    std::vector<ResourceManifestRequest> prefetches;
     bool caused_error = false;
     while (!mQuit) {
         {
@@ -216,6 +260,10 @@ void BackgroundLoader::thread_main (void)
                 Demand *d = mCurrent;
                 mDemands.erase(d);
                 mCurrent = NULL;
+                // Its resources are still in use, so their dependencies are all there.
+                if (!caused_error) d->recordManifest();
+                // Free the buffers read for it.
+                async_io_cancel(d);
             } else {
                 // demand was retracted, and we actually
                 // loaded stuff
@@ -231,11 +279,32 @@ void BackgroundLoader::thread_main (void)
                    //asynchronously call sm.finishedWith(resource);
             }
             pending.clear();
-            if (mAllowance <= 0 || !nearestDemand(mCurrent)) {
-                cVar.wait(_scoped_lock);
-                continue;    
+            // Prefetch the files of all the newly queued demands together, before loading any.
+            bool async = async_io_enabled();
+            for (unsigned i=0 ; i<mDemands.size() ; ++i) {
+                Demand *d = mDemands[i];
+                if (d->prefetched) continue;
+                d->prefetched = true;
+                if (d->manifestKey.empty() && !async) continue;
+                ResourceManifestRequest req;
+                req.key = d->manifestKey;
+                req.roots = resource_manifest_names(d->resources);
+                req.owner = d;
+                req.priority = d->mDist;
+                prefetches.push_back(req);
             }
-            pending = mCurrent->resources;
+            if (prefetches.empty()) {
+                if (mAllowance <= 0 || !nearestDemand(mCurrent)) {
+                    cVar.wait(_scoped_lock);
+                    continue;    
+                }
+                pending = mCurrent->resources;
+            }
+        }
+        if (!prefetches.empty()) {
+            resource_manifest_prefetch(prefetches);
+            prefetches.clear();
+            continue;
         }
         //APP_VERBOSE("BackgroundLoader: loading: " + name);
         caused_error = false;
@@ -249,6 +318,7 @@ void BackgroundLoader::thread_main (void)
                 }
             } catch (Exception &e) {
                 CERR << e << std::endl;
+                metric_load_errors->inc();
                 caused_error = true;
             }
         }
@@ -308,16 +378,23 @@ void BackgroundLoader::finishedWith (DiskResource *de)
 void BackgroundLoader::checkRAMGPU ()
 {
     double budget = gfx_gpu_ram_available();
+    metric_ram_budget_gpu->set(budget);
 
     while (true) {
 
         double usage = gfx_gpu_ram_used();
+        metric_ram_used_gpu->set(usage);
 
         if (usage < budget || mDeathRowGPU.size() == 0) break;
 
         DiskResource *r = mDeathRowGPU.pop();
 
-        if (r->noUsers() && r->isLoaded()) r->unload();
+        if (r->noUsers() && r->isLoaded()) {
+            metric_evictions_gpu->inc();
+            r->unload();
+            // Keep the file in memory, in case it is needed again.
+            host_cache_add(r->getName());
+        }
     }
 }
 
@@ -333,7 +410,11 @@ void BackgroundLoader::checkRAMHost ()
 
         DiskResource *r = mDeathRowHost.pop();
 
-        if (r->noUsers() && r->isLoaded())
+        if (r->noUsers() && r->isLoaded()) {
+            metric_evictions_host->inc();
             r->unload();
+            // Keep the file in memory, in case it is needed again.
+            host_cache_add(r->getName());
+        }
     }
 }
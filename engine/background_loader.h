@@ -138,9 +138,17 @@ class Demand : public fast_erase_index {
     public:
 
     Demand (void)
-        : mInBackgroundQueue(false), mDist(0.0f), incremented(false), causedError(false)
+        : mInBackgroundQueue(false), mDist(0.0f), incremented(false), causedError(false),
+          requestTime(0), prefetched(false)
     { }
 
+    /** Use the resource manifest of this key (usually the class name) to prefetch every file
+     * the resources need, see resource_manifest.h. */
+    void setManifestKey (const std::string &key)
+    {
+        manifestKey = key;
+    }
+
     /** Add a required disk resource (by absolute path to the file). */
     void addDiskResource (const std::string &rn)
     {
@@ -202,6 +210,10 @@ class Demand : public fast_erase_index {
      */
     bool errorOnLoad (void) { return causedError; }
 
+    /** When requestLoad was first called (in microseconds, see micros()), or 0 if it has not
+     * been called since the last finishedWith. */
+    unsigned long long getRequestTime (void) { return requestTime; }
+
     private:
 
     /** Did we add to the background queue yet? */
@@ -219,6 +231,18 @@ class Demand : public fast_erase_index {
     /** Did an error occur in the background thread? */
     bool causedError;
 
+    /** See getRequestTime. */
+    unsigned long long requestTime;
+
+    /** See setManifestKey. */
+    std::string manifestKey;
+
+    /** Has the background loader prefetched the files since the demand was queued? */
+    bool prefetched;
+
+    /** Record a manifest, if there is a key and no manifest for these resources. */
+    void recordManifest (void);
+
     friend class BackgroundLoader;
 };
 
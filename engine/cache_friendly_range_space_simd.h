@@ -160,7 +160,13 @@ class CacheFriendlyRangeSpace {
                          end = cargo.end();
         // if it's already in there, this is a no-op
         if (find(begin,end,o) != end) return;
-        
+        addNew(o);
+    }
+
+    /** Like add, but the caller guarantees the object is not already present, which avoids a
+     * linear search.  Adding many new objects is then linear in their number. */
+    void addNew (const T &o)
+    {
         size_t index = cargo.size();
         cargo.push_back(o);
         positions.push_back(SIMDVector4());
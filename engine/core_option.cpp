@@ -20,6 +20,8 @@
  */
 
 #include "core_option.h"
+#include "error_aggregate.h"
+#include "host_cache.h"
 #include "streamer.h"
 
 static CoreBoolOption option_keys_bool[] = {
@@ -31,12 +33,18 @@ static CoreFloatOption option_keys_float[] = {
     CORE_VISIBILITY,
     CORE_PREPARE_DISTANCE_FACTOR,
     CORE_FADE_OUT_FACTOR,
-    CORE_FADE_OVERLAP_FACTOR
+    CORE_FADE_OVERLAP_FACTOR,
+    CORE_DEACTIVATION_HYSTERESIS,
+    CORE_WARM_DEACTIVATION_TIME,
+    CORE_THRASH_WINDOW,
+    CORE_ERROR_SUMMARY_PERIOD
 };
 
 static CoreIntOption option_keys_int[] = {
     CORE_STEP_SIZE,
-    CORE_RAM
+    CORE_RAM,
+    CORE_HOST_CACHE_RAM,
+    CORE_ERROR_BURST
 };
 
 
@@ -72,6 +80,8 @@ std::string core_option_to_string (CoreIntOption o)
     switch (o) {
         case CORE_STEP_SIZE: return "STEP_SIZE";
         case CORE_RAM: return "RAM";
+        case CORE_HOST_CACHE_RAM: return "HOST_CACHE_RAM";
+        case CORE_ERROR_BURST: return "ERROR_BURST";
     }   
     return "UNKNOWN_INT_OPTION";
 }
@@ -82,6 +92,10 @@ std::string core_option_to_string (CoreFloatOption o)
         case CORE_PREPARE_DISTANCE_FACTOR: return "PREPARE_DISTANCE_FACTOR";
         case CORE_FADE_OUT_FACTOR: return "FADE_OUT_FACTOR";
         case CORE_FADE_OVERLAP_FACTOR: return "FADE_OVERLAP_FACTOR";
+        case CORE_DEACTIVATION_HYSTERESIS: return "DEACTIVATION_HYSTERESIS";
+        case CORE_WARM_DEACTIVATION_TIME: return "WARM_DEACTIVATION_TIME";
+        case CORE_THRASH_WINDOW: return "THRASH_WINDOW";
+        case CORE_ERROR_SUMMARY_PERIOD: return "ERROR_SUMMARY_PERIOD";
     }   
     return "UNKNOWN_FLOAT_OPTION";
 }
@@ -97,11 +111,17 @@ void core_option_from_string (const std::string &s,
 
     else if (s == "STEP_SIZE") { t = 1 ; o1 = CORE_STEP_SIZE; }
     else if (s == "RAM") { t = 1 ; o1 = CORE_RAM; }
+    else if (s == "HOST_CACHE_RAM") { t = 1 ; o1 = CORE_HOST_CACHE_RAM; }
+    else if (s == "ERROR_BURST") { t = 1 ; o1 = CORE_ERROR_BURST; }
 
     else if (s == "VISIBILITY") { t = 2 ; o2 = CORE_VISIBILITY; }
     else if (s == "PREPARE_DISTANCE_FACTOR") { t = 2 ; o2 = CORE_PREPARE_DISTANCE_FACTOR; }
     else if (s == "FADE_OUT_FACTOR") { t = 2 ; o2 = CORE_FADE_OUT_FACTOR; }
     else if (s == "FADE_OVERLAP_FACTOR") { t = 2 ; o2 = CORE_FADE_OVERLAP_FACTOR; }
+    else if (s == "DEACTIVATION_HYSTERESIS") { t = 2 ; o2 = CORE_DEACTIVATION_HYSTERESIS; }
+    else if (s == "WARM_DEACTIVATION_TIME") { t = 2 ; o2 = CORE_WARM_DEACTIVATION_TIME; }
+    else if (s == "THRASH_WINDOW") { t = 2 ; o2 = CORE_THRASH_WINDOW; }
+    else if (s == "ERROR_SUMMARY_PERIOD") { t = 2 ; o2 = CORE_ERROR_SUMMARY_PERIOD; }
 
     else t = -1;
 }
@@ -131,6 +151,12 @@ static void options_update (bool flush)
             case CORE_STEP_SIZE:
             case CORE_RAM:
             break;
+            case CORE_HOST_CACHE_RAM:
+            host_cache_set_budget((unsigned long long)v_new * 1024 * 1024);
+            break;
+            case CORE_ERROR_BURST:
+            error_aggregate_set_burst(v_new);
+            break;
         }
     }
     for (unsigned i=0 ; i<sizeof(option_keys_float)/sizeof(*option_keys_float) ; ++i) {
@@ -151,6 +177,18 @@ static void options_update (bool flush)
             case CORE_FADE_OVERLAP_FACTOR:
             streamer_fade_overlap_factor = v_new;
             break;
+            case CORE_DEACTIVATION_HYSTERESIS:
+            streamer_deactivation_hysteresis = v_new;
+            break;
+            case CORE_WARM_DEACTIVATION_TIME:
+            streamer_warm_deactivation_time = v_new;
+            break;
+            case CORE_THRASH_WINDOW:
+            streamer_thrash_window = v_new;
+            break;
+            case CORE_ERROR_SUMMARY_PERIOD:
+            error_aggregate_set_period(v_new);
+            break;
         }
     }
 
@@ -166,11 +204,17 @@ void core_option_reset (void)
 
     core_option(CORE_STEP_SIZE, 20000);
     core_option(CORE_RAM, 1024); // 1GB
+    core_option(CORE_HOST_CACHE_RAM, 128);
+    core_option(CORE_ERROR_BURST, 5);
 
     core_option(CORE_VISIBILITY, 1.0f);
     core_option(CORE_PREPARE_DISTANCE_FACTOR, 1.3f);
     core_option(CORE_FADE_OUT_FACTOR, 0.7f);
     core_option(CORE_FADE_OVERLAP_FACTOR, 0.7f);
+    core_option(CORE_DEACTIVATION_HYSTERESIS, 0.1f);
+    core_option(CORE_WARM_DEACTIVATION_TIME, 0.0f);
+    core_option(CORE_THRASH_WINDOW, 5.0f);
+    core_option(CORE_ERROR_SUMMARY_PERIOD, 5.0f);
 }
 
 
@@ -182,11 +226,17 @@ void core_option_init (void)
 
     valid_option(CORE_STEP_SIZE, new ValidOptionRange<int>(0, 20000));
     valid_option(CORE_RAM, new ValidOptionRange<int>(0, 1024*1024)); // 1TB
+    valid_option(CORE_HOST_CACHE_RAM, new ValidOptionRange<int>(0, 1024*1024));
+    valid_option(CORE_ERROR_BURST, new ValidOptionRange<int>(0, 1000000));
 
     valid_option(CORE_VISIBILITY, new ValidOptionRange<float>(0, 10));
     valid_option(CORE_PREPARE_DISTANCE_FACTOR, new ValidOptionRange<float>(1, 3));
     valid_option(CORE_FADE_OUT_FACTOR, new ValidOptionRange<float>(0, 1));
     valid_option(CORE_FADE_OVERLAP_FACTOR, new ValidOptionRange<float>(0, 1));
+    valid_option(CORE_DEACTIVATION_HYSTERESIS, new ValidOptionRange<float>(0, 1));
+    valid_option(CORE_WARM_DEACTIVATION_TIME, new ValidOptionRange<float>(0, 600));
+    valid_option(CORE_THRASH_WINDOW, new ValidOptionRange<float>(0, 600));
+    valid_option(CORE_ERROR_SUMMARY_PERIOD, new ValidOptionRange<float>(0, 3600));
 
 
     core_option(CORE_AUTOUPDATE, false);
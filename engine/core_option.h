@@ -49,14 +49,36 @@ enum CoreFloatOption {
     CORE_FADE_OUT_FACTOR,
 
     /** The proportion of rendering distance at which fading to the next lod level begins. */
-    CORE_FADE_OVERLAP_FACTOR
+    CORE_FADE_OVERLAP_FACTOR,
+
+    /** How far beyond its rendering distance (as a proportion of it) an activated object must
+     * go before it is deactivated.  Objects are still only activated within their rendering
+     * distance, so one at the edge does not flip between the two states. */
+    CORE_DEACTIVATION_HYSTERESIS,
+
+    /** Seconds for which an object that goes out of range is kept activated but invisible, in
+     * case it comes back into range, before it is really deactivated.  0 disables this. */
+    CORE_WARM_DEACTIVATION_TIME,
+
+    /** Seconds after its deactivation within which an object's reactivation is counted as
+     * thrashing in the streaming statistics of its class. */
+    CORE_THRASH_WINDOW,
+
+    /** Seconds between summaries of errors that were too frequent to report in full, see
+     * error_aggregate.h. */
+    CORE_ERROR_SUMMARY_PERIOD
 };
 
 enum CoreIntOption {
     /** The number of objects per frame considered for streaming in. */
     CORE_STEP_SIZE,
     /** The number of megabytes of host RAM to use for cached disk resources. */
-    CORE_RAM
+    CORE_RAM,
+    /** The number of megabytes of host RAM to use for compressed copies of resource files, so
+     * resources unloaded to free memory can be loaded again without the disk, see host_cache.h. */
+    CORE_HOST_CACHE_RAM,
+    /** The number of times the same error is reported in full before it is only counted. */
+    CORE_ERROR_BURST
 };
 
 /** Returns the enum value of the option described by s.  Only one of o0, o1,
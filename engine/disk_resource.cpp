@@ -20,8 +20,11 @@
  */
 
 
+#include <sleep.h>
+
 #include "core_option.h"
 #include "main.h"
+#include "metrics.h"
 
 #include "gfx/gfx_disk_resource.h"
 
@@ -107,7 +110,7 @@ DiskResource *disk_resource_get_or_make (const std::string &rn)
         dr = new CollisionMesh(rn);
     } else if (suffix == "wav" || suffix == "ogg" || suffix == "mp3") {
         dr = new AudioDiskResource(rn);
-    } else if (ends_with(rn, ".envcube.tiff")) {
+    } else if (ends_with(rn, ".envcube.tiff") || ends_with(rn, ".envcube.dds")) {
         dr = new GfxEnvCubeDiskResource(rn);
     } else if (ends_with(rn, ".lut.png")) {
         dr = new GfxColourGradeLUTDiskResource(rn);
@@ -150,14 +153,65 @@ void DiskResource::reload (void)
     callReloadWatchers();
 }
 
+// Bytes of resource files opened by this thread, so a load can tell how much it read.
+static thread_local unsigned long long opened_bytes = 0;
+
+void disk_resource_file_opened (size_t bytes)
+{
+    opened_bytes += bytes;
+}
+
+struct LoadMetrics {
+    MetricHistogram *seconds;
+    MetricCounter *bytes;
+};
+
+static LoadMetrics make_load_metrics (const char *kind)
+{
+    std::string labels = std::string("type=\"") + kind + "\"";
+    LoadMetrics r;
+    r.seconds = metrics_histogram("grit_disk_resource_load_seconds", labels,
+                                  "Time taken to load a resource, including its dependencies.",
+                                  metrics_latency_bounds());
+    r.bytes = metrics_counter("grit_disk_resource_read_bytes_total", labels,
+                              "Size of the files of the resources loaded.");
+    return r;
+}
+
+// Registered up front, so loads need not look them up.
+static const LoadMetrics metrics_envcube = make_load_metrics("envcube");
+static const LoadMetrics metrics_colour_grade = make_load_metrics("colour_grade");
+static const LoadMetrics metrics_mesh = make_load_metrics("mesh");
+static const LoadMetrics metrics_collision = make_load_metrics("collision");
+static const LoadMetrics metrics_audio = make_load_metrics("audio");
+static const LoadMetrics metrics_texture = make_load_metrics("texture");
+
+/** The kind of resource, from the file extension as in disk_resource_get_or_make, for metrics. */
+static const LoadMetrics &load_metrics (const std::string &rn)
+{
+    if (ends_with(rn, ".envcube.tiff") || ends_with(rn, ".envcube.dds")) return metrics_envcube;
+    if (ends_with(rn, ".lut.png") || ends_with(rn, ".lut.tiff")) return metrics_colour_grade;
+    if (ends_with(rn, ".mesh")) return metrics_mesh;
+    if (ends_with(rn, ".tcol") || ends_with(rn, ".gcol") || ends_with(rn, ".bcol"))
+        return metrics_collision;
+    if (ends_with(rn, ".wav") || ends_with(rn, ".ogg") || ends_with(rn, ".mp3"))
+        return metrics_audio;
+    return metrics_texture;
+}
+
 void DiskResource::load (void)
 {
     APP_ASSERT(!loaded);
 
+    unsigned long long before = micros();
+    unsigned long long bytes_before = opened_bytes;
     loadImpl();
+    const LoadMetrics &m = load_metrics(getName());
+    m.seconds->observe((micros() - before) / 1E6);
+    m.bytes->inc(opened_bytes - bytes_before);
 
     if (disk_resource_verbose_loads)
-            CVERB << "LOAD " << getName() << std::endl;
+        LOG_SINK(LOG_SINK_VERB, "LOAD %", getName());
     loaded = true;
 
     callReloadWatchers();
@@ -175,7 +229,7 @@ void DiskResource::decrement (void)
     APP_ASSERT(users > 0);
     users--;
     if (disk_resource_verbose_incs)
-        CVERB << "-- " << getName() << "(now " << users << ")" << std::endl;
+        LOG_SINK(LOG_SINK_VERB, "-- %(now %)", getName(), users);
     // Maybe reclaim now / later
     if (users == 0) {
         bgl->finishedWith(this);
@@ -188,13 +242,17 @@ void DiskResource::unload (void)
     APP_ASSERT(noUsers());
 
     if (disk_resource_verbose_loads)
-        CVERB << "FREE " << getName() << std::endl;
+        LOG_SINK(LOG_SINK_VERB, "FREE %", getName());
     for (unsigned i=0 ; i<dependencies.size() ; ++i) {
         dependencies[i]->decrement();
     }
     dependencies.clear();
     unloadImpl();
     loaded = false;
+
+    static MetricCounter *metric_unloads =
+        metrics_counter("grit_disk_resource_unloads_total", "", "Resources unloaded.");
+    metric_unloads->inc();
 }
 
 double host_ram_available (void)
@@ -33,6 +33,8 @@ typedef std::vector<DiskResource*> DiskResources;
 
 #include <centralised_log.h>
 
+#include "log_sink.h"
+
 
 /** \file
  *
@@ -79,6 +81,10 @@ DiskResource *disk_resource_get_or_make (const std::string &rn);
 /** Test if a disk resource of the given name exists. */
 bool disk_resource_has (const std::string &rn);
 
+/** Called by the resource file system with the size of each file it opens, so that loads can
+ * report how much they read without asking the OS again. */
+void disk_resource_file_opened (size_t bytes);
+
 /** How many MB of host RAM are available for use by disk resources. 
  * This is actually controlled by core_option(CORE_RAM)
  */
@@ -167,7 +173,7 @@ class DiskResource {
     {
         users++;
         if (disk_resource_verbose_incs)
-            CVERB << "++ " << getName() << " (now at " << users << ")" << std::endl;
+            LOG_SINK(LOG_SINK_VERB, "++ % (now at %)", getName(), users);
     }
 
     /** Inform that you are no-longer using this resource. */
@@ -185,6 +191,9 @@ class DiskResource {
     /** Erase from memory, the only copy will be on disk. */
     void unload (void);
 
+    /** The resources this one depends on, which are only known while it is loaded. */
+    const DiskResources &getDependencies (void) const { return dependencies; }
+
     /** Subclasses should register dependencies at load time.  This also loads the dependencies. */
     void addDependency (const std::string &name)
     {
@@ -0,0 +1,159 @@
+/* Copyright (c) The Grit Game Engine authors 2016
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include <map>
+#include <mutex>
+
+#include <centralised_log.h>
+#include <sleep.h>
+
+#include "error_aggregate.h"
+#include "metrics.h"
+
+static MetricCounter *metric_errors =
+    metrics_counter("grit_errors_total", "",
+                    "Errors counted by the error aggregation, whether reported or not.");
+static MetricCounter *metric_suppressed =
+    metrics_counter("grit_errors_suppressed_total", "",
+                    "Errors only counted, not reported in full, because there were too many.");
+
+namespace {
+
+    struct Entry {
+        unsigned long long count;
+        unsigned long long suppressed;
+        // Since the last summary.
+        unsigned long long periodSuppressed;
+        // Reported in full since the key was last quiet for a period.
+        unsigned reported;
+        unsigned long long first;
+        unsigned long long last;
+    };
+
+    typedef std::map<std::pair<std::string, std::string>, Entry> EntryMap;
+
+    const unsigned max_keys = 1024;
+    const char *other_key = "(other)";
+
+    std::mutex lock;
+    EntryMap entries;
+    unsigned burst = 5;
+    unsigned long long period = 5000000;
+    unsigned long long last_summary = 0;
+
+}
+
+#define SYNCHRONISED std::unique_lock<std::mutex> _scoped_lock(lock)
+
+bool error_aggregate (const std::string &site, const std::string &key)
+{
+    metric_errors->inc();
+    unsigned long long now = micros();
+    SYNCHRONISED;
+    auto it = entries.find(std::make_pair(site, key));
+    if (it == entries.end()) {
+        std::pair<std::string, std::string> k(site, entries.size() < max_keys ? key : other_key);
+        it = entries.find(k);
+        if (it == entries.end())
+            it = entries.insert(std::make_pair(k, Entry{0, 0, 0, 0, now, now})).first;
+    }
+    Entry &e = it->second;
+    e.count++;
+    e.last = now;
+    if (e.reported < burst) {
+        e.reported++;
+        return true;
+    }
+    e.suppressed++;
+    e.periodSuppressed++;
+    metric_suppressed->inc();
+    return false;
+}
+
+// Must hold the lock.
+static void summarise_locked (unsigned long long now)
+{
+    for (auto it = entries.begin() ; it != entries.end() ; ) {
+        Entry &e = it->second;
+        if (e.periodSuppressed > 0) {
+            CERR << it->first.first << ": " << it->first.second << ": "
+                 << e.periodSuppressed << " more in the last "
+                 << (now - last_summary) / 1000000.0 << "s (" << e.count << " in total)"
+                 << std::endl;
+            e.periodSuppressed = 0;
+        } else if (now - e.last >= period) {
+            // Quiet for a whole period, so forget it.  Its next error is reported in full, and
+            // the room goes to new keys rather than them all being counted as (other).
+            it = entries.erase(it);
+            continue;
+        }
+        ++it;
+    }
+    last_summary = now;
+}
+
+void error_aggregate_frame (void)
+{
+    unsigned long long now = micros();
+    SYNCHRONISED;
+    if (last_summary == 0) last_summary = now;
+    if (now - last_summary < period) return;
+    summarise_locked(now);
+}
+
+void error_aggregate_flush (void)
+{
+    unsigned long long now = micros();
+    SYNCHRONISED;
+    summarise_locked(now);
+}
+
+void error_aggregate_set_burst (unsigned v)
+{
+    SYNCHRONISED;
+    burst = v;
+}
+
+void error_aggregate_set_period (float seconds)
+{
+    SYNCHRONISED;
+    period = (unsigned long long)(seconds * 1000000);
+}
+
+std::vector<ErrorAggregate> error_aggregate_all (void)
+{
+    unsigned long long now = micros();
+    SYNCHRONISED;
+    std::vector<ErrorAggregate> r;
+    for (const auto &pair : entries) {
+        const Entry &e = pair.second;
+        r.push_back(ErrorAggregate{pair.first.first, pair.first.second, e.count, e.suppressed,
+                                   (now - e.first) / 1E6f, (now - e.last) / 1E6f});
+    }
+    return r;
+}
+
+void error_aggregate_clear (void)
+{
+    SYNCHRONISED;
+    entries.clear();
+}
@@ -0,0 +1,77 @@
+/* Copyright (c) The Grit Game Engine authors 2016
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef ErrorAggregate_h
+#define ErrorAggregate_h
+
+#include <string>
+#include <vector>
+
+/** \file
+ *
+ * Rate limiting for errors raised in hot paths, e.g. a NaN from a physics body, a garbage
+ * material index in a contact, or a Lua callback that fails every frame.  Errors are counted per
+ * site (a fixed description of where it was raised) and key (the object, class, resource or Lua
+ * error it was about).  The first few of each are reported in full, as before.  After that they
+ * are only counted, and a summary of how many there were is written once per period.  When a
+ * key has gone a whole period without an error, it is forgotten, so its next errors are reported
+ * in full again.
+ *
+ * The number reported in full is the core option ERROR_BURST, the period (in seconds) is
+ * ERROR_SUMMARY_PERIOD.  At most 1024 keys are tracked at once, further ones are counted
+ * together until some are forgotten.  Errors from the interactive console are not counted, see
+ * my_lua_console_error_handler.
+ *
+ * All the functions can be called from any thread.
+ */
+
+/** Count an occurrence of the error, returning whether to report it in full. */
+bool error_aggregate (const std::string &site, const std::string &key);
+
+/** Write the summaries that are due.  Called every frame. */
+void error_aggregate_frame (void);
+
+/** Write the summaries now, e.g. before exiting. */
+void error_aggregate_flush (void);
+
+void error_aggregate_set_burst (unsigned burst);
+void error_aggregate_set_period (float seconds);
+
+struct ErrorAggregate {
+    std::string site;
+    std::string key;
+    /** Occurrences since the errors were cleared. */
+    unsigned long long count;
+    /** Of which not reported in full. */
+    unsigned long long suppressed;
+    /** Seconds since the first and the last of them. */
+    float sinceFirst;
+    float sinceLast;
+};
+
+/** Every site and key that has had an error recently (and not been forgotten), in order. */
+std::vector<ErrorAggregate> error_aggregate_all (void);
+
+/** Forget all the errors, so the next of each is reported in full. */
+void error_aggregate_clear (void);
+
+#endif
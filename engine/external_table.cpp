@@ -48,6 +48,7 @@ void ExternalTable::clear (lua_State *L)
     }
     fields.clear();
     elements.clear();
+    shape++;
 }
 const char *ExternalTable::luaGet (lua_State *L) const
 {
@@ -102,6 +103,11 @@ static void push (lua_State *L, const ExternalTable::Value &v)
     }
 }
 
+void ExternalTable::pushValue (lua_State *L, const Value &v)
+{
+    push(L, v);
+}
+
 const char *ExternalTable::luaGet (lua_State *L, const std::string &key) const
 {
     auto it = fields.find(key);
@@ -166,7 +172,7 @@ const char *ExternalTable::luaSet (lua_State *L, const std::string &key)
         self->takeTableFromLuaStack(L, lua_gettop(L));
         set(key, self);
     } else if (lua_type(L, -1) == LUA_TFUNCTION) {
-        Value &v = fields[key];
+        Value &v = field(key);
         v.func.setNoPop(L);
         v.type = 8;
     } else if (lua_type(L, -1) == LUA_TVECTOR2) {
@@ -211,7 +217,7 @@ const char *ExternalTable::luaSet (lua_State *L, lua_Number key)
         self->takeTableFromLuaStack(L, -1);
         set(key, self);
     } else if (lua_type(L, -1) == LUA_TFUNCTION) {
-        Value &v = elements[key];
+        Value &v = element(key);
         v.func.setNoPop(L);
         v.type = 8;
     } else if (lua_type(L, -1) == LUA_TVECTOR2) {
@@ -49,7 +49,7 @@ class ExternalTable {
 
     public:
 
-    ExternalTable (void) { }
+    ExternalTable (void) : shape(0) { }
 
     void destroy (lua_State *L);
 
@@ -263,122 +263,142 @@ class ExternalTable {
 
     void set (const std::string &key, const lua_Number r)
     {
-        fields[key].type = 0;
-        fields[key].real = r;
+        Value &v = field(key);
+        v.type = 0;
+        v.real = r;
     }
 
     void set (const std::string &key, const std::string &s)
     {
-        fields[key].type = 1;
-        fields[key].str = s;
+        Value &v = field(key);
+        v.type = 1;
+        v.str = s;
     }
 
     void set (const std::string &key, const Vector3 &v3)
     {
-        fields[key].type = 2;
-        fields[key].v3 = v3;
+        Value &v = field(key);
+        v.type = 2;
+        v.v3 = v3;
     }
 
     void set (const std::string &key, const Quaternion &q)
     {
-        fields[key].type = 3;
-        fields[key].q = q;
+        Value &v = field(key);
+        v.type = 3;
+        v.q = q;
     }
 
     void set (const std::string &key, bool b)
     {
-        fields[key].type = 4;
-        fields[key].b = b;
+        Value &v = field(key);
+        v.type = 4;
+        v.b = b;
     }
 
     void set (const std::string &key, const SharedPtr<ExternalTable> &t)
     {
-        fields[key].type = 5;
-        fields[key].t = t;
+        Value &v = field(key);
+        v.type = 5;
+        v.t = t;
     }
 
     void set (const std::string &key, Plot plot)
     {
-        fields[key].type = 6;
-        fields[key].plot = plot;
+        Value &v = field(key);
+        v.type = 6;
+        v.plot = plot;
     }
 
     void set (const std::string &key, PlotV3 plot_v3)
     {
-        fields[key].type = 7;
-        fields[key].plot_v3 = plot_v3;
+        Value &v = field(key);
+        v.type = 7;
+        v.plot_v3 = plot_v3;
     }
 
     void set (const std::string &key, const Vector2 &v2)
     {
-        fields[key].type = 9;
-        fields[key].v2 = v2;
+        Value &v = field(key);
+        v.type = 9;
+        v.v2 = v2;
     }
 
     void set (const std::string &key, const Vector4 &v4)
     {
-        fields[key].type = 10;
-        fields[key].v4 = v4;
+        Value &v = field(key);
+        v.type = 10;
+        v.v4 = v4;
     }
 
     void set (lua_Number key, const lua_Number r)
     {
-        elements[key].type = 0;
-        elements[key].real = r;
+        Value &v = element(key);
+        v.type = 0;
+        v.real = r;
     }
 
     void set (lua_Number key, const std::string &s)
     {
-        elements[key].type = 1;
-        elements[key].str = s;
+        Value &v = element(key);
+        v.type = 1;
+        v.str = s;
     }
 
     void set (lua_Number key, const Vector3 &v3)
     {
-        elements[key].type = 2;
-        elements[key].v3 = v3;
+        Value &v = element(key);
+        v.type = 2;
+        v.v3 = v3;
     }
 
     void set (lua_Number &key, const Quaternion &q)
     {
-        elements[key].type = 3;
-        elements[key].q = q;
+        Value &v = element(key);
+        v.type = 3;
+        v.q = q;
     }
 
     void set (lua_Number &key, bool b)
     {
-        elements[key].type = 4;
-        elements[key].b = b;
+        Value &v = element(key);
+        v.type = 4;
+        v.b = b;
     }
 
     void set (lua_Number &key, const SharedPtr<ExternalTable> &t)
     {
-        elements[key].type = 5;
-        elements[key].t = t;
+        Value &v = element(key);
+        v.type = 5;
+        v.t = t;
     }
 
     void set (lua_Number &key, const Plot &plot)
     {
-        elements[key].type = 6;
-        elements[key].plot = plot;
+        Value &v = element(key);
+        v.type = 6;
+        v.plot = plot;
     }
 
     void set (lua_Number &key, const PlotV3 &plot_v3)
     {
-        elements[key].type = 7;
-        elements[key].plot_v3 = plot_v3;
+        Value &v = element(key);
+        v.type = 7;
+        v.plot_v3 = plot_v3;
     }
 
     void set (lua_Number &key, const Vector2 &v2)
     {
-        elements[key].type = 9;
-        elements[key].v2 = v2;
+        Value &v = element(key);
+        v.type = 9;
+        v.v2 = v2;
     }
 
     void set (lua_Number &key, const Vector4 &v4)
     {
-        elements[key].type = 10;
-        elements[key].v4 = v4;
+        Value &v = element(key);
+        v.type = 10;
+        v.v4 = v4;
     }
 
     const char *luaGet (lua_State *L) const;
@@ -390,8 +410,12 @@ class ExternalTable {
     const char *luaGet (lua_State *L, lua_Number key) const;
     const char *luaSet (lua_State *L, lua_Number key);
 
-    void unset (const std::string &key) { fields.erase(key); }
-    void unset (lua_Number key) { elements.erase(key); }
+    void unset (const std::string &key) { if (fields.erase(key)) shape++; }
+    void unset (lua_Number key) { if (elements.erase(key)) shape++; }
+
+    /** Changes whenever a key is added or removed, but not when just a value changes.  This
+     * allows callers to cache which keys are present. */
+    unsigned long getShape (void) const { return shape; }
 
     void clear (lua_State *L);
 
@@ -436,12 +460,43 @@ class ExternalTable {
 
     typedef std::map<lua_Number, Value> NumberMap;
 
+    typedef NumberMap::const_iterator ConstElementIterator;
+    ConstElementIterator elementsBegin (void) const { return elements.begin(); }
+    ConstElementIterator elementsEnd (void) const { return elements.end(); }
+
+    /** Push a value onto the Lua stack. */
+    static void pushValue (lua_State *L, const Value &v);
+
     protected:
 
+    /** Find or add the value for the key. */
+    Value &field (const std::string &key)
+    {
+        auto it = fields.lower_bound(key);
+        if (it == fields.end() || it->first != key) {
+            shape++;
+            it = fields.insert(it, StringMap::value_type(key, Value()));
+        }
+        return it->second;
+    }
+
+    /** Find or add the value for the key. */
+    Value &element (lua_Number key)
+    {
+        auto it = elements.lower_bound(key);
+        if (it == elements.end() || it->first != key) {
+            shape++;
+            it = elements.insert(it, NumberMap::value_type(key, Value()));
+        }
+        return it->second;
+    }
+
     StringMap fields;
 
     NumberMap elements;
 
+    unsigned long shape;
+
 };
 
 #endif
@@ -0,0 +1,139 @@
+/* Copyright (c) The Grit Game Engine authors 2016
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "frame_allocator.h"
+
+// The block never shrinks, and is at least this big once it has been used.
+static const size_t MIN_CAPACITY = 16 * 1024;
+
+FrameArena::FrameArena (void)
+  : block(NULL), capacity(0), top(0), live(0), frameOverflowBytes(0), frameHighWater(0),
+    wanted(0), lastHighWater(0), maxHighWater(0), overflows(0)
+{
+}
+
+FrameArena::~FrameArena (void)
+{
+    ::operator delete(block);
+}
+
+void *FrameArena::overflow (size_t bytes)
+{
+    // The heap aligns for any type, so the alignment asked for does not matter.
+    overflows++;
+    frameOverflowBytes += bytes;
+    if (top + frameOverflowBytes > frameHighWater) frameHighWater = top + frameOverflowBytes;
+    return ::operator new(bytes);
+}
+
+void FrameArena::endFrame (void)
+{
+    lastHighWater = frameHighWater;
+    if (lastHighWater > maxHighWater) maxHighWater = lastHighWater;
+    if (frameOverflowBytes > 0 && frameHighWater > wanted) wanted = frameHighWater;
+
+    // The block can only be replaced when nothing is using it.
+    if (wanted > capacity && live == 0) {
+        size_t new_capacity = wanted + wanted / 2;
+        if (new_capacity < MIN_CAPACITY) new_capacity = MIN_CAPACITY;
+        ::operator delete(block);
+        block = static_cast<char*>(::operator new(new_capacity));
+        capacity = new_capacity;
+        top = 0;
+    }
+
+    frameOverflowBytes = 0;
+    frameHighWater = top;
+}
+
+FrameArena &frame_arena (void)
+{
+    static thread_local FrameArena arena;
+    return arena;
+}
+
+void frame_arena_end_frame (void)
+{
+    frame_arena().endFrame();
+}
+
+
+// Counting heap allocations -----------------------------------------------------
+
+#ifdef USE_HEAP_COUNT
+
+static std::atomic<unsigned long long> heap_allocation_counter(0);
+
+unsigned long long heap_allocations (void)
+{
+    return heap_allocation_counter.load(std::memory_order_relaxed);
+}
+
+void *operator new (size_t sz)
+{
+    heap_allocation_counter.fetch_add(1, std::memory_order_relaxed);
+    void *p = malloc(sz == 0 ? 1 : sz);
+    if (p == NULL) throw std::bad_alloc();
+    return p;
+}
+
+void *operator new[] (size_t sz)
+{
+    return operator new(sz);
+}
+
+void *operator new (size_t sz, const std::nothrow_t &) noexcept
+{
+    heap_allocation_counter.fetch_add(1, std::memory_order_relaxed);
+    return malloc(sz == 0 ? 1 : sz);
+}
+
+void *operator new[] (size_t sz, const std::nothrow_t &nt) noexcept
+{
+    return operator new(sz, nt);
+}
+
+void operator delete (void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete[] (void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete (void *p, const std::nothrow_t &) noexcept
+{
+    free(p);
+}
+
+void operator delete[] (void *p, const std::nothrow_t &) noexcept
+{
+    free(p);
+}
+
+#endif
@@ -0,0 +1,162 @@
+/* Copyright (c) The Grit Game Engine authors 2016
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef FrameAllocator_h
+#define FrameAllocator_h
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/** \file
+ *
+ * Scratch memory for temporary containers that do not outlive the frame that created them.
+ * Each thread has an arena: a single block that allocations are carved from in order.  Freeing
+ * the most recent allocation gives its memory back, and when nothing allocated from the arena
+ * is still alive, the whole block is free again.  So a function that fills a FrameVector and
+ * then returns costs no calls to the heap.
+ *
+ * If the block is full, allocations fall back to the heap.  At the end of the frame, a block
+ * that overflowed is replaced by one large enough for the most that frame used, so the heap is
+ * only touched until the workload settles.  The frame of the main thread's arena is ended by
+ * gfx_render (or by scripts calling frame_arena_end_frame when not rendering).  Other threads
+ * must call frame_arena_end_frame themselves, or their arena never grows.
+ *
+ * Memory from an arena must be freed on the thread that allocated it.
+ */
+
+class FrameArena {
+
+  public:
+
+    FrameArena (void);
+
+    ~FrameArena (void);
+
+    void *allocate (size_t bytes, size_t align)
+    {
+        size_t start = (top + align - 1) & ~(align - 1);
+        if (start + bytes > capacity) return overflow(bytes);
+        top = start + bytes;
+        if (top > frameHighWater) frameHighWater = top;
+        live++;
+        return block + start;
+    }
+
+    void deallocate (void *p, size_t bytes)
+    {
+        uintptr_t addr = reinterpret_cast<uintptr_t>(p);
+        uintptr_t base = reinterpret_cast<uintptr_t>(block);
+        if (addr < base || addr >= base + capacity) {
+            ::operator delete(p);
+            return;
+        }
+        if (addr + bytes == base + top) top = addr - base;
+        if (--live == 0) top = 0;
+    }
+
+    /** Record the frame's high water mark, and if the block overflowed, grow it to fit. */
+    void endFrame (void);
+
+    /** Size of the block in bytes. */
+    size_t getCapacity (void) const { return capacity; }
+
+    /** Bytes currently allocated, not counting overflow. */
+    size_t getUsed (void) const { return top; }
+
+    /** The most bytes used during the last complete frame, including overflow. */
+    size_t getLastHighWater (void) const { return lastHighWater; }
+
+    /** The most bytes used during any complete frame, including overflow. */
+    size_t getMaxHighWater (void) const { return maxHighWater; }
+
+    /** The number of allocations that did not fit in the block. */
+    unsigned long getOverflows (void) const { return overflows; }
+
+  private:
+
+    void *overflow (size_t bytes);
+
+    char *block;
+    size_t capacity;
+    size_t top;
+    size_t live;
+    size_t frameOverflowBytes;
+    size_t frameHighWater;
+    // The most used during a frame that overflowed, for growing the block when possible.
+    size_t wanted;
+    size_t lastHighWater;
+    size_t maxHighWater;
+    unsigned long overflows;
+};
+
+/** The calling thread's arena. */
+FrameArena &frame_arena (void);
+
+/** End the frame of the calling thread's arena. */
+void frame_arena_end_frame (void);
+
+#ifdef USE_HEAP_COUNT
+/** The number of allocations by operator new since startup, from all threads.  Only available
+ * when built with USE_HEAP_COUNT, as it replaces the global operator new. */
+unsigned long long heap_allocations (void);
+#endif
+
+/** An STL allocator that uses the arena of the thread that constructs it. */
+template<class T> class FrameAllocator {
+
+  public:
+
+    typedef T value_type;
+
+    FrameAllocator (void) : arena(&frame_arena()) { }
+
+    template<class U> FrameAllocator (const FrameAllocator<U> &other) : arena(other.arena) { }
+
+    T *allocate (size_t n)
+    {
+        return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate (T *p, size_t n)
+    {
+        arena->deallocate(p, n * sizeof(T));
+    }
+
+    FrameArena *arena;
+};
+
+template<class T, class U>
+bool operator== (const FrameAllocator<T> &a, const FrameAllocator<U> &b)
+{
+    return a.arena == b.arena;
+}
+
+template<class T, class U>
+bool operator!= (const FrameAllocator<T> &a, const FrameAllocator<U> &b)
+{
+    return a.arena != b.arena;
+}
+
+template<class T> using FrameVector = std::vector<T, FrameAllocator<T>>;
+
+#endif
@@ -18,15 +18,27 @@
  * THE SOFTWARE.
  */
 
+#include <algorithm>
+#include <cstring>
 #include <sstream>
 
+#include <OgreArchiveManager.h>
+#include <OgreFileSystem.h>
+
 #include <sleep.h>
 
+#include "../async_io.h"
+#include "../disk_resource.h"
+#include "../error_aggregate.h"
+#include "../host_cache.h"
 #include "../path_util.h"
 #include "../main.h"
 #include "../clipboard.h"
+#include "../frame_allocator.h"
+#include "../metrics.h"
 
 #include "clutter.h"
+#include "gfx_auto_instancing.h"
 #include "gfx_body.h"
 #include "gfx_debug.h"
 #include "gfx_decal.h"
@@ -35,11 +47,14 @@
 #include "gfx_internal.h"
 #include "gfx_light.h"
 #include "gfx_material.h"
+#include "gfx_mesh_geometry.h"
 #include "gfx_option.h"
 #include "gfx_pipeline.h"
+#include "gfx_shader.h"
 #include "gfx_sky_body.h"
 #include "gfx_sky_material.h"
 #include "gfx_sprite_body.h"
+#include "gfx_texture_streaming.h"
 #include "gfx_tracer_body.h"
 
 #ifdef WIN32
@@ -569,6 +584,9 @@ void gfx_render (float elapsed, const Vector3 &cam_pos, const Quaternion &cam_di
     }
 
     try {
+        // Before the materials update their passes, so new shaders are used straight away.
+        gfx_shader_frame();
+
         if (reset_frame_buffer_on_next_render) {
             reset_frame_buffer_on_next_render = false;
             do_reset_framebuffer();
@@ -642,6 +660,10 @@ void gfx_render (float elapsed, const Vector3 &cam_pos, const Quaternion &cam_di
             ogre_win->_endUpdate();
 
             ogre_rs->_swapAllRenderTargetBuffers();
+
+            // Bodies have now requested texture resolutions for this frame.
+            gfx_texture_streaming_update();
+            gfx_auto_instancing_end_frame();
         } else {
             // corresponds to 100fps
             mysleep(10000);
@@ -654,6 +676,11 @@ void gfx_render (float elapsed, const Vector3 &cam_pos, const Quaternion &cam_di
         CERR << e << std::endl;
     }
 
+    // Scratch memory used during the frame is all free again now.
+    frame_arena_end_frame();
+    metrics_frame();
+    error_aggregate_frame();
+
     ogre_rs->markProfileEvent("end grit frame");
 }
 
@@ -882,6 +909,119 @@ struct MeshSerializerListener : Ogre::MeshSerializerListener {
     }
 } mesh_serializer_listener;
 
+static Ogre::DataStreamPtr memory_stream (const Ogre::String &filename, const unsigned char *data,
+                                          size_t size)
+{
+    auto *stream = OGRE_NEW Ogre::MemoryDataStream(filename, size);
+    if (size > 0) memcpy(stream->getPtr(), data, size);
+    return Ogre::DataStreamPtr(stream);
+}
+
+// Reads a file from the host cache, decompressing a block at a time as it is reached, so reading
+// part of the file (e.g. the mips of a DDS that are wanted) does not decompress the rest.
+class HostCacheDataStream : public Ogre::DataStream {
+    std::shared_ptr<const HostCacheFile> file;
+    size_t pos;
+    // The decompressed block, if any.
+    bool haveBlock;
+    size_t block;
+    std::vector<unsigned char> buf;
+
+    public:
+    HostCacheDataStream (const Ogre::String &filename,
+                         const std::shared_ptr<const HostCacheFile> &file)
+      : Ogre::DataStream(filename), file(file), pos(0), haveBlock(false), block(0),
+        buf(HOST_CACHE_BLOCK)
+    {
+        mSize = size_t(file->size);
+    }
+
+    size_t read (void *out, size_t count)
+    {
+        unsigned char *dest = static_cast<unsigned char*>(out);
+        size_t done = 0;
+        while (done < count && pos < mSize) {
+            size_t b = pos / HOST_CACHE_BLOCK;
+            if (!haveBlock || block != b) {
+                haveBlock = false;
+                if (!file->readBlock(b, &buf[0]))
+                    GRIT_EXCEPT("Host cache entry was corrupt: \"" + getName() + "\"");
+                haveBlock = true;
+                block = b;
+            }
+            size_t offset = pos - b * HOST_CACHE_BLOCK;
+            size_t n = std::min(count - done, file->blockSize(b) - offset);
+            memcpy(dest + done, &buf[offset], n);
+            done += n;
+            pos += n;
+        }
+        return done;
+    }
+
+    void skip (long count)
+    {
+        if (count < 0 && size_t(-count) > pos) pos = 0;
+        else pos = std::min(mSize, size_t(pos + count));
+    }
+
+    void seek (size_t p) { pos = std::min(mSize, p); }
+
+    size_t tell (void) const { return pos; }
+
+    bool eof (void) const { return pos >= mSize; }
+
+    void close (void) { }
+};
+
+// Ogre opens resource files through this, so they are taken from memory when possible: the
+// buffer async_io read ahead of the load, or the host cache.  Otherwise the file is read from
+// disk as it would be without this, so a reader that seeks only reads what it wants.
+struct GritFileSystemArchive : Ogre::FileSystemArchive {
+    GritFileSystemArchive (const Ogre::String &name, const Ogre::String &type, bool read_only)
+      : Ogre::FileSystemArchive(name, type, read_only)
+    { }
+
+    Ogre::DataStreamPtr open (const Ogre::String &filename, bool read_only) const
+    {
+        if (!read_only) return Ogre::FileSystemArchive::open(filename, read_only);
+        std::string name = "/" + filename;
+
+        auto data = async_io_get(name);
+        if (data != nullptr) {
+            disk_resource_file_opened(data->size());
+            return memory_stream(filename, data->empty() ? nullptr : &(*data)[0], data->size());
+        }
+
+        auto cached = host_cache_get(name);
+        if (cached != nullptr) {
+            disk_resource_file_opened(size_t(cached->size));
+            return Ogre::DataStreamPtr(OGRE_NEW HostCacheDataStream(filename, cached));
+        }
+
+        Ogre::DataStreamPtr stream = Ogre::FileSystemArchive::open(filename, read_only);
+        disk_resource_file_opened(stream->size());
+        return stream;
+    }
+};
+
+struct GritFileSystemArchiveFactory : Ogre::ArchiveFactory {
+    const Ogre::String &getType (void) const
+    {
+        static const Ogre::String type = "GritFileSystem";
+        return type;
+    }
+
+    Ogre::Archive *createInstance (const Ogre::String &name, bool read_only)
+    {
+        return OGRE_NEW GritFileSystemArchive(name, getType(), read_only);
+    }
+
+    void destroyInstance (Ogre::Archive *archive)
+    {
+        OGRE_DELETE archive;
+    }
+} grit_file_system_archive_factory;
+
 struct WindowEventListener : Ogre::WindowEventListener {
 
     void windowResized(Ogre::RenderWindow *rw)
@@ -1054,7 +1194,9 @@ size_t gfx_init (GfxCallback &cb_)
 
         Ogre::MeshManager::getSingleton().setListener(&mesh_serializer_listener);
         Ogre::WindowEventUtilities::addWindowEventListener(ogre_win, &window_event_listener);
-        Ogre::ResourceGroupManager::getSingleton().addResourceLocation(".", "FileSystem", RESGRP, true);
+        Ogre::ArchiveManager::getSingleton().addArchiveFactory(&grit_file_system_archive_factory);
+        Ogre::ResourceGroupManager::getSingleton().addResourceLocation(
+            ".", grit_file_system_archive_factory.getType(), RESGRP, true);
         Ogre::ResourceGroupManager::getSingleton().initialiseAllResourceGroups();
 
         Ogre::GpuProgramManager::getSingleton().setSaveMicrocodesToCache(false);
@@ -1081,6 +1223,8 @@ size_t gfx_init (GfxCallback &cb_)
         hud_init();
         gfx_decal_init();
         gfx_debug_init();
+        gfx_texture_streaming_init();
+        gfx_auto_instancing_init();
  
         gfx_env_cube(0, DiskResourcePtr<GfxEnvCubeDiskResource>());
         gfx_env_cube(1, DiskResourcePtr<GfxEnvCubeDiskResource>());
@@ -1133,6 +1277,9 @@ void gfx_shutdown (void)
         if (shutting_down) return;
         gfx_debug_shutdown();
         gfx_decal_shutdown();
+        gfx_texture_streaming_shutdown();
+        gfx_auto_instancing_shutdown();
+        gfx_mesh_geometry_shutdown();
         shutting_down = true;
         delete eye_left;
         delete eye_right;
@@ -0,0 +1,319 @@
+/* Copyright (c) The Grit Game Engine authors 2016
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+#include "gfx_auto_instancing.h"
+#include "gfx_body.h"
+#include "gfx_internal.h"
+#include "gfx_material.h"
+
+// Must match the instanced vertex declaration expected by the gasoline backends, see also
+// GfxInstances.
+static const unsigned instance_data_floats = 13;
+static const unsigned instance_data_bytes = instance_data_floats*4;
+
+namespace {
+
+    /** Draws that can be merged. */
+    struct Key {
+        Ogre::SubMesh *subMesh;
+        GfxMaterial *mat;
+        GfxPaintColour colours[4];
+        bool shadowCast;
+
+        bool operator== (const Key &other) const
+        {
+            if (subMesh != other.subMesh || mat != other.mat) return false;
+            if (shadowCast != other.shadowCast) return false;
+            for (int k=0 ; k<4 ; ++k) {
+                const GfxPaintColour &a = colours[k];
+                const GfxPaintColour &b = other.colours[k];
+                if (a.diff.x != b.diff.x || a.diff.y != b.diff.y || a.diff.z != b.diff.z)
+                    return false;
+                if (a.met != b.met || a.gloss != b.gloss || a.spec != b.spec) return false;
+            }
+            return true;
+        }
+    };
+
+    struct KeyHash {
+        size_t operator() (const Key &k) const
+        {
+            // Paint colours rarely distinguish draws of the same submesh and material.
+            size_t r = std::hash<const void*>()(k.subMesh);
+            r = r * 31 + std::hash<const void*>()(k.mat);
+            r = r * 31 + size_t(k.shadowCast);
+            return r;
+        }
+    };
+
+    struct Group {
+        Key key;
+        std::vector<GfxBody*> bodies;
+        std::vector<unsigned> subs;
+        std::vector<float> instanceData;
+    };
+
+    /** An instanced draw of one group.  These are reused from one pass to the next. */
+    class Batch : public Ogre::Renderable {
+
+        Ogre::RenderOperation op;
+        Ogre::MaterialPtr mat;
+        Ogre::VertexDeclaration *decl;
+        Ogre::VertexBufferBinding *binding;
+        Ogre::VertexData *vertexData;
+        Ogre::HardwareVertexBufferSharedPtr instBuf;
+        unsigned instBufCapacity;
+        // The mesh vertex data that decl was built from.
+        Ogre::VertexData *declSource;
+        unsigned short instSource;
+
+        public:
+
+        Batch (void)
+          : instBufCapacity(0), declSource(NULL), instSource(0)
+        {
+            Ogre::HardwareBufferManager &hbm = Ogre::HardwareBufferManager::getSingleton();
+            decl = hbm.createVertexDeclaration();
+            binding = hbm.createVertexBufferBinding();
+            vertexData = OGRE_NEW Ogre::VertexData(decl, binding);
+        }
+
+        ~Batch (void)
+        {
+            OGRE_DELETE vertexData;
+            Ogre::HardwareBufferManager &hbm = Ogre::HardwareBufferManager::getSingleton();
+            hbm.destroyVertexBufferBinding(binding);
+            hbm.destroyVertexDeclaration(decl);
+        }
+
+        void reset (const Group &g)
+        {
+            g.key.subMesh->_getRenderOperation(op, 0);
+            Ogre::VertexData *src = op.vertexData;
+
+            if (src != declSource) {
+                decl->removeAllElements();
+                for (const auto &e : src->vertexDeclaration->getElements())
+                    decl->addElement(e.getSource(), e.getOffset(), e.getType(), e.getSemantic(),
+                                     e.getIndex());
+                instSource = src->vertexBufferBinding->getLastBoundIndex();
+                unsigned sz = 0;
+                sz += decl->addElement(instSource, sz, Ogre::VET_FLOAT3, Ogre::VES_TEXTURE_COORDINATES, 1).getSize();
+                sz += decl->addElement(instSource, sz, Ogre::VET_FLOAT3, Ogre::VES_TEXTURE_COORDINATES, 2).getSize();
+                sz += decl->addElement(instSource, sz, Ogre::VET_FLOAT3, Ogre::VES_TEXTURE_COORDINATES, 3).getSize();
+                sz += decl->addElement(instSource, sz, Ogre::VET_FLOAT3, Ogre::VES_TEXTURE_COORDINATES, 4).getSize();
+                sz += decl->addElement(instSource, sz, Ogre::VET_FLOAT1, Ogre::VES_TEXTURE_COORDINATES, 5).getSize();
+                APP_ASSERT(sz == instance_data_bytes);
+                declSource = src;
+            }
+
+            unsigned instances = g.bodies.size();
+            if (instances > instBufCapacity) {
+                instBufCapacity = std::max(64u, unsigned(instances * 1.5));
+                instBuf = Ogre::HardwareBufferManager::getSingleton().createVertexBuffer(
+                    instance_data_bytes, instBufCapacity,
+                    Ogre::HardwareBuffer::HBU_DYNAMIC_WRITE_ONLY_DISCARDABLE);
+                instBuf->setIsInstanceData(true);
+                instBuf->setInstanceDataStepRate(1);
+            }
+            instBuf->writeData(0, instances * instance_data_bytes, &g.instanceData[0], true);
+
+            binding->unsetAllBindings();
+            for (const auto &b : src->vertexBufferBinding->getBindings())
+                binding->setBinding(b.first, b.second);
+            binding->setBinding(instSource, instBuf);
+            vertexData->vertexStart = src->vertexStart;
+            vertexData->vertexCount = src->vertexCount;
+
+            op.vertexData = vertexData;
+            op.numberOfInstances = instances;
+
+            // For shadow casting, Ogre chases the technique's shadow caster material, which is
+            // the instancing cast material.
+            mat = g.key.mat->instancingMat;
+
+            // The 0th one is fade, which comes from the instance data instead.
+            for (int k=0 ; k<4 ; ++k) {
+                const GfxPaintColour &c = g.key.colours[k];
+                setCustomParameter(4*k+1, Ogre::Vector4(c.diff.x, c.diff.y, c.diff.z, 0));
+                setCustomParameter(4*k+2, Ogre::Vector4(c.met, 0, 0, 0));
+                setCustomParameter(4*k+3, Ogre::Vector4(c.gloss, 0, 0, 0));
+                setCustomParameter(4*k+4, Ogre::Vector4(c.spec, 0, 0, 0));
+            }
+        }
+
+        // Renderable stuff
+
+        const Ogre::MaterialPtr& getMaterial (void) const { return mat; }
+        void getRenderOperation (Ogre::RenderOperation& o) { o = op; }
+        void getWorldTransforms (Ogre::Matrix4* xform) const
+        { xform[0] = Ogre::Matrix4::IDENTITY; }
+        Ogre::Real getSquaredViewDepth (const Ogre::Camera *) const { return 0; }
+        const Ogre::LightList &getLights (void) const
+        {
+            static Ogre::LightList no_lights;
+            return no_lights;
+        }
+    };
+
+    std::unordered_map<Key, unsigned, KeyHash> group_index;
+    // Only the first num_groups are in use, the rest are kept to reuse their storage.
+    std::vector<Group> groups;
+    unsigned num_groups = 0;
+
+    std::vector<Batch*> batches;
+
+    unsigned draws_before = 0, draws_after = 0;
+    unsigned last_draws_before = 0, last_draws_after = 0;
+
+    // Whether the mesh leaves texture coordinates 1 and above free for the instance data.
+    bool instancing_compatible (Ogre::SubMesh *sm)
+    {
+        if (!sm->useSharedVertices) return false;
+        const Ogre::VertexDeclaration *decl = sm->parent->sharedVertexData->vertexDeclaration;
+        for (const auto &e : decl->getElements()) {
+            if (e.getSemantic() == Ogre::VES_TEXTURE_COORDINATES && e.getIndex() > 0) return false;
+        }
+        return true;
+    }
+
+    void flush (Ogre::RenderQueue *queue)
+    {
+        unsigned next_batch = 0;
+        for (unsigned i=0 ; i<num_groups ; ++i) {
+            const Group &g = groups[i];
+            if (g.bodies.size() < 2 || !instancing_compatible(g.key.subMesh)) {
+                for (unsigned j=0 ; j<g.bodies.size() ; ++j)
+                    g.bodies[j]->queueSub(queue, g.subs[j], g.key.shadowCast);
+                draws_after += g.bodies.size();
+                continue;
+            }
+            if (next_batch == batches.size()) batches.push_back(new Batch());
+            Batch *b = batches[next_batch++];
+            b->reset(g);
+            queue->addRenderable(b, g.key.shadowCast ? 0 : RQ_GBUFFER_OPAQUE, 0);
+            draws_after++;
+        }
+        group_index.clear();
+        num_groups = 0;
+    }
+
+    class Listener : public Ogre::SceneManager::Listener {
+        public:
+        void preFindVisibleObjects (Ogre::SceneManager *, Ogre::SceneManager::IlluminationRenderStage,
+                                    Ogre::Viewport *)
+        {
+            group_index.clear();
+            num_groups = 0;
+        }
+        void postFindVisibleObjects (Ogre::SceneManager *sm, Ogre::SceneManager::IlluminationRenderStage,
+                                     Ogre::Viewport *)
+        {
+            flush(sm->getRenderQueue());
+        }
+    };
+
+    Listener listener;
+}
+
+bool gfx_auto_instancing_add (GfxBody *body, unsigned sub, Ogre::SubMesh *sm, GfxMaterial *mat,
+                              const GfxPaintColour *colours, const Transform &world, float fade,
+                              bool shadow_cast)
+{
+    draws_before++;
+    if (!gfx_option(GFX_AUTO_INSTANCING) || mat->getSceneBlend() != GFX_MATERIAL_OPAQUE) {
+        draws_after++;
+        return false;
+    }
+
+    Key key;
+    key.subMesh = sm;
+    key.mat = mat;
+    key.shadowCast = shadow_cast;
+    static const GfxPaintColour no_paint = { Vector3(0, 0, 0), 0, 0, 0 };
+    for (int k=0 ; k<4 ; ++k) {
+        // Paint does not affect shadows.
+        key.colours[k] = shadow_cast ? no_paint : colours[k];
+    }
+
+    auto it = group_index.find(key);
+    unsigned index;
+    if (it == group_index.end()) {
+        index = num_groups++;
+        if (index == groups.size()) groups.emplace_back();
+        Group &g = groups[index];
+        g.key = key;
+        g.bodies.clear();
+        g.subs.clear();
+        g.instanceData.clear();
+        group_index[key] = index;
+    } else {
+        index = it->second;
+    }
+
+    Group &g = groups[index];
+    g.bodies.push_back(body);
+    g.subs.push_back(sub);
+    // Rows of the rotation / scale, then position, then fade.
+    for (int row=0 ; row<3 ; ++row) {
+        for (int col=0 ; col<3 ; ++col) {
+            g.instanceData.push_back(world.mat[row][col]);
+        }
+    }
+    g.instanceData.push_back(world.pos.x);
+    g.instanceData.push_back(world.pos.y);
+    g.instanceData.push_back(world.pos.z);
+    g.instanceData.push_back(fade);
+    return true;
+}
+
+void gfx_auto_instancing_stats (unsigned &before, unsigned &after)
+{
+    before = last_draws_before;
+    after = last_draws_after;
+}
+
+void gfx_auto_instancing_end_frame (void)
+{
+    last_draws_before = draws_before;
+    last_draws_after = draws_after;
+    draws_before = 0;
+    draws_after = 0;
+}
+
+void gfx_auto_instancing_init (void)
+{
+    ogre_sm->addListener(&listener);
+}
+
+void gfx_auto_instancing_shutdown (void)
+{
+    ogre_sm->removeListener(&listener);
+    for (auto *b : batches) delete b;
+    batches.clear();
+    groups.clear();
+    group_index.clear();
+    num_groups = 0;
+}
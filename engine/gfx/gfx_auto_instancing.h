@@ -0,0 +1,61 @@
+/* Copyright (c) The Grit Game Engine authors 2016
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+class GfxBody;
+class GfxMaterial;
+struct GfxPaintColour;
+
+#ifndef GFX_AUTO_INSTANCING_H
+#define GFX_AUTO_INSTANCING_H
+
+#include <math_util.h>
+
+/** \file
+ *
+ * Draws of the same submesh with the same material and paint colours, by different GfxBody
+ * objects, are merged into a single instanced draw.  Bodies offer their opaque submeshes here
+ * instead of adding them to the render queue.  Once the scene manager has visited every visible
+ * object, each group of two or more is drawn with the material's instancing shader, using a
+ * per-frame instance buffer holding each body's world transform and fade.  Groups of one are
+ * handed back to their body to be queued as usual.
+ *
+ * Submeshes of bodies with skeletons, alpha blended materials, and meshes that already use
+ * texture coordinates 1 and above (which instancing needs for per-instance data) are never
+ * merged.
+ */
+
+/** Offer a submesh draw for merging.  Returns false if it cannot be merged, in which case the
+ * caller must queue it itself. */
+bool gfx_auto_instancing_add (GfxBody *body, unsigned sub, Ogre::SubMesh *sm, GfxMaterial *mat,
+                              const GfxPaintColour *colours, const Transform &world, float fade,
+                              bool shadow_cast);
+
+/** Number of submesh draws offered by bodies (including ones that could not be merged), and the
+ * number of draws actually queued for them, during the last frame. */
+void gfx_auto_instancing_stats (unsigned &draws_before, unsigned &draws_after);
+
+/** Called once per frame, after rendering. */
+void gfx_auto_instancing_end_frame (void);
+
+void gfx_auto_instancing_init (void);
+void gfx_auto_instancing_shutdown (void);
+
+#endif
@@ -23,6 +23,7 @@
 
 #include "gfx_internal.h"
 
+#include "gfx_auto_instancing.h"
 #include "gfx_body.h"
 
 const std::string GfxBody::className = "GfxBody";
@@ -123,6 +124,18 @@ void GfxBody::updateBoneMatrixes (void)
     }
 }
 
+// Largest factor by which the transform stretches any axis.
+static float max_scale (const Transform &t)
+{
+    float r = 0;
+    for (int col=0 ; col<3 ; ++col) {
+        float len2 = 0;
+        for (int row=0 ; row<3 ; ++row) len2 += t.mat[row][col] * t.mat[row][col];
+        r = std::max(r, len2);
+    }
+    return sqrtf(r);
+}
+
 void GfxBody::_updateRenderQueue(Ogre::RenderQueue* queue)
 {
     bool shadow_cast =
@@ -133,6 +146,9 @@ void GfxBody::_updateRenderQueue(Ogre::RenderQueue* queue)
     bool do_wireframe = (wireframe || gfx_option(GFX_WIREFRAME));
     bool do_regular = !do_wireframe || gfx_option(GFX_WIREFRAME_SOLID);
 
+    // Skinned bodies have per-body bone matrixes, so cannot be drawn with anything else.
+    bool merge = skeleton == NULL;
+
     // fade is used by both shadow_cast and regular pass
     // we could potentially move this out of the frame loop if it affects performance
     for (unsigned i=0 ; i<subList.size() ; ++i) {
@@ -152,20 +168,27 @@ void GfxBody::_updateRenderQueue(Ogre::RenderQueue* queue)
             if (!sub->getCastShadows()) continue;
             if (!m->getCastShadows()) continue;
 
-            // Ogre chases ->getTechnique(0)->getShadowCasterMaterial() to get the actual one
-            // which is m->castMat
-            renderMaterial = m->regularMat;
+            if (merge && gfx_auto_instancing_add(this, i, sub->getSubMesh(), m, colours,
+                                                 worldTransform, fade, true))
+                continue;
 
-            queue->addRenderable(sub, 0, 0);
+            queueSub(queue, i, true);
         }
 
     } else {
 
+        // How big we are on screen, so streamed textures are loaded at the right resolution.
+        float pixels = gfx_texture_streaming_screen_size(ogre_sm->getCameraInProgress(),
+                                                         worldTransform.pos,
+                                                         getBoundingRadius() * max_scale(worldTransform));
+
         // Add each visible Sub to the queue
         for (unsigned i=0 ; i<subList.size() ; ++i) {
 
             Sub *sub = subList[i];
 
+            sub->material->requestTexturePixels(pixels);
+
             // car paint
             for (int k=0 ; k<4 ; ++k) {
                 const GfxPaintColour &c = colours[k];
@@ -196,17 +219,12 @@ void GfxBody::_updateRenderQueue(Ogre::RenderQueue* queue)
                     renderMaterial = m->regularMat;
                 }
                 */
-                renderMaterial = m->regularMat;
-
-                int queue_group = RQ_GBUFFER_OPAQUE;
-                switch (m->getSceneBlend()) {
-                    case GFX_MATERIAL_OPAQUE:      queue_group = RQ_GBUFFER_OPAQUE; break;
-                    case GFX_MATERIAL_ALPHA:       queue_group = RQ_FORWARD_ALPHA; break;
-                    case GFX_MATERIAL_ALPHA_DEPTH: queue_group = RQ_FORWARD_ALPHA_DEPTH; break;
-                }
-                queue->addRenderable(sub, queue_group, 0);
+                if (!merge || !gfx_auto_instancing_add(this, i, sub->getSubMesh(), m, colours,
+                                                       worldTransform, fade, false))
+                    queueSub(queue, i, false);
 
                 if (m->getAdditionalLighting() && sub->emissiveEnabled) {
+                    int queue_group = RQ_FORWARD_OPAQUE_EMISSIVE;
                     renderMaterial = m->additionalMat;
                     switch (m->getSceneBlend()) {
                         case GFX_MATERIAL_OPAQUE:      queue_group = RQ_FORWARD_OPAQUE_EMISSIVE; break;
@@ -230,6 +248,31 @@ void GfxBody::_updateRenderQueue(Ogre::RenderQueue* queue)
 
 }
 
+void GfxBody::queueSub (Ogre::RenderQueue *queue, unsigned i, bool shadow_cast)
+{
+    Sub *sub = subList[i];
+    GfxMaterial *m = sub->material;
+
+    // Ogre asks the Sub for its material while adding it, which gives renderMaterial.
+    renderMaterial = m->regularMat;
+
+    if (shadow_cast) {
+        // Ogre chases ->getTechnique(0)->getShadowCasterMaterial() to get the actual one
+        // which is m->castMat
+        queue->addRenderable(sub, 0, 0);
+    } else {
+        int queue_group = RQ_GBUFFER_OPAQUE;
+        switch (m->getSceneBlend()) {
+            case GFX_MATERIAL_OPAQUE:      queue_group = RQ_GBUFFER_OPAQUE; break;
+            case GFX_MATERIAL_ALPHA:       queue_group = RQ_FORWARD_ALPHA; break;
+            case GFX_MATERIAL_ALPHA_DEPTH: queue_group = RQ_FORWARD_ALPHA_DEPTH; break;
+        }
+        queue->addRenderable(sub, queue_group, 0);
+    }
+
+    renderMaterial.setNull();
+}
+
 void GfxBody::visitRenderables(Ogre::Renderable::Visitor* visitor, bool)
 {
     // Visit each Sub
@@ -287,8 +330,6 @@ GfxBody::GfxBody (const DiskResourcePtr<GfxMeshDiskResource> &gdr, const GfxStri
 
     mesh = gdr->getOgreMeshPtr();
 
-    mesh->load();
-
     memset(colours, 0, sizeof(colours));
 
     fade = 1;
@@ -342,6 +383,7 @@ void GfxBody::destroyGraphics (void)
 
 void GfxBody::reinitialise (void)
 {
+    geometry = gdr->getGeometry();
     APP_ASSERT(mesh->isLoaded());
 
     destroyGraphics();
@@ -435,7 +477,7 @@ unsigned GfxBody::getBatchesWithChildren (void) const
 
 unsigned GfxBody::getVertexes (void) const
 {
-    return mesh->sharedVertexData->vertexCount;
+    return geometry->getVertexCount();
 }
 
 unsigned GfxBody::getVertexesWithChildren (void) const
@@ -776,6 +818,9 @@ void GfxBody::renderFirstPerson (const GfxShaderGlobals &g,
         bool mat_alpha = mat->getSceneBlend() != GFX_MATERIAL_OPAQUE;
         if (alpha_blend != mat_alpha) continue;
 
+        // First person bodies are always close to the camera.
+        mat->requestTexturePixels(std::numeric_limits<float>::max());
+
         bool pass_fade_dither = fade_dither && !mat_alpha;
 
         Ogre::SubMesh *sm = mesh->getSubMesh(i);
@@ -98,6 +98,7 @@ class GfxBody : public GfxFertileNode, public Ogre::MovableObject {
     public: // HACK
     Ogre::MeshPtr mesh;
     protected:
+    GfxMeshGeometryPtr geometry;
     float fade;
     // Hack to pass material into queue->addRenderable
     Ogre::MaterialPtr renderMaterial;
@@ -128,6 +129,9 @@ class GfxBody : public GfxFertileNode, public Ogre::MovableObject {
     void setEmissiveEnabled (unsigned i, bool v);
     unsigned getNumSubMeshes (void) { return subList.size(); }
 
+    /** The mesh's geometry, including a copy of its triangles for readers on the CPU. */
+    const GfxMeshGeometryPtr &getGeometry (void) const { return geometry; }
+
     protected:
     void destroyGraphics (void);
     void updateBones (void);
@@ -138,6 +142,10 @@ class GfxBody : public GfxFertileNode, public Ogre::MovableObject {
 
     void renderFirstPerson (const GfxShaderGlobals &p, bool alpha_blend);
 
+    /** Add the regular (or shadow cast) pass of the given submesh to the render queue.  Used
+     * for draws that were not merged by automatic instancing. */
+    void queueSub (Ogre::RenderQueue *queue, unsigned i, bool shadow_cast);
+
     unsigned getBatches (void) const;
     unsigned getBatchesWithChildren (void) const;
 
@@ -19,6 +19,13 @@
  * THE SOFTWARE.
  */
 
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+#include "../log_sink.h"
+
 #include "gfx_disk_resource.h"
 #include "gfx_internal.h"
 #include "gfx_material.h"
@@ -40,7 +47,8 @@ double gfx_gpu_ram_used (void)
     // not significantly deviate from Grit's number.
     Ogre::TextureManager &tm = Ogre::TextureManager::getSingleton();
     Ogre::MeshManager &mm = Ogre::MeshManager::getSingleton();
-    return (tm.getMemoryUsage() + mm.getMemoryUsage()) / 1024.0 / 1024.0;
+    size_t meshes = mm.getMemoryUsage() + gfx_mesh_geometry_unused_bytes();
+    return (tm.getMemoryUsage() + meshes) / 1024.0 / 1024.0;
 }
 
 
@@ -50,8 +58,11 @@ GfxMeshDiskResource::GfxMeshDiskResource (const std::string &name)
     try {
         std::string ogre_name = name.substr(1);
         Ogre::HardwareBuffer::Usage u = Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY;
+        // Shadow buffers allow the indexes to be rebased, and the positions copied for CPU
+        // readers, without reading back from the GPU.  Whether the mesh can be shared is not
+        // known until it is loaded, so every mesh has them, and GfxMeshGeometry::make frees them.
         auto result = Ogre::MeshManager::getSingleton()
-                .createOrRetrieve(ogre_name,RESGRP, false,0, 0, u, u, false, false);
+                .createOrRetrieve(ogre_name,RESGRP, false,0, 0, u, u, true, true);
         rp = result.first.staticCast<Ogre::Mesh>();
     } catch (Ogre::Exception &e) { 
         GRIT_EXCEPT("Couldn't find graphics resource: "+e.getFullDescription());
@@ -181,7 +192,7 @@ void GfxMeshDiskResource::loadImpl (void)
         if (!rp->isLoaded()) {
             // do as much as we can, given that this is a background thread
             if (gfx_disk_resource_verbose_loads)
-                CVERB << "Preparing an Ogre::Resource: " << rp->getName() << std::endl;
+                LOG_SINK(LOG_SINK_VERB, "Preparing an Ogre::Resource: %", rp->getName());
             rp->prepare();
 
             // for meshes, scan the bytes from disk to extract materials, then work out
@@ -220,11 +231,22 @@ void GfxMeshDiskResource::loadImpl (void)
     }
 }
 
+const GfxMeshGeometryPtr &GfxMeshDiskResource::getGeometry (void)
+{
+    if (geometry.isNull()) {
+        rp->load();
+        geometry = GfxMeshGeometry::make(rp);
+    }
+    return geometry;
+}
+
 void GfxMeshDiskResource::reloadImpl(void)
 {
     if (gfx_disk_resource_verbose_loads)
-        CVERB << "OGRE: Reloading: " << rp->getName() << std::endl;
+        LOG_SINK(LOG_SINK_VERB, "OGRE: Reloading: %", rp->getName());
     try {
+        // Users still holding the old geometry release it when they are reinitialised below.
+        geometry.setNull();
         rp->reload();
         if (rp->hasSkeleton()) rp->getSkeleton()->reload();
         for (unsigned long i=0 ; i<gfx_all_nodes.size() ; ++i) {
@@ -244,8 +266,9 @@ void GfxMeshDiskResource::reloadImpl(void)
 void GfxMeshDiskResource::unloadImpl(void)
 {
     if (gfx_disk_resource_verbose_loads)
-        CVERB << "OGRE: Unloading: " << rp->getName() << std::endl;
+        LOG_SINK(LOG_SINK_VERB, "OGRE: Unloading: %", rp->getName());
     try {
+        geometry.setNull();
         rp->unload();
     } catch (Ogre::Exception &e) {
         CERR << e.getFullDescription() << std::endl;
@@ -255,7 +278,13 @@ void GfxMeshDiskResource::unloadImpl(void)
 
 
 GfxTextureDiskResource::GfxTextureDiskResource (const std::string &name)
-    : GfxBaseTextureDiskResource(name)
+    : GfxBaseTextureDiskResource(name),
+      streamingAllowed(false),
+      streamed(false),
+      residentMip(0),
+      pendingMip(-1),
+      requestedPixels(0),
+      generation(0)
 {
     try {
         std::string ogre_name = name.substr(1);
@@ -266,15 +295,64 @@ GfxTextureDiskResource::GfxTextureDiskResource (const std::string &name)
     }       
 }
 
+void GfxTextureDiskResource::uploadMips (Ogre::Image &img, unsigned first_mip)
+{
+    if (rp->isLoaded()) rp->unload();
+    rp->setNumMipmaps(layout.numMips - first_mip - 1);
+    rp->loadImage(img);
+    residentMip = first_mip;
+}
+
+void GfxTextureDiskResource::dropMips (unsigned first_mip)
+{
+    unsigned resident = residentMip;
+    APP_ASSERT(first_mip > resident && first_mip < layout.numMips);
+    size_t bytes = layout.end() - layout.offsets[first_mip];
+    uint8_t *raw = OGRE_ALLOC_T(uint8_t, bytes, Ogre::MEMCATEGORY_GENERAL);
+    Ogre::Image img;
+    img.loadDynamicImage(raw, layout.mipWidth(first_mip), layout.mipHeight(first_mip), 1,
+                         layout.format, true, 1, layout.numMips - first_mip - 1);
+    for (unsigned i=0 ; i<layout.numMips-first_mip ; ++i) {
+        rp->getBuffer(0, first_mip - resident + i)->blitToMemory(img.getPixelBox(0, i));
+    }
+    uploadMips(img, first_mip);
+}
+
 void GfxTextureDiskResource::loadImpl (void)
 {
     APP_ASSERT(!isLoaded());
     try {
         if (!rp->isLoaded()) {
-            // do as much as we can, given that this is a background thread
-            if (gfx_disk_resource_verbose_loads)
-                CVERB << "Preparing an Ogre::Resource: " << rp->getName() << std::endl;
-            rp->prepare();
+
+            streamed = false;
+            if (streamingAllowed && gfx_option(GFX_TEXTURE_STREAMING)
+                && Ogre::StringUtil::endsWith(rp->getName(), ".dds")) {
+                Ogre::DataStreamPtr stream =
+                    Ogre::ResourceGroupManager::getSingleton().openResource(rp->getName(), RESGRP);
+                uint8_t header[GFX_DDS_HEADER_SIZE];
+                size_t header_len = stream->read(header, sizeof header);
+                streamed = gfx_dds_parse_layout(header, header_len, layout)
+                           && stream->size() >= layout.end();
+            }
+
+            if (streamed) {
+                // Start with just the smallest mips, the rest will be streamed in as bodies
+                // using the texture request it.
+                unsigned first_mip = gfx_texture_streaming_initial_mip(layout);
+                if (gfx_disk_resource_verbose_loads)
+                    LOG_SINK(LOG_SINK_VERB, "Loading streamed texture: % from mip % of %",
+                             rp->getName(), first_mip, layout.numMips);
+                std::unique_ptr<Ogre::Image> img(gfx_dds_read_mips(rp->getName(), layout, first_mip));
+                uploadMips(*img, first_mip);
+                pendingMip = -1;
+                requestedPixels = 0;
+                gfx_texture_streaming_register(this);
+            } else {
+                // do as much as we can, given that this is a background thread
+                if (gfx_disk_resource_verbose_loads)
+                    LOG_SINK(LOG_SINK_VERB, "Preparing an Ogre::Resource: %", rp->getName());
+                rp->prepare();
+            }
 
         } else {
             CVERB << "Internal warning: Loaded in OGRE, unloaded in GRIT: \"" << getName() << "\"" << std::endl;
@@ -287,18 +365,32 @@ void GfxTextureDiskResource::loadImpl (void)
 void GfxTextureDiskResource::reloadImpl(void)
 {
     if (gfx_disk_resource_verbose_loads)
-        CVERB << "OGRE: Reloading: " << rp->getName() << std::endl;
+        LOG_SINK(LOG_SINK_VERB, "OGRE: Reloading: %", rp->getName());
     try {
-        rp->reload();
+        if (streamed) {
+            // The file may have changed entirely, so start again from the smallest mips.
+            unloadImpl();
+            loadImpl();
+        } else {
+            rp->reload();
+        }
     } catch (Ogre::Exception &e) {
         CERR << e.getFullDescription() << std::endl;
-    }       
+    } catch (const Exception &e) {
+        CERR << e << std::endl;
+    }
 }  
 
 void GfxTextureDiskResource::unloadImpl(void)
 {
     if (gfx_disk_resource_verbose_loads)
-        CVERB << "OGRE: Unloading: " << rp->getName() << std::endl;
+        LOG_SINK(LOG_SINK_VERB, "OGRE: Unloading: %", rp->getName());
+    if (streamed) {
+        gfx_texture_streaming_unregister(this);
+        generation++;
+        pendingMip = -1;
+        streamed = false;
+    }
     try {
         rp->unload();
     } catch (Ogre::Exception &e) {
@@ -309,6 +401,78 @@ void GfxTextureDiskResource::unloadImpl(void)
 
 
 
+/** The compressed formats that are made of 4x4 blocks, stored a row of blocks at a time. */
+static bool is_block_compressed (Ogre::PixelFormat fmt)
+{
+    switch (fmt) {
+        case Ogre::PF_DXT1: case Ogre::PF_DXT2: case Ogre::PF_DXT3: case Ogre::PF_DXT4:
+        case Ogre::PF_DXT5: case Ogre::PF_BC4_UNORM: case Ogre::PF_BC5_UNORM:
+        return true;
+        default:
+        return false;
+    }
+}
+
+/** Copy a w by h rectangle from column from_x of an image, to slice to_z of another image of the
+ * same format, a row at a time.  Unlike getColourAt / setColourAt, this does not convert every
+ * texel through a ColourValue.  Block compressed images are copied a row of blocks at a time, so
+ * the coordinates and sizes must be multiples of 4, and to_z must be 0.
+ */
+static void copy_pixels (const Ogre::PixelBox &from, unsigned from_x,
+                         const Ogre::PixelBox &to, unsigned to_z, unsigned w, unsigned h)
+{
+    Ogre::PixelFormat fmt = from.format;
+    APP_ASSERT(to.format == fmt);
+    const uint8_t *src = static_cast<const uint8_t*>(from.data);
+    uint8_t *dst = static_cast<uint8_t*>(to.data);
+
+    if (Ogre::PixelUtil::isCompressed(fmt)) {
+        APP_ASSERT(is_block_compressed(fmt));
+        APP_ASSERT(from_x % 4 == 0 && w % 4 == 0 && h % 4 == 0 && to_z == 0);
+        // Compressed pixel boxes have no pitch, the rows of blocks are packed.
+        size_t block_bytes = Ogre::PixelUtil::getMemorySize(4, 4, 1, fmt);
+        size_t from_row = Ogre::PixelUtil::getMemorySize(from.getWidth(), 4, 1, fmt);
+        size_t to_row = Ogre::PixelUtil::getMemorySize(to.getWidth(), 4, 1, fmt);
+        for (unsigned y=0 ; y<h/4 ; ++y) {
+            memcpy(dst + y*to_row, src + y*from_row + from_x/4*block_bytes, w/4*block_bytes);
+        }
+        return;
+    }
+
+    // Pitches are in pixels.
+    size_t bpp = Ogre::PixelUtil::getNumElemBytes(fmt);
+    src += from_x * bpp;
+    dst += to_z * to.slicePitch * bpp;
+    for (unsigned y=0 ; y<h ; ++y) {
+        memcpy(dst + y*to.rowPitch*bpp, src + y*from.rowPitch*bpp, w*bpp);
+    }
+}
+
+/** Rearrange an env cube stored as a horizontal strip of 6 square faces into a cube map image. */
+static void env_cube_from_strip (const Ogre::Image &disk, Ogre::Image &img, const std::string &name)
+{
+    if (disk.getWidth() != disk.getHeight()*6) {
+        GRIT_EXCEPT("Environment map has incorrect dimensions: "+name);
+    }
+    unsigned sz = disk.getHeight();
+    if (sz & (sz-1) ) {
+        GRIT_EXCEPT("Environment map size not a power of 2: "+name);
+    }
+    Ogre::PixelFormat fmt = disk.getFormat();
+    if (Ogre::PixelUtil::isCompressed(fmt) && (!is_block_compressed(fmt) || sz < 4)) {
+        GRIT_EXCEPT("Environment map compression not supported: "+name);
+    }
+    size_t face_bytes = Ogre::PixelUtil::getMemorySize(sz, sz, 1, fmt);
+    uint8_t *raw_tex = OGRE_ALLOC_T(uint8_t, 6*face_bytes, Ogre::MEMCATEGORY_GENERAL);
+
+    img.loadDynamicImage(raw_tex, sz, sz, 1, fmt, true, 6, 0);
+    // copy faces across
+    Ogre::PixelBox from = disk.getPixelBox();
+    for (unsigned face=0 ; face<6 ; ++face) {
+        copy_pixels(from, face*sz, img.getPixelBox(face,0), 0, sz, sz);
+    }
+}
+
 GfxEnvCubeDiskResource::GfxEnvCubeDiskResource (const std::string &name)
     : GfxBaseTextureDiskResource(name)
 {
@@ -339,12 +503,11 @@ GfxEnvCubeDiskResource::GfxEnvCubeDiskResource (const std::string &name)
 void GfxEnvCubeDiskResource::loadImpl (void)
 {
     APP_ASSERT(!isLoaded());
-    uint8_t *raw_tex = NULL;
     try {
         const std::string &ogre_name = rp->getName();
 
         if (gfx_disk_resource_verbose_loads)
-            CVERB << "Loading env cube: " << ogre_name << std::endl;
+            LOG_SINK(LOG_SINK_VERB, "Loading env cube: %", ogre_name);
 
         if (rp->isLoaded()) {
             CERR << "WARNING: env cube "<<ogre_name<<" should not be loaded in Ogre" << std::endl;
@@ -353,28 +516,22 @@ void GfxEnvCubeDiskResource::loadImpl (void)
 
         Ogre::Image disk;
         disk.load (ogre_name, RESGRP);
-        if (disk.getWidth() != disk.getHeight()*6) {
-            GRIT_EXCEPT("Environment map has incorrect dimensions: "+ogre_name);
-        }
-        unsigned sz = disk.getHeight();
-        if (sz & (sz-1) ) {
-            GRIT_EXCEPT("Environment map size not a power of 2: "+ogre_name);
-        }
-        raw_tex = OGRE_ALLOC_T(uint8_t, disk.getSize(), Ogre::MEMCATEGORY_GENERAL);
 
-        Ogre::Image img;
-        img.loadDynamicImage(raw_tex, sz, sz, 1, disk.getFormat(), true, 6, 0);
-        // copy faces across
-        Ogre::PixelBox from = disk.getPixelBox();
-        for (unsigned face=0 ; face<6 ; ++face) {
-            Ogre::PixelBox to = img.getPixelBox(face,0);
-            for (unsigned y=0 ; y<sz ; ++y) {
-                for (unsigned x=0 ; x<sz ; ++x) {
-                    to.setColourAt(from.getColourAt(face*sz + x, y, 0), x, y, 0);
-                }
+        if (disk.getNumFaces() == 6) {
+            // Already a cube map (see gfx_env_cube_convert), nothing to rearrange.
+            unsigned sz = disk.getHeight();
+            if (disk.getWidth() != sz) {
+                GRIT_EXCEPT("Environment map has incorrect dimensions: "+ogre_name);
+            }
+            if (sz & (sz-1) ) {
+                GRIT_EXCEPT("Environment map size not a power of 2: "+ogre_name);
             }
+            rp->loadImage(disk);
+            return;
         }
 
+        Ogre::Image img;
+        env_cube_from_strip(disk, img, ogre_name);
 
         rp->loadImage(img);
 
@@ -387,7 +544,7 @@ void GfxEnvCubeDiskResource::loadImpl (void)
 void GfxEnvCubeDiskResource::unloadImpl(void)
 {
     if (gfx_disk_resource_verbose_loads)
-        CVERB << "OGRE: Unloading env cube: " << rp->getName() << std::endl;
+        LOG_SINK(LOG_SINK_VERB, "OGRE: Unloading env cube: %", rp->getName());
     try {
         rp->unload();
     } catch (Ogre::Exception &e) {
@@ -395,6 +552,120 @@ void GfxEnvCubeDiskResource::unloadImpl(void)
     }       
 }  
 
+// Just enough of the DDS format to write a cube map that Ogre's DDS codec can read.
+struct DDSPixelFormat {
+    uint32_t size, flags, fourCC, rgbBits, rMask, gMask, bMask, aMask;
+};
+struct DDSHeader {
+    uint32_t size, flags, height, width, pitchOrLinearSize, depth, mipMapCount, reserved1[11];
+    DDSPixelFormat pixelFormat;
+    uint32_t caps1, caps2, caps3, caps4, reserved2;
+};
+static const uint32_t DDSD_CAPS = 0x1, DDSD_HEIGHT = 0x2, DDSD_WIDTH = 0x4;
+static const uint32_t DDSD_PITCH = 0x8, DDSD_PIXELFORMAT = 0x1000, DDSD_LINEARSIZE = 0x80000;
+static const uint32_t DDPF_ALPHAPIXELS = 0x1, DDPF_FOURCC = 0x4, DDPF_RGB = 0x40;
+static const uint32_t DDSCAPS_COMPLEX = 0x8, DDSCAPS_TEXTURE = 0x1000;
+static const uint32_t DDSCAPS2_CUBEMAP_ALL_FACES = 0x200 | 0xfc00;
+static const uint32_t D3DFMT_A16B16G16R16F = 113, D3DFMT_A32B32G32R32F = 116;
+
+static uint32_t four_cc (const char *s)
+{
+    return uint32_t(s[0]) | uint32_t(s[1]) << 8 | uint32_t(s[2]) << 16 | uint32_t(s[3]) << 24;
+}
+
+void gfx_env_cube_convert (const std::string &src, const std::string &dst)
+{
+    APP_ASSERT(src.length()>0 && src[0]=='/');
+    APP_ASSERT(dst.length()>0 && dst[0]=='/');
+    Ogre::Image cube;
+    try {
+        Ogre::Image disk;
+        disk.load(src.substr(1), RESGRP);
+        env_cube_from_strip(disk, cube, src);
+    } catch (Ogre::Exception &e) {
+        GRIT_EXCEPT(e.getDescription());
+    }
+    unsigned sz = cube.getWidth();
+
+    DDSHeader header;
+    memset(&header, 0, sizeof header);
+    header.size = sizeof header;
+    header.flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT;
+    header.height = sz;
+    header.width = sz;
+    header.pixelFormat.size = sizeof header.pixelFormat;
+    header.caps1 = DDSCAPS_TEXTURE | DDSCAPS_COMPLEX;
+    header.caps2 = DDSCAPS2_CUBEMAP_ALL_FACES;
+
+    // Use the format of the strip where DDS (as read by Ogre) allows it, otherwise the closest
+    // one that keeps the range and precision.
+    Ogre::PixelFormat fmt = cube.getFormat();
+    Ogre::PixelFormat to_fmt = fmt;
+    DDSPixelFormat &pf = header.pixelFormat;
+    switch (fmt) {
+        case Ogre::PF_DXT1: pf.fourCC = four_cc("DXT1"); break;
+        case Ogre::PF_DXT3: pf.fourCC = four_cc("DXT3"); break;
+        case Ogre::PF_DXT5: pf.fourCC = four_cc("DXT5"); break;
+        case Ogre::PF_BC4_UNORM: pf.fourCC = four_cc("BC4U"); break;
+        case Ogre::PF_BC5_UNORM: pf.fourCC = four_cc("BC5U"); break;
+        default:
+        if (Ogre::PixelUtil::isCompressed(fmt)) {
+            GRIT_EXCEPT("Cannot write env cube in this compressed format: "+src);
+        }
+        switch (Ogre::PixelUtil::getComponentType(fmt)) {
+            case Ogre::PCT_BYTE:
+            to_fmt = Ogre::PF_A8R8G8B8;
+            pf.flags = DDPF_RGB | DDPF_ALPHAPIXELS;
+            pf.rgbBits = 32;
+            pf.rMask = 0x00ff0000;
+            pf.gMask = 0x0000ff00;
+            pf.bMask = 0x000000ff;
+            pf.aMask = 0xff000000;
+            break;
+            // There is no 16 bit integer format that Ogre reads back.
+            case Ogre::PCT_SHORT:
+            case Ogre::PCT_FLOAT16:
+            to_fmt = Ogre::PF_FLOAT16_RGBA;
+            pf.fourCC = D3DFMT_A16B16G16R16F;
+            break;
+            case Ogre::PCT_FLOAT32:
+            to_fmt = Ogre::PF_FLOAT32_RGBA;
+            pf.fourCC = D3DFMT_A32B32G32R32F;
+            break;
+            default:
+            GRIT_EXCEPT("Cannot write env cube in this format: "+src);
+        }
+    }
+    if (pf.fourCC != 0) pf.flags |= DDPF_FOURCC;
+
+    size_t face_bytes = Ogre::PixelUtil::getMemorySize(sz, sz, 1, to_fmt);
+    if (Ogre::PixelUtil::isCompressed(to_fmt)) {
+        header.flags |= DDSD_LINEARSIZE;
+        header.pitchOrLinearSize = face_bytes;
+    } else {
+        header.flags |= DDSD_PITCH;
+        header.pitchOrLinearSize = sz * Ogre::PixelUtil::getNumElemBytes(to_fmt);
+    }
+
+    std::ofstream f(dst.substr(1).c_str(), std::ios::binary);
+    if (!f.good()) GRIT_EXCEPT("Could not open env cube file: \""+dst+"\"");
+    f.write("DDS ", 4);
+    f.write(reinterpret_cast<const char*>(&header), sizeof header);
+    std::vector<uint8_t> face(face_bytes);
+    for (unsigned i=0 ; i<6 ; ++i) {
+        if (to_fmt == fmt) {
+            f.write(static_cast<const char*>(cube.getPixelBox(i,0).data), face_bytes);
+        } else {
+            // Done once, offline, so Ogre's general (slow) conversion is fine.
+            Ogre::PixelBox to(sz, sz, 1, to_fmt, &face[0]);
+            Ogre::PixelUtil::bulkPixelConversion(cube.getPixelBox(i,0), to);
+            f.write(reinterpret_cast<const char*>(&face[0]), face_bytes);
+        }
+    }
+    f.close();
+    if (!f.good()) GRIT_EXCEPT("Could not write env cube file: \""+dst+"\"");
+}
+
 
 
 
@@ -418,7 +689,7 @@ void GfxColourGradeLUTDiskResource::loadImpl (void)
         const std::string &ogre_name = rp->getName();
 
         if (gfx_disk_resource_verbose_loads)
-            CVERB << "Loading colour grade LUT: " << ogre_name << std::endl;
+            LOG_SINK(LOG_SINK_VERB, "Loading colour grade LUT: %", ogre_name);
 
         if (rp->isLoaded()) {
             CERR << "Colour grade "<<ogre_name<<" should not be 'loaded' in Ogre" << std::endl;
@@ -437,18 +708,18 @@ void GfxColourGradeLUTDiskResource::loadImpl (void)
         if (sz & (sz-1) ) {
             GRIT_EXCEPT("Colour grade LUT size not a power of 2: "+ogre_name);
         }
-        raw_tex = new uint8_t[disk.getSize()];
+        if (Ogre::PixelUtil::isCompressed(disk.getFormat())) {
+            GRIT_EXCEPT("Colour grade LUT must not be compressed: "+ogre_name);
+        }
+        size_t bytes = Ogre::PixelUtil::getMemorySize(sz, sz, sz, disk.getFormat());
+        raw_tex = OGRE_ALLOC_T(uint8_t, bytes, Ogre::MEMCATEGORY_GENERAL);
 
         img.loadDynamicImage(raw_tex, sz, sz, sz, disk.getFormat(), true, 1, 0);
-        // copy faces across
+        // copy slices across
         Ogre::PixelBox from = disk.getPixelBox();
         Ogre::PixelBox to = img.getPixelBox();
         for (unsigned z=0 ; z<sz ; ++z) {
-            for (unsigned y=0 ; y<sz ; ++y) {
-                for (unsigned x=0 ; x<sz ; ++x) {
-                    to.setColourAt(from.getColourAt(z*sz + x, y, 0), x, y, z);
-                }
-            }
+            copy_pixels(from, z*sz, to, z, sz, sz);
         }
 
         rp->loadImage(img);
@@ -519,7 +790,7 @@ Vector3 GfxColourGradeLUTDiskResource::lookUp (const Vector3 &v) const
 void GfxColourGradeLUTDiskResource::unloadImpl(void)
 {
     if (gfx_disk_resource_verbose_loads)
-        CVERB << "OGRE: Unloading colour grade LUT: " << rp->getName() << std::endl;
+        LOG_SINK(LOG_SINK_VERB, "OGRE: Unloading colour grade LUT: %", rp->getName());
     try {
         rp->unload();
     } catch (Ogre::Exception &e) {
@@ -27,11 +27,16 @@ class GfxColourGradeLUTDiskResource;
 #ifndef GFX_DISK_RESOURCE_H
 #define GFX_DISK_RESOURCE_H
 
+#include <atomic>
+
 #include <math_util.h>
 
 #include <centralised_log.h>
 #include "../background_loader.h"
 
+#include "gfx_mesh_geometry.h"
+#include "gfx_texture_streaming.h"
+
 /** Representation for Ogre resources.  Just hold the name, leave the rest to subclasses
  *
  * A loaded disk resource is only 'prepared' in Ogre parlance.  The actual Ogre
@@ -94,6 +99,9 @@ class GfxBaseTextureDiskResource : public GfxGPUDiskResource {
 };
 
 /** Representation for textures.  Textures have no dependencies.
+ *
+ * Textures used by world materials may be streamed a mip level at a time, see
+ * gfx_texture_streaming.h.
  */
 class GfxTextureDiskResource : public GfxBaseTextureDiskResource {
 
@@ -101,6 +109,37 @@ class GfxTextureDiskResource : public GfxBaseTextureDiskResource {
     /** Use disk_resource_get_or_make to create a new disk resource. */
     GfxTextureDiskResource (const std::string &name);
 
+    /** Allow the texture to be streamed a mip level at a time, if the file supports it.  Takes
+     * effect at the next load.  This is only safe for textures whose users call requestPixels,
+     * otherwise the texture would never be upgraded beyond its smallest mips. */
+    void allowStreaming (void) { streamingAllowed = true; }
+
+    /** Is the texture being streamed a mip level at a time? */
+    bool isStreamed (void) const { return streamed; }
+
+    /** A user of the texture appears this many pixels tall on screen in the current frame. */
+    void requestPixels (float pixels)
+    {
+        float old = requestedPixels.load(std::memory_order_relaxed);
+        while (pixels > old && !requestedPixels.compare_exchange_weak(old, pixels)) { }
+    }
+
+    /** Index of the largest mip level in GPU memory, 0 meaning full resolution. */
+    unsigned getResidentMip (void) const { return residentMip; }
+
+    /** The mip layout of the file on disk (only valid if isStreamed()). */
+    const GfxDDSLayout &getLayout (void) const { return layout; }
+
+    /** Has a residency change been requested but not yet uploaded? */
+    bool isResidencyChangePending (void) const { return pendingMip >= 0; }
+
+    /** Replace the GPU copy of the texture with the mips in img. */
+    void uploadMips (Ogre::Image &img, unsigned first_mip);
+
+    /** Drop the mips larger than first_mip.  The others are copied from the GPU, not read from
+     * the file again. */
+    void dropMips (unsigned first_mip);
+
   protected:
 
     /** Load via Ogre (i.e. prepare it in Ogre terminology). */
@@ -110,6 +149,34 @@ class GfxTextureDiskResource : public GfxBaseTextureDiskResource {
     /** Unload via Ogre. */
     virtual void unloadImpl (void);
 
+  private:
+
+    /** Set by allowStreaming, possibly from the background loading thread. */
+    volatile bool streamingAllowed;
+
+    // The following are atomic as they are written by the background loading thread while
+    // loading, and by the rendering thread while streaming, and read by both.
+
+    /** Whether the currently loaded texture is being streamed. */
+    std::atomic<bool> streamed;
+
+    /** The layout of the DDS file, if streamed.  Only written before the texture is registered
+     * with the streaming, whose lock publishes it. */
+    GfxDDSLayout layout;
+
+    /** Index of the largest resident mip. */
+    std::atomic<unsigned> residentMip;
+
+    /** The largest resident mip that has been requested from the streaming thread, or -1. */
+    std::atomic<int> pendingMip;
+
+    /** Largest on-screen size requested since the last gfx_texture_streaming_update. */
+    std::atomic<float> requestedPixels;
+
+    /** Incremented at each unload, so that reads in flight for a previous load are discarded. */
+    std::atomic<unsigned> generation;
+
+    friend void gfx_texture_streaming_update (void);
 };
 
 /** Representation for meshes.
@@ -128,10 +195,17 @@ class GfxMeshDiskResource : public GfxGPUDiskResource {
     /** Return the internal Ogre object. */
     const Ogre::MeshPtr &getOgreMeshPtr (void) { return rp; }
 
+    /** Load the mesh to the GPU if necessary and return its shared geometry.  Consumers keep the
+     * handle to keep the geometry alive.  Must be called from the main thread. */
+    const GfxMeshGeometryPtr &getGeometry (void);
+
   private:
     /** The ogre representation. */
     Ogre::MeshPtr rp;
 
+    /** The mesh's range of the shared vertex and index buffers, made on first use. */
+    GfxMeshGeometryPtr geometry;
+
     /** Load via Ogre (i.e. prepare it in Ogre terminology). */
     virtual void loadImpl (void);
     /** Reload from disk via Ogre calls. */
@@ -158,6 +232,12 @@ class GfxEnvCubeDiskResource : public GfxBaseTextureDiskResource {
 
 };
 
+/** Write the env cube src (a horizontal strip of 6 faces) to dst as a cube map DDS.  Naming it
+ * *.envcube.dds and using that instead of the original avoids rearranging the faces every time
+ * it is loaded.  Uncompressed formats that DDS does not have are written as 16 or 32 bit float
+ * RGBA.  Both are absolute paths. */
+void gfx_env_cube_convert (const std::string &src, const std::string &dst);
+
 /** Representation for colour grading 3D LUT.
  */
 class GfxColourGradeLUTDiskResource : public GfxBaseTextureDiskResource {
@@ -30,6 +30,36 @@ Vector2 GfxFont::getTextureDimensions (void) {
     return Vector2(ptr->getWidth(), ptr->getHeight());
 }
 
+void GfxFont::setCodePoint (codepoint_t cp, const CharRect &r)
+{
+    Glyph g;
+    g.rect = r;
+    g.advance = r.u2 - r.u1;
+    g.height = r.v2 - r.v1;
+
+    unsigned *index;
+    if (cp < BMP_SIZE) {
+        if (cp >= bmpIndexes.size()) bmpIndexes.resize(cp + 1, 0);
+        index = &bmpIndexes[cp];
+    } else {
+        index = &astralIndexes[cp];
+    }
+
+    if (*index == 0) {
+        glyphs.push_back(g);
+        *index = glyphs.size();
+    } else {
+        glyphs[*index - 1] = g;
+    }
+}
+
+void GfxFont::clearCodePoints (void)
+{
+    glyphs.clear();
+    bmpIndexes.clear();
+    astralIndexes.clear();
+}
+
 bool gfx_font_has (const std::string &name)
 {
     FontMap::iterator it = db.find(name);
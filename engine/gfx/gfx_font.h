@@ -28,6 +28,7 @@ typedef std::vector<GfxFont*> GfxFonts;
 #define GFXFONT_H
 
 #include <map>
+#include <unordered_map>
 
 #include <math_util.h>
 
@@ -42,12 +43,25 @@ class GfxFont {
     struct CharRect {
         unsigned long u1, v1, u2, v2;
     };
-    typedef std::map<codepoint_t, CharRect> CharRectMap;
+    /** Everything text layout needs to know about a codepoint, kept together so laying out a
+     * line touches one small array rather than walking a tree per letter. */
+    struct Glyph {
+        CharRect rect;
+        unsigned long advance;  // Horizontal distance to the next letter, in texels.
+        unsigned long height;
+    };
     const std::string name;
     private:
     DiskResourcePtr<GfxTextureDiskResource> texture;
     unsigned long height;
-    CharRectMap coords;
+    std::vector<Glyph> glyphs;
+    /* Codepoints in the Basic Multilingual Plane are looked up directly, giving the index into
+     * glyphs plus 1, or 0 for a codepoint the font does not have.  The table only extends as far
+     * as the highest codepoint defined, so fonts covering just ASCII stay small.  The rest of
+     * unicode is rare enough in fonts to be hashed instead. */
+    std::vector<unsigned> bmpIndexes;
+    std::unordered_map<codepoint_t, unsigned> astralIndexes;
+    static const codepoint_t BMP_SIZE = 0x10000;
     public:
     GfxFont (const std::string &name, GfxTextureDiskResource *tex, unsigned long height)
       : name(name), texture(tex), height(height)
@@ -67,21 +81,30 @@ class GfxFont {
         if (!tex->isLoaded()) tex->load();
         texture = tex;
     }
-    bool hasCodePoint (codepoint_t cp) const {
-        CharRectMap::const_iterator it = coords.find(cp);
-        return it != coords.end();
+    /** The glyph of the given codepoint, or NULL if the font does not have it.  The pointer is
+     * invalidated by setCodePoint and clearCodePoints. */
+    const Glyph *getGlyph (codepoint_t cp) const {
+        if (cp < bmpIndexes.size()) {
+            unsigned i = bmpIndexes[cp];
+            return i == 0 ? NULL : &glyphs[i - 1];
+        }
+        if (cp < BMP_SIZE) return NULL;
+        std::unordered_map<codepoint_t, unsigned>::const_iterator it = astralIndexes.find(cp);
+        if (it == astralIndexes.end()) return NULL;
+        return &glyphs[it->second - 1];
     }
-    void setCodePoint (codepoint_t cp, const CharRect &r) {
-        coords[cp] = r;
+    bool hasCodePoint (codepoint_t cp) const {
+        return getGlyph(cp) != NULL;
     }
+    void setCodePoint (codepoint_t cp, const CharRect &r);
     bool getCodePointOrFail (codepoint_t cp, CharRect &r) const {
-        CharRectMap::const_iterator it = coords.find(cp);
-        if (it == coords.end()) return false;
-        r = it->second;
+        const Glyph *g = getGlyph(cp);
+        if (g == NULL) return false;
+        r = g->rect;
         return true;
     }
     Vector2 getTextureDimensions (void);
-    void clearCodePoints (void) { coords.clear(); }
+    void clearCodePoints (void);
 };
 
 bool gfx_font_has (const std::string &name);
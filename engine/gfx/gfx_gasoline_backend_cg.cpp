@@ -22,7 +22,7 @@
 #include "gfx_gasoline_backend_cg.h"
 #include "gfx_gasoline_type_system.h"
 
-static std::map<std::string, std::string> vert_semantic = {
+static const std::map<std::string, std::string> vert_semantic = {
     {"position", "POSITION"},
     {"coord0", "TEXCOORD0"},
     {"coord1", "TEXCOORD1"},
@@ -39,7 +39,7 @@ static std::map<std::string, std::string> vert_semantic = {
     {"boneAssignments", "BLENDINDICES"},
 };
 
-static std::map<std::string, std::string> frag_semantic = {
+static const std::map<std::string, std::string> frag_semantic = {
     {"position", "POSITION"},
     {"colour", "COLOR"},
     {"screen", "WPOS"},
@@ -248,7 +248,7 @@ static std::string generate_vert_header (const GfxGslContext &ctx,
 
     // In (vertex attributes)
     for (const auto &f : vert_in) {
-        ss << "in " << ts->getVertType(f) << " vert_" << f << " : " << vert_semantic[f] << ";\n";
+        ss << "in " << ts->getVertType(f) << " vert_" << f << " : " << vert_semantic.at(f) << ";\n";
     }
     ss << gfx_gasoline_generate_global_fields(ctx, true);
 
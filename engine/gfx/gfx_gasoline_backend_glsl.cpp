@@ -23,7 +23,7 @@
 #include "gfx_gasoline_backend.h"
 #include "gfx_gasoline_backend_cg.h"
 
-static std::map<std::string, std::string> vert_global = {
+static const std::map<std::string, std::string> vert_global = {
     {"position", "vertex"},
     {"normal", "normal"},
     {"tangent", "tangent"},
@@ -204,7 +204,7 @@ static std::string generate_vert_header (bool glsl33,
     for (const auto &f : vert_in) {
         // I don't think it's possible to use the layout qualifier here, without
         // changing (or at least examining) the way that Ogre::Mesh maps to gl buffers.
-        ss << "in " << ts->getVertType(f) << " " << vert_global[f] << ";\n";
+        ss << "in " << ts->getVertType(f) << " " << vert_global.at(f) << ";\n";
         ss << ts->getVertType(f) << " vert_" << f << ";\n";
     }
     ss << gfx_gasoline_generate_global_fields(ctx, false);
@@ -365,7 +365,7 @@ void gfx_gasoline_unparse_glsl (const GfxGslContext &ctx,
     vert_ss << "void main (void)\n";
     vert_ss << "{\n";
     for (const auto &f : vert_in)
-        vert_ss << "    vert_" << f << " = " << vert_global[f] << ";\n";
+        vert_ss << "    vert_" << f << " = " << vert_global.at(f) << ";\n";
     vert_ss << "    Float3 world_pos;\n";
     vert_ss << "    func_user_vertex(world_pos);\n";
     if (das) {
@@ -559,7 +559,7 @@ void gfx_gasoline_unparse_body_glsl(const GfxGslContext &ctx,
     vert_ss << "void main (void)\n";
     vert_ss << "{\n";
     for (const auto &f : vert_in)
-        vert_ss << "    vert_" << f << " = " << vert_global[f] << ";\n";
+        vert_ss << "    vert_" << f << " = " << vert_global.at(f) << ";\n";
     vert_ss << "    Float3 pos_ws;\n";
     vert_ss << "    func_user_vertex(pos_ws);\n";
     if (cast) {
@@ -797,7 +797,7 @@ void gfx_gasoline_unparse_decal_glsl(const GfxGslContext &ctx,
     vert_ss << "void main (void)\n";
     vert_ss << "{\n";
     for (const auto &f : vert_in)
-        vert_ss << "    vert_" << f << " = " << vert_global[f] << ";\n";
+        vert_ss << "    vert_" << f << " = " << vert_global.at(f) << ";\n";
     vert_ss << "    Float3 pos_ws = transform_to_world(vert_position.xyz);\n";
     vert_ss << "    internal_normal = rotate_to_world(Float3(0, 1, 0));\n";
     vert_ss << "    gl_Position = mul(global_viewProj, Float4(pos_ws, 1));\n";
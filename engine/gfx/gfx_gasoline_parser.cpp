@@ -551,8 +551,8 @@ static const int precedence_apply = 1;
 static const int precedence_uop = 2;
 static const int precedence_max = 7;
 
-// Can't make this const, as [] is not a const operator.
-static std::map<GfxGslOp, int> precedence_op = {
+// Const, as shaders are compiled in more than one thread at once.
+static const std::map<GfxGslOp, int> precedence_op = {
     {GFX_GSL_OP_MUL, 3},
     {GFX_GSL_OP_DIV, 3},
     {GFX_GSL_OP_MOD, 3},
@@ -810,7 +810,7 @@ namespace {
                     }
                 } else {
                     GfxGslOp op;
-                    if (is_op(sym, op) && precedence==precedence_op[op]) {
+                    if (is_op(sym, op) && precedence==precedence_op.at(op)) {
                         auto op_tok = pop();
                         auto *b = parseExpr(precedence-1);
                         a = alloc.makeAst<GfxGslBinary>(op_tok.loc, a, op, b);
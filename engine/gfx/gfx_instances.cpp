@@ -80,7 +80,12 @@ GfxInstancesPtr GfxInstances::make (const std::string &mesh_name, const GfxNodeP
 
 GfxInstances::GfxInstances (const DiskResourcePtr<GfxMeshDiskResource> &gdr, const GfxNodePtr &par_)
   : GfxNode(par_),
-    dirty(false),
+    dirtyFrom(std::numeric_limits<unsigned>::max()),
+    dirtyTo(0),
+    posMin(std::numeric_limits<float>::max(), std::numeric_limits<float>::max(),
+           std::numeric_limits<float>::max()),
+    posMax(-std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(),
+           -std::numeric_limits<float>::max()),
     enabled(true),
     gdr(gdr),
     mBoundingBox(Ogre::AxisAlignedBox::BOX_INFINITE),
@@ -97,7 +102,7 @@ GfxInstances::GfxInstances (const DiskResourcePtr<GfxMeshDiskResource> &gdr, con
 
 void GfxInstances::updateSections (void)
 {
-    mesh->load();
+    geometry = gdr->getGeometry();
 
     APP_ASSERT(mesh->sharedVertexData != NULL);
     sharedVertexData = mesh->sharedVertexData->clone(false);
@@ -150,7 +155,7 @@ void GfxInstances::reserveSpace (unsigned new_capacity)
                         Ogre::HardwareBuffer::HBU_DYNAMIC_WRITE_ONLY);
         instBuf->setIsInstanceData(true);
         instBuf->setInstanceDataStepRate(1);
-        dirty = true; // will be lazily copied from host
+        markAllDirty(); // will be lazily copied from host
     }
     sharedVertexData->vertexBufferBinding->setBinding(1, instBuf);
 
@@ -212,8 +217,21 @@ unsigned GfxInstances::add (const Vector3 &pos, const Quaternion &q, float fade)
 void GfxInstances::update (unsigned sparse_index, const Vector3 &pos, const Quaternion &q, float fade)
 {
     indexes.sparseIndexValid(sparse_index);
-    unsigned dense_index = indexes.denseIndex(sparse_index);
+    setDense(indexes.denseIndex(sparse_index), pos, q, fade);
+}
+
+void GfxInstances::updateMany (unsigned n, const unsigned *insts, const float *data)
+{
+    for (unsigned i=0 ; i<n ; ++i) indexes.sparseIndexValid(insts[i]);
+    for (unsigned i=0 ; i<n ; ++i) {
+        const float *d = &data[i * 8];
+        setDense(indexes.denseIndex(insts[i]),
+                 Vector3(d[0], d[1], d[2]), Quaternion(d[3], d[4], d[5], d[6]), d[7]);
+    }
+}
 
+void GfxInstances::setDense (unsigned dense_index, const Vector3 &pos, const Quaternion &q, float fade)
+{
     float *base = &instBufRaw[dense_index * instance_data_floats];
     Ogre::Matrix3 rot;
     to_ogre(q).ToRotationMatrix(rot);
@@ -225,7 +243,11 @@ void GfxInstances::update (unsigned sparse_index, const Vector3 &pos, const Quat
     base[10] = pos.y;
     base[11] = pos.z;
     base[12] = fade;
-    dirty = true;
+    posMin = Vector3(std::min(posMin.x, pos.x), std::min(posMin.y, pos.y),
+                     std::min(posMin.z, pos.z));
+    posMax = Vector3(std::max(posMax.x, pos.x), std::max(posMax.y, pos.y),
+                     std::max(posMax.z, pos.z));
+    markDirty(dense_index, dense_index + 1);
 }
 
 void GfxInstances::del (unsigned sparse_index)
@@ -246,7 +268,7 @@ void GfxInstances::del (unsigned sparse_index)
     instBufRaw.resize(instance_data_floats * last);
     for (unsigned i=0 ; i<numSections ; ++i) sections[i]->setNumInstances(last);
 
-    dirty = true;
+    if (dense_index != last) markDirty(dense_index, dense_index + 1);
 }
 
 
@@ -290,13 +312,38 @@ void GfxInstances::_updateRenderQueue(Ogre::RenderQueue *queue)
 {
     if (indexes.size() == 0) return;
     if (!enabled) return;
-    if (dirty) {
-        copyToGPU();
-        dirty = false;
+    if (dirtyFrom < dirtyTo) {
+        // All updates since the last frame are uploaded together.  A small range is written in
+        // place, otherwise the whole buffer is discarded and replaced, which avoids waiting for
+        // the GPU to finish with the previous contents.
+        unsigned to = std::min(dirtyTo, unsigned(indexes.size()));
+        if (dirtyFrom >= to) {
+            // Only instances that have since been deleted.
+        } else if ((to - dirtyFrom) * 4 >= indexes.size()) {
+            copyToGPU();
+        } else {
+            copyToGPU(dirtyFrom, to, false);
+        }
+        dirtyFrom = std::numeric_limits<unsigned>::max();
+        dirtyTo = 0;
+    }
+    // How big the nearest instance could be on screen, so streamed textures are loaded at the
+    // right resolution.
+    const Ogre::Camera *cam = ogre_sm->getCameraInProgress();
+    float pixels = std::numeric_limits<float>::max();
+    if (cam != nullptr) {
+        Vector3 cam_pos = from_ogre(cam->getDerivedPosition());
+        Vector3 nearest(std::max(posMin.x, std::min(posMax.x, cam_pos.x)),
+                        std::max(posMin.y, std::min(posMax.y, cam_pos.y)),
+                        std::max(posMin.z, std::min(posMax.z, cam_pos.z)));
+        pixels = gfx_texture_streaming_screen_size(cam, nearest, mesh->getBoundingSphereRadius());
     }
+
     for (unsigned i=0 ; i<numSections ; ++i) {
         Section *s = sections[i];
 
+        s->getGritMaterial()->requestTexturePixels(pixels);
+
         queue->addRenderable(s, s->queueID, s->queuePriority);
     }
 }
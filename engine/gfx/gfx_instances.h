@@ -19,6 +19,8 @@
  * THE SOFTWARE.
  */
 
+#include <algorithm>
+
 #include "../shared_ptr.h"
 
 class GfxInstances;
@@ -48,10 +50,15 @@ class GfxInstances : public GfxNode, public Ogre::MovableObject {
     Section **sections;
 
     Ogre::MeshPtr mesh;
+    GfxMeshGeometryPtr geometry;
     Ogre::VertexData *sharedVertexData;
     Ogre::HardwareVertexBufferSharedPtr instBuf;
     std::vector<float> instBufRaw;
-    bool dirty;
+    // Range of dense indexes changed since the last upload, empty if dirtyFrom >= dirtyTo.
+    unsigned dirtyFrom, dirtyTo;
+    // Bounds of every position an instance has had, so streamed textures can be loaded at the
+    // resolution that the nearest instance could need.
+    Vector3 posMin, posMax;
     bool enabled;
     const DiskResourcePtr<GfxMeshDiskResource> gdr;
 
@@ -64,6 +71,9 @@ class GfxInstances : public GfxNode, public Ogre::MovableObject {
     unsigned int add (const Vector3 &pos, const Quaternion &q, float fade);
     // in future, perhaps 3d scale, skew, or general 3x3 matrix?
     void update (unsigned int inst, const Vector3 &pos, const Quaternion &q, float fade);
+    /** Update n instances at once.  The data holds 8 floats per instance: position (x, y, z),
+     * orientation (w, x, y, z), and fade.  All indexes are checked before any are updated. */
+    void updateMany (unsigned n, const unsigned *insts, const float *data);
     void del (unsigned int inst);
 
     // don't call this reserve because a subclass wants to call its member function reserve
@@ -88,6 +98,14 @@ class GfxInstances : public GfxNode, public Ogre::MovableObject {
     void copyToGPU ();
     void copyToGPU (unsigned from, unsigned to, bool discard);
 
+    void setDense (unsigned dense_index, const Vector3 &pos, const Quaternion &q, float fade);
+    void markDirty (unsigned from, unsigned to)
+    {
+        dirtyFrom = std::min(dirtyFrom, from);
+        dirtyTo = std::max(dirtyTo, to);
+    }
+    void markAllDirty (void) { markDirty(0, indexes.size()); }
+
 
     // Stuff for Ogre::MovableObject
 
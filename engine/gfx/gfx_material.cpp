@@ -64,6 +64,24 @@ GfxMaterial::GfxMaterial (const std::string &name)
 {
 }
 
+void GfxMaterial::addDependencies (DiskResource *into) const
+{
+    GFX_MAT_SYNC;
+    for (const auto &i : textures) {
+        auto *tex = dynamic_cast<GfxTextureDiskResource*>(i.second.texture);
+        if (tex != nullptr) tex->allowStreaming();
+        into->addDependency(i.second.texture);
+    }
+}
+
+void GfxMaterial::requestTexturePixels (float pixels) const
+{
+    for (const auto &i : textures) {
+        auto *tex = dynamic_cast<GfxTextureDiskResource*>(i.second.texture);
+        if (tex != nullptr) tex->requestPixels(pixels);
+    }
+}
+
 void GfxMaterial::setSceneBlend (GfxMaterialSceneBlend v)
 {
     sceneBlend = v;
@@ -61,7 +61,7 @@ class GfxBaseMaterial {
     const GfxTextureStateMap &getTextures (void) const { return textures; } 
     void setTextures (const GfxTextureStateMap &v) { GFX_MAT_SYNC; textures = v; }
 
-    void addDependencies (DiskResource *into) const;
+    virtual void addDependencies (DiskResource *into) const;
 
     const GfxShaderBindings &getBindings (void) const { return bindings; }
     void setBindings (const GfxShaderBindings &v) { bindings = v; }
@@ -141,6 +141,12 @@ class GfxMaterial : public GfxBaseMaterial {
     void buildOgreMaterials (void);
     void updateOgreMaterials (const GfxShaderGlobals &globs);
 
+    // Also allows the textures to be streamed, since users of GfxMaterial request their size.
+    void addDependencies (DiskResource *into) const;
+
+    // Called by bodies each frame, to drive texture streaming.
+    void requestTexturePixels (float pixels) const;
+
     const GfxGslMaterialEnvironment &getMaterialEnvironment (void) const { return matEnv; }
 
     friend GfxMaterial *gfx_material_add(const std::string &);
@@ -0,0 +1,470 @@
+/* Copyright (c) The Grit Game Engine authors 2016
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <utility>
+
+#include <centralised_log.h>
+
+#include "gfx_disk_resource.h"
+#include "gfx_internal.h"
+#include "gfx_mesh_geometry.h"
+
+// Largest number of vertexes in a shared vertex buffer, so that 16 bit indexes can address all of
+// it.
+static const size_t VERTEX_PAGE_CAPACITY = 65536;
+
+// Number of indexes in a shared index buffer.
+static const size_t INDEX_PAGE_CAPACITY = 1024 * 1024;
+
+/** Best-fit allocator of ranges of [0, capacity). */
+class RangeAllocator {
+
+    /** Unused ranges, start -> length.  Adjacent ranges are always merged. */
+    std::map<size_t, size_t> unused;
+
+    /** The same ranges, as (length, start), so the smallest that fits can be found quickly. */
+    std::set<std::pair<size_t, size_t>> unusedBySize;
+
+    size_t capacity;
+    size_t used;
+
+    void addUnused (size_t start, size_t len)
+    {
+        unused[start] = len;
+        unusedBySize.emplace(len, start);
+    }
+
+    void removeUnused (std::map<size_t, size_t>::iterator i)
+    {
+        unusedBySize.erase(std::make_pair(i->second, i->first));
+        unused.erase(i);
+    }
+
+    public:
+
+    RangeAllocator (size_t capacity)
+      : capacity(capacity), used(0)
+    {
+        addUnused(0, capacity);
+    }
+
+    size_t getCapacity (void) const { return capacity; }
+    size_t getUsed (void) const { return used; }
+    bool isEmpty (void) const { return used == 0; }
+
+    bool alloc (size_t len, size_t &start)
+    {
+        auto fit = unusedBySize.lower_bound(std::make_pair(len, size_t(0)));
+        if (fit == unusedBySize.end()) return false;
+        start = fit->second;
+        size_t remaining = fit->first - len;
+        removeUnused(unused.find(start));
+        if (remaining > 0) addUnused(start + len, remaining);
+        used += len;
+        return true;
+    }
+
+    void release (size_t start, size_t len)
+    {
+        used -= len;
+        auto next = unused.lower_bound(start);
+        if (next != unused.begin()) {
+            auto prev = next;
+            --prev;
+            if (prev->first + prev->second == start) {
+                start = prev->first;
+                len += prev->second;
+                removeUnused(prev);
+            }
+        }
+        if (next != unused.end() && start + len == next->first) {
+            len += next->second;
+            removeUnused(next);
+        }
+        addUnused(start, len);
+    }
+};
+
+/** Binding source and vertex size of each vertex buffer used by a mesh. */
+typedef std::vector<std::pair<unsigned short, size_t>> VertexLayout;
+
+struct GfxMeshVertexPage {
+    VertexLayout layout;
+    RangeAllocator ranges;
+    /** One for each entry in the layout. */
+    std::vector<Ogre::HardwareVertexBufferSharedPtr> buffers;
+    /** Holds a single mesh that was too large for a regular page. */
+    bool dedicated;
+
+    GfxMeshVertexPage (const VertexLayout &layout, size_t capacity, bool dedicated)
+      : layout(layout), ranges(capacity), dedicated(dedicated)
+    {
+        for (const auto &source : layout) {
+            buffers.push_back(Ogre::HardwareBufferManager::getSingleton().createVertexBuffer(
+                source.second, capacity, Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY));
+        }
+    }
+};
+
+struct GfxMeshIndexPage {
+    Ogre::HardwareIndexBuffer::IndexType type;
+    RangeAllocator ranges;
+    Ogre::HardwareIndexBufferSharedPtr buffer;
+
+    GfxMeshIndexPage (Ogre::HardwareIndexBuffer::IndexType type, size_t capacity)
+      : type(type), ranges(capacity)
+    {
+        buffer = Ogre::HardwareBufferManager::getSingleton().createIndexBuffer(
+            type, capacity, Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY);
+    }
+};
+
+// Disk resources can outlive the graphics system, so their geometry may be released after the
+// pages are gone.
+static bool shut_down = false;
+
+static std::map<VertexLayout, std::vector<GfxMeshVertexPage*>> vertex_pages;
+static std::map<Ogre::HardwareIndexBuffer::IndexType, std::vector<GfxMeshIndexPage*>> index_pages;
+
+static GfxMeshVertexPage *alloc_vertexes (const VertexLayout &layout, size_t count, size_t &start)
+{
+    auto &pages = vertex_pages[layout];
+    if (count > VERTEX_PAGE_CAPACITY) {
+        auto *page = new GfxMeshVertexPage(layout, count, true);
+        page->ranges.alloc(count, start);
+        pages.push_back(page);
+        return page;
+    }
+    for (auto *page : pages) {
+        if (page->dedicated) continue;
+        if (page->ranges.alloc(count, start)) return page;
+    }
+    auto *page = new GfxMeshVertexPage(layout, VERTEX_PAGE_CAPACITY, false);
+    page->ranges.alloc(count, start);
+    pages.push_back(page);
+    return page;
+}
+
+static GfxMeshIndexPage *alloc_indexes (Ogre::HardwareIndexBuffer::IndexType type, size_t count,
+                                        size_t &start)
+{
+    auto &pages = index_pages[type];
+    for (auto *page : pages) {
+        if (page->ranges.alloc(count, start)) return page;
+    }
+    auto *page = new GfxMeshIndexPage(type, std::max(count, INDEX_PAGE_CAPACITY));
+    page->ranges.alloc(count, start);
+    pages.push_back(page);
+    return page;
+}
+
+// Pages are freed when empty, except that one regular page of each kind is kept, to avoid
+// recreating it when meshes are streamed in and out.
+
+static void release_vertexes (GfxMeshVertexPage *page, size_t start, size_t count)
+{
+    page->ranges.release(start, count);
+    if (!page->ranges.isEmpty()) return;
+    auto &pages = vertex_pages[page->layout];
+    if (!page->dedicated && pages.size() == 1) return;
+    pages.erase(std::find(pages.begin(), pages.end(), page));
+    if (pages.empty()) vertex_pages.erase(page->layout);
+    delete page;
+}
+
+static void release_indexes (GfxMeshIndexPage *page, size_t start, size_t count)
+{
+    page->ranges.release(start, count);
+    if (!page->ranges.isEmpty()) return;
+    auto &pages = index_pages[page->type];
+    if (pages.size() == 1) return;
+    pages.erase(std::find(pages.begin(), pages.end(), page));
+    delete page;
+}
+
+template<class T> static void rebase_indexes (const Ogre::HardwareIndexBufferSharedPtr &src,
+                                              size_t src_start, size_t count, size_t base,
+                                              const Ogre::HardwareIndexBufferSharedPtr &dst,
+                                              size_t dst_start)
+{
+    std::vector<T> indexes(count);
+    src->readData(src_start * sizeof(T), count * sizeof(T), &indexes[0]);
+    for (auto &index : indexes) index += T(base);
+    dst->writeData(dst_start * sizeof(T), count * sizeof(T), &indexes[0]);
+}
+
+static bool can_share (const Ogre::MeshPtr &mesh)
+{
+    if (mesh->sharedVertexData == NULL) return false;
+    if (mesh->sharedVertexData->vertexCount == 0) return false;
+    if (mesh->hasVertexAnimation()) return false;
+    // LOD index lists would also have to be rewritten.
+    if (mesh->getNumLodLevels() > 1) return false;
+    for (unsigned i=0 ; i<mesh->getNumSubMeshes() ; ++i) {
+        Ogre::SubMesh *sm = mesh->getSubMesh(i);
+        if (!sm->useSharedVertices) return false;
+        if (sm->indexData == NULL || sm->indexData->indexCount == 0) return false;
+    }
+    return true;
+}
+
+
+// Replaces the vertex buffers with copies that have no shadow buffer, freeing the host memory.
+static void drop_vertex_shadows (Ogre::VertexData *vdata)
+{
+    if (vdata == NULL) return;
+    Ogre::VertexBufferBinding *vbind = vdata->vertexBufferBinding;
+    // Copied, as setBinding changes it.
+    Ogre::VertexBufferBinding::VertexBufferBindingMap bindings = vbind->getBindings();
+    for (const auto &binding : bindings) {
+        const Ogre::HardwareVertexBufferSharedPtr &src = binding.second;
+        if (!src->hasShadowBuffer()) continue;
+        Ogre::HardwareVertexBufferSharedPtr dst =
+            Ogre::HardwareBufferManager::getSingleton().createVertexBuffer(
+                src->getVertexSize(), src->getNumVertices(), src->getUsage());
+        dst->copyData(*src);
+        vbind->setBinding(binding.first, dst);
+    }
+}
+
+// Replaces the index buffer with a copy that has no shadow buffer, freeing the host memory.
+static void drop_index_shadow (Ogre::IndexData *idata)
+{
+    if (idata == NULL || idata->indexBuffer.isNull()) return;
+    const Ogre::HardwareIndexBufferSharedPtr &src = idata->indexBuffer;
+    if (!src->hasShadowBuffer()) return;
+    Ogre::HardwareIndexBufferSharedPtr dst =
+        Ogre::HardwareBufferManager::getSingleton().createIndexBuffer(
+            src->getType(), src->getNumIndexes(), src->getUsage());
+    dst->copyData(*src);
+    idata->indexBuffer = dst;
+}
+
+// The shadow buffers are only needed until the geometry has been read (and shared, if it can be).
+// Meshes with vertex animation keep them, as Ogre animates those on the CPU.
+static void drop_shadows (const Ogre::MeshPtr &mesh)
+{
+    if (mesh->hasVertexAnimation()) return;
+    drop_vertex_shadows(mesh->sharedVertexData);
+    for (unsigned i=0 ; i<mesh->getNumSubMeshes() ; ++i) {
+        Ogre::SubMesh *sm = mesh->getSubMesh(i);
+        if (!sm->useSharedVertices) drop_vertex_shadows(sm->vertexData);
+        drop_index_shadow(sm->indexData);
+        for (auto *lod : sm->mLodFaceList) drop_index_shadow(lod);
+    }
+}
+
+// Appends the positions of the vertex data, read from its shadow buffer.
+static void read_positions (const Ogre::VertexData *vdata, std::vector<float> &positions)
+{
+    const Ogre::VertexElement *el =
+        vdata->vertexDeclaration->findElementBySemantic(Ogre::VES_POSITION);
+    if (el == NULL) {
+        positions.resize(positions.size() + vdata->vertexCount * 3, 0.0f);
+        return;
+    }
+    const Ogre::HardwareVertexBufferSharedPtr &buf =
+        vdata->vertexBufferBinding->getBuffer(el->getSource());
+    size_t sz = buf->getVertexSize();
+    std::vector<unsigned char> data(vdata->vertexCount * sz);
+    buf->readData(vdata->vertexStart * sz, data.size(), data.empty() ? NULL : &data[0]);
+    for (size_t i=0 ; i<vdata->vertexCount ; ++i) {
+        float *pos;
+        el->baseVertexPointerToElement(&data[i * sz], &pos);
+        positions.insert(positions.end(), pos, pos + 3);
+    }
+}
+
+// Appends the indexes of the submesh, read from its shadow buffer, plus the given base.
+template<class T> static void read_indexes (const Ogre::IndexData *idata, uint32_t base,
+                                            std::vector<uint32_t> &indexes)
+{
+    std::vector<T> data(idata->indexCount);
+    idata->indexBuffer->readData(idata->indexStart * sizeof(T), data.size() * sizeof(T),
+                                 &data[0]);
+    for (T index : data) indexes.push_back(base + index);
+}
+
+GfxMeshGeometry::GfxMeshGeometry (const Ogre::MeshPtr &mesh)
+  : vertexData(mesh->sharedVertexData),
+    vertexCount(mesh->sharedVertexData == NULL ? 0 : mesh->sharedVertexData->vertexCount),
+    vertexStart(0),
+    vertexPage(NULL)
+{
+    uint32_t shared_base = 0;
+    if (mesh->sharedVertexData != NULL) read_positions(mesh->sharedVertexData, positions);
+    for (unsigned i=0 ; i<mesh->getNumSubMeshes() ; ++i) {
+        Ogre::SubMesh *sm = mesh->getSubMesh(i);
+        uint32_t base = shared_base;
+        if (!sm->useSharedVertices) {
+            base = positions.size() / 3;
+            read_positions(sm->vertexData, positions);
+        }
+        Ogre::IndexData *idata = sm->indexData;
+        indexBufferKeys.push_back(idata == NULL ? NULL : idata->indexBuffer.get());
+        if (idata == NULL || idata->indexCount == 0) continue;
+        if (idata->indexBuffer->getType() == Ogre::HardwareIndexBuffer::IT_16BIT) {
+            read_indexes<uint16_t>(idata, base, indexes);
+        } else {
+            read_indexes<uint32_t>(idata, base, indexes);
+        }
+    }
+}
+
+GfxMeshGeometryPtr GfxMeshGeometry::make (const Ogre::MeshPtr &mesh)
+{
+    APP_ASSERT(mesh->isLoaded());
+    GfxMeshGeometry *geometry = new GfxMeshGeometry(mesh);
+    if (can_share(mesh)) {
+        try {
+            geometry->share(mesh);
+        } catch (Ogre::Exception &e) {
+            CERR << "Could not share geometry of mesh \"/" << mesh->getName() << "\": "
+                 << e.getDescription() << std::endl;
+            geometry->release();
+        }
+    }
+    if (!geometry->isShared()) {
+        try {
+            drop_shadows(mesh);
+        } catch (Ogre::Exception &e) {
+            CERR << "Could not free shadow buffers of mesh \"/" << mesh->getName() << "\": "
+                 << e.getDescription() << std::endl;
+        }
+    }
+    return GfxMeshGeometryPtr(geometry);
+}
+
+void GfxMeshGeometry::share (const Ogre::MeshPtr &mesh)
+{
+    Ogre::VertexData *vdata = mesh->sharedVertexData;
+    Ogre::VertexBufferBinding *vbind = vdata->vertexBufferBinding;
+
+    VertexLayout layout;
+    for (const auto &binding : vbind->getBindings())
+        layout.emplace_back(binding.first, binding.second->getVertexSize());
+
+    size_t start;
+    vertexPage = alloc_vertexes(layout, vertexCount, start);
+    vertexStart = start;
+
+    for (unsigned i=0 ; i<layout.size() ; ++i) {
+        size_t sz = layout[i].second;
+        const Ogre::HardwareVertexBufferSharedPtr &src = vbind->getBuffer(layout[i].first);
+        vertexPage->buffers[i]->copyData(*src, vdata->vertexStart * sz, vertexStart * sz,
+                                         vertexCount * sz);
+    }
+
+    for (unsigned i=0 ; i<mesh->getNumSubMeshes() ; ++i) {
+        Ogre::IndexData *idata = mesh->getSubMesh(i)->indexData;
+        Ogre::HardwareIndexBuffer::IndexType type = idata->indexBuffer->getType();
+        IndexRange r;
+        r.count = idata->indexCount;
+        r.page = alloc_indexes(type, r.count, r.start);
+        indexRanges.push_back(r);
+        if (type == Ogre::HardwareIndexBuffer::IT_16BIT) {
+            rebase_indexes<uint16_t>(idata->indexBuffer, idata->indexStart, r.count, vertexStart,
+                                     r.page->buffer, r.start);
+        } else {
+            rebase_indexes<uint32_t>(idata->indexBuffer, idata->indexStart, r.count, vertexStart,
+                                     r.page->buffer, r.start);
+        }
+    }
+
+    // Everything is copied, so now point the mesh at it.  This releases the mesh's own buffers.
+    // Ogre has already measured the mesh for its memory budget, so that is unaffected.
+    for (unsigned i=0 ; i<layout.size() ; ++i)
+        vbind->setBinding(layout[i].first, vertexPage->buffers[i]);
+    vdata->vertexStart = 0;
+    vdata->vertexCount = vertexStart + vertexCount;
+    for (unsigned i=0 ; i<mesh->getNumSubMeshes() ; ++i) {
+        Ogre::IndexData *idata = mesh->getSubMesh(i)->indexData;
+        idata->indexBuffer = indexRanges[i].page->buffer;
+        idata->indexStart = indexRanges[i].start;
+        indexBufferKeys[i] = indexRanges[i].page->buffer.get();
+    }
+}
+
+void GfxMeshGeometry::release (void)
+{
+    if (shut_down) return;
+    if (vertexPage != NULL) release_vertexes(vertexPage, vertexStart, vertexCount);
+    for (const auto &r : indexRanges) release_indexes(r.page, r.start, r.count);
+    vertexPage = NULL;
+    vertexStart = 0;
+    indexRanges.clear();
+}
+
+GfxMeshGeometry::~GfxMeshGeometry (void)
+{
+    release();
+}
+
+const void *GfxMeshGeometry::getIndexBufferKey (unsigned submesh) const
+{
+    APP_ASSERT(submesh < indexBufferKeys.size());
+    return indexBufferKeys[submesh];
+}
+
+GfxMeshGeometryStats gfx_mesh_geometry_stats (void)
+{
+    GfxMeshGeometryStats r = { 0, 0, 0, 0, 0, 0 };
+    for (const auto &pair : vertex_pages) {
+        size_t stride = 0;
+        for (const auto &source : pair.first) stride += source.second;
+        for (const auto *page : pair.second) {
+            r.vertexBuffers += page->buffers.size();
+            r.vertexBytes += page->ranges.getCapacity() * stride;
+            r.vertexBytesUsed += page->ranges.getUsed() * stride;
+        }
+    }
+    for (const auto &pair : index_pages) {
+        size_t sz = pair.first == Ogre::HardwareIndexBuffer::IT_16BIT ? 2 : 4;
+        for (const auto *page : pair.second) {
+            r.indexBuffers++;
+            r.indexBytes += page->ranges.getCapacity() * sz;
+            r.indexBytesUsed += page->ranges.getUsed() * sz;
+        }
+    }
+    return r;
+}
+
+size_t gfx_mesh_geometry_unused_bytes (void)
+{
+    GfxMeshGeometryStats s = gfx_mesh_geometry_stats();
+    return (s.vertexBytes - s.vertexBytesUsed) + (s.indexBytes - s.indexBytesUsed);
+}
+
+void gfx_mesh_geometry_shutdown (void)
+{
+    shut_down = true;
+    for (const auto &pair : vertex_pages) {
+        for (auto *page : pair.second) delete page;
+    }
+    vertex_pages.clear();
+    for (const auto &pair : index_pages) {
+        for (auto *page : pair.second) delete page;
+    }
+    index_pages.clear();
+}
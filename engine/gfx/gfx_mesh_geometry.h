@@ -0,0 +1,130 @@
+/* Copyright (c) The Grit Game Engine authors 2016
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <cstdint>
+#include <vector>
+
+#include "../shared_ptr.h"
+
+class GfxMeshGeometry;
+struct GfxMeshVertexPage;
+struct GfxMeshIndexPage;
+typedef SharedPtr<GfxMeshGeometry> GfxMeshGeometryPtr;
+
+#ifndef GFX_MESH_GEOMETRY_H
+#define GFX_MESH_GEOMETRY_H
+
+/** \file
+ *
+ * The vertexes and indexes of meshes are copied into a small number of large GPU buffers,
+ * shared by all meshes with the same vertex layout.  The Ogre::Mesh is then pointed at its
+ * range of those buffers, so GfxBody, GfxInstances and everything else that draws the mesh use
+ * the same allocation, and the buffers created by Ogre when the mesh was loaded are freed.
+ * Consecutive draws of different meshes therefore usually need no buffer binds, and draws
+ * sharing geometry can be merged.
+ *
+ * Indexes are rewritten to be relative to the start of the shared vertex buffer, so no render
+ * system support for a base vertex is needed.  To keep 16 bit indexes valid, a shared vertex
+ * buffer holds at most 65536 vertexes.  Meshes larger than that get buffers of their own.
+ */
+
+/** Handle to a mesh's range of the shared vertex and index buffers.  The range is released
+ * when the last handle goes away.  Use GfxMeshDiskResource::getGeometry to get one. */
+class GfxMeshGeometry : public SharedPtrCounted {
+
+  public:
+
+    /** Move the geometry of a loaded mesh into the shared buffers.  Meshes that cannot share
+     * (vertex animation, LOD, per-submesh vertex data, or non-indexed submeshes) keep their own
+     * buffers, and the handle then only records their size.  Either way, the shadow buffers the
+     * mesh was loaded with are freed, unless it has vertex animation. */
+    static GfxMeshGeometryPtr make (const Ogre::MeshPtr &mesh);
+
+    ~GfxMeshGeometry (void);
+
+    /** Whether the mesh now draws from the shared buffers. */
+    bool isShared (void) const { return vertexPage != NULL; }
+
+    /** Number of vertexes in the mesh, not counting others in the same shared buffer. */
+    unsigned getVertexCount (void) const { return vertexCount; }
+
+    /** Offset of the mesh's first vertex in the shared vertex buffer (0 if not shared). */
+    unsigned getVertexStart (void) const { return vertexStart; }
+
+    /** The vertex data the mesh draws from, valid until the mesh is unloaded or reloaded. */
+    Ogre::VertexData *getVertexData (void) const { return vertexData; }
+
+    /** Identity of the index buffer of the given submesh.  Draws with the same vertex data and
+     * index buffer need no buffer binds in between. */
+    const void *getIndexBufferKey (unsigned submesh) const;
+
+    /** Positions of the mesh's vertexes (x, y, z), for readers on the CPU such as the navmesh
+     * builder.  The GPU buffers are write only, and when shared they also hold other meshes. */
+    const std::vector<float> &getPositions (void) const { return positions; }
+
+    /** Triangles of all the submeshes, as indexes into getPositions. */
+    const std::vector<uint32_t> &getIndexes (void) const { return indexes; }
+
+  private:
+
+    /** A range of an index page, one for each submesh. */
+    struct IndexRange {
+        GfxMeshIndexPage *page;
+        size_t start, count;
+    };
+
+    GfxMeshGeometry (const Ogre::MeshPtr &mesh);
+
+    /** Copy the mesh into the shared buffers, then rebind it.  If this throws, the mesh has not
+     * yet been touched. */
+    void share (const Ogre::MeshPtr &mesh);
+
+    void release (void);
+
+    Ogre::VertexData *vertexData;
+    unsigned vertexCount;
+    unsigned vertexStart;
+    GfxMeshVertexPage *vertexPage;
+    std::vector<IndexRange> indexRanges;
+    std::vector<const void*> indexBufferKeys;
+    std::vector<float> positions;
+    std::vector<uint32_t> indexes;
+
+    friend class SharedPtr<GfxMeshGeometry>;
+};
+
+/** Number of shared vertex and index buffers, and their total and used sizes in bytes. */
+struct GfxMeshGeometryStats {
+    unsigned vertexBuffers, indexBuffers;
+    size_t vertexBytes, vertexBytesUsed;
+    size_t indexBytes, indexBytesUsed;
+};
+
+GfxMeshGeometryStats gfx_mesh_geometry_stats (void);
+
+/** Bytes of the shared buffers not used by any mesh.  The used bytes are already counted by Ogre
+ * as part of each mesh, so this is what the shared buffers add to the GPU memory usage. */
+size_t gfx_mesh_geometry_unused_bytes (void);
+
+/** Free all shared buffers, at shutdown.  Handles released afterwards do nothing. */
+void gfx_mesh_geometry_shutdown (void);
+
+#endif
@@ -45,7 +45,7 @@ typedef SharedPtr<GfxFertileNode> GfxNodePtr;
  * scenegraph uses the Grit Transform struct which has correct handling of non-uniform scaling
  * (where !(x == y == z)).
  */
-class GfxNode : public fast_erase_index {
+class GfxNode : public fast_erase_index, public SharedPtrCounted {
     protected:
     static const std::string className;
     Vector3 localPos, localScale;
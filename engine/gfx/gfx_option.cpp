@@ -55,6 +55,8 @@ GfxBoolOption gfx_bool_options[] = {
 
     GFX_RENDER_FIRST_PERSON,
     GFX_UPDATE_MATERIALS,
+    GFX_TEXTURE_STREAMING,
+    GFX_AUTO_INSTANCING,
 };  
 
 GfxIntOption gfx_int_options[] = {
@@ -65,6 +67,8 @@ GfxIntOption gfx_int_options[] = {
     GFX_BLOOM_ITERATIONS,
     GFX_RAM,
     GFX_DEBUG_MODE,
+    GFX_TEXTURE_STREAMING_INITIAL_SIZE,
+    GFX_TEXTURE_STREAMING_MAX_PENDING,
 };      
         
 GfxFloatOption gfx_float_options[] = {
@@ -105,6 +109,7 @@ GfxFloatOption gfx_float_options[] = {
     GFX_ANAGLYPH_RIGHT_BLUE_MASK,
     GFX_ANAGLYPH_DESATURATION,
     GFX_BLOOM_THRESHOLD,
+    GFX_TEXTURE_STREAMING_MIP_BIAS,
 };
 
 static std::map<GfxBoolOption,bool> options_bool;
@@ -156,6 +161,8 @@ std::string gfx_option_to_string (GfxBoolOption o)
 
         TO_STRING_MACRO(GFX_RENDER_FIRST_PERSON);
         TO_STRING_MACRO(GFX_UPDATE_MATERIALS);
+        TO_STRING_MACRO(GFX_TEXTURE_STREAMING);
+        TO_STRING_MACRO(GFX_AUTO_INSTANCING);
     }
     return "UNKNOWN_BOOL_OPTION";
 }
@@ -169,6 +176,8 @@ std::string gfx_option_to_string (GfxIntOption o)
         TO_STRING_MACRO(GFX_BLOOM_ITERATIONS);
         TO_STRING_MACRO(GFX_RAM);
         TO_STRING_MACRO(GFX_DEBUG_MODE);
+        TO_STRING_MACRO(GFX_TEXTURE_STREAMING_INITIAL_SIZE);
+        TO_STRING_MACRO(GFX_TEXTURE_STREAMING_MAX_PENDING);
     }
     return "UNKNOWN_INT_OPTION";
 }
@@ -212,6 +221,7 @@ std::string gfx_option_to_string (GfxFloatOption o)
         TO_STRING_MACRO(GFX_ANAGLYPH_RIGHT_BLUE_MASK);
         TO_STRING_MACRO(GFX_ANAGLYPH_DESATURATION);
         TO_STRING_MACRO(GFX_BLOOM_THRESHOLD);
+        TO_STRING_MACRO(GFX_TEXTURE_STREAMING_MIP_BIAS);
     }
     return "UNKNOWN_FLOAT_OPTION";
 }
@@ -255,6 +265,8 @@ void gfx_option_from_string (const std::string &s,
 
     FROM_STRING_BOOL_MACRO(GFX_RENDER_FIRST_PERSON)
     FROM_STRING_BOOL_MACRO(GFX_UPDATE_MATERIALS)
+    FROM_STRING_BOOL_MACRO(GFX_TEXTURE_STREAMING)
+    FROM_STRING_BOOL_MACRO(GFX_AUTO_INSTANCING)
 
 
     FROM_STRING_INT_MACRO(GFX_FULLSCREEN_WIDTH)
@@ -265,6 +277,8 @@ void gfx_option_from_string (const std::string &s,
 
     FROM_STRING_INT_MACRO(GFX_RAM)
     FROM_STRING_INT_MACRO(GFX_DEBUG_MODE)
+    FROM_STRING_INT_MACRO(GFX_TEXTURE_STREAMING_INITIAL_SIZE)
+    FROM_STRING_INT_MACRO(GFX_TEXTURE_STREAMING_MAX_PENDING)
 
 
     FROM_STRING_FLOAT_MACRO(GFX_FOV)
@@ -304,6 +318,7 @@ void gfx_option_from_string (const std::string &s,
     FROM_STRING_FLOAT_MACRO(GFX_ANAGLYPH_RIGHT_BLUE_MASK)
     FROM_STRING_FLOAT_MACRO(GFX_ANAGLYPH_DESATURATION)
     FROM_STRING_FLOAT_MACRO(GFX_BLOOM_THRESHOLD)
+    FROM_STRING_FLOAT_MACRO(GFX_TEXTURE_STREAMING_MIP_BIAS)
 
     else t = -1;
 }
@@ -369,6 +384,8 @@ static void options_update (bool flush)
             case GFX_RENDER_HUD: break;
             case GFX_RENDER_FIRST_PERSON: break;
             case GFX_UPDATE_MATERIALS: break;
+            case GFX_TEXTURE_STREAMING: break;
+            case GFX_AUTO_INSTANCING: break;
         }
     }
     for (unsigned i=0 ; i<sizeof(gfx_int_options)/sizeof(*gfx_int_options) ; ++i) {
@@ -387,6 +404,9 @@ static void options_update (bool flush)
             break;
             case GFX_DEBUG_MODE:
             break;
+            case GFX_TEXTURE_STREAMING_INITIAL_SIZE:
+            case GFX_TEXTURE_STREAMING_MAX_PENDING:
+            break;
             case GFX_SHADOW_RES:
             shader_scene_env.shadowRes = v_new;
             reset_shadowmaps = true;
@@ -465,6 +485,8 @@ static void options_update (bool flush)
             break;
             case GFX_BLOOM_THRESHOLD:
             break;
+            case GFX_TEXTURE_STREAMING_MIP_BIAS:
+            break;
         }
     }
 
@@ -583,6 +605,8 @@ void gfx_option_reset (void)
 
     gfx_option(GFX_RENDER_FIRST_PERSON, true);
     gfx_option(GFX_UPDATE_MATERIALS, true);
+    gfx_option(GFX_TEXTURE_STREAMING, true);
+    gfx_option(GFX_AUTO_INSTANCING, true);
 
 
     gfx_option(GFX_FULLSCREEN_WIDTH, 800);
@@ -592,6 +616,8 @@ void gfx_option_reset (void)
     gfx_option(GFX_BLOOM_ITERATIONS, 0);
     gfx_option(GFX_RAM, 128);
     gfx_option(GFX_DEBUG_MODE, 0);
+    gfx_option(GFX_TEXTURE_STREAMING_INITIAL_SIZE, 64);
+    gfx_option(GFX_TEXTURE_STREAMING_MAX_PENDING, 16);
 
 
     gfx_option(GFX_FOV, 55.0f);
@@ -632,6 +658,7 @@ void gfx_option_reset (void)
 
     gfx_option(GFX_ANAGLYPH_DESATURATION, 0.5f);
     gfx_option(GFX_BLOOM_THRESHOLD, 1.0f);
+    gfx_option(GFX_TEXTURE_STREAMING_MIP_BIAS, 0.0f);
 
 }
 
@@ -649,6 +676,8 @@ void gfx_option_init (void)
     valid_option(GFX_BLOOM_ITERATIONS, new ValidOptionRange<int>(0,255));
     valid_option(GFX_RAM, new ValidOptionRange<int>(0,16384));
     valid_option(GFX_DEBUG_MODE, new ValidOptionRange<int>(0,8));
+    valid_option(GFX_TEXTURE_STREAMING_INITIAL_SIZE, new ValidOptionRange<int>(1,16384));
+    valid_option(GFX_TEXTURE_STREAMING_MAX_PENDING, new ValidOptionRange<int>(1,1024));
 
 
     valid_option(GFX_FOV, new ValidOptionRange<float>(0.0000001f,179.0f));
@@ -689,6 +718,7 @@ void gfx_option_init (void)
 
     valid_option(GFX_ANAGLYPH_DESATURATION, new ValidOptionRange<float>(0.0f,1.0f));
     valid_option(GFX_BLOOM_THRESHOLD, new ValidOptionRange<float>(0.0f,255.0f));
+    valid_option(GFX_TEXTURE_STREAMING_MIP_BIAS, new ValidOptionRange<float>(-4.0f,4.0f));
 
     gfx_option(GFX_AUTOUPDATE, false);
     gfx_option_reset();
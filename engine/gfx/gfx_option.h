@@ -49,6 +49,8 @@ enum GfxBoolOption {
 
     GFX_RENDER_FIRST_PERSON,
     GFX_UPDATE_MATERIALS,
+    GFX_TEXTURE_STREAMING,
+    GFX_AUTO_INSTANCING,
 };
 
 enum GfxIntOption {
@@ -60,6 +62,8 @@ enum GfxIntOption {
 
     GFX_RAM,
     GFX_DEBUG_MODE,
+    GFX_TEXTURE_STREAMING_INITIAL_SIZE,
+    GFX_TEXTURE_STREAMING_MAX_PENDING,
 };
 
 enum GfxFloatOption {
@@ -100,7 +104,8 @@ enum GfxFloatOption {
     GFX_ANAGLYPH_RIGHT_BLUE_MASK,
     GFX_ANAGLYPH_DESATURATION,
 
-    GFX_BLOOM_THRESHOLD
+    GFX_BLOOM_THRESHOLD,
+    GFX_TEXTURE_STREAMING_MIP_BIAS,
 };
 
 std::string gfx_option_to_string (GfxBoolOption o);
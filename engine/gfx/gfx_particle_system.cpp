@@ -25,6 +25,7 @@
 
 #include <math_util.h>
 
+#include "../frame_allocator.h"
 #include "../vect_util.h"
 
 #include "gfx.h"
@@ -308,7 +309,8 @@ class GfxParticleSystem {
         // PREPARE BUFFERS
 
         // temporary list for sorting in
-        std::vector<GfxParticle*> tmp_list;
+        FrameVector<GfxParticle*> tmp_list;
+        tmp_list.reserve(particles.size());
         for (unsigned i=0 ; i<particles.size() ; ++i) {
             GfxParticle *p = particles[i];
             p->preProcess(cam_pos);
@@ -19,7 +19,16 @@
  * THE SOFTWARE.
  */
 
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <set>
+#include <thread>
+
 #include <centralised_log.h>
+#include <sleep.h>
+
+#include "../metrics.h"
 
 #include "gfx.h"
 #include "gfx_gasoline.h"
@@ -184,31 +193,218 @@ template<class T> static void hack_set_constant(const Ogre::GpuProgramParameters
 }
 
 
+static MetricHistogram *metric_reload_seconds =
+    metrics_histogram("grit_gfx_shader_reload_seconds", "",
+                      "Time from a shader being changed to its new programs being in use.",
+                      metrics_latency_bounds());
+static MetricCounter *metric_reload_permutations =
+    metrics_counter("grit_gfx_shader_reload_permutations_total", "",
+                    "Shader permutations recompiled by hot reloads.");
+
+// Shaders with a reset being compiled in the background.
+static std::set<GfxShader*> pending_resets;
+
+// Time to spend creating native programs for pending resets, per frame.
+static const unsigned long long reset_budget_micros = 4000;
+
+static GfxGslMetadata make_metadata (const GfxGslRunParams &params, bool internal,
+                                     GfxGslPurpose purpose,
+                                     const GfxGslConfigEnvironment &cfg_env,
+                                     const GfxGslMaterialEnvironment &mat_env,
+                                     const GfxGslMeshEnvironment &mesh_env)
+{
+    GfxGslMetadata md;
+    md.params = params;
+    md.cfgEnv = cfg_env;
+    md.matEnv = mat_env;
+    md.meshEnv = mesh_env;
+    md.d3d9 = gfx_d3d9();
+    md.internal = internal;
+    md.lightingTextures = gfx_gasoline_does_lighting(purpose);
+    return md;
+}
+
+template<class T> static void remove_programs (const T &cache)
+{
+    for (const auto &pair1 : cache) {
+        for (const auto &pair2 : pair1.second) {
+            const auto &np = pair2.second;
+            Ogre::HighLevelGpuProgramManager::getSingleton().remove(np.vp);
+            Ogre::HighLevelGpuProgramManager::getSingleton().remove(np.fp);
+        }
+    }
+}
+
+struct GfxShader::PendingReset {
+    GfxGslRunParams params;
+    std::string srcVertex, srcDangs, srcAdditional;
+    bool internal;
+
+    struct Job {
+        GfxGslMaterialEnvironment matEnv;
+        Split split;
+        GfxGslMetadata md;
+        std::future<GfxGasolineResult> output;
+    };
+    // Permutations of the old code that were in use, in the current config environment, then
+    // any first requested while the reset was pending.  The futures join their threads when
+    // destroyed, which is before the sources they read are.
+    std::vector<Job> jobs;
+    // Jobs given to a thread so far.
+    unsigned launched;
+    // Jobs whose native programs have been created so far, always in order.
+    unsigned built;
+
+    GfxGslConfigEnvironment cfgEnv;
+    ShaderCacheByConfig cache;
+
+    unsigned long long started;
+
+    void add (const GfxGslConfigEnvironment &cfg_env, const GfxGslMaterialEnvironment &mat_env,
+              const Split &split)
+    {
+        jobs.emplace_back();
+        Job &job = jobs.back();
+        job.matEnv = mat_env;
+        job.split = split;
+        job.md = make_metadata(params, internal, split.purpose, cfg_env, mat_env, split.meshEnv);
+    }
+
+    void launch (void)
+    {
+        Job &job = jobs[launched++];
+        GfxGslPurpose purpose = job.split.purpose;
+        // A copy, as jobs can be added (moving the others) while it runs.
+        GfxGslMetadata md = job.md;
+        job.output = std::async(std::launch::async, [this, purpose, md] () {
+            return gfx_gasoline_compile(purpose, backend, srcVertex, srcDangs, srcAdditional, md);
+        });
+    }
+};
+
 void GfxShader::reset (const GfxGslRunParams &p,
                        const std::string &src_vertex,
                        const std::string &src_dangs,
                        const std::string &src_additional,
                        bool internal_)
 {
-    params = p;
-    srcVertex = src_vertex;
-    srcDangs = src_dangs;
-    srcAdditional = src_additional;
-    internal = internal_;
-
-    // Destroy all currently built shaders
-    for (const auto &pair1 : shaderCache) {
-        for (const auto &pair2 : pair1.second) {
-            for (const auto &pair3 : pair2.second) {
-                const NativePair &np = pair3.second;
-                Ogre::HighLevelGpuProgramManager::getSingleton().remove(np.vp);
-                Ogre::HighLevelGpuProgramManager::getSingleton().remove(np.fp);
-            }
+    // A newer reset replaces one that has not finished yet.
+    abandonReset();
+
+    auto it = shaderCache.find(shader_scene_env);
+    if (it == shaderCache.end() || it->second.empty()) {
+        // Nothing is using the old code, so there is nothing to recompile.
+        params = p;
+        srcVertex = src_vertex;
+        srcDangs = src_dangs;
+        srcAdditional = src_additional;
+        internal = internal_;
+        for (const auto &pair1 : shaderCache) remove_programs(pair1.second);
+        shaderCache.clear();
+        return;
+    }
+
+    pending = new PendingReset();
+    PendingReset &r = *pending;
+    r.params = p;
+    r.srcVertex = src_vertex;
+    r.srcDangs = src_dangs;
+    r.srcAdditional = src_additional;
+    r.internal = internal_;
+    r.cfgEnv = shader_scene_env;
+    r.launched = 0;
+    r.built = 0;
+    r.started = micros();
+    for (const auto &pair2 : it->second) {
+        for (const auto &pair3 : pair2.second)
+            r.add(r.cfgEnv, pair2.first, pair3.first);
+    }
+    pending_resets.insert(this);
+    // The jobs are started by pollReset, so that only a few threads run at a time.
+    pollReset(0);
+}
+
+bool GfxShader::pollReset (unsigned long long budget_micros)
+{
+    if (pending == nullptr) return true;
+    PendingReset &r = *pending;
+
+    unsigned long long deadline = micros() + budget_micros;
+    bool first = true;
+    while (r.built < r.launched) {
+        // Always build at least one program per frame, so the reset finishes eventually.
+        if (!first && micros() >= deadline) break;
+        PendingReset::Job &job = r.jobs[r.built];
+        if (job.output.wait_for(std::chrono::seconds(0)) != std::future_status::ready) break;
+        first = false;
+        try {
+            GfxGasolineResult output = job.output.get();
+            r.cache[job.md.cfgEnv][job.matEnv][job.split] = makeNativePair(job.split, output);
+        } catch (const Exception &e) {
+            CERR << name << ": " << e.msg << std::endl;
+            CERR << name << ": Keeping the previous version of the shader." << std::endl;
+            abandonReset();
+            return true;
+        } catch (const std::exception &e) {
+            // Including Ogre exceptions, from the native compiler.
+            CERR << name << ": " << e.what() << std::endl;
+            CERR << name << ": Keeping the previous version of the shader." << std::endl;
+            abandonReset();
+            return true;
         }
+        r.built++;
+    }
+
+    // Keep the threads busy.
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    while (r.launched < r.jobs.size() && r.launched - r.built < threads) r.launch();
+
+    if (r.built < r.jobs.size()) return false;
+
+    // Swap everything at once, so no material ever uses a mix of old and new code.
+    params = r.params;
+    srcVertex = r.srcVertex;
+    srcDangs = r.srcDangs;
+    srcAdditional = r.srcAdditional;
+    internal = r.internal;
+    for (const auto &pair1 : shaderCache) remove_programs(pair1.second);
+    shaderCache = std::move(r.cache);
+
+    double seconds = (micros() - r.started) / 1E6;
+    metric_reload_seconds->observe(seconds);
+    metric_reload_permutations->inc(r.jobs.size());
+    CVERB << "Reloaded shader " << name << ": " << r.jobs.size() << " permutations in "
+          << seconds * 1000 << "ms" << std::endl;
+
+    delete pending;
+    pending = nullptr;
+    pending_resets.erase(this);
+    // Materials pick up the new programs the next time their passes are updated.
+    return true;
+}
+
+void GfxShader::finishReset (void)
+{
+    while (pending != nullptr) {
+        PendingReset &r = *pending;
+        if (r.built < r.launched) r.jobs[r.built].output.wait();
+        // Builds at least one program, and launches more jobs.
+        pollReset(0);
     }
-    shaderCache.clear();
+}
 
-    // all mats must reset now
+void GfxShader::abandonReset (void)
+{
+    if (pending == nullptr) return;
+    for (const auto &pair1 : pending->cache) remove_programs(pair1.second);
+    delete pending;
+    pending = nullptr;
+    pending_resets.erase(this);
+}
+
+const GfxGslRunParams &GfxShader::getParams (void) const
+{
+    return pending == nullptr ? params : pending->params;
 }
 
 // Build a list of texture params that are not satisfied by actual textures.
@@ -220,7 +416,9 @@ void GfxShader::populateMatEnv (bool fade_dither,
 {
     mat_env.ubt.clear();
     mat_env.fadeDither = fade_dither;
-    for (const auto &u : params) {
+    // While a reset is pending, this is the environment of the new code.  If the old code was
+    // built for the same one, that is used until the swap, otherwise see getNativePair.
+    for (const auto &u : getParams()) {
         // Find undefined textures.
         if (gfx_gasoline_param_is_texture(u.second)) {
             if (textures.find(u.first) == textures.end()) {
@@ -251,79 +449,35 @@ GfxShader::NativePair GfxShader::getNativePair (GfxGslPurpose purpose,
     // Need to choose / maybe compile a shader for this combination of textures and bindings.
     //
     //
-    ShaderCacheBySplit &cache = shaderCache[shader_scene_env][mat_env];
     Split split;
     split.purpose = purpose;
     split.meshEnv = mesh_env;
+
+    if (pending != nullptr) {
+        const ShaderCacheBySplit &old = shaderCache[shader_scene_env][mat_env];
+        auto it = old.find(split);
+        if (it != old.end()) return it->second;
+        // The old code was never built for this permutation.  Building it now would be thrown
+        // away at the swap, so add it to the reset and swap straight away instead.  If the new
+        // code fails to compile, the old code is built below as usual.
+        pending->add(shader_scene_env, mat_env, split);
+        finishReset();
+    }
+
+    ShaderCacheBySplit &cache = shaderCache[shader_scene_env][mat_env];
     auto it = cache.find(split);
 
     if (it == cache.end()) {
         // Need to build it.
-        Ogre::HighLevelGpuProgramPtr vp;
-        Ogre::HighLevelGpuProgramPtr fp;
-
-
-        std::string oname = fresh_name();
-        if (backend == GFX_GSL_BACKEND_CG) {
-            vp = Ogre::HighLevelGpuProgramManager::getSingleton().createProgram(
-                oname+"_v", RESGRP, "cg", Ogre::GPT_VERTEX_PROGRAM);
-            fp = Ogre::HighLevelGpuProgramManager::getSingleton().createProgram(
-                oname+"_f", RESGRP, "cg", Ogre::GPT_FRAGMENT_PROGRAM);
-            Ogre::StringVector vp_profs, fp_profs;
-            if (gfx_d3d9()) {
-                vp_profs.push_back("vs_3_0");
-                fp_profs.push_back("ps_3_0");
-            } else {
-                vp_profs.push_back("gpu_vp");
-                fp_profs.push_back("gp4fp");
-            }
-
-            Ogre::CgProgram *tmp_vp = static_cast<Ogre::CgProgram*>(&*vp);
-            tmp_vp->setEntryPoint("main");
-            tmp_vp->setProfiles(vp_profs);
-            tmp_vp->setCompileArguments("-I. -O3");
-
-            Ogre::CgProgram *tmp_fp = static_cast<Ogre::CgProgram*>(&*fp);
-            tmp_fp->setEntryPoint("main");
-            tmp_fp->setProfiles(fp_profs);
-            tmp_fp->setCompileArguments("-I. -O3");
-        } else {
-            vp = Ogre::HighLevelGpuProgramManager::getSingleton().createProgram(
-                oname+"_v", RESGRP, "glsl", Ogre::GPT_VERTEX_PROGRAM);
-            fp = Ogre::HighLevelGpuProgramManager::getSingleton().createProgram(
-                oname+"_f", RESGRP, "glsl", Ogre::GPT_FRAGMENT_PROGRAM);
-        }
-
-
-        GfxGslMetadata md;
-        md.params = params;
-        md.cfgEnv = shader_scene_env;
-        md.matEnv = mat_env;
-        md.meshEnv = mesh_env;
-        md.d3d9 = gfx_d3d9();
-        md.internal = internal;
-        md.lightingTextures = gfx_gasoline_does_lighting(purpose);
-
+        GfxGslMetadata md = make_metadata(params, internal, purpose, shader_scene_env,
+                                          mat_env, mesh_env);
         GfxGasolineResult output;
         try {
             output = gfx_gasoline_compile(purpose, backend, srcVertex, srcDangs, srcAdditional, md);
         } catch (const Exception &e) {
             EXCEPT << name << ": " << e.msg << ENDL;
         }
-        if (dump_shader == "*" || dump_shader == name) {
-            CVERB << "=== Compiling: " << name << " " << split << std::endl;
-            CVERB << "--- Vertex ---\n" << output.vertexShader << std::endl;
-            CVERB << "--- Fragment ---\n" << output.fragmentShader << std::endl;
-        }
-        vp->setSource(output.vertexShader);
-        fp->setSource(output.fragmentShader);
-        vp->load();
-        fp->load();
-
-        if (backend == GFX_GSL_BACKEND_GLSL33) {
-            gfx_gl3_plus_force_shader_compilation(vp, fp);
-        }
-        NativePair np = {vp, fp};
+        NativePair np = makeNativePair(split, output);
         cache[split] = np;
 
         return np;
@@ -335,6 +489,61 @@ GfxShader::NativePair GfxShader::getNativePair (GfxGslPurpose purpose,
     }
 }
 
+GfxShader::NativePair GfxShader::makeNativePair (const Split &split,
+                                                 const GfxGasolineResult &output)
+{
+    Ogre::HighLevelGpuProgramPtr vp;
+    Ogre::HighLevelGpuProgramPtr fp;
+
+
+    std::string oname = fresh_name();
+    if (backend == GFX_GSL_BACKEND_CG) {
+        vp = Ogre::HighLevelGpuProgramManager::getSingleton().createProgram(
+            oname+"_v", RESGRP, "cg", Ogre::GPT_VERTEX_PROGRAM);
+        fp = Ogre::HighLevelGpuProgramManager::getSingleton().createProgram(
+            oname+"_f", RESGRP, "cg", Ogre::GPT_FRAGMENT_PROGRAM);
+        Ogre::StringVector vp_profs, fp_profs;
+        if (gfx_d3d9()) {
+            vp_profs.push_back("vs_3_0");
+            fp_profs.push_back("ps_3_0");
+        } else {
+            vp_profs.push_back("gpu_vp");
+            fp_profs.push_back("gp4fp");
+        }
+
+        Ogre::CgProgram *tmp_vp = static_cast<Ogre::CgProgram*>(&*vp);
+        tmp_vp->setEntryPoint("main");
+        tmp_vp->setProfiles(vp_profs);
+        tmp_vp->setCompileArguments("-I. -O3");
+
+        Ogre::CgProgram *tmp_fp = static_cast<Ogre::CgProgram*>(&*fp);
+        tmp_fp->setEntryPoint("main");
+        tmp_fp->setProfiles(fp_profs);
+        tmp_fp->setCompileArguments("-I. -O3");
+    } else {
+        vp = Ogre::HighLevelGpuProgramManager::getSingleton().createProgram(
+            oname+"_v", RESGRP, "glsl", Ogre::GPT_VERTEX_PROGRAM);
+        fp = Ogre::HighLevelGpuProgramManager::getSingleton().createProgram(
+            oname+"_f", RESGRP, "glsl", Ogre::GPT_FRAGMENT_PROGRAM);
+    }
+
+    if (dump_shader == "*" || dump_shader == name) {
+        CVERB << "=== Compiling: " << name << " " << split << std::endl;
+        CVERB << "--- Vertex ---\n" << output.vertexShader << std::endl;
+        CVERB << "--- Fragment ---\n" << output.fragmentShader << std::endl;
+    }
+    vp->setSource(output.vertexShader);
+    fp->setSource(output.fragmentShader);
+    vp->load();
+    fp->load();
+
+    if (backend == GFX_GSL_BACKEND_GLSL33) {
+        gfx_gl3_plus_force_shader_compilation(vp, fp);
+    }
+    NativePair np = {vp, fp};
+    return np;
+}
+
 
 void GfxShader::bindShaderParams (int counter,
                                   const Ogre::GpuProgramParametersSharedPtr &vparams,
@@ -377,9 +586,11 @@ void GfxShader::bindShaderParams (int counter,
             auto bind = bindings.find(name);
             if (bind != bindings.end()) {
                 GfxGslParamType bt = bind->second.t;
+                // While a reset is pending, the binding may be for the new type of the
+                // uniform, in which case the old programs get the default.
                 if (bt == param.t) {
                     vptr = &bind->second;
-                } else {
+                } else if (pending == nullptr) {
                     EXCEPTEX << "Binding \"" << name << "\" had wrong type in shader "
                              << "\"" << this->name << "\": got " << bt << " but expected "
                              << vptr->t << ENDL;
@@ -1340,12 +1551,30 @@ void gfx_shader_check (const std::string &name,
 
 
 
+void gfx_shader_frame (void)
+{
+    // Copied, as the shaders remove themselves when they are done.
+    std::vector<GfxShader*> shaders(pending_resets.begin(), pending_resets.end());
+    unsigned long long deadline = micros() + reset_budget_micros;
+    for (GfxShader *shader : shaders) {
+        unsigned long long now = micros();
+        shader->pollReset(now < deadline ? deadline - now : 0);
+    }
+}
+
+unsigned gfx_shader_resets_pending (void)
+{
+    return pending_resets.size();
+}
+
 void gfx_shader_init (void)
 {
 }
 
 void gfx_shader_shutdown (void)
 {
+    std::vector<GfxShader*> shaders(pending_resets.begin(), pending_resets.end());
+    for (GfxShader *shader : shaders) shader->abandonReset();
 }
 
 
@@ -145,6 +145,11 @@ class GfxShader {
 
     ShaderCacheByConfig shaderCache;
 
+    // A reset whose permutations are still being compiled.  Until all of them are ready, the old
+    // sources and programs stay in use.
+    struct PendingReset;
+    PendingReset *pending;
+
     public:
 
     const std::string name;
@@ -156,19 +161,38 @@ class GfxShader {
                const std::string &src_dangs,
                const std::string &src_additional,
                bool internal)
-      : name(name)
+      : pending(nullptr), name(name)
     {
         reset(params, src_vertex, src_dangs, src_additional, internal);
     }
 
 
+    /** Replace the source code.  If programs have already been built, the permutations that
+     * were in use are recompiled in the background and swapped in together by pollReset, so the
+     * old programs are used until then. */
     void reset (const GfxGslRunParams &params,
                 const std::string &src_vertex,
                 const std::string &src_dangs,
                 const std::string &src_additional,
                 bool internal);
 
-    const GfxGslRunParams &getParams(void) const { return params; }
+    /** Called every frame while a reset is pending.  Builds the programs that are ready, within
+     * the given time, and returns true once the new ones have been swapped in (or the reset has
+     * failed and been abandoned). */
+    bool pollReset (unsigned long long budget_micros);
+
+    /** Waits for the background compilation and swaps the new programs in now. */
+    void finishReset (void);
+
+    /** Waits for the background compilation and throws away its programs, leaving the old ones
+     * in use. */
+    void abandonReset (void);
+
+    bool isResetting (void) const { return pending != nullptr; }
+
+    /** The uniforms of the newest code, even if its programs are still being built, so that
+     * materials can be registered against it straight away. */
+    const GfxGslRunParams &getParams(void) const;
 
 
     // New API, may throw compilation errors if not checked previously.
@@ -249,6 +273,9 @@ class GfxShader {
                               const GfxGslMaterialEnvironment &mat_env,
                               const GfxGslMeshEnvironment &mesh_env);
 
+    // Creates and loads the native programs for generated code.
+    NativePair makeNativePair (const Split &split, const GfxGasolineResult &output);
+
     // Generic: binds uniforms (not textures, but texture indexes) for both RS and passes
     void bindGlobals (const Ogre::GpuProgramParametersSharedPtr &vparams,
                       const Ogre::GpuProgramParametersSharedPtr &fparams,
@@ -310,6 +337,12 @@ GfxShader *gfx_shader_make_or_reset (const std::string &name,
 GfxShader *gfx_shader_get (const std::string &name);
 bool gfx_shader_has (const std::string &name);
 
+/** Continues the resets that are being compiled in the background. */
+void gfx_shader_frame (void);
+
+/** The number of shaders whose resets are still being compiled. */
+unsigned gfx_shader_resets_pending (void);
+
 void gfx_shader_init (void);
 void gfx_shader_shutdown (void);
 
@@ -26,14 +26,16 @@
 const unsigned VERT_FLOAT_SZ = 2+2+4;
 const unsigned VERT_BYTE_SZ = VERT_FLOAT_SZ*sizeof(float);
 
-/** If the font doesn't have the codepoint, try some alternatives. */
-static GfxFont::codepoint_t override_cp (GfxFont *font, GfxFont::codepoint_t cp) 
+/** Look up the glyph of the codepoint, or if the font doesn't have it, try some alternatives. */
+static const GfxFont::Glyph *lookup_glyph (GfxFont *font, GfxFont::codepoint_t cp)
 {
-    if (font->hasCodePoint(cp)) return cp;
-    if (font->hasCodePoint(UNICODE_ERROR_CODEPOINT)) return UNICODE_ERROR_CODEPOINT;
-    if (font->hasCodePoint(' ')) return ' ';
-    if (font->hasCodePoint('E')) return 'E';
-    return cp;
+    const GfxFont::Glyph *g = font->getGlyph(cp);
+    if (g != NULL) return g;
+    g = font->getGlyph(UNICODE_ERROR_CODEPOINT);
+    if (g != NULL) return g;
+    g = font->getGlyph(' ');
+    if (g != NULL) return g;
+    return font->getGlyph('E');
 }
 
 static bool is_whitespace (GfxFont::codepoint_t cp)
@@ -141,19 +143,19 @@ void GfxTextBuffer::updateGPU (bool no_scroll, long top, long bottom)
 
     unsigned long current_size = 0;
 
+    Vector2 tex_dim = font->getTextureDimensions();
+
     for (unsigned long i=start_index ; i<stop_index ; ++i) {
         const ColouredChar &c = colouredText[i];
         if (is_whitespace(c.cp)) {
             continue;
         }
 
-        GfxFont::CharRect uvs;
-        GfxFont::codepoint_t cp = override_cp(font, c.cp);
-        bool r = font->getCodePointOrFail(cp, uvs);
-        if (!r) continue;
-        Vector2 tex_dim = font->getTextureDimensions();
-        float width = uvs.u2 - uvs.u1;
-        float height = uvs.v2 - uvs.v1;
+        const GfxFont::Glyph *glyph = lookup_glyph(font, c.cp);
+        if (glyph == NULL) continue;
+        const GfxFont::CharRect &uvs = glyph->rect;
+        float width = glyph->advance;
+        float height = glyph->height;
 
         if (width == 0 || height == 0) {
             // invalid char rect in font -- indicates char should not be rendered
@@ -302,10 +304,10 @@ void GfxTextBuffer::recalculatePositions (unsigned long start)
             break;
 
             case '\t': {
-                GfxFont::CharRect uvs;
-                if (font->getCodePointOrFail(' ', uvs)) {
+                const GfxFont::Glyph *space = font->getGlyph(' ');
+                if (space != NULL) {
                     // TODO: override tab width per textbuffer?
-                    unsigned long tab_width = 8 * (uvs.u2 - uvs.u1);
+                    unsigned long tab_width = 8 * space->advance;
                     // round up to next multiple of tab_width
                     if (tab_width > 0)
                         currentLeft = (currentLeft + tab_width)/tab_width * tab_width;
@@ -314,11 +316,9 @@ void GfxTextBuffer::recalculatePositions (unsigned long start)
             break;
 
             default: {
-                GfxFont::CharRect uvs;
-                GfxFont::codepoint_t cp = override_cp(font, c.cp);
-                if (!font->getCodePointOrFail(cp, uvs)) continue;
-                float width = (uvs.u2 - uvs.u1);
-                currentLeft += width;
+                const GfxFont::Glyph *glyph = lookup_glyph(font, c.cp);
+                if (glyph == NULL) continue;
+                currentLeft += glyph->advance;
                 if (c.cp != ' ') {
                 }
             }
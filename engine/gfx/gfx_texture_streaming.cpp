@@ -0,0 +1,386 @@
+/* Copyright (c) The Grit Game Engine authors 2016
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+
+#include <centralised_log.h>
+
+#include "../log_sink.h"
+
+#include "gfx_disk_resource.h"
+#include "gfx_internal.h"
+#include "gfx_texture_streaming.h"
+
+// {{{ DDS parsing
+
+static uint32_t read_u32 (const uint8_t *p)
+{
+    return uint32_t(p[0]) | uint32_t(p[1]) << 8 | uint32_t(p[2]) << 16 | uint32_t(p[3]) << 24;
+}
+
+static uint32_t four_cc (const char *s)
+{
+    return read_u32(reinterpret_cast<const uint8_t*>(s));
+}
+
+static const uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+static const uint32_t DDPF_ALPHAPIXELS = 0x1;
+static const uint32_t DDPF_FOURCC = 0x4;
+static const uint32_t DDPF_RGB = 0x40;
+static const uint32_t DDSCAPS2_CUBEMAP = 0x200;
+static const uint32_t DDSCAPS2_VOLUME = 0x200000;
+
+bool gfx_dds_parse_layout (const uint8_t *header, size_t header_len, GfxDDSLayout &layout)
+{
+    if (header_len < GFX_DDS_HEADER_SIZE) return false;
+    if (read_u32(header) != four_cc("DDS ")) return false;
+    if (read_u32(header + 4) != 124) return false;
+
+    uint32_t flags = read_u32(header + 8);
+    layout.height = read_u32(header + 12);
+    layout.width = read_u32(header + 16);
+    layout.numMips = (flags & DDSD_MIPMAPCOUNT) ? read_u32(header + 28) : 1;
+
+    uint32_t pf_flags = read_u32(header + 80);
+    uint32_t pf_four_cc = read_u32(header + 84);
+    uint32_t pf_bits = read_u32(header + 88);
+    uint32_t pf_r = read_u32(header + 92);
+    uint32_t pf_g = read_u32(header + 96);
+    uint32_t pf_b = read_u32(header + 100);
+    uint32_t pf_a = read_u32(header + 104);
+    uint32_t caps2 = read_u32(header + 112);
+
+    if (caps2 & (DDSCAPS2_CUBEMAP | DDSCAPS2_VOLUME)) return false;
+    if (layout.width == 0 || layout.height == 0) return false;
+
+    // Streaming a texture with no smaller mips would achieve nothing.
+    unsigned full_chain = 1;
+    while ((std::max(layout.width, layout.height) >> full_chain) > 0) full_chain++;
+    if (layout.numMips != full_chain) return false;
+
+    // Either the size of a 4x4 block, or the size of a pixel.
+    unsigned block_bytes = 0;
+    bool compressed = false;
+    if (pf_flags & DDPF_FOURCC) {
+        compressed = true;
+        if (pf_four_cc == four_cc("DXT1")) {
+            layout.format = Ogre::PF_DXT1; block_bytes = 8;
+        } else if (pf_four_cc == four_cc("DXT3")) {
+            layout.format = Ogre::PF_DXT3; block_bytes = 16;
+        } else if (pf_four_cc == four_cc("DXT5")) {
+            layout.format = Ogre::PF_DXT5; block_bytes = 16;
+        } else if (pf_four_cc == four_cc("ATI1") || pf_four_cc == four_cc("BC4U")) {
+            layout.format = Ogre::PF_BC4_UNORM; block_bytes = 8;
+        } else if (pf_four_cc == four_cc("ATI2") || pf_four_cc == four_cc("BC5U")) {
+            layout.format = Ogre::PF_BC5_UNORM; block_bytes = 16;
+        } else {
+            // Includes DX10 extended headers, and float formats.
+            return false;
+        }
+    } else if (pf_flags & DDPF_RGB) {
+        if (pf_r != 0x00ff0000 || pf_g != 0x0000ff00 || pf_b != 0x000000ff) return false;
+        bool alpha = (pf_flags & DDPF_ALPHAPIXELS) && pf_a == 0xff000000;
+        if (pf_bits == 32) {
+            layout.format = alpha ? Ogre::PF_A8R8G8B8 : Ogre::PF_X8R8G8B8; block_bytes = 4;
+        } else if (pf_bits == 24 && !alpha) {
+            layout.format = Ogre::PF_R8G8B8; block_bytes = 3;
+        } else {
+            return false;
+        }
+    } else {
+        return false;
+    }
+
+    layout.offsets.resize(layout.numMips);
+    layout.sizes.resize(layout.numMips);
+    size_t offset = GFX_DDS_HEADER_SIZE;
+    for (unsigned i=0 ; i<layout.numMips ; ++i) {
+        size_t w = layout.mipWidth(i);
+        size_t h = layout.mipHeight(i);
+        size_t sz = compressed ? ((w + 3) / 4) * ((h + 3) / 4) * block_bytes : w * h * block_bytes;
+        layout.offsets[i] = offset;
+        layout.sizes[i] = sz;
+        offset += sz;
+    }
+    return true;
+}
+
+Ogre::Image *gfx_dds_read_mips (const std::string &file, const GfxDDSLayout &layout, unsigned first_mip)
+{
+    APP_ASSERT(first_mip < layout.numMips);
+    Ogre::DataStreamPtr stream = Ogre::ResourceGroupManager::getSingleton().openResource(file, RESGRP);
+    size_t bytes = layout.end() - layout.offsets[first_mip];
+    uint8_t *raw = OGRE_ALLOC_T(uint8_t, bytes, Ogre::MEMCATEGORY_GENERAL);
+    stream->seek(layout.offsets[first_mip]);
+    if (stream->read(raw, bytes) != bytes) {
+        OGRE_FREE(raw, Ogre::MEMCATEGORY_GENERAL);
+        GRIT_EXCEPT("DDS file was truncated: /" + file);
+    }
+    Ogre::Image *img = new Ogre::Image();
+    img->loadDynamicImage(raw, layout.mipWidth(first_mip), layout.mipHeight(first_mip), 1,
+                          layout.format, true, 1, layout.numMips - first_mip - 1);
+    return img;
+}
+
+// }}}
+
+
+float gfx_texture_streaming_screen_size (const Ogre::Camera *cam, const Vector3 &pos, float radius)
+{
+    if (cam == nullptr) return std::numeric_limits<float>::max();
+    float dist = (pos - from_ogre(cam->getDerivedPosition())).length();
+    // Inside the sphere, so it could fill the screen.
+    if (dist <= radius) return std::numeric_limits<float>::max();
+    float tan_half_fov = tanf(cam->getFOVy().valueRadians() / 2);
+    float vp_height = cam->getViewport() == nullptr ? 1024 : cam->getViewport()->getActualHeight();
+    return radius / (dist * tan_half_fov) * vp_height;
+}
+
+
+// {{{ Streaming thread
+
+namespace {
+
+    struct MipRead {
+        GfxTextureDiskResource *tex;
+        unsigned generation;
+        // Copied so the texture can be unloaded and reloaded while the read is in flight.
+        std::string file;
+        GfxDDSLayout layout;
+        unsigned firstMip;
+        // Null if the read failed.
+        Ogre::Image *img;
+    };
+
+    // Protects everything in this namespace.
+    std::mutex lock;
+    std::condition_variable cvar;
+    std::deque<MipRead> requests;
+    std::vector<MipRead> completed;
+    std::set<GfxTextureDiskResource*> streamed_textures;
+    std::thread *thread = nullptr;
+    bool quit = false;
+
+}
+
+#define SYNCHRONISED std::unique_lock<std::mutex> _scoped_lock(lock)
+
+static void thread_main (void)
+{
+    while (true) {
+        MipRead r;
+        {
+            SYNCHRONISED;
+            while (!quit && requests.empty()) cvar.wait(_scoped_lock);
+            if (quit) return;
+            r = requests.front();
+            requests.pop_front();
+        }
+        try {
+            r.img = gfx_dds_read_mips(r.file, r.layout, r.firstMip);
+        } catch (Ogre::Exception &e) {
+            CERR << "Streaming texture " << r.tex->getName() << ": " << e.getDescription() << std::endl;
+            r.img = nullptr;
+        } catch (const Exception &e) {
+            CERR << "Streaming texture " << r.tex->getName() << ": " << e << std::endl;
+            r.img = nullptr;
+        }
+        {
+            SYNCHRONISED;
+            completed.push_back(r);
+        }
+    }
+}
+
+void gfx_texture_streaming_register (GfxTextureDiskResource *tex)
+{
+    SYNCHRONISED;
+    streamed_textures.insert(tex);
+}
+
+void gfx_texture_streaming_unregister (GfxTextureDiskResource *tex)
+{
+    SYNCHRONISED;
+    streamed_textures.erase(tex);
+    // Anything in completed for this texture will be discarded due to the generation change.
+    for (auto i = requests.begin() ; i != requests.end() ; ) {
+        if (i->tex == tex) i = requests.erase(i); else ++i;
+    }
+}
+
+// }}}
+
+
+unsigned gfx_texture_streaming_initial_mip (const GfxDDSLayout &l)
+{
+    unsigned initial_size = gfx_option(GFX_TEXTURE_STREAMING_INITIAL_SIZE);
+    unsigned mip = 0;
+    while (mip < l.numMips - 1 && std::max(l.mipWidth(mip), l.mipHeight(mip)) > initial_size)
+        mip++;
+    return mip;
+}
+
+static unsigned desired_mip (const GfxDDSLayout &l, float pixels)
+{
+    unsigned lowest = gfx_texture_streaming_initial_mip(l);
+    if (pixels <= 0) return lowest;
+    float texels_per_pixel = std::max(l.width, l.height) / pixels;
+    float mip = floorf(log2f(texels_per_pixel) + gfx_option(GFX_TEXTURE_STREAMING_MIP_BIAS));
+    if (mip <= 0) return 0;
+    return std::min(lowest, unsigned(mip));
+}
+
+void gfx_texture_streaming_update (void)
+{
+    std::vector<MipRead> done;
+    std::vector<GfxTextureDiskResource*> textures;
+    {
+        SYNCHRONISED;
+        std::swap(done, completed);
+        textures.assign(streamed_textures.begin(), streamed_textures.end());
+    }
+
+    for (const MipRead &r : done) {
+        std::unique_ptr<Ogre::Image> img(r.img);
+        GfxTextureDiskResource *tex = r.tex;
+        // Discard reads for a previous load of the texture.
+        if (r.generation != tex->generation || !tex->streamed) continue;
+        tex->pendingMip = -1;
+        if (img == nullptr) continue;
+        if (gfx_disk_resource_verbose_loads)
+            LOG_SINK(LOG_SINK_VERB, "Texture residency: % mip % -> %",
+                     tex->getName(), unsigned(tex->residentMip), r.firstMip);
+        try {
+            tex->uploadMips(*img, r.firstMip);
+        } catch (Ogre::Exception &e) {
+            CERR << "Streaming texture " << tex->getName() << ": " << e.getDescription() << std::endl;
+        }
+    }
+
+    bool over_budget = gfx_gpu_ram_used() > gfx_gpu_ram_available();
+    unsigned max_pending = gfx_option(GFX_TEXTURE_STREAMING_MAX_PENDING);
+    unsigned pending = 0;
+
+    // Textures that want larger mips read from the file, with the largest on-screen size first.
+    std::vector<std::pair<float, MipRead>> changes;
+
+    for (GfxTextureDiskResource *tex : textures) {
+        float pixels = tex->requestedPixels.exchange(0);
+        if (tex->pendingMip >= 0) {
+            pending++;
+            continue;
+        }
+        unsigned resident = tex->residentMip;
+        unsigned target = resident;
+        if (pixels > 0) {
+            // Visible, so grow to the requested resolution, or if over budget, shrink to it.
+            unsigned desired = desired_mip(tex->layout, pixels);
+            target = over_budget ? std::max(desired, resident) : std::min(desired, resident);
+        } else if (over_budget) {
+            // Not drawn this frame, so give up one top mip at a time.
+            target = std::min(resident + 1, gfx_texture_streaming_initial_mip(tex->layout));
+        }
+        if (target == resident) continue;
+        if (target > resident) {
+            // The smaller mips are already on the GPU, so there is nothing to read.
+            if (gfx_disk_resource_verbose_loads)
+                LOG_SINK(LOG_SINK_VERB, "Texture residency: % mip % -> %",
+                         tex->getName(), resident, target);
+            try {
+                tex->dropMips(target);
+            } catch (Ogre::Exception &e) {
+                CERR << "Streaming texture " << tex->getName() << ": " << e.getDescription() << std::endl;
+            }
+            continue;
+        }
+        const std::string &file = tex->getOgreTexturePtr()->getName();
+        changes.emplace_back(pixels, MipRead { tex, tex->generation, file, tex->layout, target,
+                                               nullptr });
+    }
+
+    if (pending >= max_pending || changes.empty()) return;
+
+    unsigned slots = std::min<size_t>(max_pending - pending, changes.size());
+    std::partial_sort(changes.begin(), changes.begin() + slots, changes.end(),
+                      [] (const std::pair<float, MipRead> &a, const std::pair<float, MipRead> &b) {
+                          return a.first > b.first;
+                      });
+
+    SYNCHRONISED;
+    for (unsigned i=0 ; i<slots ; ++i) {
+        MipRead &r = changes[i].second;
+        r.tex->pendingMip = r.firstMip;
+        requests.push_back(r);
+    }
+    cvar.notify_one();
+}
+
+std::map<unsigned, unsigned> gfx_texture_streaming_histogram (void)
+{
+    SYNCHRONISED;
+    std::map<unsigned, unsigned> r;
+    for (GfxTextureDiskResource *tex : streamed_textures) {
+        const GfxDDSLayout &l = tex->getLayout();
+        unsigned mip = tex->getResidentMip();
+        r[std::max(l.mipWidth(mip), l.mipHeight(mip))]++;
+    }
+    return r;
+}
+
+unsigned gfx_texture_streaming_pending (void)
+{
+    SYNCHRONISED;
+    unsigned r = 0;
+    for (GfxTextureDiskResource *tex : streamed_textures) {
+        if (tex->isResidencyChangePending()) r++;
+    }
+    return r;
+}
+
+void gfx_texture_streaming_init (void)
+{
+    quit = false;
+    thread = new std::thread(thread_main);
+}
+
+void gfx_texture_streaming_shutdown (void)
+{
+    if (thread == nullptr) return;
+    {
+        SYNCHRONISED;
+        quit = true;
+        cvar.notify_one();
+    }
+    thread->join();
+    delete thread;
+    thread = nullptr;
+    for (const MipRead &r : completed) delete r.img;
+    completed.clear();
+    requests.clear();
+    streamed_textures.clear();
+}
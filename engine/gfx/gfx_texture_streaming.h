@@ -0,0 +1,109 @@
+/* Copyright (c) The Grit Game Engine authors 2016
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <cstdint>
+#include <string>
+#include <map>
+#include <vector>
+
+struct GfxDDSLayout;
+class GfxTextureDiskResource;
+
+#ifndef GFX_TEXTURE_STREAMING_H
+#define GFX_TEXTURE_STREAMING_H
+
+#include <math_util.h>
+
+/** \file
+ *
+ * Textures that are drawn by bodies in the world are streamed a mip level at a
+ * time.  When such a texture is loaded, only the smallest mips are read from
+ * disk.  Each frame, the bodies that use the texture report how large they
+ * appear on screen, and the texture's residency is upgraded in the background
+ * to the mip level that is actually needed.  Under GPU memory pressure, top mip
+ * levels are dropped from textures that are not currently being drawn, rather
+ * than evicting whole textures.
+ *
+ * Only uncompressed RGB and BCn DDS files with a full mip chain can be streamed
+ * this way.  All other textures are loaded whole, as before.
+ */
+
+/** Size of the DDS header (including magic number) that must be given to gfx_dds_parse_layout. */
+static const size_t GFX_DDS_HEADER_SIZE = 128;
+
+/** Where each mip level of a DDS file lives, so they can be read independently. */
+struct GfxDDSLayout {
+    /** Dimensions of the largest mip. */
+    unsigned width, height;
+    /** Number of mip levels in the file, including the largest one. */
+    unsigned numMips;
+    /** The Ogre equivalent of the DDS pixel format. */
+    Ogre::PixelFormat format;
+    /** Byte offset into the file of each mip level. */
+    std::vector<size_t> offsets;
+    /** Number of bytes in each mip level. */
+    std::vector<size_t> sizes;
+
+    /** Dimensions of the given mip level. */
+    unsigned mipWidth (unsigned mip) const { return std::max(1u, width >> mip); }
+    unsigned mipHeight (unsigned mip) const { return std::max(1u, height >> mip); }
+
+    /** Byte offset of the end of the smallest mip. */
+    size_t end (void) const { return offsets.back() + sizes.back(); }
+};
+
+/** Parse a DDS header.  Returns false if the file cannot be streamed a mip at a time, e.g. if it
+ * is a cube map or volume texture, is missing mipmaps, or has a pixel format not supported here.
+ */
+bool gfx_dds_parse_layout (const uint8_t *header, size_t header_len, GfxDDSLayout &layout);
+
+/** Read the given mip level and all smaller ones of a DDS file into an image.  Does not touch
+ * the GPU so is safe to call from a background thread. */
+Ogre::Image *gfx_dds_read_mips (const std::string &file, const GfxDDSLayout &layout, unsigned first_mip);
+
+/** The largest mip level no bigger than GFX_TEXTURE_STREAMING_INITIAL_SIZE.  This and all
+ * smaller mips are always resident in a streamed texture. */
+unsigned gfx_texture_streaming_initial_mip (const GfxDDSLayout &layout);
+
+/** Approximate height in pixels of a sphere on screen, as seen by the given camera. */
+float gfx_texture_streaming_screen_size (const Ogre::Camera *cam, const Vector3 &pos, float radius);
+
+/** Upload completed mip reads, and schedule new ones according to the sizes requested during
+ * the last frame and the GPU memory budget.  Called once per frame, after rendering. */
+void gfx_texture_streaming_update (void);
+
+/** Number of streamed textures keyed by the size (largest dimension) of their largest resident
+ * mip.  Textures with a residency change in flight are counted at their current size. */
+std::map<unsigned, unsigned> gfx_texture_streaming_histogram (void);
+
+/** Number of residency changes that have been requested but not yet uploaded. */
+unsigned gfx_texture_streaming_pending (void);
+
+/** Called when a streamed texture is loaded, so it is considered by gfx_texture_streaming_update. */
+void gfx_texture_streaming_register (GfxTextureDiskResource *tex);
+
+/** Called when a streamed texture is unloaded.  Any mip read in flight for it is discarded. */
+void gfx_texture_streaming_unregister (GfxTextureDiskResource *tex);
+
+void gfx_texture_streaming_init (void);
+void gfx_texture_streaming_shutdown (void);
+
+#endif
@@ -19,7 +19,10 @@
  * THE SOFTWARE.
  */
 
+#include <algorithm>
+
 #include <centralised_log.h>
+#include "../frame_allocator.h"
 #include "../path_util.h"
 
 #include "lua_wrappers_gfx.h"
@@ -98,9 +101,9 @@ static fast_erase_vector<HudBase*> root_elements;
  * increment the reference counters for all these objects before the iteration,
  * as well as using a copied std::vector.
  */
-static std::vector<HudObject *> get_all_hud_objects (const fast_erase_vector<HudBase*> &bases)
+static FrameVector<HudObject *> get_all_hud_objects (const fast_erase_vector<HudBase*> &bases)
 {
-    std::vector<HudObject*> r;
+    FrameVector<HudObject*> r;
     for (unsigned i=0 ; i<bases.size() ; ++i) {
         HudObject *o = dynamic_cast<HudObject*>(bases[i]);
         if (o == NULL) continue;
@@ -113,22 +116,58 @@ static std::vector<HudObject *> get_all_hud_objects (const fast_erase_vector<Hud
 /** The companion to get_all_hud_objects.  This simply decs the reference count
  * for all the objects.
  */
-static void dec_all_hud_objects (lua_State *L, std::vector<HudObject *> objs)
+static void dec_all_hud_objects (lua_State *L, const FrameVector<HudObject *> &objs)
 {
     for (unsigned i=0 ; i<objs.size() ; ++i) {
         objs[i]->decRefCount(L);
     }
 }
 
+/** Shared by all event dispatches, to avoid allocating a vector at every level of the tree for
+ * every event.  Each dispatch pushes the objects it will visit (see push_subscribers) and pops
+ * them again when done, so nested dispatches use the part above their caller's.
+ */
+static std::vector<HudObject *> dispatch_stack;
+
+/** Like get_all_hud_objects, but only takes the objects with frame (or input) subscribers in
+ * their subtree, and pushes them onto the dispatch stack.  Returns the index of the first one.
+ */
+static size_t push_subscribers (const fast_erase_vector<HudBase*> &bases, bool frame)
+{
+    size_t begin = dispatch_stack.size();
+    for (unsigned i=0 ; i<bases.size() ; ++i) {
+        HudBase *base = bases[i];
+        if ((frame ? base->getFrameSubscribers() : base->getInputSubscribers()) == 0) continue;
+        HudObject *o = dynamic_cast<HudObject*>(base);
+        if (o == NULL) continue;
+        dispatch_stack.push_back(o);
+        o->incRefCount();
+    }
+    return begin;
+}
+
+/** The companion to push_subscribers, pass the stack size from just after pushing. */
+static void pop_subscribers (lua_State *L, size_t begin, size_t end)
+{
+    // decRefCount can run destroy callbacks that dispatch events of their own, which push and
+    // pop above end.
+    for (size_t i=begin ; i<end ; ++i) {
+        dispatch_stack[i]->decRefCount(L);
+    }
+    dispatch_stack.resize(begin);
+}
+
 
 void HudBase::registerRemove (void)
 {
     //CVERB << "Hud element unregistering its existence: " << this << std::endl;
     if (parent != NULL) {
         parent->notifyChildRemove(this);
+        parent->adjustSubscribers(-int(frameSubscribers), -int(inputSubscribers));
     } else {
         root_elements.erase(this);
     }
+    layoutChanged();
 }
 
 void HudBase::registerAdd (void)
@@ -136,14 +175,27 @@ void HudBase::registerAdd (void)
     //CVERB << "Hud element registering its existence: " << this << std::endl;
     if (parent != NULL) {
         parent->notifyChildAdd(this);
+        parent->adjustSubscribers(frameSubscribers, inputSubscribers);
     } else {
         root_elements.push_back(this);
     }
+    layoutChanged();
+}
+
+void HudBase::adjustSubscribers (int frame, int input)
+{
+    for (HudBase *b = this ; b != NULL ; b = b->parent) {
+        b->frameSubscribers += frame;
+        b->inputSubscribers += input;
+        // A destroyed element has already removed its counts from its parent.
+        if (b->aliveness == DEAD) break;
+    }
 }
 
 HudBase::HudBase (void)
   : aliveness(ALIVE), parent(NULL), zOrder(3),
-    position(0,0), orientation(0), inheritOrientation(true), enabled(true), snapPixels(true)
+    position(0,0), orientation(0), inheritOrientation(true), enabled(true),
+    frameSubscribers(0), inputSubscribers(0), snapPixels(true)
 {
     //CVERB << "Hud element created: " << this << std::endl;
     registerAdd();
@@ -251,6 +303,21 @@ void HudObject::decRefCount (lua_State *L)
     }
 }
 
+void HudObject::updateNeedsInputCallbacks (bool v)
+{
+    if (needsInputCallbacks == v) return;
+    needsInputCallbacks = v;
+    adjustSubscribers(0, v ? 1 : -1);
+    layoutChanged();
+}
+
+void HudObject::updateNeedsFrameCallbacks (bool v)
+{
+    if (needsFrameCallbacks == v) return;
+    needsFrameCallbacks = v;
+    adjustSubscribers(v ? 1 : -1, 0);
+}
+
 void HudObject::setColour (const Vector3 &v)
 {
     assertAlive();
@@ -484,9 +551,10 @@ void HudObject::setSize (lua_State *L, const Vector2 &v)
     assertAlive();
     sizeSet = true;
     size = v;
+    layoutChanged();
 
     // use local_children copy since callbacks can alter hierarchy
-    std::vector<HudObject*> local_children = get_all_hud_objects(children);
+    FrameVector<HudObject*> local_children = get_all_hud_objects(children);
     for (unsigned j=0 ; j<local_children.size() ; ++j) {
         HudObject *obj = local_children[j];
         if (!obj->destroyed()) obj->triggerParentResized(L);
@@ -514,30 +582,144 @@ Vector2 HudObject::screenToLocal (const Vector2 &screen_pos)
     return (screen_pos - getDerivedPosition()).rotateBy(-getDerivedOrientation());
 }
 
-static HudObject *ray (const Vector2 &screen_pos)
+// Hit testing is done with a grid over the screen.  Each cell lists the objects with input
+// callbacks whose bounding box overlaps it, in the order HudObject::shootRay would visit them.  A
+// ray then only needs to test the objects in one cell, and the first one that is hit is the
+// answer.  The grid is rebuilt lazily, after anything changes position, size, or visibility.
+
+static const float hit_grid_cell_size = 64;
+
+static bool hit_grid_dirty = true;
+static unsigned hit_grid_w, hit_grid_h;
+static std::vector<HudObject*> hit_candidates;
+static std::vector<unsigned> hit_cell_begin;  // w * h + 1 offsets into hit_cell_entries
+static std::vector<unsigned> hit_cell_entries;  // indexes into hit_candidates
+// Cell range covered by each candidate: x0, y0, x1, y1 (inclusive).
+static std::vector<unsigned> hit_candidate_cells;
+// Where the next entry of each cell goes, while filling in hit_cell_entries.
+static std::vector<unsigned> hit_cell_next;
+
+// The last ray, valid until the layout changes.
+static bool last_ray_valid = false;
+static Vector2 last_ray_pos;
+static HudObject *last_ray_hit;
+
+void HudBase::layoutChanged (void)
+{
+    hit_grid_dirty = true;
+    last_ray_valid = false;
+}
+
+static unsigned hit_grid_cell_x (float x)
+{
+    float c = floorf(x / hit_grid_cell_size);
+    if (!(c > 0)) return 0;  // also catches NaN
+    if (c >= hit_grid_w) return hit_grid_w - 1;
+    return unsigned(c);
+}
+
+static unsigned hit_grid_cell_y (float y)
+{
+    float c = floorf(y / hit_grid_cell_size);
+    if (!(c > 0)) return 0;  // also catches NaN
+    if (c >= hit_grid_h) return hit_grid_h - 1;
+    return unsigned(c);
+}
+
+/** Collect the objects that can be hit, in the same order as shootRay. */
+static void hit_grid_collect (HudObject *obj, const fast_erase_vector<HudBase*> &children)
 {
     for (int i=GFX_HUD_ZORDER_MAX ; i>=0 ; --i) {
-        for (unsigned j=0 ; j<root_elements.size() ; ++j) {
-            HudBase *base = root_elements[j];
+        for (unsigned j=0 ; j<children.size() ; ++j) {
+            HudBase *base = children[j];
             if (base->destroyed()) continue;
             if (base->getZOrder() != i) continue;
-            HudObject *obj = dynamic_cast<HudObject*>(base);
-            if (obj == nullptr) continue;
-            HudObject *hit = obj->shootRay(screen_pos);
-            if (hit != NULL) return hit;
+            if (base->getInputSubscribers() == 0) continue;
+            if (!base->isEnabled()) continue;
+            HudObject *child = dynamic_cast<HudObject*>(base);
+            if (child == nullptr) continue;
+            hit_grid_collect(child, child->getChildren());
+        }
+    }
+    if (obj != nullptr && obj->getNeedsInputCallbacks()) hit_candidates.push_back(obj);
+}
+
+static void hit_grid_build (void)
+{
+    hit_grid_w = std::max(1.0f, ceilf(win_size.x / hit_grid_cell_size));
+    hit_grid_h = std::max(1.0f, ceilf(win_size.y / hit_grid_cell_size));
+
+    hit_candidates.clear();
+    hit_grid_collect(nullptr, root_elements);
+
+    // Count the entries of each cell, then turn the counts into offsets and fill them in.  Going
+    // through the candidates in order keeps each cell's list in shootRay order.
+    hit_cell_begin.assign(hit_grid_w * hit_grid_h + 1, 0);
+    hit_candidate_cells.resize(hit_candidates.size() * 4);
+    for (unsigned i=0 ; i<hit_candidates.size() ; ++i) {
+        HudObject *obj = hit_candidates[i];
+        Vector2 centre = obj->getDerivedPosition();
+        Vector2 half = obj->getDerivedBounds() / 2;
+        unsigned *cells = &hit_candidate_cells[i * 4];
+        cells[0] = hit_grid_cell_x(centre.x - half.x);
+        cells[1] = hit_grid_cell_y(centre.y - half.y);
+        cells[2] = hit_grid_cell_x(centre.x + half.x);
+        cells[3] = hit_grid_cell_y(centre.y + half.y);
+        for (unsigned y=cells[1] ; y<=cells[3] ; ++y) {
+            for (unsigned x=cells[0] ; x<=cells[2] ; ++x) {
+                hit_cell_begin[y * hit_grid_w + x + 1]++;
+            }
+        }
+    }
+    for (unsigned c=0 ; c<hit_grid_w * hit_grid_h ; ++c) {
+        hit_cell_begin[c + 1] += hit_cell_begin[c];
+    }
+    hit_cell_entries.resize(hit_cell_begin.back());
+    hit_cell_next.assign(hit_cell_begin.begin(), hit_cell_begin.end() - 1);
+    for (unsigned i=0 ; i<hit_candidates.size() ; ++i) {
+        const unsigned *cells = &hit_candidate_cells[i * 4];
+        for (unsigned y=cells[1] ; y<=cells[3] ; ++y) {
+            for (unsigned x=cells[0] ; x<=cells[2] ; ++x) {
+                hit_cell_entries[hit_cell_next[y * hit_grid_w + x]++] = i;
+            }
+        }
+    }
+
+    hit_grid_dirty = false;
+}
+
+static HudObject *ray (const Vector2 &screen_pos)
+{
+    if (last_ray_valid && last_ray_pos == screen_pos) return last_ray_hit;
+    if (hit_grid_dirty) hit_grid_build();
+
+    HudObject *hit = NULL;
+    unsigned c = hit_grid_cell_y(screen_pos.y) * hit_grid_w + hit_grid_cell_x(screen_pos.x);
+    for (unsigned i=hit_cell_begin[c] ; i<hit_cell_begin[c + 1] ; ++i) {
+        HudObject *obj = hit_candidates[hit_cell_entries[i]];
+        if (obj->isInside(screen_pos)) {
+            hit = obj;
+            break;
         }
     }
 
-    return NULL;
+    last_ray_valid = true;
+    last_ray_pos = screen_pos;
+    last_ray_hit = hit;
+    return hit;
+}
+
+bool HudObject::isInside (const Vector2 &screen_pos)
+{
+    Vector2 local_pos = screenToLocal(screen_pos);
+    return fabsf(local_pos.x) < getSize().x / 2 && fabsf(local_pos.y) < getSize().y / 2;
 }
 
 HudObject *HudObject::shootRay (const Vector2 &screen_pos)
 {
     if (!isEnabled()) return NULL; // can't hit any children either
 
-    Vector2 local_pos = screenToLocal(screen_pos);
-    bool inside = fabsf(local_pos.x) < getSize().x / 2
-                && fabsf(local_pos.y) < getSize().y / 2;
+    bool inside = isInside(screen_pos);
 
     // children can still be hit, since they can be larger than parent, so do not return yet...
     //if (!inside) return NULL;
@@ -568,6 +750,9 @@ void HudObject::triggerMouseMove (lua_State *L, const Vector2 &screen_pos)
 
     if (!isEnabled()) return;
 
+    // Nothing in this subtree wants the event.
+    if (inputSubscribers == 0) return;
+
     do {
 
         if (!needsInputCallbacks) continue;
@@ -590,7 +775,7 @@ void HudObject::triggerMouseMove (lua_State *L, const Vector2 &screen_pos)
             lua_pop(L,2);
             STACK_CHECK;
             CERR << "Hud object of class: \"" << hudClass->name << "\" has no mouseMoveCallback function, disabling input callbacks." << std::endl;
-            needsInputCallbacks = false;
+            updateNeedsInputCallbacks(false);
             continue; // to children
         }
 
@@ -626,7 +811,7 @@ void HudObject::triggerMouseMove (lua_State *L, const Vector2 &screen_pos)
             // have already printed it out
             lua_pop(L,1);
             CERR << "Hud object of class: \"" << hudClass->name << "\" raised an error on mouseMoveCallback, disabling input callbacks." << std::endl;
-            needsInputCallbacks = false;
+            updateNeedsInputCallbacks(false);
             //stack: err
             STACK_CHECK_N(1);
         } else {
@@ -645,13 +830,14 @@ void HudObject::triggerMouseMove (lua_State *L, const Vector2 &screen_pos)
 
     // note if we destroyed ourselves due to an error in the callback, children should be empty
 
-    // use local_children copy since callbacks can alter hierarchy
-    std::vector<HudObject*> local_children = get_all_hud_objects(children);
-    for (unsigned j=0 ; j<local_children.size() ; ++j) {
-        HudObject *obj = local_children[j];
+    // use a copy of the children since callbacks can alter hierarchy
+    size_t begin = push_subscribers(children, false);
+    size_t end = dispatch_stack.size();
+    for (size_t j=begin ; j<end ; ++j) {
+        HudObject *obj = dispatch_stack[j];
         if (!obj->destroyed()) obj->triggerMouseMove(L, screen_pos);
     }
-    dec_all_hud_objects(L, local_children);
+    pop_subscribers(L, begin, end);
 }
 
 void HudObject::triggerButton (lua_State *L, const std::string &name)
@@ -660,6 +846,9 @@ void HudObject::triggerButton (lua_State *L, const std::string &name)
 
     if (!isEnabled()) return;
 
+    // Nothing in this subtree wants the event.
+    if (inputSubscribers == 0) return;
+
     do {
         if (!needsInputCallbacks) continue;
 
@@ -681,7 +870,7 @@ void HudObject::triggerButton (lua_State *L, const std::string &name)
             lua_pop(L,2);
             STACK_CHECK;
             CERR << "Hud object of class: \"" << hudClass->name << "\" has no buttonCallback function, disabling input callbacks." << std::endl;
-            needsInputCallbacks = false;
+            updateNeedsInputCallbacks(false);
             continue; // to children
         }
 
@@ -704,7 +893,7 @@ void HudObject::triggerButton (lua_State *L, const std::string &name)
             // have already printed it out
             lua_pop(L,1);
             CERR << "Hud object of class: \"" << hudClass->name << "\" raised an error on buttonCallback, disabling input callbacks." << std::endl;
-            needsInputCallbacks = false;
+            updateNeedsInputCallbacks(false);
             //stack: err
             STACK_CHECK_N(1);
         } else {
@@ -723,13 +912,14 @@ void HudObject::triggerButton (lua_State *L, const std::string &name)
 
     // note if we destroyed ourselves due to an error in the callback, children should be empty
 
-    // use local_children copy since callbacks can alter hierarchy
-    std::vector<HudObject*> local_children = get_all_hud_objects(children);
-    for (unsigned j=0 ; j<local_children.size() ; ++j) {
-        HudObject *obj = local_children[j];
+    // use a copy of the children since callbacks can alter hierarchy
+    size_t begin = push_subscribers(children, false);
+    size_t end = dispatch_stack.size();
+    for (size_t j=begin ; j<end ; ++j) {
+        HudObject *obj = dispatch_stack[j];
         if (!obj->destroyed()) obj->triggerButton(L, name);
     }
-    dec_all_hud_objects(L, local_children);
+    pop_subscribers(L, begin, end);
 }
 
 void HudObject::triggerFrame (lua_State *L, float elapsed)
@@ -738,6 +928,9 @@ void HudObject::triggerFrame (lua_State *L, float elapsed)
 
     if (!isEnabled()) return;
 
+    // Nothing in this subtree wants the event.
+    if (frameSubscribers == 0) return;
+
     do {
         if (!needsFrameCallbacks) continue;
 
@@ -759,7 +952,7 @@ void HudObject::triggerFrame (lua_State *L, float elapsed)
             lua_pop(L,2);
             STACK_CHECK;
             CERR << "Hud object of class: \"" << hudClass->name << "\" has no frameCallback function, disabling frame callbacks." << std::endl;
-            needsFrameCallbacks = false;
+            updateNeedsFrameCallbacks(false);
             continue; // to children
         }
 
@@ -782,7 +975,7 @@ void HudObject::triggerFrame (lua_State *L, float elapsed)
             // have already printed it out
             lua_pop(L,1);
             CERR << "Hud object of class: \"" << hudClass->name << "\" raised an error on frameCallback, disabling frame callbacks." << std::endl;
-            needsFrameCallbacks = false;
+            updateNeedsFrameCallbacks(false);
             //stack: err
             STACK_CHECK_N(1);
         } else {
@@ -801,13 +994,14 @@ void HudObject::triggerFrame (lua_State *L, float elapsed)
 
     // note if we destroyed ourselves due to an error in the callback, children should be empty
 
-    // use local_children copy since callbacks can alter hierarchy
-    std::vector<HudObject*> local_children = get_all_hud_objects(children);
-    for (unsigned j=0 ; j<local_children.size() ; ++j) {
-        HudObject *obj = local_children[j];
+    // use a copy of the children since callbacks can alter hierarchy
+    size_t begin = push_subscribers(children, true);
+    size_t end = dispatch_stack.size();
+    for (size_t j=begin ; j<end ; ++j) {
+        HudObject *obj = dispatch_stack[j];
         if (!obj->destroyed()) obj->triggerFrame(L, elapsed);
     }
-    dec_all_hud_objects(L, local_children);
+    pop_subscribers(L, begin, end);
 }
 
 void HudObject::notifyChildAdd (HudBase *child)
@@ -1157,7 +1351,7 @@ void hud_shutdown (lua_State *L)
         }
 
         // Now kill the ones with lua callbacks.
-        std::vector<HudObject*> local_root_objects = get_all_hud_objects(root_elements);
+        FrameVector<HudObject*> local_root_objects = get_all_hud_objects(root_elements);
         for (unsigned j=0 ; j<local_root_objects.size() ; ++j) {
             HudObject *obj = local_root_objects[j];
             if (obj->destroyed()) continue;
@@ -1535,29 +1729,30 @@ void hud_signal_window_resized (unsigned w, unsigned h)
     if (win_size == new_win_size) return;
     win_size = new_win_size;
     window_size_dirty = true;
+    HudBase::layoutChanged();
 }
 
 void hud_call_per_frame_callbacks (lua_State *L, float elapsed)
 {
-
-    std::vector<HudObject*> local_root_objects = get_all_hud_objects(root_elements);
-
     if (window_size_dirty) {
         window_size_dirty = false;
+        FrameVector<HudObject*> local_root_objects = get_all_hud_objects(root_elements);
         for (unsigned j=0 ; j<local_root_objects.size() ; ++j) {
             HudObject *obj = local_root_objects[j];
             if (obj->destroyed()) continue;
             obj->triggerParentResized(L);
         }
+        dec_all_hud_objects(L, local_root_objects);
     }
 
-    for (unsigned j=0 ; j<local_root_objects.size() ; ++j) {
-        HudObject *obj = local_root_objects[j];
+    size_t begin = push_subscribers(root_elements, true);
+    size_t end = dispatch_stack.size();
+    for (size_t j=begin ; j<end ; ++j) {
+        HudObject *obj = dispatch_stack[j];
         if (obj->destroyed()) continue;
         obj->triggerFrame(L, elapsed);
     }
-
-    dec_all_hud_objects(L, local_root_objects);
+    pop_subscribers(L, begin, end);
 }
 
 // }}}
@@ -1575,31 +1770,29 @@ static Vector2 last_mouse_abs;
 void hud_signal_mouse_move (lua_State *L, const Vector2 &abs)
 {
     // make local copy because callbacks can destroy elements
-    std::vector<HudObject*> local_root_objects = get_all_hud_objects(root_elements);
-
-    for (unsigned j=0 ; j<local_root_objects.size() ; ++j) {
-        HudObject *obj = local_root_objects[j];
+    size_t begin = push_subscribers(root_elements, false);
+    size_t end = dispatch_stack.size();
+    for (size_t j=begin ; j<end ; ++j) {
+        HudObject *obj = dispatch_stack[j];
         if (obj->destroyed()) continue;
         obj->triggerMouseMove(L, abs);
     }
-
-    dec_all_hud_objects(L, local_root_objects);
+    pop_subscribers(L, begin, end);
     last_mouse_abs = abs;
 }
 
 void hud_signal_button (lua_State *L, const std::string &key)
 {
     // make local copy because callbacks can destroy elements
-    std::vector<HudObject*> local_root_objects = get_all_hud_objects(root_elements);
-
-    for (unsigned j=0 ; j<local_root_objects.size() ; ++j) {
-        HudObject *obj = local_root_objects[j];
+    size_t begin = push_subscribers(root_elements, false);
+    size_t end = dispatch_stack.size();
+    for (size_t j=begin ; j<end ; ++j) {
+        HudObject *obj = dispatch_stack[j];
         if (obj->destroyed()) continue;
         obj->triggerMouseMove(L, last_mouse_abs);
         obj->triggerButton(L, key);
     }
-
-    dec_all_hud_objects(L, local_root_objects);
+    pop_subscribers(L, begin, end);
 }
 
 void hud_signal_flush (lua_State *L)
@@ -147,6 +147,11 @@ class HudBase : public fast_erase_index {
     bool inheritOrientation;
     bool enabled;
 
+    /** The number of objects in this subtree (including this one) that need frame / input
+     * callbacks.  Events are only dispatched into subtrees that have some. */
+    unsigned frameSubscribers;
+    unsigned inputSubscribers;
+
     public:
     bool snapPixels;
     protected:
@@ -157,6 +162,9 @@ class HudBase : public fast_erase_index {
     void registerRemove (void);
     void registerAdd (void);
 
+    /** Add to the subscriber counts of this element and its ancestors. */
+    void adjustSubscribers (int frame, int input);
+
     public:
 
     virtual ~HudBase (void);
@@ -171,13 +179,14 @@ class HudBase : public fast_erase_index {
     void setEnabled (bool v) { assertAlive(); registerRemove() ; enabled = v; registerAdd(); }
     bool isEnabled (void) { assertAlive(); return enabled; }
 
-    void setInheritOrientation (bool v) { assertAlive(); inheritOrientation = v; }
+    void setInheritOrientation (bool v)
+    { assertAlive(); inheritOrientation = v; layoutChanged(); }
     bool getInheritOrientation (void) const { assertAlive(); return inheritOrientation; } 
-    void setOrientation (Radian v) { assertAlive(); orientation = v; }
+    void setOrientation (Radian v) { assertAlive(); orientation = v; layoutChanged(); }
     Radian getOrientation (void) const { assertAlive(); return orientation; }
     Radian getDerivedOrientation (void) const;
 
-    void setPosition (const Vector2 &v) { assertAlive(); position = v; }
+    void setPosition (const Vector2 &v) { assertAlive(); position = v; layoutChanged(); }
     Vector2 getPosition (void) const { assertAlive(); return position; }
     Vector2 getDerivedPosition (void) const;
 
@@ -197,6 +206,12 @@ class HudBase : public fast_erase_index {
     void setZOrder (unsigned char v) { assertAlive(); registerRemove(); zOrder = v; registerAdd(); }
     unsigned char getZOrder (void) const { assertAlive(); return zOrder; }
 
+    unsigned getFrameSubscribers (void) const { return frameSubscribers; }
+    unsigned getInputSubscribers (void) const { return inputSubscribers; }
+
+    /** Something moved, resized, appeared, or disappeared, so the hit-test grid is stale. */
+    static void layoutChanged (void);
+
 };
 
 class HudObject : public HudBase {
@@ -253,6 +268,8 @@ class HudObject : public HudBase {
     void notifyChildRemove (HudBase *child);
     void notifyChildAdd (HudBase *child);
 
+    const fast_erase_vector<HudBase*> &getChildren (void) const { return children; }
+
     float getAlpha (void) const { assertAlive(); return alpha; }
     void setAlpha (float v);
     
@@ -293,10 +310,10 @@ class HudObject : public HudBase {
     { assertAlive(); needsParentResizedCallbacks = v; }
 
     bool getNeedsInputCallbacks (void) const { assertAlive(); return needsInputCallbacks; }
-    void setNeedsInputCallbacks (bool v) { assertAlive(); needsInputCallbacks = v; }
+    void setNeedsInputCallbacks (bool v) { assertAlive(); updateNeedsInputCallbacks(v); }
 
     bool getNeedsFrameCallbacks (void) const { assertAlive(); return needsFrameCallbacks; }
-    void setNeedsFrameCallbacks (bool v) { assertAlive(); needsFrameCallbacks = v; }
+    void setNeedsFrameCallbacks (bool v) { assertAlive(); updateNeedsFrameCallbacks(v); }
 
     // Transform screen co-ordinates (e.g. from the mouse) to co-ordinates local to the HudObject.
     Vector2 screenToLocal (const Vector2 &screen_pos);
@@ -304,8 +321,15 @@ class HudObject : public HudBase {
     /** Return NULL for a miss, otherwise return the object hit, which can be a child.  Must have needsInputCallbacks otherwise ignored. */
     HudObject *shootRay (const Vector2 &screen_pos);
 
+    /** Whether the screen position is within this object's rect (ignoring children). */
+    bool isInside (const Vector2 &screen_pos);
+
     private:
 
+    // Like the setters, but usable after a callback that may have destroyed the object.
+    void updateNeedsInputCallbacks (bool v);
+    void updateNeedsFrameCallbacks (bool v);
+
     unsigned refCount;
 
     // internal function
@@ -31,6 +31,7 @@
 #include "../lua_ptr.h"
 #include "../path_util.h"
 
+#include "gfx_auto_instancing.h"
 #include "gfx_debug.h"
 #include "gfx_font.h"
 #include "gfx_option.h"
@@ -1464,6 +1465,38 @@ TRY_START
 TRY_END
 }
 
+/** Takes an array of instance indexes, and a flat array of 8 numbers per instance: position x,
+ * y, z, orientation w, x, y, z, then fade. */
+static int gfxinstances_update_many (lua_State *L)
+{
+TRY_START
+    check_args(L,3);
+    GET_UD_MACRO(GfxInstancesPtr,self,1,GFXINSTANCES_TAG);
+    luaL_checktype(L,2,LUA_TTABLE);
+    luaL_checktype(L,3,LUA_TTABLE);
+    unsigned n = lua_objlen(L,2);
+    if (lua_objlen(L,3) != 8*n)
+        EXCEPT << "Expected 8 numbers per instance, got " << lua_objlen(L,3) << " for "
+               << n << " instances." << ENDL;
+    std::vector<unsigned> indexes(n);
+    std::vector<float> data(8*n);
+    for (unsigned i=0 ; i<n ; ++i) {
+        lua_rawgeti(L,2,i+1);
+        if (!lua_isnumber(L,-1)) my_lua_error(L, "Instance index must be a number");
+        indexes[i] = lua_tonumber(L,-1);
+        lua_pop(L,1);
+    }
+    for (unsigned i=0 ; i<8*n ; ++i) {
+        lua_rawgeti(L,3,i+1);
+        if (!lua_isnumber(L,-1)) my_lua_error(L, "Instance data must be a number");
+        data[i] = lua_tonumber(L,-1);
+        lua_pop(L,1);
+    }
+    if (n > 0) self->updateMany(n, &indexes[0], &data[0]);
+    return 0;
+TRY_END
+}
+
 static int gfxinstances_del (lua_State *L)
 {
 TRY_START
@@ -1498,6 +1531,8 @@ TRY_START
         push_cfunction(L,gfxinstances_add);
     } else if (!::strcmp(key,"update")) {
         push_cfunction(L,gfxinstances_update);
+    } else if (!::strcmp(key,"updateMany")) {
+        push_cfunction(L,gfxinstances_update_many);
     } else if (!::strcmp(key,"del")) {
         push_cfunction(L,gfxinstances_del);
     } else if (!::strcmp(key,"enabled")) {
@@ -2602,6 +2637,17 @@ TRY_START
 TRY_END
 }
 
+static int global_gfx_env_cube_convert (lua_State *L)
+{
+TRY_START
+    check_args(L,2);
+    std::string src = check_path(L,1);
+    std::string dst = check_path(L,2);
+    gfx_env_cube_convert(src, dst);
+    return 0;
+TRY_END
+}
+
 static int global_gfx_screenshot (lua_State *L)
 {
 TRY_START
@@ -2917,10 +2963,9 @@ TRY_START
     unsigned long width = 0;
     for (size_t i=0 ; i<text.length() ; ++i) {
         GfxFont::codepoint_t cp = decode_utf8(text, i);
-        GfxFont::CharRect uvs;
-        bool r = font->getCodePointOrFail(cp, uvs);
-        if (!r) continue;
-        width += uvs.u2 - uvs.u1;
+        const GfxFont::Glyph *glyph = font->getGlyph(cp);
+        if (glyph == NULL) continue;
+        width += glyph->advance;
     }
     lua_pushnumber(L, width);
     return 1;
@@ -4039,6 +4084,49 @@ static int global_gfx_gpu_ram_used (lua_State *L)
     return 1;
 }
 
+static int global_gfx_texture_residency_histogram (lua_State *L)
+{
+TRY_START
+    check_args(L,0);
+    std::map<unsigned, unsigned> h = gfx_texture_streaming_histogram();
+    lua_createtable(L, 0, h.size());
+    for (const auto &pair : h) {
+        lua_pushnumber(L, pair.first);
+        lua_pushnumber(L, pair.second);
+        lua_rawset(L, -3);
+    }
+    lua_pushnumber(L, gfx_texture_streaming_pending());
+    return 2;
+TRY_END
+}
+
+static int global_gfx_mesh_geometry_stats (lua_State *L)
+{
+TRY_START
+    check_args(L,0);
+    GfxMeshGeometryStats stats = gfx_mesh_geometry_stats();
+    lua_pushnumber(L, stats.vertexBuffers);
+    lua_pushnumber(L, stats.vertexBytes);
+    lua_pushnumber(L, stats.vertexBytesUsed);
+    lua_pushnumber(L, stats.indexBuffers);
+    lua_pushnumber(L, stats.indexBytes);
+    lua_pushnumber(L, stats.indexBytesUsed);
+    return 6;
+TRY_END
+}
+
+static int global_gfx_auto_instancing_stats (lua_State *L)
+{
+TRY_START
+    check_args(L,0);
+    unsigned before, after;
+    gfx_auto_instancing_stats(before, after);
+    lua_pushnumber(L, before);
+    lua_pushnumber(L, after);
+    return 2;
+TRY_END
+}
+
 static lua_Number anim_rate (lua_Number n)
 {
     // n * ANIM_TIME_MAX must be an integer k, since this means the animation
@@ -4958,6 +5046,7 @@ TRY_START
         if (it == params.end()) {
             CERR << "Material \"" << name << "\" references unknown uniform: "
                  << pair.first << std::endl;
+            continue;
         }
         handle_param_binding("Sky material", name, bindings, textures, it->second, t, k);
     }
@@ -5104,6 +5193,15 @@ TRY_START
 TRY_END
 }
 
+static int global_gfx_shader_resets_pending (lua_State *L)
+{
+TRY_START
+    check_args(L, 0);
+    lua_pushnumber(L, gfx_shader_resets_pending());
+    return 1;
+TRY_END
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 static int global_resource_exists (lua_State *L)
@@ -5198,6 +5296,7 @@ static const luaL_reg global[] = {
     {"gfx_render", global_gfx_render},
     {"gfx_bake_env_cube", global_gfx_bake_env_cube},
     {"gfx_screenshot", global_gfx_screenshot},
+    {"gfx_env_cube_convert", global_gfx_env_cube_convert},
     {"gfx_option", global_gfx_option},
     {"gfx_option_reset", global_gfx_option_reset},
     {"gfx_body_make", global_gfx_body_make},
@@ -5221,6 +5320,7 @@ static const luaL_reg global[] = {
     {"gfx_register_sky_material", global_gfx_register_sky_material},
     {"gfx_register_material", global_gfx_register_material},
     {"gfx_register_shader", global_gfx_register_shader},
+    {"gfx_shader_resets_pending", global_gfx_shader_resets_pending},
 
     {"gfx_font_define", global_gfx_font_define},
     {"gfx_font_line_height", global_gfx_font_line_height},
@@ -5302,6 +5402,9 @@ static const luaL_reg global[] = {
 
     {"gfx_gpu_ram_available", global_gfx_gpu_ram_available},
     {"gfx_gpu_ram_used", global_gfx_gpu_ram_used},
+    {"gfx_texture_residency_histogram", global_gfx_texture_residency_histogram},
+    {"gfx_mesh_geometry_stats", global_gfx_mesh_geometry_stats},
+    {"gfx_auto_instancing_stats", global_gfx_auto_instancing_stats},
 
     {"gfx_anim_rate", global_gfx_anim_rate},
 
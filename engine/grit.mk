@@ -28,24 +28,34 @@ COL_CONV_STANDALONE_CPP_SRCS = \
 
 
 ENGINE_CPP_SRCS=\
+	async_io.cpp \
 	background_loader.cpp \
 	bullet_debug_drawer.cpp \
 	core_option.cpp \
 	dense_index_map.cpp \
 	disk_resource.cpp \
+	error_aggregate.cpp \
 	external_table.cpp \
+	fastlz.cpp \
+	frame_allocator.cpp \
 	grit_class.cpp \
 	grit_lua_util.cpp \
 	grit_object.cpp \
+	host_cache.cpp \
 	input_filter.cpp \
 	ldbglue.cpp \
+	log_sink.cpp \
 	lua_wrappers_core.cpp \
 	lua_wrappers_disk_resource.cpp \
 	lua_wrappers_gritobj.cpp \
 	lua_wrappers_primitives.cpp \
 	main.cpp \
+	metrics.cpp \
 	path_util.cpp \
+	resource_manifest.cpp \
+	script_tasks.cpp \
 	streamer.cpp \
+	world_snapshot.cpp \
 	 \
 	audio/audio.cpp \
 	audio/lua_wrappers_audio.cpp \
@@ -54,6 +64,7 @@ ENGINE_CPP_SRCS=\
 	 \
 	gfx/gfx_body.cpp \
 	gfx/gfx.cpp \
+	gfx/gfx_auto_instancing.cpp \
 	gfx/gfx_debug.cpp \
 	gfx/gfx_decal.cpp \
 	gfx/gfx_disk_resource.cpp \
@@ -63,6 +74,7 @@ ENGINE_CPP_SRCS=\
 	gfx/gfx_instances.cpp \
 	gfx/gfx_light.cpp \
 	gfx/gfx_material.cpp \
+	gfx/gfx_mesh_geometry.cpp \
 	gfx/gfx_node.cpp \
 	gfx/gfx_option.cpp \
 	gfx/gfx_particle_system.cpp \
@@ -74,13 +86,14 @@ ENGINE_CPP_SRCS=\
 	gfx/gfx_sprite_body.cpp \
 	gfx/gfx_text_body.cpp \
 	gfx/gfx_text_buffer.cpp \
+	gfx/gfx_texture_streaming.cpp \
 	gfx/gfx_tracer_body.cpp \
 	gfx/hud.cpp \
 	gfx/lua_wrappers_gfx.cpp \
 	 \
 	navigation/chunky_tri_mesh.cpp \
 	navigation/crowd_manager.cpp \
-	navigation/fastlz.cpp \
+	navigation/geom_cache.cpp \
 	navigation/input_geom.cpp \
 	navigation/lua_wrappers_navigation.cpp \
 	navigation/mesh_loader_obj.cpp \
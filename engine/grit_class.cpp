@@ -23,6 +23,34 @@
 
 static GritClassMap classes;
 
+static const std::string slot_names[GRIT_CLASS_SLOT_MAX] = {
+    "init",
+    "activate",
+    "deactivate",
+    "setFade",
+    "frameCallback",
+    "stepCallback",
+    "renderingDistance",
+};
+
+const std::string &grit_class_slot_name (GritClassSlot slot)
+{
+    return slot_names[slot];
+}
+
+void GritClass::freeze (void)
+{
+    frozenFields.clear();
+    for (ExternalTable::ConstKeyIterator i=table.begin(), i_=table.end() ; i != i_ ; ++i) {
+        frozenFields[i->first] = &i->second;
+    }
+    for (unsigned s=0 ; s<GRIT_CLASS_SLOT_MAX ; ++s) {
+        auto it = frozenFields.find(slot_names[s]);
+        slots[s] = it == frozenFields.end() ? NULL : it->second;
+    }
+    frozen = true;
+}
+
 GritClass *class_add (lua_State *L, const std::string& name)
 {
     GritClass *gcp;
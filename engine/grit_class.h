@@ -29,6 +29,7 @@ typedef std::map<std::string, GritClass*> GritClassMap;
 #define GritClass_h
 
 #include <string>
+#include <unordered_map>
 
 extern "C" {
     #include <lua.h>
@@ -41,6 +42,22 @@ extern "C" {
 #include "lua_ptr.h"
 #include "path_util.h"
 
+/** Fields that the engine looks up all the time (mostly callbacks), which classes resolve ahead
+ * of time.  \see GritClass::get(lua_State *, GritClassSlot) */
+enum GritClassSlot {
+    GRIT_CLASS_SLOT_INIT,
+    GRIT_CLASS_SLOT_ACTIVATE,
+    GRIT_CLASS_SLOT_DEACTIVATE,
+    GRIT_CLASS_SLOT_SET_FADE,
+    GRIT_CLASS_SLOT_FRAME_CALLBACK,
+    GRIT_CLASS_SLOT_STEP_CALLBACK,
+    GRIT_CLASS_SLOT_RENDERING_DISTANCE,
+    GRIT_CLASS_SLOT_MAX
+};
+
+/** The field name of the slot, e.g. "frameCallback". */
+const std::string &grit_class_slot_name (GritClassSlot slot);
+
 /** A game object class.  The 'DNA' from which multiple similar game objects
  * can be instantiated.  For example, there could be a class representing a
  * street lamp, complete with data and code to define its appearance and
@@ -52,6 +69,11 @@ extern "C" {
  * is used whenever the class itself does not provide a mapping for a given
  * key.  For its own mappings, the class uses an ExternalTable to store data
  * without pressurising the Lua garbage collector.
+ *
+ * Classes are rarely changed once defined, but are read every time one of their objects runs a
+ * callback.  So lookups go through a frozen, hashed copy of the class's own mappings, in which
+ * the slots (\see GritClassSlot) are resolved in advance.  Any change to the class thaws it,
+ * and it is frozen again at the next lookup.
  */
 class GritClass {
 
@@ -59,7 +81,7 @@ class GritClass {
 
     /** Create a class using class_add, this function is internal. */
     GritClass (lua_State *L, const std::string &name_)
-          : name(name_), refCount(1)
+          : name(name_), refCount(1), frozen(false)
     {
         int index = lua_gettop(L);
         for (lua_pushnil(L) ; lua_next(L, index)!=0 ; lua_pop(L, 1)) {
@@ -86,20 +108,31 @@ class GritClass {
      * is unbound. */
     void get (lua_State *L, const std::string &key)
     {
-        const char *err = table.luaGet(L, key);
-        if (err) my_lua_error(L, err);
-        // check the parent
-        if (lua_isnil(L, -1)) {
-            lua_pop(L, 1);
-            pushParent(L);
-            lua_getfield(L, -1, key.c_str());
-            lua_replace(L, -2); // pop the parent
+        if (!frozen) freeze();
+        auto it = frozenFields.find(key);
+        if (it != frozenFields.end()) {
+            ExternalTable::pushValue(L, *it->second);
+            return;
+        }
+        getFromParent(L, key.c_str());
+    }
+
+    /** Look up one of the common fields, like get(L, grit_class_slot_name(slot)) but faster. */
+    void get (lua_State *L, GritClassSlot slot)
+    {
+        if (!frozen) freeze();
+        const ExternalTable::Value *v = slots[slot];
+        if (v != NULL) {
+            ExternalTable::pushValue(L, *v);
+            return;
         }
+        getFromParent(L, grit_class_slot_name(slot).c_str());
     }
 
     /** Set the given key to the value at the top of the Lua stack. */
     void set (lua_State *L, const std::string &key)
     {
+        frozen = false;
         const char *err = table.luaSet(L, key);
         if (err) my_lua_error(L, err);
     }
@@ -107,6 +140,7 @@ class GritClass {
     /** Set the key at Lua stack position -2 to the value at Lua stack position -1. */
     void set (lua_State *L)
     {
+        frozen = false;
         const char *err = table.luaSet(L);
         if (err) my_lua_error(L, err);
     }
@@ -133,6 +167,8 @@ class GritClass {
     {
         refCount--;
         if (refCount>0) return;
+        frozen = false;
+        frozenFields.clear();
         table.destroy(L);
         parentClass.setNil(L);
         delete this;
@@ -141,6 +177,25 @@ class GritClass {
     /** The name of the class, as a Grit path. */
     const std::string name;
 
+    /** Counts of streaming events for objects of this class, to find classes whose objects are
+     * repeatedly activated and deactivated. */
+    struct StreamingStats {
+        StreamingStats (void)
+          : activations(0), deactivations(0), parks(0), revivals(0), thrashes(0)
+        { }
+        /** Calls of the activate callback. */
+        unsigned long activations;
+        /** Calls of the deactivate callback. */
+        unsigned long deactivations;
+        /** Times an object left its range and was kept warm instead of being deactivated. */
+        unsigned long parks;
+        /** Times a warm object came back into range, so no activation was needed. */
+        unsigned long revivals;
+        /** Activations that happened soon after the same object was deactivated. */
+        unsigned long thrashes;
+    };
+    StreamingStats streamingStats;
+
     protected:
 
     /** The number of objects using this class.
@@ -156,6 +211,26 @@ class GritClass {
     /** The class's key/value mappings. */
     ExternalTable table;
 
+    /** Whether frozenFields and slots reflect the table. */
+    bool frozen;
+
+    /** The table's string keys, pointing into the table. */
+    std::unordered_map<std::string, const ExternalTable::Value*> frozenFields;
+
+    /** Each slot's value in the table, or NULL if the parent must be checked. */
+    const ExternalTable::Value *slots[GRIT_CLASS_SLOT_MAX];
+
+    /** Rebuild frozenFields and slots. */
+    void freeze (void);
+
+    /** Push the parent's value for the key. */
+    void getFromParent (lua_State *L, const char *key)
+    {
+        pushParent(L);
+        lua_getfield(L, -1, key);
+        lua_replace(L, -2); // pop the parent
+    }
+
 };
 
 /** Create a new class or replace the existing class with the given name.  Uses
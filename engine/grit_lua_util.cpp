@@ -26,6 +26,7 @@
 #include <io_util.h>
 #include <lua_stack.h>
 
+#include "error_aggregate.h"
 #include "lua_ptr.h"
 #include "grit_lua_util.h"
 #include "path_util.h"
@@ -63,12 +64,24 @@ std::string check_path (lua_State *L, int stack_index)
 }
 
 
+static int report_lua_error (lua_State *l, lua_State *coro, int levelhack, bool aggregate);
+
 int my_lua_error_handler (lua_State *l)
 {
-    return my_lua_error_handler(l, l, 1);
+    return report_lua_error(l, l, 1, true);
 }
 
 int my_lua_error_handler (lua_State *l, lua_State *coro, int levelhack)
+{
+    return report_lua_error(l, coro, levelhack, true);
+}
+
+int my_lua_console_error_handler (lua_State *l)
+{
+    return report_lua_error(l, l, 1, false);
+}
+
+static int report_lua_error (lua_State *l, lua_State *coro, int levelhack, bool aggregate)
 {
     //check_args(l, 1);
     int level = 0;
@@ -82,6 +95,18 @@ int my_lua_error_handler (lua_State *l, lua_State *coro, int levelhack)
     
     std::string str = check_string(l, -1);
 
+    // Count the error by where it was raised and what it said before getting the traceback, so
+    // a callback that fails every frame costs little once it has been reported a few times.
+    if (aggregate) {
+        lua_Debug ar;
+        std::stringstream where;
+        if (lua_getstack(coro, level, &ar) && lua_getinfo(coro, "Sl", &ar))
+            where << ar.short_src << ":" << ar.currentline << ": ";
+        std::string key = str;
+        if (key.compare(0, where.str().length(), where.str()) != 0) key = where.str() + key;
+        if (!error_aggregate("Lua error", key)) return 1;
+    }
+
     std::vector<struct stack_frame> tb = traceback(coro, level);
 
     if (tb.size()==0) {
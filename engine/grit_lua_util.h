@@ -50,3 +50,7 @@ void func_map_leak_all (void);
 int my_lua_error_handler (lua_State *l);
 
 int my_lua_error_handler (lua_State *l, lua_State *coro, int levelhack);
+
+/** As my_lua_error_handler, but the error is always reported in full, never rate limited.  For
+ * code typed at the interactive console, where the user is waiting to see each error. */
+int my_lua_console_error_handler (lua_State *l);
@@ -21,6 +21,9 @@
 
 #include <cmath>
 
+#include <sleep.h>
+
+#include "frame_allocator.h"
 #include "main.h"
 #include "grit_object.h"
 #include "grit_class.h"
@@ -28,6 +31,8 @@
 #include "grit_lua_util.h"
 #include "lua_wrappers_gritobj.h"
 
+#include "physics/physics_world.h"
+
 
 static GObjMap objs;
 static GObjSet objs_needing_frame_callbacks;
@@ -45,9 +50,15 @@ GritObject::GritObject (const std::string &name_,
     needsStepCallbacks(false),
     demandRegistered(false),
     imposedFarFade(1.0),
-    lastFade(-1)
+    lastFade(-1),
+    parked(false),
+    parkedSince(0),
+    lastDeactivated(0),
+    slotOverrides(0),
+    slotOverridesShape(-1)
 {
     gritClass->acquire();
+    demand.setManifestKey(gritClass->name);
 }       
 
 void GritObject::destroy (lua_State *L, const GritObjectPtr &self)
@@ -89,7 +100,7 @@ void GritObject::notifyFade (lua_State *L,
 
     // call into lua...
     //stack: err
-    getField(L, "setFade");
+    getField(L, GRIT_CLASS_SLOT_SET_FADE);
     //stack: err, class, callback
     if (lua_isnil(L, -1)) {
         // TODO(dcunnin): We should add needsFadeCallbacks.
@@ -161,7 +172,7 @@ void GritObject::activate (lua_State *L,
     //stack: err
 
     //stack: err
-    getField(L, "activate");
+    getField(L, GRIT_CLASS_SLOT_ACTIVATE);
     //stack: err, callback
     if (lua_isnil(L, -1)) {
         // don't activate it as class does not have activate function
@@ -213,6 +224,10 @@ void GritObject::activate (lua_State *L,
         //stack: err
         streamer_list_as_activated(self);
         lastFade = -1;
+        gritClass->streamingStats.activations++;
+        const unsigned long long thrash_window = streamer_thrash_window * 1E6;
+        if (lastDeactivated != 0 && micros() - lastDeactivated < thrash_window)
+            gritClass->streamingStats.thrashes++;
     }
     //stack: err
 
@@ -222,6 +237,22 @@ void GritObject::activate (lua_State *L,
     STACK_CHECK;
 }
 
+void GritObject::park (unsigned long long now)
+{
+    parked = true;
+    parkedSince = now;
+    gritClass->streamingStats.parks++;
+    // It is invisible, so should not be felt either.
+    physics_suspend_owned_bodies(this, true);
+}
+
+void GritObject::revive (void)
+{
+    parked = false;
+    gritClass->streamingStats.revivals++;
+    physics_suspend_owned_bodies(this, false);
+}
+
 float GritObject::calcFade (const float range2, bool &overlap)
 {
     // Windows prohibits use of variables called 'near' and 'far'.
@@ -273,6 +304,13 @@ bool GritObject::deactivate (lua_State *L, const GritObjectPtr &self)
     bool killme = false;
 
     streamer_unlist_as_activated(self);
+    if (parked) {
+        // In case the deactivate callback keeps any of them.
+        physics_suspend_owned_bodies(this, false);
+        parked = false;
+    }
+    lastDeactivated = micros();
+    gritClass->streamingStats.deactivations++;
 
     STACK_BASE;
     //stack is empty
@@ -283,7 +321,7 @@ bool GritObject::deactivate (lua_State *L, const GritObjectPtr &self)
     //stack: err
 
     //stack: err
-    getField(L, "deactivate");
+    getField(L, GRIT_CLASS_SLOT_DEACTIVATE);
     //stack: err, callback
     if (lua_isnil(L, -1)) {
         lua_pop(L, 2);
@@ -345,7 +383,7 @@ void GritObject::init (lua_State *L, const GritObjectPtr &self)
     //stack: err
 
     //stack: err
-    getField(L, "init");
+    getField(L, GRIT_CLASS_SLOT_INIT);
     //stack: err, callback
     if (lua_isnil(L, -1)) {
         lua_pop(L, 2);
@@ -394,7 +432,7 @@ bool GritObject::frameCallback (lua_State *L, const GritObjectPtr &self, float e
     int error_handler = lua_gettop(L);
 
     //stack: err
-    getField(L, "frameCallback");
+    getField(L, GRIT_CLASS_SLOT_FRAME_CALLBACK);
     //stack: err, callback
     if (lua_isnil(L, -1)) {
         lua_pop(L, 2);
@@ -438,7 +476,7 @@ bool GritObject::stepCallback (lua_State *L, const GritObjectPtr &self, float el
 
     //stack: err
 
-    getField(L, "stepCallback");
+    getField(L, GRIT_CLASS_SLOT_STEP_CALLBACK);
     //stack: err, callback
     if (lua_isnil(L, -1)) {
         lua_pop(L, 2);
@@ -526,6 +564,26 @@ void GritObject::getField (lua_State *L, const std::string &f) const
     gritClass->get(L, f);
 }
 
+void GritObject::getField (lua_State *L, GritClassSlot slot) const
+{
+    if (gritClass==NULL) GRIT_EXCEPT("Object destroyed");
+
+    if (slotOverridesShape != userValues.getShape()) {
+        slotOverrides = 0;
+        for (unsigned s=0 ; s<GRIT_CLASS_SLOT_MAX ; ++s) {
+            if (userValues.has(grit_class_slot_name(GritClassSlot(s)))) slotOverrides |= 1 << s;
+        }
+        slotOverridesShape = userValues.getShape();
+    }
+
+    if (slotOverrides & (1 << slot)) {
+        const char *err = userValues.luaGet(L, grit_class_slot_name(slot));
+        if (err) my_lua_error(L, err);
+        return;
+    }
+    gritClass->get(L, slot);
+}
+
 
 
 
@@ -604,22 +662,27 @@ int object_count (void) {
 
 void object_do_frame_callbacks (lua_State *L, float elapsed)
 {
-    GObjSet victims = objs_needing_frame_callbacks;
-    typedef GObjSet::iterator I;
-    for (I i=victims.begin(), i_=victims.end() ; i != i_ ; ++i) {
-        if (!(*i)->frameCallback(L, *i, elapsed)) {
-            (*i)->setNeedsFrameCallbacks(*i, false);
+    // The callbacks can change the set, so iterate over a copy.
+    FrameVector<GritObjectPtr> victims(objs_needing_frame_callbacks.begin(),
+                                       objs_needing_frame_callbacks.end());
+    for (const auto &o : victims) {
+        // Parked objects are suspended until they are revived or deactivated.
+        if (o->isParked()) continue;
+        if (!o->frameCallback(L, o, elapsed)) {
+            o->setNeedsFrameCallbacks(o, false);
         }
     }
 }
 
 void object_do_step_callbacks (lua_State *L, float elapsed)
 {
-    GObjSet victims = objs_needing_step_callbacks;
-    typedef GObjSet::iterator I;
-    for (I i=victims.begin(), i_=victims.end() ; i != i_ ; ++i) {
-        if (!(*i)->stepCallback(L, *i, elapsed)) {
-            (*i)->setNeedsStepCallbacks(*i, false);
+    // The callbacks can change the set, so iterate over a copy.
+    FrameVector<GritObjectPtr> victims(objs_needing_step_callbacks.begin(),
+                                       objs_needing_step_callbacks.end());
+    for (const auto &o : victims) {
+        if (o->isParked()) continue;
+        if (!o->stepCallback(L, o, elapsed)) {
+            o->setNeedsStepCallbacks(o, false);
         }
     }
 }
@@ -38,6 +38,7 @@ typedef std::set<GritObjectPtr> GObjSet;
 
 #include "background_loader.h"
 #include "external_table.h"
+#include "grit_class.h"
 #include "streamer.h"
 
 /** A streamed game object, occupying a place in the map.
@@ -69,7 +70,7 @@ typedef std::set<GritObjectPtr> GObjSet;
  *
  * TODO: talk about lods
  */ 
-class GritObject {
+class GritObject : public SharedPtrCounted {
 
     public:
 
@@ -137,6 +138,20 @@ class GritObject {
     /** Is the object activated (close enough to the player)? */
     bool isActivated (void) const { return lua != LUA_NOREF; }
 
+    /** Is the object activated but out of range, waiting to be either deactivated or revived?
+     * It is invisible (faded out) while parked, but keeps all its state.  Its physics bodies are
+     * suspended and its frame and step callbacks are not called. */
+    bool isParked (void) const { return parked; }
+
+    /** When the object was parked, in microseconds. */
+    unsigned long long getParkedSince (void) const { return parkedSince; }
+
+    /** Keep an activated object that is out of range, instead of deactivating it. */
+    void park (unsigned long long now);
+
+    /** The parked object came back into range. */
+    void revive (void);
+
     /** Push the object's Lua table state, which only exists when it is activated. */
     void pushLuaTable (lua_State *L)
     {
@@ -179,6 +194,12 @@ class GritObject {
         return demand.isInBackgroundQueue();
     }
 
+    /** When the resources were first requested, see Demand::getRequestTime. */
+    unsigned long long getLoadRequestTime (void)
+    {
+        return demand.getRequestTime();
+    }
+
     /** Return whether or not there was a problem loading dependent resources. */
     bool backgroundLoadingCausedError (void)
     {
@@ -328,6 +349,9 @@ class GritObject {
 
     void getField (lua_State *L, const std::string &f) const;
 
+    /** Like getField(L, grit_class_slot_name(slot)), but faster. */
+    void getField (lua_State *L, GritClassSlot slot) const;
+
     protected:
 
     /** Current position of the object. */
@@ -374,6 +398,19 @@ class GritObject {
      * callback is only invoked if the fade has changed, for performance reasons.
      */
     float lastFade;
+
+    /** See isParked(). */
+    bool parked;
+    unsigned long long parkedSince;
+
+    /** When the object was last deactivated, in microseconds, or 0 if never. */
+    unsigned long long lastDeactivated;
+
+    /** Which slots are overridden by userValues (one bit per slot).  Objects rarely override
+     * their class's callbacks, so this saves looking in userValues first.  Only valid while
+     * userValues has the shape slotOverridesShape. */
+    mutable unsigned slotOverrides;
+    mutable unsigned long slotOverridesShape;
 };
 
 /** Instantiate the given class to create a new object with the given name.
@@ -0,0 +1,318 @@
+/* Copyright (c) The Grit Game Engine authors 2016
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <climits>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <iterator>
+#include <list>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#include <centralised_log.h>
+
+#include "fastlz.h"
+#include "host_cache.h"
+#include "metrics.h"
+
+static MetricCounter *metric_hits =
+    metrics_counter("grit_host_cache_hits_total", "",
+                    "Resource files opened from the host cache instead of the disk.");
+static MetricCounter *metric_misses =
+    metrics_counter("grit_host_cache_misses_total", "",
+                    "Resource files that were not in the host cache, or had changed since.");
+static MetricCounter *metric_drops =
+    metrics_counter("grit_host_cache_drops_total", "",
+                    "Files dropped from the host cache to stay within its budget.");
+static MetricGauge *metric_compressed =
+    metrics_gauge("grit_host_cache_bytes", "size=\"compressed\"",
+                  "Size of the files in the host cache.");
+static MetricGauge *metric_raw =
+    metrics_gauge("grit_host_cache_bytes", "size=\"raw\"",
+                  "Size of the files in the host cache.");
+
+namespace {
+
+    struct Entry {
+        std::string name;
+        std::shared_ptr<const HostCacheFile> file;
+        unsigned long long held;
+    };
+
+    // Most recently used first.
+    typedef std::list<Entry> Entries;
+
+    std::mutex lock;
+    Entries entries;
+    std::map<std::string, Entries::iterator> index;
+    unsigned long long budget = 0;
+    unsigned long long held = 0;
+    unsigned long long held_raw = 0;
+
+    // Files waiting for the thread, and whether it is working on one.
+    std::deque<std::string> queue;
+    bool busy = false;
+    bool quit = false;
+    std::condition_variable cvar;
+    std::condition_variable idle_cvar;
+    std::thread *worker = nullptr;
+
+}
+
+#define SYNCHRONISED std::unique_lock<std::mutex> _scoped_lock(lock)
+
+size_t HostCacheFile::blockSize (size_t i) const
+{
+    if (i + 1 < blocks.size()) return HOST_CACHE_BLOCK;
+    return size_t(size - (unsigned long long)i * HOST_CACHE_BLOCK);
+}
+
+bool HostCacheFile::readBlock (size_t i, unsigned char *out) const
+{
+    const std::vector<unsigned char> &block = blocks[i];
+    size_t raw = blockSize(i);
+    if (block.size() == raw) {
+        std::copy(block.begin(), block.end(), out);
+        return true;
+    }
+    int n = fastlz_decompress(&block[0], int(block.size()), out, int(HOST_CACHE_BLOCK));
+    return size_t(n) == raw;
+}
+
+// Resources are files relative to the game directory, which is the current directory.
+static bool file_stat (const std::string &name, struct stat &st)
+{
+    return stat(name.substr(1).c_str(), &st) == 0;
+}
+
+static bool unchanged (const HostCacheFile &f, const struct stat &st)
+{
+    return f.size == (unsigned long long)st.st_size && f.mtime == st.st_mtime;
+}
+
+// Read and compress the file, or return nullptr if it is not on disk or changes meanwhile.
+static std::shared_ptr<HostCacheFile> read_file (const std::string &name, const struct stat &st)
+{
+    FILE *f = fopen(name.substr(1).c_str(), "rb");
+    if (f == nullptr) return nullptr;
+    auto file = std::make_shared<HostCacheFile>();
+    file->size = st.st_size;
+    file->mtime = st.st_mtime;
+    std::vector<unsigned char> raw(HOST_CACHE_BLOCK);
+    // The output can be 5% larger than the input, and at least 66 bytes.
+    std::vector<unsigned char> buf(HOST_CACHE_BLOCK + HOST_CACHE_BLOCK / 16 + 66);
+    unsigned long long left = file->size;
+    while (left > 0) {
+        size_t want = size_t(std::min<unsigned long long>(left, HOST_CACHE_BLOCK));
+        if (fread(&raw[0], 1, want, f) != want) {
+            fclose(f);
+            return nullptr;
+        }
+        left -= want;
+        file->blocks.emplace_back();
+        std::vector<unsigned char> &block = file->blocks.back();
+        // FastLZ needs at least 16 bytes.
+        int n = want < 16 ? 0 : fastlz_compress_level(1, &raw[0], int(want), &buf[0]);
+        if (n > 0 && size_t(n) < want) {
+            block.assign(buf.begin(), buf.begin() + n);
+        } else {
+            block.assign(raw.begin(), raw.begin() + want);
+        }
+    }
+    fclose(f);
+    return file;
+}
+
+// All of the following must hold the lock.
+
+static void update_gauges_locked (void)
+{
+    metric_compressed->set(held);
+    metric_raw->set(held_raw);
+}
+
+static void remove_locked (Entries::iterator it)
+{
+    held -= it->held;
+    held_raw -= it->file->size;
+    index.erase(it->name);
+    entries.erase(it);
+}
+
+static void shrink_locked (void)
+{
+    while (!entries.empty() && (held > budget || budget == 0)) {
+        remove_locked(std::prev(entries.end()));
+        metric_drops->inc();
+    }
+    update_gauges_locked();
+}
+
+static void insert_locked (const std::string &name, const std::shared_ptr<HostCacheFile> &file)
+{
+    unsigned long long compressed = 0;
+    for (const auto &block : file->blocks) compressed += block.size();
+    auto it = index.find(name);
+    if (it != index.end()) remove_locked(it->second);
+    entries.push_front(Entry { name, file, compressed });
+    index[name] = entries.begin();
+    held += compressed;
+    held_raw += file->size;
+    shrink_locked();
+}
+
+static void worker_main (void)
+{
+    SYNCHRONISED;
+    while (true) {
+        while (!quit && queue.empty()) cvar.wait(_scoped_lock);
+        if (quit) break;
+        std::string name = queue.front();
+        queue.pop_front();
+        busy = true;
+
+        struct stat st;
+        bool wanted = budget > 0 && file_stat(name, st)
+                   && (unsigned long long)st.st_size <= budget;
+        auto it = index.find(name);
+        if (wanted && it != index.end() && unchanged(*it->second->file, st)) wanted = false;
+
+        if (wanted) {
+            // Read and compress without the lock.
+            _scoped_lock.unlock();
+            auto file = read_file(name, st);
+            _scoped_lock.lock();
+            if (file != nullptr && budget > 0) insert_locked(name, file);
+        }
+
+        busy = false;
+        if (queue.empty()) idle_cvar.notify_all();
+    }
+}
+
+void host_cache_init (void)
+{
+    SYNCHRONISED;
+    if (worker != nullptr) return;
+    quit = false;
+    worker = new std::thread(worker_main);
+}
+
+void host_cache_shutdown (void)
+{
+    {
+        SYNCHRONISED;
+        if (worker == nullptr) return;
+        quit = true;
+        queue.clear();
+        cvar.notify_all();
+    }
+    worker->join();
+    delete worker;
+    worker = nullptr;
+    idle_cvar.notify_all();
+}
+
+void host_cache_add (const std::string &name)
+{
+    SYNCHRONISED;
+    if (budget == 0 || worker == nullptr) return;
+    auto it = index.find(name);
+    // Whether it has changed is checked by the thread.
+    if (it != index.end()) entries.splice(entries.begin(), entries, it->second);
+    if (std::find(queue.begin(), queue.end(), name) != queue.end()) return;
+    queue.push_back(name);
+    cvar.notify_one();
+}
+
+void host_cache_flush (void)
+{
+    SYNCHRONISED;
+    while (worker != nullptr && !quit && (busy || !queue.empty())) idle_cvar.wait(_scoped_lock);
+}
+
+std::shared_ptr<const HostCacheFile> host_cache_get (const std::string &name)
+{
+    struct stat st;
+    bool exists = file_stat(name, st);
+
+    SYNCHRONISED;
+    if (budget == 0) return nullptr;
+    auto it = index.find(name);
+    if (it == index.end()) {
+        metric_misses->inc();
+        return nullptr;
+    }
+    if (!exists || !unchanged(*it->second->file, st)) {
+        remove_locked(it->second);
+        update_gauges_locked();
+        metric_misses->inc();
+        return nullptr;
+    }
+    entries.splice(entries.begin(), entries, it->second);
+    metric_hits->inc();
+    // Decompressed by the caller, without the lock.
+    return it->second->file;
+}
+
+bool host_cache_has (const std::string &name)
+{
+    SYNCHRONISED;
+    return index.find(name) != index.end();
+}
+
+void host_cache_set_budget (unsigned long long bytes)
+{
+    SYNCHRONISED;
+    budget = bytes;
+    if (budget == 0) queue.clear();
+    shrink_locked();
+}
+
+unsigned long long host_cache_get_budget (void)
+{
+    SYNCHRONISED;
+    return budget;
+}
+
+void host_cache_clear (void)
+{
+    SYNCHRONISED;
+    entries.clear();
+    index.clear();
+    held = 0;
+    held_raw = 0;
+    update_gauges_locked();
+}
+
+void host_cache_stats (unsigned &files, unsigned long long &compressed, unsigned long long &raw)
+{
+    SYNCHRONISED;
+    files = entries.size();
+    compressed = held;
+    raw = held_raw;
+}
@@ -0,0 +1,101 @@
+/* Copyright (c) The Grit Game Engine authors 2016
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef HostCache_h
+#define HostCache_h
+
+#include <ctime>
+#include <memory>
+#include <string>
+#include <vector>
+
+/** \file
+ *
+ * A second tier below the loaded resources, for machines with spare memory but slow disks.  A
+ * resource unloaded to stay within the memory budget has to be read from disk again when it is
+ * next needed, e.g. when the player turns around.  The host cache keeps the bytes of resource
+ * files, compressed with FastLZ, within a budget of its own (the core option HOST_CACHE_RAM), and
+ * Ogre opens files from it before going to the disk.
+ *
+ * Files are added when the resource loaded from them is unloaded to free memory.  A thread of the
+ * cache's own reads the file again (it was read recently, so it is usually in the page cache) and
+ * compresses it, so nothing else waits for that.  The least recently used are dropped to stay
+ * within the budget, so the cache favours what was just unloaded over what has stayed loaded for
+ * a long time.  An entry is only used while the file has the same size and modification time.
+ *
+ * Each file is split into blocks that are compressed separately, so a part of it can be read
+ * without decompressing the rest, e.g. the smaller mips of a streamed DDS texture.
+ *
+ * All the functions can be called from any thread.
+ */
+
+/** The uncompressed size of the blocks. */
+static const size_t HOST_CACHE_BLOCK = 64 * 1024;
+
+/** A file in the cache.  It never changes once it has been added, so it can be read without any
+ * lock, and stays valid after it has been dropped from the cache. */
+struct HostCacheFile {
+    // Of the file when it was added.
+    unsigned long long size;
+    time_t mtime;
+    // Blocks that did not compress are stored as they are.
+    std::vector<std::vector<unsigned char>> blocks;
+
+    /** The uncompressed size of block i. */
+    size_t blockSize (size_t i) const;
+
+    /** Decompress block i into out, which must have room for HOST_CACHE_BLOCK bytes.  Returns
+     * false if the block is corrupt. */
+    bool readBlock (size_t i, unsigned char *out) const;
+};
+
+/** Start the thread that reads and compresses the files. */
+void host_cache_init (void);
+
+/** Stop the thread, dropping the files that are still queued. */
+void host_cache_shutdown (void);
+
+/** Queue the file to be added in the background, or make it the most recently used if it is
+ * already there.  Does nothing for files that are not on disk, e.g. in a zip. */
+void host_cache_add (const std::string &name);
+
+/** Wait until the queued files have been added. */
+void host_cache_flush (void);
+
+/** Get the file, or nullptr if it is not there or has since changed on disk. */
+std::shared_ptr<const HostCacheFile> host_cache_get (const std::string &name);
+
+/** Is the file there?  Does not check if it has changed. */
+bool host_cache_has (const std::string &name);
+
+/** Set the budget for the compressed bytes, dropping files to fit.  0 disables the cache. */
+void host_cache_set_budget (unsigned long long bytes);
+
+unsigned long long host_cache_get_budget (void);
+
+/** Drop every file. */
+void host_cache_clear (void);
+
+/** The number of files, and their compressed and uncompressed sizes. */
+void host_cache_stats (unsigned &files, unsigned long long &compressed, unsigned long long &raw);
+
+#endif
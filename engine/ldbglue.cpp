@@ -1,6 +1,21 @@
-extern "C" {
-#include "lua.h"
-}
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <centralised_log.h>
+#include <sleep.h>
+
+#include "ldbglue.h"
+#include "lua_ptr.h"
 
 /* Call ldb as carefully as possible. Returns true if it managed
  * to call ldb and ldb does not return 'false' (nil is ok). An
@@ -81,3 +96,334 @@ int luaopen_ldbglue (lua_State *L) {
   return 0;
 }
 
+
+
+// Hooks ------------------------------------------------------------------------
+
+static void hook (lua_State *L, lua_Debug *ar);
+
+namespace {
+    // Written by the hook, on whichever thread is running Lua, and read from Lua.
+    struct Stats {
+        std::atomic<unsigned long> hookCalls;
+        std::atomic<unsigned long long> hookMicros;
+        std::atomic<unsigned long> breaks;
+        std::atomic<unsigned long> samples;
+        std::atomic<unsigned long> samplesOverwritten;
+    };
+}
+
+static Stats stats = { {0}, {0}, {0}, {0}, {0} };
+
+static bool attached = false;
+static LuaPtr client;  // nil means use ldb
+static bool stepping = false;
+static bool in_client = false;
+
+static std::set<std::pair<std::string, int>> breakpoints;
+// Lines with a breakpoint in any source, to avoid looking up the source on most lines.
+static std::unordered_set<int> breakpoint_lines;
+
+// The hooks wanted by the debugger, which the sampler adds its count hook to.
+static std::atomic<int> base_mask(0);
+
+/** Install the hooks the debugger currently needs, which also disarms the sampler. */
+static void install_hooks (lua_State *L)
+{
+    int mask = 0;
+    if (attached && (stepping || !breakpoints.empty())) mask |= LUA_MASKLINE;
+    base_mask = mask;
+    lua_sethook(L, mask == 0 ? NULL : hook, mask, 0);
+}
+
+static void call_client (lua_State *L, lua_Debug *ar)
+{
+    lua_getinfo(L, "S", ar);
+    stats.breaks++;
+    stepping = false;
+    in_client = true;
+    if (client.isNil()) {
+        char msg[256];
+        snprintf(msg, sizeof msg, "break at %s:%d", ar->short_src, ar->currentline);
+        ldb(L, msg);
+    } else if (lua_checkstack(L, 3)) {
+        client.push(L);
+        lua_pushstring(L, ar->short_src);
+        lua_pushnumber(L, ar->currentline);
+        if (lua_pcall(L, 2, 1, 0)) {
+            CERR << "Debugger client: " << lua_tostring(L, -1) << std::endl;
+        } else if (lua_type(L, -1) == LUA_TSTRING && std::string(lua_tostring(L, -1)) == "step") {
+            stepping = true;
+        }
+        lua_pop(L, 1);
+    }
+    in_client = false;
+    install_hooks(L);
+}
+
+
+// Sampling ---------------------------------------------------------------------
+
+static const unsigned SAMPLE_DEPTH = 64;
+
+namespace {
+    struct Sample {
+        unsigned depth;
+        unsigned frames[SAMPLE_DEPTH];  // innermost first
+    };
+}
+
+static std::vector<Sample> ring;
+static size_t ring_next = 0;
+static size_t ring_used = 0;
+
+static std::vector<std::string> frame_names;
+static std::unordered_map<std::string, unsigned> frame_ids;
+
+static unsigned frame_id (const lua_Debug &ar)
+{
+    char buf[512];
+    snprintf(buf, sizeof buf, "%s (%s:%d)", ar.name == NULL ? "?" : ar.name, ar.short_src,
+             ar.linedefined);
+    // Semicolons separate the frames in the folded output.
+    for (char *c = buf ; *c != '\0' ; ++c) {
+        if (*c == ';') *c = ',';
+    }
+    auto it = frame_ids.find(buf);
+    if (it != frame_ids.end()) return it->second;
+    unsigned id = frame_names.size();
+    frame_names.push_back(buf);
+    frame_ids[buf] = id;
+    return id;
+}
+
+static void take_sample (lua_State *L)
+{
+    if (ring.empty()) return;
+    Sample &s = ring[ring_next];
+    lua_Debug frame;
+    s.depth = 0;
+    for (int level=0 ; s.depth<SAMPLE_DEPTH && lua_getstack(L, level, &frame) ; ++level) {
+        lua_getinfo(L, "Sn", &frame);
+        s.frames[s.depth++] = frame_id(frame);
+    }
+    ring_next = (ring_next + 1) % ring.size();
+    if (ring_used == ring.size()) {
+        stats.samplesOverwritten++;
+    } else {
+        ring_used++;
+    }
+    stats.samples++;
+}
+
+static std::thread *sampler = NULL;
+static std::mutex sampler_mutex;
+static std::condition_variable sampler_cv;
+static bool sampler_quit;
+static lua_State *sampler_L;
+// The coroutine being resumed by a script task, or NULL for sampler_L.  Guarded by
+// sampler_mutex while the sampler is running, so a finished coroutine is never armed.
+static lua_State *running_L = NULL;
+static std::chrono::microseconds sampler_period;
+
+static void sampler_main (void)
+{
+    auto next = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(sampler_mutex);
+    while (true) {
+        next += sampler_period;
+        if (sampler_cv.wait_until(lock, next, []{ return sampler_quit; })) break;
+        // Setting a hook from another thread is allowed, it is how the standalone
+        // interpreter handles ^C.  The hook disarms itself after one instruction.
+        lua_State *L = running_L == NULL ? sampler_L : running_L;
+        lua_sethook(L, hook, base_mask | LUA_MASKCOUNT, 1);
+    }
+}
+
+static void hook (lua_State *L, lua_Debug *ar)
+{
+    unsigned long long before = micros();
+    stats.hookCalls++;
+    if (ar->event == LUA_HOOKCOUNT) {
+        take_sample(L);
+        install_hooks(L);
+    } else if (ar->event == LUA_HOOKLINE && !in_client) {
+        bool stop = stepping;
+        if (!stop && breakpoint_lines.count(ar->currentline) > 0) {
+            lua_getinfo(L, "S", ar);
+            stop = breakpoints.count(std::make_pair(std::string(ar->short_src), ar->currentline)) > 0;
+        }
+        if (stop) {
+            stats.hookMicros += micros() - before;
+            call_client(L, ar);
+            return;
+        }
+    }
+    stats.hookMicros += micros() - before;
+}
+
+
+// Interface --------------------------------------------------------------------
+
+void ldb_attach (lua_State *L)
+{
+    if (lua_isnil(L, -1)) {
+        lua_pop(L, 1);
+        client.setNil(L);
+    } else {
+        client.set(L);
+    }
+    attached = true;
+    stepping = false;
+    install_hooks(L);
+}
+
+void ldb_detach (lua_State *L)
+{
+    attached = false;
+    stepping = false;
+    client.setNil(L);
+    install_hooks(L);
+}
+
+void ldb_resume_begin (lua_State *co)
+{
+    // Otherwise it keeps whatever hooks were current when it was created or last ran.
+    install_hooks(co);
+    if (sampler == NULL) {
+        running_L = co;
+    } else {
+        std::lock_guard<std::mutex> lock(sampler_mutex);
+        running_L = co;
+    }
+}
+
+void ldb_resume_end (lua_State *L)
+{
+    if (sampler == NULL) {
+        running_L = NULL;
+    } else {
+        std::lock_guard<std::mutex> lock(sampler_mutex);
+        running_L = NULL;
+    }
+    // The coroutine may have changed the hooks, e.g. by stepping out of it.
+    install_hooks(L);
+}
+
+bool ldb_attached (void)
+{
+    return attached;
+}
+
+static void update_breakpoint_lines (lua_State *L)
+{
+    breakpoint_lines.clear();
+    for (const auto &b : breakpoints) breakpoint_lines.insert(b.second);
+    install_hooks(L);
+}
+
+void ldb_break_add (lua_State *L, const std::string &source, int line)
+{
+    breakpoints.insert(std::make_pair(source, line));
+    update_breakpoint_lines(L);
+}
+
+bool ldb_break_del (lua_State *L, const std::string &source, int line)
+{
+    bool r = breakpoints.erase(std::make_pair(source, line)) > 0;
+    update_breakpoint_lines(L);
+    return r;
+}
+
+void ldb_break_clear (lua_State *L)
+{
+    breakpoints.clear();
+    update_breakpoint_lines(L);
+}
+
+void ldb_profiler_start (lua_State *L, float period, unsigned capacity)
+{
+    ldb_profiler_stop(L);
+    ring.clear();
+    ring.resize(capacity);
+    ring_next = 0;
+    ring_used = 0;
+    frame_names.clear();
+    frame_ids.clear();
+    stats.samples = 0;
+    stats.samplesOverwritten = 0;
+    sampler_quit = false;
+    sampler_L = L;
+    sampler_period = std::chrono::microseconds((long long)(period * 1E6));
+    if (sampler_period.count() < 1) sampler_period = std::chrono::microseconds(1);
+    sampler = new std::thread(sampler_main);
+}
+
+void ldb_profiler_stop (lua_State *L)
+{
+    if (sampler == NULL) return;
+    {
+        std::lock_guard<std::mutex> lock(sampler_mutex);
+        sampler_quit = true;
+    }
+    sampler_cv.notify_all();
+    sampler->join();
+    delete sampler;
+    sampler = NULL;
+    // Disarm a sample that was due but not yet taken.
+    install_hooks(L);
+}
+
+bool ldb_profiler_running (void)
+{
+    return sampler != NULL;
+}
+
+unsigned ldb_profiler_dump (const std::string &filename)
+{
+    std::map<std::string, unsigned long> stacks;
+    size_t first = ring.empty() ? 0 : (ring_next + ring.size() - ring_used) % ring.size();
+    for (size_t i=0 ; i<ring_used ; ++i) {
+        const Sample &s = ring[(first + i) % ring.size()];
+        std::string folded;
+        for (unsigned j=s.depth ; j>0 ; --j) {
+            if (j < s.depth) folded += ';';
+            folded += frame_names[s.frames[j-1]];
+        }
+        // A sample taken outside any function (e.g. in a chunk being loaded).
+        if (folded.empty()) folded = "?";
+        stacks[folded]++;
+    }
+
+    std::ofstream f(filename.c_str());
+    if (!f.good()) EXCEPT << "Could not open profile for writing: \"" << filename << "\"" << ENDL;
+    for (const auto &s : stacks) f << s.first << " " << s.second << "\n";
+    f.close();
+    if (!f.good()) EXCEPT << "Could not write profile: \"" << filename << "\"" << ENDL;
+    return stacks.size();
+}
+
+LdbStats ldb_stats (void)
+{
+    LdbStats r;
+    r.hookCalls = stats.hookCalls;
+    r.hookMicros = stats.hookMicros;
+    r.breaks = stats.breaks;
+    r.samples = stats.samples;
+    r.samplesOverwritten = stats.samplesOverwritten;
+    return r;
+}
+
+void ldb_stats_reset (void)
+{
+    stats.hookCalls = 0;
+    stats.hookMicros = 0;
+    stats.breaks = 0;
+}
+
+void ldb_shutdown (lua_State *L)
+{
+    ldb_profiler_stop(L);
+    ldb_break_clear(L);
+    ldb_detach(L);
+}
@@ -0,0 +1,121 @@
+/* Copyright (c) The Grit Game Engine authors 2016
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef LdbGlue_h
+#define LdbGlue_h
+
+#include <string>
+
+extern "C" {
+    #include <lua.h>
+}
+
+/** \file
+ *
+ * Debugger and profiler support for the core Lua state.  Nothing is installed until a debugger
+ * client attaches or the profiler is started, so when neither is in use, Lua runs without hooks
+ * and pays nothing.
+ *
+ * A debugger client is a Lua function standing in for the other end of a pipe.  It is called
+ * with the source and line whenever a breakpoint is hit, and returns "step" to stop again at the
+ * next line, or anything else to continue.  If no client function is given, the ldb module
+ * loaded by luaopen_ldbglue is used.  Line hooks are only installed while there are breakpoints
+ * or a step is pending.
+ *
+ * The profiler samples the Lua stack periodically instead of hooking every call.  A timer thread
+ * arms a one-shot count hook at each period, and the hook records the stack into a ring buffer
+ * then disarms itself, so between samples Lua runs as it does detached.  Samples can be written
+ * out as folded stacks, one line per distinct stack, for flame graph tools.
+ *
+ * Lua hooks are per thread, and coroutines copy them from their creator when created.  Script
+ * tasks are given the current hooks each time they are resumed (see ldb_resume_begin), and are
+ * sampled while they run.  Other coroutines only have the hooks that were current when they
+ * were created, and samples are only taken of the main thread or a running task (a sample due
+ * while in C code, or in a coroutine resumed by a task, is taken when that thread runs Lua
+ * again).
+ */
+
+/** Call the ldb module (if loaded) with the given message.  Returns true if it did and ldb did
+ * not return false. */
+int ldb (lua_State *L, const char *msg);
+
+/** Call the ldb module with the given command, for use from gdb. */
+void ldbdo (lua_State *L, const char *cmd);
+
+/** Load the ldb module. */
+int luaopen_ldbglue (lua_State *L);
+
+/** Attach a client, popping it (a function, or nil to use ldb) from the top of the stack. */
+void ldb_attach (lua_State *L);
+
+/** Detach the client and remove its hooks.  Breakpoints are kept for the next client. */
+void ldb_detach (lua_State *L);
+
+bool ldb_attached (void);
+
+/** Call just before resuming the coroutine of a script task, to give it the current hooks and
+ * make it the thread that is sampled. */
+void ldb_resume_begin (lua_State *co);
+
+/** Call once the coroutine has yielded or finished, with the thread that resumed it. */
+void ldb_resume_end (lua_State *L);
+
+/** Break at the given line of the given source (as reported by debug.getinfo's short_src). */
+void ldb_break_add (lua_State *L, const std::string &source, int line);
+
+/** Returns false if there was no such breakpoint. */
+bool ldb_break_del (lua_State *L, const std::string &source, int line);
+
+void ldb_break_clear (lua_State *L);
+
+/** Start sampling every period seconds, keeping the last capacity samples. */
+void ldb_profiler_start (lua_State *L, float period, unsigned capacity);
+
+/** Stop sampling.  The samples are kept until the next start. */
+void ldb_profiler_stop (lua_State *L);
+
+bool ldb_profiler_running (void);
+
+/** Write the samples as folded stacks, returning the number of distinct stacks. */
+unsigned ldb_profiler_dump (const std::string &filename);
+
+struct LdbStats {
+    /** Calls of the hook, for breakpoints, stepping and sampling. */
+    unsigned long hookCalls;
+    /** Total time spent in the hook, in microseconds, not counting the client. */
+    unsigned long long hookMicros;
+    /** Breakpoints and steps that stopped in the client. */
+    unsigned long breaks;
+    /** Samples taken since the profiler was started, and how many of those were overwritten
+     * because the ring buffer was full. */
+    unsigned long samples;
+    unsigned long samplesOverwritten;
+};
+
+LdbStats ldb_stats (void);
+
+void ldb_stats_reset (void);
+
+/** Stop the profiler and detach, before the Lua state is closed. */
+void ldb_shutdown (lua_State *L);
+
+#endif
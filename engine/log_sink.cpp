@@ -0,0 +1,287 @@
+/* Copyright (c) The Grit Game Engine authors 2016
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include <centralised_log.h>
+
+#include "log_sink.h"
+#include "metrics.h"
+
+static MetricCounter *metric_written =
+    metrics_counter("grit_log_sink_written_total", "",
+                    "Messages formatted and written by the log sink's thread.");
+static MetricCounter *metric_dropped =
+    metrics_counter("grit_log_sink_dropped_total", "",
+                    "Messages dropped because the log sink's ring was full.");
+
+namespace {
+
+    // The record comes first, so a record handed out by log_sink_claim can be turned back into
+    // its slot.
+    struct Slot {
+        LogSinkRecord record;
+        // The position the slot is free to be claimed at, that plus 1 once the record has been
+        // committed, and that plus the capacity once it has been written.
+        std::atomic<unsigned long long> seq;
+    };
+
+    // The slots are never freed, so a thread still logging during shutdown does not touch freed
+    // memory.
+    Slot *slots = NULL;
+    unsigned long long mask;
+    std::atomic<unsigned long long> enqueue_pos;
+    std::atomic<unsigned long long> dequeue_pos;
+    std::atomic<bool> running(false);
+    // Threads between log_sink_claim and log_sink_commit of a slot, so shutdown can wait for them
+    // instead of losing a record committed after the last drain.
+    std::atomic<unsigned> writers(0);
+
+    // Only for the consumer thread to sleep on, the threads that log do not take it.
+    std::mutex lock;
+    std::condition_variable cvar;
+    std::condition_variable flushed_cvar;
+    std::atomic<bool> idle(false);
+    bool quit = false;
+    std::thread *consumer = NULL;
+
+    // Used instead of a slot when the consumer thread is not running.
+    thread_local LogSinkRecord direct_record;
+
+}
+
+#define SYNCHRONISED std::unique_lock<std::mutex> _scoped_lock(lock)
+
+std::string LogSinkRecord::str (void) const
+{
+    std::stringstream ss;
+    unsigned pos = 0;
+    for (const char *c = format->format ; *c != '\0' ; ++c) {
+        if (*c != '%') {
+            ss << *c;
+            continue;
+        }
+        if (c[1] == '%') {
+            ss << '%';
+            ++c;
+            continue;
+        }
+        if (pos >= size) {
+            // Missing, or dropped because the record was full.
+            ss << '%';
+            continue;
+        }
+        Type t = Type(data[pos]);
+        const char *v = &data[pos + 1];
+        switch (t) {
+            case INT: {
+                long long v2;
+                memcpy(&v2, v, sizeof v2);
+                ss << v2;
+                pos += 1 + sizeof v2;
+            }
+            break;
+            case UINT: {
+                unsigned long long v2;
+                memcpy(&v2, v, sizeof v2);
+                ss << v2;
+                pos += 1 + sizeof v2;
+            }
+            break;
+            case FLOAT: {
+                double v2;
+                memcpy(&v2, v, sizeof v2);
+                ss << v2;
+                pos += 1 + sizeof v2;
+            }
+            break;
+            case VECTOR3: {
+                float v2[3];
+                memcpy(v2, v, sizeof v2);
+                ss << "(" << v2[0] << ", " << v2[1] << ", " << v2[2] << ")";
+                pos += 1 + sizeof v2;
+            }
+            break;
+            case STRING: {
+                unsigned short len;
+                memcpy(&len, v, sizeof len);
+                ss.write(v + sizeof len, len);
+                pos += 1 + sizeof len + len;
+            }
+            break;
+        }
+    }
+    if (truncated) ss << " [truncated]";
+    return ss.str();
+}
+
+static void write_record (const LogSinkRecord &r)
+{
+    std::string line = r.str();
+    switch (r.format->level) {
+        case LOG_SINK_VERB: CVERB << line << std::endl; break;
+        case LOG_SINK_LOG: CLOG << line << std::endl; break;
+        case LOG_SINK_ERR: CERR << line << std::endl; break;
+    }
+}
+
+// Write the committed records, in order, stopping at the first that is not committed yet.
+// Returns the number written.
+static unsigned long long drain (void)
+{
+    unsigned long long pos = dequeue_pos.load(std::memory_order_relaxed);
+    unsigned long long first = pos;
+    while (true) {
+        Slot &s = slots[pos & mask];
+        if (s.seq.load(std::memory_order_acquire) != pos + 1) break;
+        write_record(s.record);
+        s.seq.store(pos + mask + 1, std::memory_order_release);
+        pos++;
+        dequeue_pos.store(pos, std::memory_order_release);
+    }
+    metric_written->inc(pos - first);
+    return pos - first;
+}
+
+static void consumer_main (void)
+{
+    unsigned long long reported_drops = metric_dropped->get();
+    while (true) {
+        unsigned long long written = drain();
+        unsigned long long drops = metric_dropped->get();
+        if (drops != reported_drops) {
+            CLOG << "Log sink was full, dropped " << (drops - reported_drops) << " messages."
+                 << std::endl;
+            reported_drops = drops;
+        }
+        if (written > 0) continue;
+        SYNCHRONISED;
+        flushed_cvar.notify_all();
+        if (quit) break;
+        idle.store(true);
+        // A wakeup can be missed, as the threads that log do not take the lock, so do not sleep
+        // for long.
+        cvar.wait_for(_scoped_lock, std::chrono::milliseconds(10));
+        idle.store(false);
+    }
+}
+
+void log_sink_init (unsigned capacity)
+{
+    if (running) return;
+    if (slots == NULL) {
+        unsigned long long n = 1;
+        while (n < capacity) n *= 2;
+        slots = new Slot[n];
+        mask = n - 1;
+        for (unsigned long long i=0 ; i<n ; ++i) slots[i].seq.store(i);
+        enqueue_pos.store(0);
+        dequeue_pos.store(0);
+    }
+    quit = false;
+    consumer = new std::thread(consumer_main);
+    running.store(true);
+}
+
+void log_sink_shutdown (void)
+{
+    if (!running) return;
+    running.store(false);
+    {
+        SYNCHRONISED;
+        quit = true;
+    }
+    cvar.notify_one();
+    consumer->join();
+    delete consumer;
+    consumer = NULL;
+    // Anything committed since the thread stopped, or still being written by threads that
+    // claimed a slot before running was cleared.  Any later claim writes directly.
+    while (writers.load() > 0 || dequeue_pos.load() != enqueue_pos.load()) {
+        if (drain() == 0) std::this_thread::yield();
+    }
+}
+
+void log_sink_flush (void)
+{
+    if (!running) return;
+    unsigned long long target = enqueue_pos.load();
+    SYNCHRONISED;
+    while (dequeue_pos.load() < target) {
+        cvar.notify_one();
+        flushed_cvar.wait_for(_scoped_lock, std::chrono::milliseconds(1));
+    }
+}
+
+void log_sink_stats (unsigned long long &queued, unsigned long long &written,
+                     unsigned long long &dropped)
+{
+    queued = enqueue_pos.load() - dequeue_pos.load();
+    written = metric_written->get();
+    dropped = metric_dropped->get();
+}
+
+LogSinkRecord *log_sink_claim (const LogSinkFormat &format)
+{
+    // Counted before checking running, so either shutdown waits for this thread or this thread
+    // sees that the sink has stopped.
+    writers.fetch_add(1);
+    if (!running.load()) {
+        writers.fetch_sub(1);
+        direct_record.reset(format);
+        return &direct_record;
+    }
+    unsigned long long pos = enqueue_pos.load(std::memory_order_relaxed);
+    while (true) {
+        Slot &s = slots[pos & mask];
+        unsigned long long seq = s.seq.load(std::memory_order_acquire);
+        if (seq == pos) {
+            if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                s.record.reset(format);
+                return &s.record;
+            }
+        } else if (seq < pos) {
+            // Not written yet since the last time round the ring.
+            metric_dropped->inc();
+            writers.fetch_sub(1, std::memory_order_release);
+            return NULL;
+        } else {
+            pos = enqueue_pos.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void log_sink_commit (LogSinkRecord *record)
+{
+    if (record == &direct_record) {
+        write_record(*record);
+        return;
+    }
+    Slot *s = reinterpret_cast<Slot*>(record);
+    s->seq.store(s->seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    writers.fetch_sub(1, std::memory_order_release);
+    if (idle.load(std::memory_order_relaxed)) cvar.notify_one();
+}
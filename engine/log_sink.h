@@ -0,0 +1,202 @@
+/* Copyright (c) The Grit Game Engine authors 2016
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef LogSink_h
+#define LogSink_h
+
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+#include <math_util.h>
+
+/** \file
+ *
+ * A sink for log messages that are written too often to format on the spot, e.g. the verbose
+ * modes that report every resource load, every reference count change, or every physics contact.
+ * The thread that logs does not format anything or take any lock: it copies the format (a
+ * pointer to a static) and the arguments into a fixed size record in a bounded ring.  A consumer
+ * thread formats the records and writes them to the centralised log, as CVERB, CLOG or CERR.
+ *
+ * If the ring is full, the message is dropped, counted, and the consumer reports how many were
+ * dropped once it catches up.  So the memory is bounded and a verbose mode costs little more
+ * than a copy, whether or not anything is reading the log.
+ *
+ * Each % in the format is replaced by the next argument, formatted as an iostream would
+ * (%% is a %).  Arguments can be integers, floating point numbers, strings and Vector3.  Strings
+ * are copied, and cut short if the record is full.
+ *
+ * Messages from one thread are written in order, but may come after messages that thread wrote
+ * directly with CVERB, CLOG or CERR later.  Until log_sink_init and after log_sink_shutdown,
+ * messages are formatted and written directly by the thread that logs.
+ */
+
+enum LogSinkLevel {
+    LOG_SINK_VERB,
+    LOG_SINK_LOG,
+    LOG_SINK_ERR
+};
+
+/** A format and the level it is written at.  Records refer to it by address, so it must outlive
+ * the sink; the LOG_SINK macro keeps it in a static at the call site. */
+struct LogSinkFormat {
+    LogSinkLevel level;
+    const char *format;
+    LogSinkFormat (LogSinkLevel level, const char *format) : level(level), format(format) { }
+};
+
+static const unsigned LOG_SINK_RECORD_DATA = 240;
+
+/** A format and its arguments.  Each argument is a type byte followed by its value. */
+class LogSinkRecord {
+
+    public:
+
+    enum Type {
+        INT,
+        UINT,
+        FLOAT,
+        STRING,
+        VECTOR3
+    };
+
+    const LogSinkFormat *format;
+    unsigned short size;
+    bool truncated;
+    char data[LOG_SINK_RECORD_DATA];
+
+    void reset (const LogSinkFormat &f)
+    {
+        format = &f;
+        size = 0;
+        truncated = false;
+    }
+
+    template<class T>
+    typename std::enable_if<std::is_integral<T>::value>::type add (T v)
+    {
+        if (std::is_signed<T>::value) {
+            long long v2 = v;
+            addRaw(INT, &v2, sizeof v2);
+        } else {
+            unsigned long long v2 = v;
+            addRaw(UINT, &v2, sizeof v2);
+        }
+    }
+
+    template<class T>
+    typename std::enable_if<std::is_floating_point<T>::value>::type add (T v)
+    {
+        double v2 = v;
+        addRaw(FLOAT, &v2, sizeof v2);
+    }
+
+    void add (const Vector3 &v)
+    {
+        float v2[3] = { v.x, v.y, v.z };
+        addRaw(VECTOR3, v2, sizeof v2);
+    }
+
+    void add (const char *s)
+    {
+        addString(s, strlen(s));
+    }
+
+    void add (const std::string &s)
+    {
+        addString(s.data(), s.length());
+    }
+
+    /** Format the record as the CVERB etc. would have. */
+    std::string str (void) const;
+
+    private:
+
+    void addRaw (Type t, const void *v, unsigned bytes)
+    {
+        if (truncated || size + 1 + bytes > LOG_SINK_RECORD_DATA) {
+            truncated = true;
+            return;
+        }
+        data[size] = char(t);
+        memcpy(&data[size + 1], v, bytes);
+        size += 1 + bytes;
+    }
+
+    void addString (const char *s, size_t len)
+    {
+        unsigned short header = 1 + sizeof(unsigned short);
+        if (truncated || size + header > LOG_SINK_RECORD_DATA) {
+            truncated = true;
+            return;
+        }
+        size_t room = LOG_SINK_RECORD_DATA - size - header;
+        if (len > room) {
+            len = room;
+            truncated = true;
+        }
+        unsigned short len2 = len;
+        data[size] = char(STRING);
+        memcpy(&data[size + 1], &len2, sizeof len2);
+        memcpy(&data[size + header], s, len);
+        size += header + len;
+    }
+};
+
+/** Start the consumer thread, with room for the given number of records (rounded up to a power
+ * of 2).  Each takes 256 bytes. */
+void log_sink_init (unsigned capacity = 4096);
+
+/** Write what is left and stop the consumer thread. */
+void log_sink_shutdown (void);
+
+/** Wait until everything logged so far has been written. */
+void log_sink_flush (void);
+
+/** Records waiting to be written, written, and dropped because the ring was full. */
+void log_sink_stats (unsigned long long &queued, unsigned long long &written,
+                     unsigned long long &dropped);
+
+/** A record to fill in, or NULL if the ring is full.  Must be followed by log_sink_commit. */
+LogSinkRecord *log_sink_claim (const LogSinkFormat &format);
+
+/** Pass the record to the consumer thread. */
+void log_sink_commit (LogSinkRecord *record);
+
+template<class... Args>
+void log_sink_write (const LogSinkFormat &format, const Args &... args)
+{
+    LogSinkRecord *r = log_sink_claim(format);
+    if (r == NULL) return;
+    int unused[] = { 0, (r->add(args), 0)... };
+    (void) unused;
+    log_sink_commit(r);
+}
+
+/** e.g. LOG_SINK(LOG_SINK_VERB, "LOAD %", getName()); */
+#define LOG_SINK(level, format, ...) \
+    do { \
+        static const LogSinkFormat _log_sink_format(level, format); \
+        log_sink_write(_log_sink_format, __VA_ARGS__); \
+    } while (0)
+
+#endif
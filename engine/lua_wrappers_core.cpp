@@ -40,21 +40,27 @@
 #include <centralised_log.h>
 #include "clipboard.h"
 #include "core_option.h"
+#include "error_aggregate.h"
+#include "frame_allocator.h"
 #include "gfx/gfx_disk_resource.h"
 #include "gfx/lua_wrappers_gfx.h"
 #include "grit_lua_util.h"
 #include "input_filter.h"
 #include "joystick.h"
 #include "keyboard.h"
+#include "ldbglue.h"
+#include "log_sink.h"
 #include "lua_wrappers_disk_resource.h"
 #include "lua_wrappers_gritobj.h"
 #include "lua_wrappers_primitives.h"
 #include "main.h"
+#include "metrics.h"
 #include "mouse.h"
 #include "navigation/lua_wrappers_navigation.h"
 #include "net/lua_wrappers_net.h"
 #include "path_util.h"
 #include "physics/lua_wrappers_physics.h"
+#include "script_tasks.h"
 
 #define IFILTER_TAG "Grit/InputFilter"
 
@@ -486,6 +492,203 @@ TRY_START
 TRY_END
 }
 
+static int global_frame_arena_stats (lua_State *L)
+{
+TRY_START
+    check_args(L, 0);
+    const FrameArena &arena = frame_arena();
+    lua_pushnumber(L, arena.getCapacity());
+    lua_pushnumber(L, arena.getUsed());
+    lua_pushnumber(L, arena.getLastHighWater());
+    lua_pushnumber(L, arena.getMaxHighWater());
+    lua_pushnumber(L, arena.getOverflows());
+    return 5;
+TRY_END
+}
+
+static int global_frame_arena_end_frame (lua_State *L)
+{
+TRY_START
+    check_args(L, 0);
+    frame_arena_end_frame();
+    return 0;
+TRY_END
+}
+
+static int global_heap_allocations (lua_State *L)
+{
+TRY_START
+    check_args(L, 0);
+    #ifdef USE_HEAP_COUNT
+        lua_pushnumber(L, heap_allocations());
+    #else
+        // Not counted in this build.
+        lua_pushnil(L);
+    #endif
+    return 1;
+TRY_END
+}
+
+static Metric *check_metric (lua_State *L)
+{
+    std::string name = check_string(L, 1);
+    std::string labels = lua_gettop(L) >= 2 ? check_string(L, 2) : "";
+    Metric *m = metrics_get(name, labels);
+    if (m == NULL) my_lua_error(L, "No such metric: " + name + "{" + labels + "}");
+    return m;
+}
+
+static int global_metrics_all (lua_State *L)
+{
+TRY_START
+    check_args(L, 0);
+    std::vector<Metric*> all = metrics_all();
+    lua_createtable(L, all.size(), 0);
+    for (unsigned i=0 ; i<all.size() ; ++i) {
+        lua_createtable(L, 3, 0);
+        lua_pushstring(L, all[i]->name.c_str());
+        lua_rawseti(L, -2, 1);
+        lua_pushstring(L, all[i]->labels.c_str());
+        lua_rawseti(L, -2, 2);
+        const char *type = all[i]->type == Metric::COUNTER ? "COUNTER"
+                         : all[i]->type == Metric::GAUGE ? "GAUGE" : "HISTOGRAM";
+        lua_pushstring(L, type);
+        lua_rawseti(L, -2, 3);
+        lua_rawseti(L, -2, i + 1);
+    }
+    return 1;
+TRY_END
+}
+
+static int global_metrics_value (lua_State *L)
+{
+TRY_START
+    if (lua_gettop(L) != 1) check_args(L, 2);
+    Metric *m = check_metric(L);
+    switch (m->type) {
+        case Metric::COUNTER:
+        lua_pushnumber(L, static_cast<MetricCounter*>(m)->get());
+        return 1;
+
+        case Metric::GAUGE:
+        lua_pushnumber(L, static_cast<MetricGauge*>(m)->get());
+        return 1;
+
+        case Metric::HISTOGRAM: {
+            std::vector<unsigned long long> counts;
+            unsigned long long count;
+            double sum;
+            static_cast<MetricHistogram*>(m)->get(counts, count, sum);
+            lua_pushnumber(L, count);
+            lua_pushnumber(L, sum);
+            return 2;
+        }
+    }
+    return 0;
+TRY_END
+}
+
+static int global_metrics_history (lua_State *L)
+{
+TRY_START
+    if (lua_gettop(L) != 1) check_args(L, 2);
+    Metric *m = check_metric(L);
+    std::vector<float> history;
+    m->getHistory(history);
+    lua_createtable(L, history.size(), 0);
+    for (unsigned i=0 ; i<history.size() ; ++i) {
+        lua_pushnumber(L, history[i]);
+        lua_rawseti(L, -2, i + 1);
+    }
+    return 1;
+TRY_END
+}
+
+static int global_metrics_frame (lua_State *L)
+{
+TRY_START
+    check_args(L, 0);
+    metrics_frame();
+    return 0;
+TRY_END
+}
+
+static int global_metrics_write (lua_State *L)
+{
+TRY_START
+    check_args(L, 1);
+    std::string filename = check_string(L, 1);
+    metrics_write(filename);
+    return 0;
+TRY_END
+}
+
+static int global_log_sink_stats (lua_State *L)
+{
+TRY_START
+    check_args(L, 0);
+    unsigned long long queued, written, dropped;
+    log_sink_stats(queued, written, dropped);
+    lua_pushnumber(L, queued);
+    lua_pushnumber(L, written);
+    lua_pushnumber(L, dropped);
+    return 3;
+TRY_END
+}
+
+static int global_log_sink_flush (lua_State *L)
+{
+TRY_START
+    check_args(L, 0);
+    log_sink_flush();
+    return 0;
+TRY_END
+}
+
+static int global_error_aggregate_all (lua_State *L)
+{
+TRY_START
+    check_args(L, 0);
+    std::vector<ErrorAggregate> all = error_aggregate_all();
+    lua_createtable(L, all.size(), 0);
+    for (unsigned i=0 ; i<all.size() ; ++i) {
+        lua_createtable(L, 0, 6);
+        lua_pushstring(L, all[i].site.c_str());
+        lua_setfield(L, -2, "site");
+        lua_pushstring(L, all[i].key.c_str());
+        lua_setfield(L, -2, "key");
+        lua_pushnumber(L, all[i].count);
+        lua_setfield(L, -2, "count");
+        lua_pushnumber(L, all[i].suppressed);
+        lua_setfield(L, -2, "suppressed");
+        lua_pushnumber(L, all[i].sinceFirst);
+        lua_setfield(L, -2, "sinceFirst");
+        lua_pushnumber(L, all[i].sinceLast);
+        lua_setfield(L, -2, "sinceLast");
+        lua_rawseti(L, -2, i + 1);
+    }
+    return 1;
+TRY_END
+}
+
+static int global_error_aggregate_flush (lua_State *L)
+{
+TRY_START
+    check_args(L, 0);
+    error_aggregate_flush();
+    return 0;
+TRY_END
+}
+
+static int global_error_aggregate_clear (lua_State *L)
+{
+TRY_START
+    check_args(L, 0);
+    error_aggregate_clear();
+    return 0;
+TRY_END
+}
+
 static int global_get_in_queue_size (lua_State *L)
 {
 TRY_START
@@ -670,6 +873,14 @@ TRY_START
 TRY_END
 }
 
+static int global_console_error_handler (lua_State *L)
+{
+TRY_START
+    my_lua_console_error_handler(L);
+    return 0;
+TRY_END
+}
+
 
 static int global_print (lua_State *L)
 {
@@ -1129,6 +1340,214 @@ TRY_END
 }
 
 
+static int global_task_spawn (lua_State *L)
+{
+TRY_START
+    if (lua_gettop(L) == 1) lua_pushstring(L, "NORMAL");
+    if (lua_gettop(L) == 2) lua_pushstring(L, "");
+    check_args(L, 3);
+    if (!lua_isfunction(L, 1)) my_lua_error(L, "Argument 1 must be a function.");
+    std::string pstr = check_string(L, 2);
+    std::string name = check_string(L, 3);
+    ScriptTaskPriority priority;
+    if (!script_task_priority_from_string(pstr, priority))
+        my_lua_error(L, "Unrecognised task priority: \"" + pstr + "\"");
+    lua_settop(L, 1);
+    lua_pushnumber(L, script_task_spawn(L, name, priority));
+    return 1;
+TRY_END
+}
+
+static int global_task_kill (lua_State *L)
+{
+TRY_START
+    check_args(L, 1);
+    unsigned id = check_t<unsigned>(L, 1);
+    lua_pushboolean(L, script_task_kill(id));
+    return 1;
+TRY_END
+}
+
+static int global_task_all (lua_State *L)
+{
+TRY_START
+    check_args(L, 0);
+    std::vector<unsigned> ids = script_task_all();
+    lua_createtable(L, ids.size(), 0);
+    for (unsigned i=0 ; i<ids.size() ; ++i) {
+        lua_pushnumber(L, ids[i]);
+        lua_rawseti(L, -2, i + 1);
+    }
+    return 1;
+TRY_END
+}
+
+static int global_task_stats (lua_State *L)
+{
+TRY_START
+    check_args(L, 1);
+    unsigned id = check_t<unsigned>(L, 1);
+    ScriptTaskStats s;
+    if (!script_task_stats(id, s)) {
+        lua_pushnil(L);
+        return 1;
+    }
+    lua_pushstring(L, s.name.c_str());
+    lua_pushstring(L, script_task_priority_to_string(s.priority).c_str());
+    lua_pushnumber(L, s.cpuTime / 1E6);
+    lua_pushnumber(L, s.maxSlice / 1E6);
+    lua_pushnumber(L, s.resumes);
+    lua_pushnumber(L, s.starvedFrames);
+    lua_pushnumber(L, s.maxStarvedFrames);
+    return 7;
+TRY_END
+}
+
+static int global_clear_tasks (lua_State *L)
+{
+TRY_START
+    check_args(L, 0);
+    script_task_kill_all();
+    return 0;
+TRY_END
+}
+
+static int global_do_tasks (lua_State *L)
+{
+TRY_START
+    check_args(L, 1);
+    float budget = check_float(L, 1);
+    script_tasks_do_frame(L, budget);
+    return 0;
+TRY_END
+}
+
+static int global_debugger_attach (lua_State *L)
+{
+TRY_START
+    if (lua_gettop(L) == 0) lua_pushnil(L);
+    check_args(L, 1);
+    if (!lua_isnil(L, 1) && !lua_isfunction(L, 1))
+        my_lua_error(L, "Debugger client must be a function or nil.");
+    ldb_attach(L);
+    return 0;
+TRY_END
+}
+
+static int global_debugger_detach (lua_State *L)
+{
+TRY_START
+    check_args(L, 0);
+    ldb_detach(L);
+    return 0;
+TRY_END
+}
+
+static int global_debugger_attached (lua_State *L)
+{
+TRY_START
+    check_args(L, 0);
+    lua_pushboolean(L, ldb_attached());
+    return 1;
+TRY_END
+}
+
+static int global_debugger_break_add (lua_State *L)
+{
+TRY_START
+    check_args(L, 2);
+    std::string source = check_string(L, 1);
+    int line = check_t<int>(L, 2);
+    ldb_break_add(L, source, line);
+    return 0;
+TRY_END
+}
+
+static int global_debugger_break_del (lua_State *L)
+{
+TRY_START
+    check_args(L, 2);
+    std::string source = check_string(L, 1);
+    int line = check_t<int>(L, 2);
+    lua_pushboolean(L, ldb_break_del(L, source, line));
+    return 1;
+TRY_END
+}
+
+static int global_debugger_break_clear (lua_State *L)
+{
+TRY_START
+    check_args(L, 0);
+    ldb_break_clear(L);
+    return 0;
+TRY_END
+}
+
+static int global_debugger_stats (lua_State *L)
+{
+TRY_START
+    check_args(L, 0);
+    LdbStats s = ldb_stats();
+    lua_pushnumber(L, s.hookCalls);
+    lua_pushnumber(L, s.hookMicros);
+    lua_pushnumber(L, s.breaks);
+    lua_pushnumber(L, s.samples);
+    lua_pushnumber(L, s.samplesOverwritten);
+    return 5;
+TRY_END
+}
+
+static int global_debugger_stats_reset (lua_State *L)
+{
+TRY_START
+    check_args(L, 0);
+    ldb_stats_reset();
+    return 0;
+TRY_END
+}
+
+static int global_lua_profiler_start (lua_State *L)
+{
+TRY_START
+    if (lua_gettop(L) == 1) lua_pushnumber(L, 10000);
+    check_args(L, 2);
+    float period = check_float(L, 1);
+    unsigned capacity = check_t<unsigned>(L, 2, 1, 10000000);
+    if (!(period > 0)) my_lua_error(L, "Sampling period must be positive.");
+    ldb_profiler_start(L, period, capacity);
+    return 0;
+TRY_END
+}
+
+static int global_lua_profiler_stop (lua_State *L)
+{
+TRY_START
+    check_args(L, 0);
+    ldb_profiler_stop(L);
+    return 0;
+TRY_END
+}
+
+static int global_lua_profiler_running (lua_State *L)
+{
+TRY_START
+    check_args(L, 0);
+    lua_pushboolean(L, ldb_profiler_running());
+    return 1;
+TRY_END
+}
+
+static int global_lua_profiler_dump (lua_State *L)
+{
+TRY_START
+    check_args(L, 1);
+    std::string filename = check_string(L, 1);
+    lua_pushnumber(L, ldb_profiler_dump(filename));
+    return 1;
+TRY_END
+}
+
+
 
 static const luaL_reg global[] = {
 
@@ -1140,6 +1559,7 @@ static const luaL_reg global[] = {
     {"current_dir", global_current_dir},
     {"error", global_error},
     {"error_handler", global_error_handler},
+    {"console_error_handler", global_console_error_handler},
     {"print", global_print},
     {"console_poll", global_console_poll},
     {"check_nan", global_check_nan},
@@ -1165,6 +1585,22 @@ static const luaL_reg global[] = {
     {"get_alloc_stats", global_get_alloc_stats},
     {"set_alloc_stats", global_set_alloc_stats},
     {"reset_alloc_stats", global_reset_alloc_stats},
+    {"frame_arena_stats", global_frame_arena_stats},
+    {"frame_arena_end_frame", global_frame_arena_end_frame},
+    {"heap_allocations", global_heap_allocations},
+
+    {"metrics_all", global_metrics_all},
+    {"metrics_value", global_metrics_value},
+    {"metrics_history", global_metrics_history},
+    {"metrics_frame", global_metrics_frame},
+    {"metrics_write", global_metrics_write},
+
+    {"log_sink_stats", global_log_sink_stats},
+    {"log_sink_flush", global_log_sink_flush},
+
+    {"error_aggregate_all", global_error_aggregate_all},
+    {"error_aggregate_flush", global_error_aggregate_flush},
+    {"error_aggregate_clear", global_error_aggregate_clear},
 
     {"get_in_queue_size", global_get_in_queue_size},
     {"get_out_queue_size_gpu", global_get_out_queue_size_gpu},
@@ -1198,6 +1634,26 @@ static const luaL_reg global[] = {
     {"dump_events", global_dump_events},
     {"do_events", global_do_events},
 
+    {"task_spawn", global_task_spawn},
+    {"task_kill", global_task_kill},
+    {"task_all", global_task_all},
+    {"task_stats", global_task_stats},
+    {"clear_tasks", global_clear_tasks},
+    {"do_tasks", global_do_tasks},
+
+    {"debugger_attach", global_debugger_attach},
+    {"debugger_detach", global_debugger_detach},
+    {"debugger_attached", global_debugger_attached},
+    {"debugger_break_add", global_debugger_break_add},
+    {"debugger_break_del", global_debugger_break_del},
+    {"debugger_break_clear", global_debugger_break_clear},
+    {"debugger_stats", global_debugger_stats},
+    {"debugger_stats_reset", global_debugger_stats_reset},
+    {"lua_profiler_start", global_lua_profiler_start},
+    {"lua_profiler_stop", global_lua_profiler_stop},
+    {"lua_profiler_running", global_lua_profiler_running},
+    {"lua_profiler_dump", global_lua_profiler_dump},
+
     {NULL, NULL}
 };
 
@@ -1272,6 +1728,7 @@ void init_lua (const char *filename, const std::vector<std::string> &args, lua_S
 
 void shutdown_lua (lua_State *L)
 {
+    ldb_shutdown(L);
     lua_close(L);
     func_map_leak_all();
 }
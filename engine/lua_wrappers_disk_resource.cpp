@@ -19,9 +19,12 @@
  * THE SOFTWARE.
  */
 
+#include "async_io.h"
 #include "grit_lua_util.h"
+#include "host_cache.h"
 #include "lua_wrappers_disk_resource.h"
 #include "main.h"
+#include "resource_manifest.h"
 
 #include "gfx/gfx_disk_resource.h"
 
@@ -322,6 +325,219 @@ TRY_END
 
 
 
+static int global_resource_manifest_get (lua_State *L)
+{
+TRY_START
+    check_args(L, 1);
+    std::string key = check_path(L, 1);
+    ResourceManifest m;
+    if (!resource_manifest_get(key, m)) {
+        lua_pushnil(L);
+        return 1;
+    }
+    lua_createtable(L, m.files.size(), 0);
+    for (unsigned i=0 ; i<m.files.size() ; ++i) {
+        lua_createtable(L, 2, 0);
+        lua_pushstring(L, m.files[i].name.c_str());
+        lua_rawseti(L, -2, 1);
+        lua_pushnumber(L, m.files[i].size);
+        lua_rawseti(L, -2, 2);
+        lua_rawseti(L, -2, i + 1);
+    }
+    return 1;
+TRY_END
+}
+
+static int global_resource_manifest_count (lua_State *L)
+{
+TRY_START
+    check_args(L, 0);
+    lua_pushnumber(L, resource_manifest_count());
+    return 1;
+TRY_END
+}
+
+static int global_resource_manifest_clear (lua_State *L)
+{
+TRY_START
+    check_args(L, 0);
+    resource_manifest_clear();
+    return 0;
+TRY_END
+}
+
+static int global_resource_manifest_save (lua_State *L)
+{
+TRY_START
+    check_args(L, 1);
+    resource_manifest_save(check_string(L, 1));
+    return 0;
+TRY_END
+}
+
+static int global_resource_manifest_load (lua_State *L)
+{
+TRY_START
+    check_args(L, 1);
+    resource_manifest_load(check_string(L, 1));
+    return 0;
+TRY_END
+}
+
+
+
+static int global_async_io_get_backend (lua_State *L)
+{
+TRY_START
+    check_args(L, 0);
+    lua_pushstring(L, async_io_backend_name(async_io_backend()));
+    return 1;
+TRY_END
+}
+
+static int global_async_io_set_backend (lua_State *L)
+{
+TRY_START
+    check_args(L, 1);
+    std::string name = check_string(L, 1);
+    AsyncIOBackend b = ASYNC_IO_OFF;
+    if (name == "threads") {
+        b = ASYNC_IO_THREADS;
+    } else if (name == "io_uring") {
+        b = ASYNC_IO_URING;
+    } else if (name != "off") {
+        my_lua_error(L, "Unknown async I/O backend: \"" + name + "\"");
+    }
+    lua_pushboolean(L, async_io_set_backend(b));
+    return 1;
+TRY_END
+}
+
+static int global_async_io_get_depth (lua_State *L)
+{
+TRY_START
+    check_args(L, 0);
+    lua_pushnumber(L, async_io_get_depth());
+    return 1;
+TRY_END
+}
+
+static int global_async_io_set_depth (lua_State *L)
+{
+TRY_START
+    check_args(L, 1);
+    async_io_set_depth(check_int(L, 1, 1, 256));
+    return 0;
+TRY_END
+}
+
+static int global_async_io_get_budget (lua_State *L)
+{
+TRY_START
+    check_args(L, 0);
+    lua_pushnumber(L, async_io_get_budget());
+    return 1;
+TRY_END
+}
+
+static int global_async_io_set_budget (lua_State *L)
+{
+TRY_START
+    check_args(L, 1);
+    async_io_set_budget(check_t<unsigned long long>(L, 1));
+    return 0;
+TRY_END
+}
+
+static int global_async_io_stats (lua_State *L)
+{
+TRY_START
+    check_args(L, 0);
+    unsigned queued, in_flight, done;
+    unsigned long long bytes;
+    async_io_stats(queued, in_flight, done, bytes);
+    lua_pushnumber(L, queued);
+    lua_pushnumber(L, in_flight);
+    lua_pushnumber(L, done);
+    lua_pushnumber(L, bytes);
+    return 4;
+TRY_END
+}
+
+static int global_async_io_drop_cache (lua_State *L)
+{
+TRY_START
+    check_args(L, 1);
+    lua_pushboolean(L, async_io_drop_cache(check_path(L, 1)));
+    return 1;
+TRY_END
+}
+
+// Read the files all at once, e.g. to benchmark the backend.  Returns the number of bytes read.
+static int global_async_io_read_all (lua_State *L)
+{
+TRY_START
+    check_args(L, 1);
+    int table = lua_gettop(L);
+    if (!lua_istable(L, table))
+        my_lua_error(L, "Parameter should be a table");
+    std::vector<std::string> names;
+    for (lua_pushnil(L) ; lua_next(L, table) != 0 ; lua_pop(L, 1)) {
+        names.push_back(check_path(L, -1));
+    }
+    static const char owner = 0;
+    for (unsigned i=0 ; i<names.size() ; ++i) async_io_read(names[i], 0, &owner);
+    async_io_wait();
+    unsigned long long bytes = 0;
+    for (unsigned i=0 ; i<names.size() ; ++i) {
+        auto data = async_io_get(names[i]);
+        if (data == nullptr) {
+            async_io_cancel(&owner);
+            my_lua_error(L, "Could not read: \"" + names[i] + "\"");
+        }
+        bytes += data->size();
+    }
+    async_io_cancel(&owner);
+    lua_pushnumber(L, bytes);
+    return 1;
+TRY_END
+}
+
+
+static int global_host_cache_stats (lua_State *L)
+{
+TRY_START
+    check_args(L, 0);
+    unsigned files;
+    unsigned long long compressed, raw;
+    host_cache_stats(files, compressed, raw);
+    lua_pushnumber(L, files);
+    lua_pushnumber(L, compressed);
+    lua_pushnumber(L, raw);
+    return 3;
+TRY_END
+}
+
+static int global_host_cache_clear (lua_State *L)
+{
+TRY_START
+    check_args(L, 0);
+    host_cache_clear();
+    return 0;
+TRY_END
+}
+
+static int global_host_cache_flush (lua_State *L)
+{
+TRY_START
+    check_args(L, 0);
+    host_cache_flush();
+    return 0;
+TRY_END
+}
+
+
+
 static const luaL_reg global[] = {
 
     // global flags
@@ -351,6 +567,26 @@ static const luaL_reg global[] = {
 
     {"disk_resource_check", global_disk_resource_check},
 
+    {"resource_manifest_get", global_resource_manifest_get},
+    {"resource_manifest_count", global_resource_manifest_count},
+    {"resource_manifest_clear", global_resource_manifest_clear},
+    {"resource_manifest_save", global_resource_manifest_save},
+    {"resource_manifest_load", global_resource_manifest_load},
+
+    {"async_io_get_backend", global_async_io_get_backend},
+    {"async_io_set_backend", global_async_io_set_backend},
+    {"async_io_get_depth", global_async_io_get_depth},
+    {"async_io_set_depth", global_async_io_set_depth},
+    {"async_io_get_budget", global_async_io_get_budget},
+    {"async_io_set_budget", global_async_io_set_budget},
+    {"async_io_stats", global_async_io_stats},
+    {"async_io_drop_cache", global_async_io_drop_cache},
+    {"async_io_read_all", global_async_io_read_all},
+
+    {"host_cache_stats", global_host_cache_stats},
+    {"host_cache_clear", global_host_cache_clear},
+    {"host_cache_flush", global_host_cache_flush},
+
     {"host_ram_available", global_host_ram_available},
     {"host_ram_used", global_host_ram_used},
 
@@ -26,6 +26,7 @@
 #include "lua_wrappers_primitives.h"
 #include "main.h"
 #include "path_util.h"
+#include "world_snapshot.h"
 
 
 // GRIT CLASS ============================================================= {{{
@@ -416,6 +417,21 @@ TRY_START
 TRY_END
 }
 
+static int global_class_streaming_stats (lua_State *L)
+{
+TRY_START
+    check_args(L, 1);
+    std::string name = check_path(L, 1);
+    const GritClass::StreamingStats &stats = class_get(name)->streamingStats;
+    lua_pushnumber(L, stats.activations);
+    lua_pushnumber(L, stats.deactivations);
+    lua_pushnumber(L, stats.parks);
+    lua_pushnumber(L, stats.revivals);
+    lua_pushnumber(L, stats.thrashes);
+    return 5;
+TRY_END
+}
+
 static int global_class_all (lua_State *L)
 {
 TRY_START
@@ -459,7 +475,7 @@ TRY_START
     if (lua_isnil(L, -1)) {
         lua_pop(L, 1);
         // Otherwise, use class.
-        o->getClass()->get(L, "renderingDistance");
+        o->getClass()->get(L, GRIT_CLASS_SLOT_RENDERING_DISTANCE);
         if (lua_isnil(L, -1)) {
             object_del(L, o);
             my_lua_error(L, "no renderingDistance in class \""
@@ -702,6 +718,26 @@ TRY_END
 }
 
 
+static int global_world_snapshot_save (lua_State *L)
+{
+TRY_START
+    check_args(L, 1);
+    std::string filename = check_string(L, 1);
+    lua_pushnumber(L, world_snapshot_save(filename));
+    return 1;
+TRY_END
+}
+
+static int global_world_snapshot_load (lua_State *L)
+{
+TRY_START
+    check_args(L, 1);
+    std::string filename = check_string(L, 1);
+    lua_pushnumber(L, world_snapshot_load(L, filename));
+    return 1;
+TRY_END
+}
+
 
 static const luaL_reg global[] = {
     {"streamer_centre", global_streamer_centre},
@@ -713,6 +749,7 @@ static const luaL_reg global[] = {
     {"class_has", global_class_has},
     {"class_all", global_class_all},
     {"class_count", global_class_count},
+    {"class_streaming_stats", global_class_streaming_stats},
     {"object_add", global_object_add},
     {"object_del", global_object_del},
     {"object_all_del", global_object_all_del},
@@ -727,6 +764,8 @@ static const luaL_reg global[] = {
     {"object_all_deactivate", global_object_all_deactivate},
     {"object_do_frame_callbacks", global_object_do_frame_callbacks},
     {"object_do_step_callbacks", global_object_do_step_callbacks},
+    {"world_snapshot_save", global_world_snapshot_save},
+    {"world_snapshot_load", global_world_snapshot_load},
     {NULL, NULL}
 };
 
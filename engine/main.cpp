@@ -21,6 +21,8 @@
 
 //#include <fenv.h>
 #include <cerrno>
+#include <functional>
+#include <future>
 #include <sstream>
 
 #ifdef WIN32
@@ -37,11 +39,17 @@
 #  include "linux/joystick_devjs.h"
 #endif
 
+#include "async_io.h"
 #include "clipboard.h"
 
 #include <centralised_log.h>
+#include <sleep.h>
+
 #include "core_option.h"
+#include "error_aggregate.h"
 #include "grit_lua_util.h"
+#include "host_cache.h"
+#include "log_sink.h"
 #include "lua_wrappers_core.h"
 #include "main.h"
 
@@ -92,9 +100,43 @@ void app_fatal()
         gfx_shutdown();
     }
 
+    log_sink_flush();
     abort();
 }
 
+/** Time taken by each stage of startup, reported once everything is initialised. */
+struct InitStage {
+    std::string name;
+    unsigned long long micros;
+};
+static std::vector<InitStage> init_stages;
+
+static unsigned long long time_init_stage (const std::function<void(void)> &f)
+{
+    unsigned long long before = micros();
+    f();
+    return micros() - before;
+}
+
+/** Run an initialisation stage in the calling thread. */
+static void init_stage (const std::string &name, const std::function<void(void)> &f)
+{
+    init_stages.push_back(InitStage{name, time_init_stage(f)});
+}
+
+/** Start an initialisation stage in another thread.  It must not need the graphics (or anything
+ * else not yet initialised), and nothing may use the subsystem until init_stage_wait. */
+static std::future<unsigned long long> init_stage_async (const std::function<void(void)> &f)
+{
+    return std::async(std::launch::async, time_init_stage, f);
+}
+
+/** Wait for a stage started with init_stage_async, rethrowing any error it raised. */
+static void init_stage_wait (const std::string &name, std::future<unsigned long long> &stage)
+{
+    init_stages.push_back(InitStage{name + " (parallel)", stage.get()});
+}
+
 int main (int argc, const char **argv)
 {
     #ifdef WIN32
@@ -123,37 +165,63 @@ int main (int argc, const char **argv)
         // feenableexcept(FE_DIVBYZERO | FE_INVALID);
         // #endif
 
-        bgl = new BackgroundLoader();
-
-        size_t winid = gfx_init(cb);
-
-        debug_drawer = new BulletDebugDrawer(); // FIXME: hack
-
-        #ifdef WIN32
-        mouse = new MouseDirectInput8(winid);
-        bool use_dinput = getenv("GRIT_DINPUT")!=NULL;
-        keyboard = use_dinput ? (Keyboard *)new KeyboardDirectInput8(winid)
-                      : (Keyboard *)new KeyboardWinAPI(winid);
-        joystick = new JoystickDirectInput8(winid);
-        #else
-        mouse = new MouseX11(winid);
-        keyboard = new KeyboardX11(winid);
-        joystick = new JoystickDevjs(winid);
-        #endif
-
-        clipboard_init();
+        unsigned long long startup_before = micros();
 
-        physics_init();
-
-        net_init();
-
-        core_option_init();
-        streamer_init();
-
-        navigation_init();
+        // Before anything that could log, as the other stages start threads.
+        log_sink_init();
 
+        // These need neither the window nor each other, so get them going while the graphics
+        // initialise, which takes the longest.
+        auto physics_stage = init_stage_async(physics_init);
+        auto net_stage = init_stage_async(net_init);
+        auto navigation_stage = init_stage_async(navigation_init);
         // audio_init(getenv("GRIT_AUDIO_DEV"));
-        audio_init(NULL);
+        auto audio_stage = init_stage_async([] { audio_init(NULL); });
+
+        init_stage("background loader", [] {
+            async_io_init();
+            host_cache_init();
+            bgl = new BackgroundLoader();
+        });
+
+        size_t winid;
+        init_stage("graphics", [&] { winid = gfx_init(cb); });
+
+        init_stage("input", [&] {
+            #ifdef WIN32
+            mouse = new MouseDirectInput8(winid);
+            bool use_dinput = getenv("GRIT_DINPUT")!=NULL;
+            keyboard = use_dinput ? (Keyboard *)new KeyboardDirectInput8(winid)
+                          : (Keyboard *)new KeyboardWinAPI(winid);
+            joystick = new JoystickDirectInput8(winid);
+            #else
+            mouse = new MouseX11(winid);
+            keyboard = new KeyboardX11(winid);
+            joystick = new JoystickDevjs(winid);
+            #endif
+        });
+
+        init_stage("clipboard", clipboard_init);
+
+        init_stage("core options", [] {
+            core_option_init();
+            streamer_init();
+        });
+
+        init_stage_wait("physics", physics_stage);
+        init_stage("physics debug drawer", [] {
+            debug_drawer = new BulletDebugDrawer(); // FIXME: hack
+            physics_init_debug_drawer();
+        });
+
+        init_stage_wait("net", net_stage);
+        init_stage_wait("navigation", navigation_stage);
+        init_stage_wait("audio", audio_stage);
+
+        CVERB << "Initialised in " << (micros() - startup_before) / 1000 << "ms:" << std::endl;
+        for (const auto &stage : init_stages) {
+            CVERB << "    " << stage.name << ": " << stage.micros / 1000 << "ms" << std::endl;
+        }
 
         std::vector<std::string> args;
         for (int i=0 ; i<argc ; i++) {
@@ -184,6 +252,8 @@ int main (int argc, const char **argv)
 
         CVERB << "Shutting down Background Loader..." << std::endl;
         bgl->shutdown();
+        async_io_shutdown();
+        host_cache_shutdown();
 
         CVERB << "Shutting down Mouse & Keyboard..." << std::endl;
         if (mouse) delete mouse;
@@ -210,6 +280,9 @@ int main (int argc, const char **argv)
 
         delete bgl;
 
+        error_aggregate_flush();
+        log_sink_shutdown();
+
     } catch (Exception &e) {
         std::cerr << "TOP LEVEL ERROR: " << e << std::endl;
         return EXIT_FAILURE;
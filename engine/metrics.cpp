@@ -0,0 +1,277 @@
+/* Copyright (c) The Grit Game Engine authors 2016
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+
+#include <centralised_log.h>
+
+#include "metrics.h"
+
+Metric::Metric (Type type, const std::string &name, const std::string &labels,
+                const std::string &help)
+  : type(type), name(name), labels(labels), help(help), historyNext(0)
+{
+    for (unsigned i=0 ; i<METRICS_HISTORY ; ++i) history[i] = 0;
+}
+
+void Metric::frame (void)
+{
+    history[historyNext] = sample();
+    historyNext = (historyNext + 1) % METRICS_HISTORY;
+}
+
+void Metric::getHistory (std::vector<float> &r) const
+{
+    r.resize(METRICS_HISTORY);
+    for (unsigned i=0 ; i<METRICS_HISTORY ; ++i) {
+        r[i] = history[(historyNext + i) % METRICS_HISTORY];
+    }
+}
+
+double MetricCounter::sample (void)
+{
+    unsigned long long v = get();
+    double r = double(v - lastSampled);
+    lastSampled = v;
+    return r;
+}
+
+MetricHistogram::MetricHistogram (const std::string &name, const std::string &labels,
+                                  const std::string &help, const std::vector<double> &bounds)
+  : Metric(HISTOGRAM, name, labels, help), bounds(bounds), buckets(bounds.size() + 1),
+    count(0), sum(0), lastSampledCount(0), lastSampledSum(0)
+{
+}
+
+void MetricHistogram::observe (double v)
+{
+    unsigned i = 0;
+    while (i < bounds.size() && v > bounds[i]) i++;
+    buckets[i].fetch_add(1, std::memory_order_relaxed);
+    double old_sum = sum.load(std::memory_order_relaxed);
+    while (!sum.compare_exchange_weak(old_sum, old_sum + v, std::memory_order_relaxed)) { }
+    count.fetch_add(1, std::memory_order_relaxed);
+}
+
+void MetricHistogram::get (std::vector<unsigned long long> &counts, unsigned long long &count_,
+                           double &sum_) const
+{
+    counts.resize(buckets.size());
+    for (unsigned i=0 ; i<buckets.size() ; ++i) {
+        counts[i] = buckets[i].load(std::memory_order_relaxed);
+    }
+    count_ = count.load(std::memory_order_relaxed);
+    sum_ = sum.load(std::memory_order_relaxed);
+}
+
+double MetricHistogram::sample (void)
+{
+    unsigned long long c = count.load(std::memory_order_relaxed);
+    double s = sum.load(std::memory_order_relaxed);
+    double r = c == lastSampledCount ? 0 : (s - lastSampledSum) / (c - lastSampledCount);
+    lastSampledCount = c;
+    lastSampledSum = s;
+    return r;
+}
+
+
+typedef std::map<std::pair<std::string, std::string>, Metric*> MetricMap;
+
+// Metrics are usually registered during static initialisation of other files, so the registry
+// must be constructed on first use.
+static MetricMap &registry (void)
+{
+    static MetricMap *m = new MetricMap();
+    return *m;
+}
+
+static std::mutex &registry_mutex (void)
+{
+    static std::mutex *m = new std::mutex();
+    return *m;
+}
+
+// Must hold the registry mutex.  Returns NULL if there is no such metric.
+static Metric *find_locked (Metric::Type type, const std::string &name, const std::string &labels)
+{
+    auto it = registry().find(std::make_pair(name, labels));
+    if (it == registry().end()) return NULL;
+    if (it->second->type != type)
+        EXCEPT << "Metric already exists with a different type: " << name << "{" << labels << "}"
+               << ENDL;
+    return it->second;
+}
+
+MetricCounter *metrics_counter (const std::string &name, const std::string &labels,
+                                const std::string &help)
+{
+    std::lock_guard<std::mutex> lock(registry_mutex());
+    Metric *m = find_locked(Metric::COUNTER, name, labels);
+    if (m == NULL) {
+        m = new MetricCounter(name, labels, help);
+        registry()[std::make_pair(name, labels)] = m;
+    }
+    return static_cast<MetricCounter*>(m);
+}
+
+MetricGauge *metrics_gauge (const std::string &name, const std::string &labels,
+                            const std::string &help)
+{
+    std::lock_guard<std::mutex> lock(registry_mutex());
+    Metric *m = find_locked(Metric::GAUGE, name, labels);
+    if (m == NULL) {
+        m = new MetricGauge(name, labels, help);
+        registry()[std::make_pair(name, labels)] = m;
+    }
+    return static_cast<MetricGauge*>(m);
+}
+
+MetricHistogram *metrics_histogram (const std::string &name, const std::string &labels,
+                                    const std::string &help, const std::vector<double> &bounds)
+{
+    std::lock_guard<std::mutex> lock(registry_mutex());
+    Metric *m = find_locked(Metric::HISTOGRAM, name, labels);
+    if (m == NULL) {
+        m = new MetricHistogram(name, labels, help, bounds);
+        registry()[std::make_pair(name, labels)] = m;
+    }
+    return static_cast<MetricHistogram*>(m);
+}
+
+const std::vector<double> &metrics_latency_bounds (void)
+{
+    static const std::vector<double> bounds = {
+        0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5,
+        1, 2.5, 5, 10
+    };
+    return bounds;
+}
+
+Metric *metrics_get (const std::string &name, const std::string &labels)
+{
+    std::lock_guard<std::mutex> lock(registry_mutex());
+    auto it = registry().find(std::make_pair(name, labels));
+    if (it == registry().end()) return NULL;
+    return it->second;
+}
+
+std::vector<Metric*> metrics_all (void)
+{
+    std::lock_guard<std::mutex> lock(registry_mutex());
+    std::vector<Metric*> r;
+    for (const auto &m : registry()) r.push_back(m.second);
+    return r;
+}
+
+void metrics_frame (void)
+{
+    std::lock_guard<std::mutex> lock(registry_mutex());
+    for (const auto &m : registry()) m.second->frame();
+}
+
+static const char *type_name (Metric::Type t)
+{
+    switch (t) {
+        case Metric::COUNTER: return "counter";
+        case Metric::GAUGE: return "gauge";
+        case Metric::HISTOGRAM: return "histogram";
+    }
+    return "untyped";
+}
+
+// Labels with the given one added, in braces, or nothing if there are none.
+static std::string with_label (const std::string &labels, const std::string &extra)
+{
+    std::string r = labels;
+    if (!r.empty() && !extra.empty()) r += ",";
+    r += extra;
+    return r.empty() ? r : "{" + r + "}";
+}
+
+static void write_metric (std::ostream &o, Metric *m)
+{
+    switch (m->type) {
+        case Metric::COUNTER:
+        o << m->name << with_label(m->labels, "") << " "
+          << static_cast<MetricCounter*>(m)->get() << "\n";
+        break;
+
+        case Metric::GAUGE:
+        o << m->name << with_label(m->labels, "") << " "
+          << static_cast<MetricGauge*>(m)->get() << "\n";
+        break;
+
+        case Metric::HISTOGRAM: {
+            MetricHistogram *h = static_cast<MetricHistogram*>(m);
+            std::vector<unsigned long long> counts;
+            unsigned long long count;
+            double sum;
+            h->get(counts, count, sum);
+            const std::vector<double> &bounds = h->getBounds();
+            // Prometheus buckets are cumulative.
+            unsigned long long so_far = 0;
+            for (unsigned i=0 ; i<counts.size() ; ++i) {
+                so_far += counts[i];
+                std::stringstream le;
+                le << "le=\"";
+                if (i < bounds.size()) le << bounds[i]; else le << "+Inf";
+                le << "\"";
+                o << m->name << "_bucket" << with_label(m->labels, le.str()) << " " << so_far
+                  << "\n";
+            }
+            o << m->name << "_sum" << with_label(m->labels, "") << " " << sum << "\n";
+            o << m->name << "_count" << with_label(m->labels, "") << " " << count << "\n";
+        }
+        break;
+    }
+}
+
+void metrics_write (const std::string &filename)
+{
+    std::string tmp = filename + ".tmp";
+    {
+        std::ofstream f(tmp.c_str());
+        if (!f.good()) EXCEPT << "Could not open metrics file: \"" << tmp << "\"" << ENDL;
+        f.precision(12);
+        std::string last_name;
+        for (Metric *m : metrics_all()) {
+            if (m->name != last_name) {
+                f << "# HELP " << m->name << " " << m->help << "\n";
+                f << "# TYPE " << m->name << " " << type_name(m->type) << "\n";
+                last_name = m->name;
+            }
+            write_metric(f, m);
+        }
+        f.close();
+        if (!f.good()) EXCEPT << "Could not write metrics file: \"" << tmp << "\"" << ENDL;
+    }
+    #ifdef WIN32
+    // Windows does not replace an existing file when renaming.
+    std::remove(filename.c_str());
+    #endif
+    if (std::rename(tmp.c_str(), filename.c_str()) != 0)
+        EXCEPT << "Could not rename \"" << tmp << "\" to \"" << filename << "\"" << ENDL;
+}
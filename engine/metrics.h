@@ -0,0 +1,185 @@
+/* Copyright (c) The Grit Game Engine authors 2016
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef Metrics_h
+#define Metrics_h
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+/** \file
+ *
+ * A registry of named measurements, for tuning the engine (streaming in particular) while it
+ * runs.  Counters only go up, gauges are set to the current value of something, and histograms
+ * count observations (e.g. latencies) in buckets.  A metric is identified by its name and its
+ * labels, which are written like the inside of the braces in Prometheus syntax, e.g.
+ * type="mesh", or empty.  Metrics are never destroyed, so a pointer to one can be kept in a
+ * static variable at the place it is fed.  Counters, gauges and histograms can be fed from any
+ * thread.
+ *
+ * metrics_write writes all the metrics to a file in the Prometheus text exposition format.
+ * Once per frame, metrics_frame records a value for each metric into its history, for drawing
+ * graphs.  For counters this is the increase during the frame, for gauges the current value,
+ * and for histograms the mean of the frame's observations.
+ */
+
+/** Number of frames of history kept for each metric. */
+static const unsigned METRICS_HISTORY = 128;
+
+class Metric {
+
+  public:
+
+    enum Type { COUNTER, GAUGE, HISTOGRAM };
+
+    Metric (Type type, const std::string &name, const std::string &labels,
+            const std::string &help);
+
+    virtual ~Metric (void) { }
+
+    const Type type;
+    const std::string name;
+    const std::string labels;
+    const std::string help;
+
+    /** Record the value for this frame into the history. */
+    void frame (void);
+
+    /** The history, oldest first. */
+    void getHistory (std::vector<float> &history) const;
+
+  protected:
+
+    /** The value to record in the history, called once per frame by the main thread. */
+    virtual double sample (void) = 0;
+
+  private:
+
+    float history[METRICS_HISTORY];
+    unsigned historyNext;
+};
+
+class MetricCounter : public Metric {
+
+  public:
+
+    MetricCounter (const std::string &name, const std::string &labels, const std::string &help)
+      : Metric(COUNTER, name, labels, help), value(0), lastSampled(0)
+    { }
+
+    void inc (unsigned long long n = 1) { value.fetch_add(n, std::memory_order_relaxed); }
+
+    unsigned long long get (void) const { return value.load(std::memory_order_relaxed); }
+
+  protected:
+
+    double sample (void);
+
+  private:
+
+    std::atomic<unsigned long long> value;
+    unsigned long long lastSampled;
+};
+
+class MetricGauge : public Metric {
+
+  public:
+
+    MetricGauge (const std::string &name, const std::string &labels, const std::string &help)
+      : Metric(GAUGE, name, labels, help), value(0)
+    { }
+
+    void set (double v) { value.store(v, std::memory_order_relaxed); }
+
+    double get (void) const { return value.load(std::memory_order_relaxed); }
+
+  protected:
+
+    double sample (void) { return get(); }
+
+  private:
+
+    std::atomic<double> value;
+};
+
+class MetricHistogram : public Metric {
+
+  public:
+
+    /** The bounds are the (inclusive) upper bounds of the buckets, in increasing order.  There
+     * is an extra bucket for everything larger. */
+    MetricHistogram (const std::string &name, const std::string &labels, const std::string &help,
+                     const std::vector<double> &bounds);
+
+    void observe (double v);
+
+    const std::vector<double> &getBounds (void) const { return bounds; }
+
+    /** Counts for each bucket (not cumulative), including the last one, and the total count
+     * and sum of all observations. */
+    void get (std::vector<unsigned long long> &counts, unsigned long long &count,
+              double &sum) const;
+
+  protected:
+
+    double sample (void);
+
+  private:
+
+    const std::vector<double> bounds;
+    std::vector<std::atomic<unsigned long long>> buckets;
+    std::atomic<unsigned long long> count;
+    std::atomic<double> sum;
+    unsigned long long lastSampledCount;
+    double lastSampledSum;
+};
+
+/** Find or create a counter.  Throws an exception if there is a metric of a different type with
+ * the same name and labels. */
+MetricCounter *metrics_counter (const std::string &name, const std::string &labels,
+                                const std::string &help);
+
+MetricGauge *metrics_gauge (const std::string &name, const std::string &labels,
+                            const std::string &help);
+
+/** If the histogram already exists, the bounds are ignored. */
+MetricHistogram *metrics_histogram (const std::string &name, const std::string &labels,
+                                    const std::string &help, const std::vector<double> &bounds);
+
+/** Bucket bounds suitable for durations in seconds, from 100us to 10s. */
+const std::vector<double> &metrics_latency_bounds (void);
+
+/** Returns NULL if there is no such metric. */
+Metric *metrics_get (const std::string &name, const std::string &labels);
+
+/** All metrics, sorted by name then labels. */
+std::vector<Metric*> metrics_all (void);
+
+/** Record a frame of history for every metric.  Called by gfx_render. */
+void metrics_frame (void);
+
+/** Write every metric to the file, replacing it in one step so that a reader never sees part
+ * of the file. */
+void metrics_write (const std::string &filename);
+
+#endif
@@ -144,11 +144,13 @@ bool rcCreateChunkyTriMesh(const float* verts, const int* tris, int ntris,
 {
     int nchunks = (ntris + trisPerChunk-1) / trisPerChunk;
 
-    cm->nodes = new rcChunkyTriMeshNode[nchunks*4];
+    rcChunkyTriMeshNode* nodes = new rcChunkyTriMeshNode[nchunks*4];
+    cm->nodes = nodes;
     if (!cm->nodes)
         return false;
         
-    cm->tris = new int[ntris*3];
+    int* chunkTris = new int[ntris*3];
+    cm->tris = chunkTris;
     if (!cm->tris)
         return false;
         
@@ -180,7 +182,7 @@ bool rcCreateChunkyTriMesh(const float* verts, const int* tris, int ntris,
 
     int curTri = 0;
     int curNode = 0;
-    subdivide(items, ntris, 0, ntris, trisPerChunk, curNode, cm->nodes, nchunks*4, curTri, cm->tris, tris);
+    subdivide(items, ntris, 0, ntris, trisPerChunk, curNode, nodes, nchunks*4, curTri, chunkTris, tris);
     
     delete [] items;
     
@@ -190,7 +192,7 @@ bool rcCreateChunkyTriMesh(const float* verts, const int* tris, int ntris,
     cm->maxTrisPerChunk = 0;
     for (int i = 0; i < cm->nnodes; ++i)
     {
-        rcChunkyTriMeshNode& node = cm->nodes[i];
+        const rcChunkyTriMeshNode& node = cm->nodes[i];
         const bool isLeaf = node.i >= 0;
         if (!isLeaf) continue;
         if (node.n > cm->maxTrisPerChunk)
@@ -29,14 +29,16 @@ struct rcChunkyTriMeshNode
 
 struct rcChunkyTriMesh
 {
-    inline rcChunkyTriMesh() : nodes(0), nnodes(0), tris(0), ntris(0), maxTrisPerChunk(0) {};
-    inline ~rcChunkyTriMesh() { delete [] nodes; delete [] tris; }
+    inline rcChunkyTriMesh() : nodes(0), nnodes(0), tris(0), ntris(0), maxTrisPerChunk(0), ownsData(true) {};
+    inline ~rcChunkyTriMesh() { if (ownsData) { delete [] nodes; delete [] tris; } }
 
-    rcChunkyTriMeshNode* nodes;
+    const rcChunkyTriMeshNode* nodes;
     int nnodes;
-    int* tris;
+    const int* tris;
     int ntris;
     int maxTrisPerChunk;
+    /// False when the arrays belong to something else, e.g. a mapped geometry cache file.
+    bool ownsData;
 
 private:
     // Explicitly disabled copy constructor and copy assignment operator.
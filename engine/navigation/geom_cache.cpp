@@ -0,0 +1,417 @@
+/* Copyright (c) The Grit Game Engine authors 2016
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <unordered_map>
+#include <vector>
+
+#ifdef WIN32
+#include <windows.h>
+#include <direct.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "geom_cache.h"
+
+static size_t align4(size_t n)
+{
+    return (n + 3) & ~size_t(3);
+}
+
+static size_t calcBlockSize(int nverts, int ntris, int nnodes)
+{
+    return sizeof(rcGeomCacheHeader) + sizeof(float)*nverts*3 + sizeof(int)*ntris*3
+         + sizeof(rcChunkyTriMeshNode)*nnodes + align4(ntris);
+}
+
+rcGeomCacheData::rcGeomCacheData() :
+    m_block(0),
+    m_size(0),
+    m_mapped(false),
+#ifdef WIN32
+    m_file(INVALID_HANDLE_VALUE),
+    m_mapping(0),
+#endif
+    m_header(0),
+    m_verts(0),
+    m_tris(0),
+    m_nodes(0),
+    m_areas(0)
+{
+}
+
+rcGeomCacheData::~rcGeomCacheData()
+{
+#ifdef WIN32
+    if (m_mapped)
+        UnmapViewOfFile(m_block);
+    else
+        delete [] m_block;
+    if (m_mapping)
+        CloseHandle(m_mapping);
+    if (m_file != INVALID_HANDLE_VALUE)
+        CloseHandle(m_file);
+#else
+    if (m_mapped)
+        munmap(m_block, m_size);
+    else
+        delete [] m_block;
+#endif
+}
+
+bool rcGeomCacheData::setPointers()
+{
+    if (m_size < sizeof(rcGeomCacheHeader))
+        return false;
+    m_header = reinterpret_cast<const rcGeomCacheHeader*>(m_block);
+    const rcGeomCacheHeader& h = *m_header;
+    if (h.magic != RC_GEOM_CACHE_MAGIC || h.version != RC_GEOM_CACHE_VERSION)
+        return false;
+    if (h.vertCount < 0 || h.triCount < 0 || h.nodeCount < 0)
+        return false;
+    if (m_size != calcBlockSize(h.vertCount, h.triCount, h.nodeCount))
+        return false;
+
+    unsigned char* d = m_block + sizeof(rcGeomCacheHeader);
+    m_verts = reinterpret_cast<const float*>(d);
+    d += sizeof(float)*h.vertCount*3;
+    m_tris = reinterpret_cast<const int*>(d);
+    d += sizeof(int)*h.triCount*3;
+    m_nodes = reinterpret_cast<const rcChunkyTriMeshNode*>(d);
+    d += sizeof(rcChunkyTriMeshNode)*h.nodeCount;
+    m_areas = d;
+    return true;
+}
+
+bool rcGeomCacheData::validate() const
+{
+    const rcGeomCacheHeader& h = *m_header;
+    for (int i = 0; i < h.triCount*3; ++i)
+    {
+        if (m_tris[i] < 0 || m_tris[i] >= h.vertCount)
+            return false;
+    }
+    for (int i = 0; i < h.nodeCount; ++i)
+    {
+        const rcChunkyTriMeshNode& node = m_nodes[i];
+        if (node.i >= 0)
+        {
+            // A leaf, with the triangles [i, i+n).  The tile builder sizes its buffers by
+            // maxTrisPerChunk.
+            if (node.n < 0 || node.n > h.maxTrisPerChunk || node.i > h.triCount - node.n)
+                return false;
+        }
+        else
+        {
+            // The traversal skips -i nodes, which must be positive.  Skipping past the end
+            // just ends it.
+            if (node.i == INT_MIN)
+                return false;
+        }
+    }
+    return true;
+}
+
+void rcGeomCacheData::getChunkyMesh(rcChunkyTriMesh* cm) const
+{
+    cm->ownsData = false;
+    cm->nodes = m_nodes;
+    cm->nnodes = m_header->nodeCount;
+    cm->tris = m_tris;
+    cm->ntris = m_header->triCount;
+    cm->maxTrisPerChunk = m_header->maxTrisPerChunk;
+}
+
+namespace
+{
+    struct VertKey
+    {
+        float v[3];
+        bool operator==(const VertKey& o) const
+        {
+            return memcmp(v, o.v, sizeof(v)) == 0;
+        }
+    };
+    struct VertKeyHash
+    {
+        size_t operator()(const VertKey& k) const
+        {
+            return size_t(rcGeomCacheHash(k.v, sizeof(k.v)));
+        }
+    };
+}
+
+rcGeomCacheData* rcGeomCacheData::build(uint64_t hash, const float* verts, int nverts,
+                                        const int* tris, int ntris, int trisPerChunk,
+                                        unsigned char area)
+{
+    // Weld vertices with exactly the same position.  Meshes converted from graphics bodies
+    // repeat a vertex for every normal and uv it has, and each submesh has its own copy.
+    std::vector<int> remap(nverts);
+    std::vector<float> welded;
+    welded.reserve(nverts*3);
+    {
+        std::unordered_map<VertKey, int, VertKeyHash> seen(nverts);
+        for (int i = 0; i < nverts; ++i)
+        {
+            VertKey k;
+            memcpy(k.v, &verts[i*3], sizeof(k.v));
+            // Otherwise 0 and -0 would not be welded.
+            for (int j = 0; j < 3; ++j)
+                if (k.v[j] == 0.0f) k.v[j] = 0.0f;
+            auto ins = seen.insert(std::make_pair(k, int(welded.size()/3)));
+            if (ins.second)
+                welded.insert(welded.end(), k.v, k.v + 3);
+            remap[i] = ins.first->second;
+        }
+    }
+    const int nwelded = int(welded.size()/3);
+
+    std::vector<int> kept;
+    kept.reserve(ntris*3);
+    for (int i = 0; i < ntris; ++i)
+    {
+        const int a = remap[tris[i*3+0]];
+        const int b = remap[tris[i*3+1]];
+        const int c = remap[tris[i*3+2]];
+        if (a == b || b == c || c == a)
+            continue;
+        kept.push_back(a);
+        kept.push_back(b);
+        kept.push_back(c);
+    }
+    const int nkept = int(kept.size()/3);
+
+    rcChunkyTriMesh cm;
+    if (nkept > 0 && !rcCreateChunkyTriMesh(&welded[0], &kept[0], nkept, trisPerChunk, &cm))
+        return 0;
+
+    rcGeomCacheData* data = new rcGeomCacheData;
+    data->m_size = calcBlockSize(nwelded, nkept, cm.nnodes);
+    data->m_block = new unsigned char[data->m_size];
+    memset(data->m_block, 0, data->m_size);
+
+    rcGeomCacheHeader* h = reinterpret_cast<rcGeomCacheHeader*>(data->m_block);
+    h->magic = RC_GEOM_CACHE_MAGIC;
+    h->version = RC_GEOM_CACHE_VERSION;
+    h->hash = hash;
+    h->vertCount = nwelded;
+    h->triCount = nkept;
+    h->nodeCount = cm.nnodes;
+    h->maxTrisPerChunk = cm.maxTrisPerChunk;
+    for (int j = 0; j < 3; ++j)
+    {
+        h->bmin[j] = nwelded ? welded[j] : 0.0f;
+        h->bmax[j] = nwelded ? welded[j] : 0.0f;
+    }
+    for (int i = 1; i < nwelded; ++i)
+    {
+        for (int j = 0; j < 3; ++j)
+        {
+            const float v = welded[i*3+j];
+            if (v < h->bmin[j]) h->bmin[j] = v;
+            if (v > h->bmax[j]) h->bmax[j] = v;
+        }
+    }
+
+    data->setPointers();
+    memcpy(const_cast<float*>(data->m_verts), welded.data(), sizeof(float)*nwelded*3);
+    memcpy(const_cast<int*>(data->m_tris), cm.tris, sizeof(int)*nkept*3);
+    memcpy(const_cast<rcChunkyTriMeshNode*>(data->m_nodes), cm.nodes,
+           sizeof(rcChunkyTriMeshNode)*cm.nnodes);
+    memset(const_cast<unsigned char*>(data->m_areas), area, nkept);
+    return data;
+}
+
+rcGeomCacheData* rcGeomCacheData::map(const std::string& filename, uint64_t hash)
+{
+    rcGeomCacheData* data = new rcGeomCacheData;
+
+#ifdef WIN32
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        delete data;
+        return 0;
+    }
+    data->m_file = file;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+    {
+        delete data;
+        return 0;
+    }
+    data->m_mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!data->m_mapping)
+    {
+        delete data;
+        return 0;
+    }
+    data->m_block = static_cast<unsigned char*>(MapViewOfFile(data->m_mapping, FILE_MAP_READ, 0, 0, 0));
+    data->m_size = size_t(size.QuadPart);
+    data->m_mapped = data->m_block != 0;
+#else
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        delete data;
+        return 0;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        close(fd);
+        delete data;
+        return 0;
+    }
+    void* p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping stays valid after the file is closed.
+    close(fd);
+    if (p != MAP_FAILED)
+    {
+        data->m_block = static_cast<unsigned char*>(p);
+        data->m_size = size_t(st.st_size);
+        data->m_mapped = true;
+    }
+#endif
+
+    if (!data->m_mapped || !data->setPointers() || data->m_header->hash != hash
+        || !data->validate())
+    {
+        delete data;
+        return 0;
+    }
+    return data;
+}
+
+bool rcGeomCacheData::write(const std::string& filename) const
+{
+    const std::string tmp = filename + ".tmp";
+    FILE* fp = fopen(tmp.c_str(), "wb");
+    if (!fp)
+        return false;
+    const bool ok = fwrite(m_block, m_size, 1, fp) == 1;
+    if (fclose(fp) != 0 || !ok)
+    {
+        remove(tmp.c_str());
+        return false;
+    }
+#ifdef WIN32
+    // Windows does not replace an existing file when renaming.
+    remove(filename.c_str());
+#endif
+    if (rename(tmp.c_str(), filename.c_str()) != 0)
+    {
+        remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+uint64_t rcGeomCacheHash(const void* data, size_t size, uint64_t hash)
+{
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= p[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static std::string& cacheDir()
+{
+    static std::string dir;
+    return dir;
+}
+
+void rcSetGeomCacheDir(const std::string& dir)
+{
+    cacheDir() = dir;
+    if (dir.empty())
+        return;
+    // Only the last component is created.  It is fine if it already exists.
+#ifdef WIN32
+    _mkdir(dir.c_str());
+#else
+    mkdir(dir.c_str(), 0777);
+#endif
+}
+
+const std::string& rcGetGeomCacheDir()
+{
+    return cacheDir();
+}
+
+std::string rcGeomCacheFilename(uint64_t hash)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.navgeom", (unsigned long long)hash);
+    return cacheDir() + "/" + name;
+}
+
+static bool isCacheFile(const std::string& name)
+{
+    static const std::string ext = ".navgeom";
+    return name.size() > ext.size() && name.compare(name.size() - ext.size(), ext.size(), ext) == 0;
+}
+
+int rcClearGeomCache()
+{
+    const std::string& dir = cacheDir();
+    if (dir.empty())
+        return 0;
+    int removed = 0;
+#ifdef WIN32
+    WIN32_FIND_DATAA data;
+    HANDLE h = FindFirstFileA((dir + "/*.navgeom").c_str(), &data);
+    if (h == INVALID_HANDLE_VALUE)
+        return 0;
+    do
+    {
+        if (isCacheFile(data.cFileName) && remove((dir + "/" + data.cFileName).c_str()) == 0)
+            removed++;
+    }
+    while (FindNextFileA(h, &data));
+    FindClose(h);
+#else
+    DIR* d = opendir(dir.c_str());
+    if (!d)
+        return 0;
+    while (struct dirent* e = readdir(d))
+    {
+        if (isCacheFile(e->d_name) && remove((dir + "/" + e->d_name).c_str()) == 0)
+            removed++;
+    }
+    closedir(d);
+#endif
+    return removed;
+}
@@ -0,0 +1,125 @@
+/* Copyright (c) The Grit Game Engine authors 2016
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef GEOMCACHE_H
+#define GEOMCACHE_H
+
+#include <cstdint>
+#include <string>
+
+#include "chunky_tri_mesh.h"
+
+/// The input geometry of one source in the form the tile builder wants it: welded vertices,
+/// triangles in chunk order, an area id per triangle and the chunky mesh tree over them.  It is
+/// a single block laid out exactly like the cache file, so a cached source is used straight
+/// from the mapped file without parsing or partitioning anything.
+///
+/// Layout (all offsets multiples of 4):
+///   rcGeomCacheHeader
+///   float verts[vertCount*3]
+///   int tris[triCount*3]          (the chunky mesh's tris, grouped by node)
+///   rcChunkyTriMeshNode nodes[nodeCount]
+///   unsigned char areas[triCount] (padded to 4 bytes)
+struct rcGeomCacheHeader
+{
+    int magic;
+    int version;
+    uint64_t hash;
+    int vertCount;
+    int triCount;
+    int nodeCount;
+    int maxTrisPerChunk;
+    float bmin[3];
+    float bmax[3];
+};
+
+static const int RC_GEOM_CACHE_MAGIC = 'G'<<24 | 'N'<<16 | 'A'<<8 | 'V';
+static const int RC_GEOM_CACHE_VERSION = 1;
+
+class rcGeomCacheData
+{
+public:
+    ~rcGeomCacheData();
+
+    /// Welds identical vertices, drops triangles left degenerate, and partitions the rest.
+    /// Every triangle gets the given area; slopes are still checked when the tile is built.
+    /// Returns 0 if out of memory.
+    static rcGeomCacheData* build(uint64_t hash, const float* verts, int nverts,
+                                  const int* tris, int ntris, int trisPerChunk,
+                                  unsigned char area);
+
+    /// Maps the file read only.  Returns 0 if it does not exist, or is not a cache of the
+    /// expected version and hash (e.g. it is truncated), or has a triangle or tree node that
+    /// is out of range.
+    static rcGeomCacheData* map(const std::string& filename, uint64_t hash);
+
+    /// Writes the block to a temporary file and renames it into place, so a reader never maps
+    /// half of it.
+    bool write(const std::string& filename) const;
+
+    const rcGeomCacheHeader& getHeader() const { return *m_header; }
+    const float* getVerts() const { return m_verts; }
+    const unsigned char* getAreas() const { return m_areas; }
+    size_t getSize() const { return m_size; }
+    bool isMapped() const { return m_mapped; }
+
+    /// Points the chunky mesh at the tree in the block; it does not take ownership.
+    void getChunkyMesh(rcChunkyTriMesh* cm) const;
+
+private:
+    rcGeomCacheData();
+    bool setPointers();
+    bool validate() const;
+
+    // Explicitly disabled copy constructor and copy assignment operator.
+    rcGeomCacheData(const rcGeomCacheData&);
+    rcGeomCacheData& operator=(const rcGeomCacheData&);
+
+    unsigned char* m_block;
+    size_t m_size;
+    bool m_mapped;
+#ifdef WIN32
+    void* m_file;
+    void* m_mapping;
+#endif
+
+    const rcGeomCacheHeader* m_header;
+    const float* m_verts;
+    const int* m_tris;
+    const rcChunkyTriMeshNode* m_nodes;
+    const unsigned char* m_areas;
+};
+
+/// 64 bit FNV-1a, for keying cache files by the content they were made from.
+uint64_t rcGeomCacheHash(const void* data, size_t size, uint64_t hash = 14695981039346656037ULL);
+
+/// The directory cache files are kept in.  Empty (the default) disables the cache.
+void rcSetGeomCacheDir(const std::string& dir);
+const std::string& rcGetGeomCacheDir();
+
+/// The file in the cache directory for the given hash.
+std::string rcGeomCacheFilename(uint64_t hash);
+
+/// Deletes the cache files in the cache directory, e.g. after the tools that make the geometry
+/// change.  Returns how many were deleted.
+int rcClearGeomCache();
+
+#endif // GEOMCACHE_H
@@ -22,6 +22,7 @@
 #include <ctype.h>
 #include <string.h>
 #include <algorithm>
+#include <vector>
 #include "Recast.h"
 #include "input_geom.h"
 #include "chunky_tri_mesh.h"
@@ -29,6 +30,9 @@
 #include "DebugDraw.h"
 #include "RecastDebugDraw.h"
 #include "DetourNavMesh.h"
+#include "../metrics.h"
+
+static const int TRIS_PER_CHUNK = 256;
 
 static bool intersectSegmentTriangle(const float* sp, const float* sq,
                                      const float* a, const float* b, const float* c,
@@ -104,143 +108,234 @@ static char* parseRow(char* buf, char* bufEnd, char* row, int len)
 }
 
 InputGeom::InputGeom() :
-    m_chunkyMesh(0),
-    m_mesh(0),
+    m_nextSourceId(1),
     m_hasBuildSettings(false),
     m_offMeshConCount(0),
     m_volumeCount(0)
 {
+    memset(m_meshBMin, 0, sizeof(m_meshBMin));
+    memset(m_meshBMax, 0, sizeof(m_meshBMax));
 }
 
 InputGeom::~InputGeom()
 {
-    delete m_chunkyMesh;
-    delete m_mesh;
 }
-        
-bool InputGeom::loadMesh(rcContext* ctx, const std::string& filepath)
+
+int InputGeom::addSource(rcGeomCacheData* data)
 {
-    if (m_mesh)
-    {
-        delete m_chunkyMesh;
-        m_chunkyMesh = 0;
-        delete m_mesh;
-        m_mesh = 0;
-    }
-    m_offMeshConCount = 0;
-    m_volumeCount = 0;
-    
-    m_mesh = new rcMeshLoaderObj;
-    if (!m_mesh)
-    {
-        ctx->log(RC_LOG_ERROR, "loadMesh: Out of memory 'm_mesh'.");
-        return false;
-    }
-    if (!m_mesh->load(filepath))
-    {
-        ctx->log(RC_LOG_ERROR, "buildTiledNavigation: Could not load '%s'", filepath.c_str());
-        return false;
-    }
+    InputGeomSource* source = new InputGeomSource;
+    source->data = data;
+    rcVcopy(source->bmin, data->getHeader().bmin);
+    rcVcopy(source->bmax, data->getHeader().bmax);
+    source->chunkyMesh = new rcChunkyTriMesh;
+    data->getChunkyMesh(source->chunkyMesh);
+
+    const int id = m_nextSourceId++;
+    m_sources[id] = InputGeomSourcePtr(source);
+    calcBounds();
+    return id;
+}
 
-    rcCalcBounds(m_mesh->getVerts(), m_mesh->getVertCount(), m_meshBMin, m_meshBMax);
+static MetricCounter *geom_cache_hits =
+    metrics_counter("grit_navigation_geom_cache_hits_total", "",
+                    "Navigation input sources mapped from the geometry cache.");
+static MetricCounter *geom_cache_misses =
+    metrics_counter("grit_navigation_geom_cache_misses_total", "",
+                    "Navigation input sources converted because they were not in the cache.");
+
+// Returns 0 if the cache is disabled or does not have it.
+static rcGeomCacheData* findCached(uint64_t hash)
+{
+    if (rcGetGeomCacheDir().empty())
+        return 0;
+    rcGeomCacheData* data = rcGeomCacheData::map(rcGeomCacheFilename(hash), hash);
+    if (data)
+        geom_cache_hits->inc();
+    else
+        geom_cache_misses->inc();
+    return data;
+}
 
-    m_chunkyMesh = new rcChunkyTriMesh;
-    if (!m_chunkyMesh)
+int InputGeom::addConverted(rcContext* ctx, uint64_t hash, const rcMeshLoaderObj& mesh)
+{
+    rcGeomCacheData* data = rcGeomCacheData::build(hash, mesh.getVerts(), mesh.getVertCount(),
+                                                   mesh.getTris(), mesh.getTriCount(),
+                                                   TRIS_PER_CHUNK, RC_WALKABLE_AREA);
+    if (!data)
     {
-        ctx->log(RC_LOG_ERROR, "buildTiledNavigation: Out of memory 'm_chunkyMesh'.");
-        return false;
+        ctx->log(RC_LOG_ERROR, "addConverted: Failed to build chunky mesh.");
+        return 0;
     }
-    if (!rcCreateChunkyTriMesh(m_mesh->getVerts(), m_mesh->getTris(), m_mesh->getTriCount(), 256, m_chunkyMesh))
-    {
-        ctx->log(RC_LOG_ERROR, "buildTiledNavigation: Failed to build chunky mesh.");
-        return false;
-    }        
+    if (!rcGetGeomCacheDir().empty() && !data->write(rcGeomCacheFilename(hash)))
+        ctx->log(RC_LOG_WARNING, "addConverted: Could not write '%s'",
+                 rcGeomCacheFilename(hash).c_str());
+    return addSource(data);
+}
 
-    return true;
+void InputGeom::clearSources()
+{
+    m_sources.clear();
+    m_filename.clear();
+    calcBounds();
 }
 
-bool InputGeom::loadGfxBody(rcContext* ctx, std::vector<GfxBodyPtr> bodies)
+void InputGeom::calcBounds()
 {
-    if (m_mesh)
+    if (m_sources.empty())
     {
-        delete m_chunkyMesh;
-        m_chunkyMesh = 0;
-        delete m_mesh;
-        m_mesh = 0;
+        memset(m_meshBMin, 0, sizeof(m_meshBMin));
+        memset(m_meshBMax, 0, sizeof(m_meshBMax));
+        return;
     }
-    m_offMeshConCount = 0;
-    m_volumeCount = 0;
+    rcVcopy(m_meshBMin, m_sources.begin()->second->bmin);
+    rcVcopy(m_meshBMax, m_sources.begin()->second->bmax);
+    for (const auto& s : m_sources)
+    {
+        rcVmin(m_meshBMin, s.second->bmin);
+        rcVmax(m_meshBMax, s.second->bmax);
+    }
+}
 
-    m_mesh = new rcMeshLoaderObj;
-    if (!m_mesh)
+int InputGeom::addMesh(rcContext* ctx, const std::string& filepath)
+{
+    // The file is hashed before it is parsed, so a cached one is never parsed at all.
+    std::vector<char> buf;
+    FILE* fp = fopen(filepath.c_str(), "rb");
+    if (fp)
     {
-        ctx->log(RC_LOG_ERROR, "loadMesh: Out of memory 'm_mesh'.");
-        return false;
+        if (fseek(fp, 0, SEEK_END) == 0)
+        {
+            long size = ftell(fp);
+            if (size > 0 && fseek(fp, 0, SEEK_SET) == 0)
+            {
+                buf.resize(size);
+                if (fread(&buf[0], size, 1, fp) != 1)
+                    buf.clear();
+            }
+        }
+        fclose(fp);
     }
-    if (!m_mesh->convertGfxBody(bodies))
+    if (buf.empty())
     {
-        //ctx->log(RC_LOG_ERROR, "buildTiledNavigation: Could not load '%s'", body);
-        return false;
+        ctx->log(RC_LOG_ERROR, "addMesh: Could not load '%s'", filepath.c_str());
+        return 0;
     }
 
-    rcCalcBounds(m_mesh->getVerts(), m_mesh->getVertCount(), m_meshBMin, m_meshBMax);
+    uint64_t hash = rcGeomCacheHash(&buf[0], buf.size());
+    hash = rcGeomCacheHash(&TRIS_PER_CHUNK, sizeof(TRIS_PER_CHUNK), hash);
+    if (rcGeomCacheData* data = findCached(hash))
+        return addSource(data);
 
-    m_chunkyMesh = new rcChunkyTriMesh;
-    if (!m_chunkyMesh)
+    rcMeshLoaderObj mesh;
+    if (!mesh.parse(&buf[0], (long)buf.size()))
     {
-        ctx->log(RC_LOG_ERROR, "buildTiledNavigation: Out of memory 'm_chunkyMesh'.");
-        return false;
+        ctx->log(RC_LOG_ERROR, "addMesh: Could not load '%s'", filepath.c_str());
+        return 0;
     }
-    if (!rcCreateChunkyTriMesh(m_mesh->getVerts(), m_mesh->getTris(), m_mesh->getTriCount(), 256, m_chunkyMesh))
+    return addConverted(ctx, hash, mesh);
+}
+
+// The cache key of converted geometry: for bodies there is no file to hash, so it is the
+// triangles themselves.  This skips welding and partitioning, but not the conversion.
+static uint64_t hashConverted(const rcMeshLoaderObj& mesh)
+{
+    uint64_t hash = rcGeomCacheHash(mesh.getVerts(), sizeof(float)*mesh.getVertCount()*3);
+    hash = rcGeomCacheHash(mesh.getTris(), sizeof(int)*mesh.getTriCount()*3, hash);
+    return rcGeomCacheHash(&TRIS_PER_CHUNK, sizeof(TRIS_PER_CHUNK), hash);
+}
+
+int InputGeom::addGfxBody(rcContext* ctx, const GfxBodyPtr& body)
+{
+    rcMeshLoaderObj mesh;
+    if (!mesh.convertGfxBody(std::vector<GfxBodyPtr>(1, body)))
     {
-        ctx->log(RC_LOG_ERROR, "buildTiledNavigation: Failed to build chunky mesh.");
-        return false;
+        ctx->log(RC_LOG_ERROR, "addGfxBody: Could not convert body.");
+        return 0;
     }
+    const uint64_t hash = hashConverted(mesh);
+    if (rcGeomCacheData* data = findCached(hash))
+        return addSource(data);
+    return addConverted(ctx, hash, mesh);
+}
 
+bool InputGeom::removeSource(int id, float* bmin, float* bmax)
+{
+    if (!getSourceBounds(id, bmin, bmax))
+        return false;
+    m_sources.erase(id);
+    calcBounds();
     return true;
 }
 
-bool InputGeom::loadRigidBody(rcContext* ctx, std::vector<RigidBody*> bodies)
+bool InputGeom::getSourceBounds(int id, float* bmin, float* bmax) const
+{
+    auto it = m_sources.find(id);
+    if (it == m_sources.end())
+        return false;
+    rcVcopy(bmin, it->second->bmin);
+    rcVcopy(bmax, it->second->bmax);
+    return true;
+}
+
+void InputGeom::getSourcesOverlapping(const float* bmin, const float* bmax,
+                                      std::vector<InputGeomSourcePtr>& out) const
 {
-    if (m_mesh)
+    for (const auto& s : m_sources)
     {
-        delete m_chunkyMesh;
-        m_chunkyMesh = 0;
-        delete m_mesh;
-        m_mesh = 0;
+        const InputGeomSource& src = *s.second;
+        if (src.bmin[0] > bmax[0] || src.bmax[0] < bmin[0]) continue;
+        if (src.bmin[2] > bmax[2] || src.bmax[2] < bmin[2]) continue;
+        out.push_back(s.second);
     }
+}
+        
+bool InputGeom::loadMesh(rcContext* ctx, const std::string& filepath)
+{
+    clearSources();
     m_offMeshConCount = 0;
     m_volumeCount = 0;
-
-    m_mesh = new rcMeshLoaderObj;
-    if (!m_mesh)
-    {
-        ctx->log(RC_LOG_ERROR, "loadMesh: Out of memory 'm_mesh'.");
-        return false;
-    }
-    if (!m_mesh->convertRigidBody(bodies))
-    {
-        //ctx->log(RC_LOG_ERROR, "buildTiledNavigation: Could not load '%s'", body);
+    
+    if (!addMesh(ctx, filepath))
         return false;
-    }
+    m_filename = filepath;
 
-    rcCalcBounds(m_mesh->getVerts(), m_mesh->getVertCount(), m_meshBMin, m_meshBMax);
+    return true;
+}
 
-    m_chunkyMesh = new rcChunkyTriMesh;
-    if (!m_chunkyMesh)
-    {
-        ctx->log(RC_LOG_ERROR, "buildTiledNavigation: Out of memory 'm_chunkyMesh'.");
-        return false;
-    }
-    if (!rcCreateChunkyTriMesh(m_mesh->getVerts(), m_mesh->getTris(), m_mesh->getTriCount(), 256, m_chunkyMesh))
+bool InputGeom::loadGfxBody(rcContext* ctx, std::vector<GfxBodyPtr> bodies)
+{
+    clearSources();
+    m_offMeshConCount = 0;
+    m_volumeCount = 0;
+
+    // Each body is a separate source, so any of them can be removed later.
+    for (const auto& body : bodies)
     {
-        ctx->log(RC_LOG_ERROR, "buildTiledNavigation: Failed to build chunky mesh.");
-        return false;
+        if (!addGfxBody(ctx, body))
+            return false;
     }
 
     return true;
 }
 
+bool InputGeom::loadRigidBody(rcContext* ctx, std::vector<RigidBody*> bodies)
+{
+    clearSources();
+    m_offMeshConCount = 0;
+    m_volumeCount = 0;
+
+    rcMeshLoaderObj mesh;
+    if (!mesh.convertRigidBody(bodies))
+        return false;
+    if (mesh.getTriCount() == 0)
+        return true;
+
+    const uint64_t hash = hashConverted(mesh);
+    if (rcGeomCacheData* data = findCached(hash))
+        return addSource(data) != 0;
+    return addConverted(ctx, hash, mesh) != 0;
+}
+
 bool InputGeom::loadGeomSet(rcContext* ctx, const std::string& filepath)
 {
     char* buf = 0;
@@ -282,8 +377,7 @@ bool InputGeom::loadGeomSet(rcContext* ctx, const std::string& filepath)
     
     m_offMeshConCount = 0;
     m_volumeCount = 0;
-    delete m_mesh;
-    m_mesh = 0;
+    clearSources();
 
     char* src = buf;
     char* srcEnd = buf + bufSize;
@@ -394,10 +488,10 @@ bool InputGeom::load(rcContext* ctx, const std::string& filepath)
 
 bool InputGeom::saveGeomSet(const BuildSettings* settings)
 {
-    if (!m_mesh) return false;
+    if (m_filename.empty()) return false;
     
     // Change extension
-    std::string filepath = m_mesh->getFileName();
+    std::string filepath = m_filename;
     size_t extPos = filepath.find_last_of('.');
     if (extPos != std::string::npos)
         filepath = filepath.substr(0, extPos);
@@ -408,7 +502,7 @@ bool InputGeom::saveGeomSet(const BuildSettings* settings)
     if (!fp) return false;
     
     // Store mesh filename.
-    fprintf(fp, "f %s\n", m_mesh->getFileName().c_str());
+    fprintf(fp, "f %s\n", m_filename.c_str());
 
     // Store settings if any
     if (settings)
@@ -514,32 +608,38 @@ bool InputGeom::raycastMesh(float* src, float* dst, float& tmin)
     q[0] = src[0] + (dst[0]-src[0])*btmax;
     q[1] = src[2] + (dst[2]-src[2])*btmax;
     
-    int cid[512];
-    const int ncid = rcGetChunksOverlappingSegment(m_chunkyMesh, p, q, cid, 512);
-    if (!ncid)
-        return false;
-    
     tmin = 1.0f;
     bool hit = false;
-    const float* verts = m_mesh->getVerts();
-    
-    for (int i = 0; i < ncid; ++i)
+
+    for (const auto& s : m_sources)
     {
-        const rcChunkyTriMeshNode& node = m_chunkyMesh->nodes[cid[i]];
-        const int* tris = &m_chunkyMesh->tris[node.i*3];
-        const int ntris = node.n;
+        const InputGeomSource& source = *s.second;
+        float stmin, stmax;
+        if (!isectSegAABB(src, dst, source.bmin, source.bmax, stmin, stmax))
+            continue;
+
+        int cid[512];
+        const int ncid = rcGetChunksOverlappingSegment(source.chunkyMesh, p, q, cid, 512);
+        const float* verts = source.getVerts();
 
-        for (int j = 0; j < ntris*3; j += 3)
+        for (int i = 0; i < ncid; ++i)
         {
-            float t = 1;
-            if (intersectSegmentTriangle(src, dst,
-                                         &verts[tris[j]*3],
-                                         &verts[tris[j+1]*3],
-                                         &verts[tris[j+2]*3], t))
+            const rcChunkyTriMeshNode& node = source.chunkyMesh->nodes[cid[i]];
+            const int* tris = &source.chunkyMesh->tris[node.i*3];
+            const int ntris = node.n;
+
+            for (int j = 0; j < ntris*3; j += 3)
             {
-                if (t < tmin)
-                    tmin = t;
-                hit = true;
+                float t = 1;
+                if (intersectSegmentTriangle(src, dst,
+                                             &verts[tris[j]*3],
+                                             &verts[tris[j+1]*3],
+                                             &verts[tris[j+2]*3], t))
+                {
+                    if (t < tmin)
+                        tmin = t;
+                    hit = true;
+                }
             }
         }
     }
@@ -19,7 +19,13 @@
 #ifndef INPUTGEOM_H
 #define INPUTGEOM_H
 
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
 #include "chunky_tri_mesh.h"
+#include "geom_cache.h"
 #include "mesh_loader_obj.h"
 
 #include"navigation_system.h"
@@ -71,10 +77,39 @@ struct BuildSettings
     float tileSize;
 };
 
+/// The triangles from one body or obj file, kept apart from the others so that it can be added
+/// or removed without converting the rest of the geometry again.
+struct InputGeomSource
+{
+    inline InputGeomSource() : data(0), chunkyMesh(0) {}
+    inline ~InputGeomSource() { delete chunkyMesh; delete data; }
+
+    /// Holds the vertices, triangles, areas and chunky mesh tree, either in memory or mapped
+    /// from the geometry cache.
+    rcGeomCacheData* data;
+    rcChunkyTriMesh* chunkyMesh;
+    float bmin[3], bmax[3];
+
+    const float* getVerts() const { return data->getVerts(); }
+    int getVertCount() const { return data->getHeader().vertCount; }
+    /// Area id of each triangle, in the order of chunkyMesh->tris.
+    const unsigned char* getTriAreas() const { return data->getAreas(); }
+
+private:
+    // Explicitly disabled copy constructor and copy assignment operator.
+    InputGeomSource(const InputGeomSource&);
+    InputGeomSource& operator=(const InputGeomSource&);
+};
+
+/// Sources never change once made.  Tiles being rebuilt on worker threads hold on to the ones
+/// they use, so a source can be removed from the InputGeom at any time.
+typedef std::shared_ptr<const InputGeomSource> InputGeomSourcePtr;
+
 class InputGeom
 {
-    rcChunkyTriMesh* m_chunkyMesh;
-    rcMeshLoaderObj* m_mesh;
+    std::map<int, InputGeomSourcePtr> m_sources;
+    int m_nextSourceId;
+    std::string m_filename;
     float m_meshBMin[3], m_meshBMax[3];
     BuildSettings m_buildSettings;
     bool m_hasBuildSettings;
@@ -108,16 +143,29 @@ public:
     bool loadGfxBody(rcContext* ctx, std::vector<GfxBodyPtr> body);
     bool loadRigidBody(rcContext* ctx, std::vector<RigidBody*> bodies);
 
+    /// @name Sources.
+    /// Unlike the load functions, these keep the existing geometry.
+    ///@{
+    /// Returns the id of the new source, or 0 if it could not be loaded.
+    int addMesh(rcContext* ctx, const std::string& filepath);
+    int addGfxBody(rcContext* ctx, const GfxBodyPtr& body);
+    /// Returns false if there is no such source, otherwise sets bmin/bmax to its bounds.
+    bool removeSource(int id, float* bmin, float* bmax);
+    bool getSourceBounds(int id, float* bmin, float* bmax) const;
+    int getSourceCount() const { return (int)m_sources.size(); }
+    /// Appends the sources whose bounds overlap the box on the xz plane.
+    void getSourcesOverlapping(const float* bmin, const float* bmax,
+                               std::vector<InputGeomSourcePtr>& out) const;
+    bool hasGeometry() const { return !m_sources.empty(); }
+    ///@}
+
     bool load(class rcContext* ctx, const std::string& filepath);
     bool saveGeomSet(const BuildSettings* settings);
     
-    /// Method to return static mesh data.
-    const rcMeshLoaderObj* getMesh() const { return m_mesh; }
     const float* getMeshBoundsMin() const { return m_meshBMin; }
     const float* getMeshBoundsMax() const { return m_meshBMax; }
     const float* getNavMeshBoundsMin() const { return m_hasBuildSettings ? m_buildSettings.navMeshBMin : m_meshBMin; }
     const float* getNavMeshBoundsMax() const { return m_hasBuildSettings ? m_buildSettings.navMeshBMax : m_meshBMax; }
-    const rcChunkyTriMesh* getChunkyMesh() const { return m_chunkyMesh; }
     const BuildSettings* getBuildSettings() const { return m_hasBuildSettings ? &m_buildSettings : 0; }
     bool raycastMesh(float* src, float* dst, float& tmin);
 
@@ -147,6 +195,13 @@ public:
     ///@}
 
 private:
+    int addSource(rcGeomCacheData* data);
+    /// For meshes not found in the geometry cache: welds and partitions the mesh, and writes
+    /// it to the cache if there is one.
+    int addConverted(rcContext* ctx, uint64_t hash, const rcMeshLoaderObj& mesh);
+    void clearSources();
+    void calcBounds();
+
     // Explicitly disabled copy constructor and copy assignment operator.
     InputGeom(const InputGeom&);
     InputGeom& operator=(const InputGeom&);
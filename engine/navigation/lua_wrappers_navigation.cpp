@@ -36,7 +36,7 @@ static int navigation_system_update(lua_State *L)
 TRY_START
     check_args(L, 1);
 
-    navigation_update(check_float(L, 1));
+    navigation_update(L, check_float(L, 1));
 
     return 0;
 TRY_END
@@ -57,7 +57,7 @@ static int navigation_system_reset(lua_State *L)
 {
 TRY_START
     check_args(L, 0);
-    nvsys->reset();
+    nvsys->reset(L);
     return 0;
 TRY_END
 }
@@ -89,11 +89,90 @@ static int global_navigation_add_gfx_body(lua_State *L)
 TRY_START
     check_args(L, 1);
     GET_UD_MACRO(GfxBodyPtr, body, 1, GFXBODY_TAG);
-    nvsys->addGfxBody(body);
+    lua_pushnumber(L, nvsys->addGfxBody(body));
+    return 1;
+TRY_END
+}
+
+static int global_navigation_add_obj_geometry(lua_State *L)
+{
+TRY_START
+    check_args(L, 1);
+    lua_pushnumber(L, nvsys->addObjGeometry(check_string(L, 1)));
+    return 1;
+TRY_END
+}
+
+static int global_navigation_set_geometry_cache(lua_State *L)
+{
+TRY_START
+    check_args(L, 1);
+    std::string dir = check_string(L, 1);
+    rcSetGeomCacheDir(dir.empty() ? dir : "./" + dir);
     return 0;
 TRY_END
 }
 
+static int global_navigation_clear_geometry_cache(lua_State *L)
+{
+TRY_START
+    check_args(L, 0);
+    lua_pushnumber(L, rcClearGeomCache());
+    return 1;
+TRY_END
+}
+
+static int global_navigation_remove_geometry(lua_State *L)
+{
+TRY_START
+    check_args(L, 1);
+    lua_pushboolean(L, nvsys->removeGeometry(check_t<int>(L, 1)));
+    return 1;
+TRY_END
+}
+
+static int global_navigation_geometry_bounds(lua_State *L)
+{
+TRY_START
+    check_args(L, 1);
+    float bmin[3], bmax[3];
+    if (!nvsys->getGeometryBounds(check_t<int>(L, 1), bmin, bmax)) {
+        lua_pushnil(L);
+        return 1;
+    }
+    Ogre::Vector3 a = swap_yz(Ogre::Vector3(bmin));
+    Ogre::Vector3 b = swap_yz(Ogre::Vector3(bmax));
+    // Swapping flips x, so the corners have to be sorted again.
+    Ogre::Vector3 lo = a, hi = a;
+    lo.makeFloor(b);
+    hi.makeCeil(b);
+    push_v3(L, from_ogre(lo));
+    push_v3(L, from_ogre(hi));
+    return 2;
+TRY_END
+}
+
+static int global_navigation_pending_tiles(lua_State *L)
+{
+TRY_START
+    check_args(L, 0);
+    lua_pushnumber(L, nvsys->pendingTileCount());
+    return 1;
+TRY_END
+}
+
+static int global_navigation_finish_tile_rebuilds(lua_State *L)
+{
+TRY_START
+    check_args(L, 0);
+    nvsys->finishTileRebuilds();
+    NavigationManager *nvmgr = nvsys->getNavigationManager();
+    lua_pushnumber(L, nvmgr->getLastRebuildTileCount());
+    lua_pushnumber(L, nvmgr->getLastRebuildTimeMs());
+    return 2;
+TRY_END
+}
+
 static int global_navigation_add_gfx_bodies(lua_State *L)
 {
 TRY_START
@@ -130,8 +209,8 @@ static int global_add_temp_obstacle(lua_State *L)
 {
 TRY_START
     check_args(L, 1);
-    nvsys->addTempObstacle(to_ogre(check_v3(L, 1)));
-    return 0;
+    lua_pushnumber(L, nvsys->addTempObstacle(to_ogre(check_v3(L, 1))));
+    return 1;
 TRY_END
 }
 
@@ -144,6 +223,52 @@ TRY_START
 TRY_END
 }
 
+static int global_add_body_obstacle(lua_State *L)
+{
+TRY_START
+    check_args(L, 2);
+    GET_UD_MACRO(RigidBody, body, 1, "Grit/RigidBody");
+    std::string shape = check_string(L, 2);
+    bool box = shape == "BOX";
+    if (!box && shape != "CYLINDER")
+        my_lua_error(L, "Obstacle shape must be \"BOX\" or \"CYLINDER\", got: \"" + shape + "\"");
+    lua_pushboolean(L, nvsys->addBodyObstacle(&body, box));
+    return 1;
+TRY_END
+}
+
+static int global_remove_body_obstacle(lua_State *L)
+{
+TRY_START
+    check_args(L, 1);
+    GET_UD_MACRO(RigidBody, body, 1, "Grit/RigidBody");
+    lua_pushboolean(L, nvsys->removeBodyObstacle(L, &body));
+    return 1;
+TRY_END
+}
+
+static int global_set_max_obstacles(lua_State *L)
+{
+TRY_START
+    check_args(L, 1);
+    nvsys->getNavigationManager()->setMaxObstacles(check_t<int>(L, 1, 0));
+    return 0;
+TRY_END
+}
+
+static int global_obstacle_stats(lua_State *L)
+{
+TRY_START
+    check_args(L, 0);
+    NavigationManager *nvmgr = nvsys->getNavigationManager();
+    lua_pushnumber(L, nvmgr->getObstacleCount());
+    lua_pushnumber(L, nvmgr->getMaxObstacles());
+    lua_pushnumber(L, nvmgr->getPendingObstacleRequests());
+    lua_pushnumber(L, nvmgr->getPendingTileCount());
+    return 4;
+TRY_END
+}
+
 static int global_add_offmesh_connection(lua_State *L)
 {
 TRY_START
@@ -268,6 +393,26 @@ TRY_START
 TRY_END
 }
 
+static int global_navigation_find_path(lua_State *L)
+{
+TRY_START
+    check_args(L, 2);
+    Ogre::Vector3 start = swap_yz(to_ogre(check_v3(L, 1)));
+    Ogre::Vector3 end = swap_yz(to_ogre(check_v3(L, 2)));
+    std::vector<Ogre::Vector3> points;
+    if (!nvsys->findPath(start, end, points)) {
+        lua_pushnil(L);
+        return 1;
+    }
+    lua_createtable(L, points.size(), 0);
+    for (size_t i = 0; i < points.size(); ++i) {
+        push_v3(L, from_ogre(swap_yz(points[i])));
+        lua_rawseti(L, -2, i + 1);
+    }
+    return 1;
+TRY_END
+}
+
 static int global_navigation_random_navmesh_point(lua_State *L)
 {
 TRY_START
@@ -450,6 +595,13 @@ static const luaL_reg global_navigation[] = {
     { "navigation_add_gfx_body", global_navigation_add_gfx_body },
     { "navigation_add_gfx_bodies", global_navigation_add_gfx_bodies },
     { "navigation_add_rigid_body", global_navigation_add_rigid_body },
+    { "navigation_add_obj_geometry", global_navigation_add_obj_geometry },
+    { "navigation_remove_geometry", global_navigation_remove_geometry },
+    { "navigation_geometry_bounds", global_navigation_geometry_bounds },
+    { "navigation_set_geometry_cache", global_navigation_set_geometry_cache },
+    { "navigation_clear_geometry_cache", global_navigation_clear_geometry_cache },
+    { "navigation_pending_tiles", global_navigation_pending_tiles },
+    { "navigation_finish_tile_rebuilds", global_navigation_finish_tile_rebuilds },
 
     { "navigation_update", navigation_system_update },
     { "navigation_update_debug", navigation_system_update_debug },
@@ -460,6 +612,10 @@ static const luaL_reg global_navigation[] = {
     { "crowd_move_to", crowd_move_agents },
     { "navigation_add_obstacle", global_add_temp_obstacle },
     { "navigation_remove_obstacle", global_remove_temp_obstacle },
+    { "navigation_add_body_obstacle", global_add_body_obstacle },
+    { "navigation_remove_body_obstacle", global_remove_body_obstacle },
+    { "navigation_set_max_obstacles", global_set_max_obstacles },
+    { "navigation_obstacle_stats", global_obstacle_stats },
     { "navigation_add_offmesh_connection", global_add_offmesh_connection },
 
     { "navigation_add_convex_volume_point", global_add_convex_volume_point },
@@ -470,6 +626,7 @@ static const luaL_reg global_navigation[] = {
     { "navigation_update_params", global_navigation_update_params },
     { "navigation_nearest_point_on_navmesh", global_navigation_nearest_point_on_navmesh },
 
+    { "navigation_find_path", global_navigation_find_path },
     { "navigation_random_navmesh_point", global_navigation_random_navmesh_point },
     { "navigation_random_navmesh_point_in_circle", global_navigation_random_navmesh_point_in_circle },
 
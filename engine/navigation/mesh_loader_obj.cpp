@@ -77,7 +77,7 @@ void rcMeshLoaderObj::addTriangle(int a, int b, int c, int& cap)
     m_triCount++;
 }
 
-static char* parseRow(char* buf, char* bufEnd, char* row, int len)
+static const char* parseRow(const char* buf, const char* bufEnd, char* row, int len)
 {
     bool start = true;
     bool done = false;
@@ -167,14 +167,19 @@ bool rcMeshLoaderObj::load(const std::string& filename)
     size_t readLen = fread(buf, bufSize, 1, fp);
     fclose(fp);
 
-    if (readLen != 1)
-    {
-        delete[] buf;
+    const bool ok = readLen == 1 && parse(buf, bufSize);
+    delete [] buf;
+    if (!ok)
         return false;
-    }
 
-    char* src = buf;
-    char* srcEnd = buf + bufSize;
+    m_filename = filename;
+    return true;
+}
+
+bool rcMeshLoaderObj::parse(const char* buf, long bufSize)
+{
+    const char* src = buf;
+    const char* srcEnd = buf + bufSize;
     char row[512];
     int face[32];
     float x,y,z;
@@ -211,8 +216,6 @@ bool rcMeshLoaderObj::load(const std::string& filename)
         }
     }
 
-    delete [] buf;
-
     // Calculate normals.
     m_normals = new float[m_triCount*3];
     for (int i = 0; i < m_triCount*3; i += 3)
@@ -239,8 +242,7 @@ bool rcMeshLoaderObj::load(const std::string& filename)
             n[2] *= d;
         }
     }
-    
-    m_filename = filename;
+
     return true;
 }
 
@@ -249,27 +251,15 @@ bool rcMeshLoaderObj::convertGfxBody(std::vector<GfxBodyPtr> srcBodies)
 {
     // TODO: This function should probably return early if srcBodies.size() == 0?
     APP_ASSERT(srcBodies.size() > 0);
-    GfxBodyPtr ent = srcBodies[0];
-
-//Convert all vertices and triangles to recast format
-    const int numNodes = srcBodies.size();
-    size_t *meshVertexCount = new size_t[numNodes];
-    size_t *meshIndexCount = new size_t[numNodes];
-    Ogre::Vector3 **meshVertices = new Ogre::Vector3*[numNodes];
-    unsigned long **meshIndices = new unsigned long*[numNodes];
 
+    // The triangles are read from the CPU copy kept with the geometry, as the GPU buffers are
+    // write only and may be shared with other meshes.
     m_vertCount = 0;
     int index_count = 0;
-    size_t i = 0;
-    for (std::vector<GfxBodyPtr>::iterator iter = srcBodies.begin(); iter != srcBodies.end(); iter++) {
-        getMeshInformation((*iter)->mesh, meshVertexCount[i], meshVertices[i], meshIndexCount[i], meshIndices[i]);
-
-        //total number of verts
-        m_vertCount += meshVertexCount[i];
-        //total number of indices
-        index_count += meshIndexCount[i];
-
-        i++;
+    for (const GfxBodyPtr &body : srcBodies) {
+        const GfxMeshGeometryPtr &geometry = body->getGeometry();
+        m_vertCount += geometry->getPositions().size() / 3;
+        index_count += geometry->getIndexes().size();
     }
 
 // DECLARE RECAST DATA BUFFERS USING THE INFO WE GRABBED ABOVE
@@ -283,42 +273,32 @@ bool rcMeshLoaderObj::convertGfxBody(std::vector<GfxBodyPtr> srcBodies)
     int vertsIndex = 0;
     int prevVerticiesCount = 0;
     int prevIndexCountTotal = 0;
-    i = 0;
-    for (std::vector<GfxBodyPtr>::iterator iter = srcBodies.begin(); iter != srcBodies.end(); iter++) {
-        GfxBodyPtr ent = *iter;
+    for (const GfxBodyPtr &body : srcBodies) {
+        const std::vector<float> &positions = body->getGeometry()->getPositions();
+        const std::vector<uint32_t> &indexes = body->getGeometry()->getIndexes();
         //find the transform between the reference node and this node
-        Transform transform = ent->getWorldTransform();
-        Vector3 vertexPos;
-        for (size_t j = 0; j < meshVertexCount[i]; j++)
+        Transform transform = body->getWorldTransform();
+        for (size_t j = 0; j < positions.size(); j += 3)
         {
-            vertexPos = transform*from_ogre(meshVertices[i][j]);
+            Vector3 vertexPos = transform * Vector3(positions[j], positions[j+1], positions[j+2]);
             m_verts[vertsIndex + 0] = -vertexPos.x;
             m_verts[vertsIndex + 1] = vertexPos.z;
             m_verts[vertsIndex + 2] = vertexPos.y;
             vertsIndex += 3;
         }
 
-        for (size_t j = 0; j < meshIndexCount[i]; j++)
+        for (size_t j = 0; j < indexes.size(); j++)
         {
-            m_tris[prevIndexCountTotal + j] = meshIndices[i][j] + prevVerticiesCount;
+            m_tris[prevIndexCountTotal + j] = indexes[j] + prevVerticiesCount;
         }
-        prevIndexCountTotal += meshIndexCount[i];
-        prevVerticiesCount += meshVertexCount[i];
+        prevIndexCountTotal += indexes.size();
+        prevVerticiesCount += positions.size() / 3;
 
         APP_ASSERT(vertsIndex == prevVerticiesCount * 3);
-
-        i++;
     }
     APP_ASSERT(prevVerticiesCount == m_vertCount);
     APP_ASSERT(prevIndexCountTotal == m_triCount * 3);
 
-    //delete tempory arrays
-    //TODO These probably could member variables, this would increase performance slightly
-    delete[] meshVertices;
-    delete[] meshIndices;
-    delete[] meshVertexCount;
-    delete[] meshIndexCount;
-
     m_normals = new float[m_triCount * 3];
     for (int i = 0; i < m_triCount * 3; i += 3)
     {
@@ -348,119 +328,6 @@ bool rcMeshLoaderObj::convertGfxBody(std::vector<GfxBodyPtr> srcBodies)
     return true;
 }
 
-// Get the mesh information for the given mesh.  Code found on this Wiki link:
-// http://www.ogre3d.org/tikiwiki/RetrieveVertexData
-void getMeshInformation(const Ogre::MeshPtr mesh, size_t &vertex_count, Ogre::Vector3* &vertices,
-    size_t &index_count, unsigned long* &indices, const Ogre::Vector3 &position,
-    const Ogre::Quaternion &orient, const Ogre::Vector3 &scale)
-{
-    bool added_shared = false;
-    size_t current_offset = 0;
-    size_t shared_offset = 0;
-    size_t next_offset = 0;
-    size_t index_offset = 0;
-
-    vertex_count = index_count = 0;
-
-    // Calculate how many vertices and indices we're going to need
-    for (unsigned short i = 0; i < mesh->getNumSubMeshes(); ++i)
-    {
-        Ogre::SubMesh* submesh = mesh->getSubMesh(i);
-        // We only need to add the shared vertices once
-        if (submesh->useSharedVertices)
-        {
-            if (!added_shared)
-            {
-                vertex_count += mesh->sharedVertexData->vertexCount;
-                added_shared = true;
-            }
-        }
-        else
-        {
-            vertex_count += submesh->vertexData->vertexCount;
-        }
-        // Add the indices
-        index_count += submesh->indexData->indexCount;
-    }
-
-    // Allocate space for the vertices and indices
-    vertices = new Ogre::Vector3[vertex_count];
-    indices = new unsigned long[index_count];
-
-    added_shared = false;
-
-    // Run through the submeshes again, adding the data into the arrays
-    for (unsigned short i = 0; i < mesh->getNumSubMeshes(); ++i)
-    {
-        Ogre::SubMesh* submesh = mesh->getSubMesh(i);
-
-        Ogre::VertexData* vertex_data = submesh->useSharedVertices ? mesh->sharedVertexData : submesh->vertexData;
-
-        if ((!submesh->useSharedVertices) || (submesh->useSharedVertices && !added_shared))
-        {
-            if (submesh->useSharedVertices)
-            {
-                added_shared = true;
-                shared_offset = current_offset;
-            }
-
-            const Ogre::VertexElement* posElem =
-                vertex_data->vertexDeclaration->findElementBySemantic(Ogre::VES_POSITION);
-
-            Ogre::HardwareVertexBufferSharedPtr vbuf =
-                vertex_data->vertexBufferBinding->getBuffer(posElem->getSource());
-
-            unsigned char* vertex =
-                static_cast<unsigned char*>(vbuf->lock(Ogre::HardwareBuffer::HBL_READ_ONLY));
-
-            // There is _no_ baseVertexPointerToElement() which takes an Ogre::Real or a double
-            //  as second argument. So make it float, to avoid trouble when Ogre::Real will
-            //  be comiled/typedefed as double:
-            //Ogre::Real* pReal;
-            float* pReal;
-
-            for (size_t j = 0; j < vertex_data->vertexCount; ++j, vertex += vbuf->getVertexSize())
-            {
-                posElem->baseVertexPointerToElement(vertex, &pReal);
-                Ogre::Vector3 pt(pReal[0], pReal[1], pReal[2]);
-                vertices[current_offset + j] = (orient * (pt * scale)) + position;
-            }
-
-            vbuf->unlock();
-            next_offset += vertex_data->vertexCount;
-        }
-
-
-        Ogre::IndexData* index_data = submesh->indexData;
-        size_t numTris = index_data->indexCount / 3;
-        Ogre::HardwareIndexBufferSharedPtr ibuf = index_data->indexBuffer;
-
-        bool use32bitindexes = (ibuf->getType() == Ogre::HardwareIndexBuffer::IT_32BIT);
-
-        size_t offset = (submesh->useSharedVertices) ? shared_offset : current_offset;
-
-        if (use32bitindexes)
-        {
-            auto *pLong = static_cast<uint32_t*>(ibuf->lock(Ogre::HardwareBuffer::HBL_READ_ONLY));
-            for (size_t k = 0; k < numTris * 3; ++k)
-            {
-                indices[index_offset++] = pLong[k] + offset;
-            }
-        }
-        else
-        {
-            auto *pShort = static_cast<uint16_t*>(ibuf->lock(Ogre::HardwareBuffer::HBL_READ_ONLY));
-            for (size_t k = 0; k < numTris * 3; ++k)
-            {
-                indices[index_offset++] = static_cast<unsigned long>(pShort[k]) + offset;
-            }
-        }
-
-        ibuf->unlock();
-        current_offset = next_offset;
-    }
-}
-
 // TODO
 bool rcMeshLoaderObj::convertRigidBody(std::vector<RigidBody*> srcBodies)
 {
@@ -28,6 +28,8 @@ public:
     ~rcMeshLoaderObj();
     
     bool load(const std::string& fileName);
+    /// Parses the contents of an obj file that has already been read.
+    bool parse(const char* buf, long bufSize);
 
     bool convertGfxBody(std::vector<GfxBodyPtr> srcBodies);
     bool convertRigidBody(std::vector<RigidBody*> srcBodies);
@@ -56,13 +58,4 @@ private:
     int m_triCount;
 };
 
-extern void getMeshInformation(const Ogre::MeshPtr mesh,
-    size_t &vertex_count,
-    Ogre::Vector3* &vertices,
-    size_t &index_count,
-    unsigned long* &indices,
-    const Ogre::Vector3 &position = Ogre::Vector3::ZERO,
-    const Ogre::Quaternion &orient = Ogre::Quaternion::IDENTITY,
-    const Ogre::Vector3 &scale = Ogre::Vector3::UNIT_SCALE);
-
 #endif // MESHLOADER_OBJ
@@ -119,9 +119,9 @@ void NavigationSystem::init()
     nvmgr->setContext(&ctx);
 }
 
-void navigation_update(const float tslf)
+void navigation_update(lua_State *L, const float tslf)
 {
-    nvsys->Update(tslf);
+    nvsys->Update(L, tslf);
 }
 
 void navigation_update_debug(const float tslf)
@@ -129,8 +129,9 @@ void navigation_update_debug(const float tslf)
     nvsys->updateDebug(tslf);
 }
 
-void NavigationSystem::Update(const Ogre::Real tslf)
+void NavigationSystem::Update(lua_State *L, const Ogre::Real tslf)
 {
+    updateBodyObstacles(L);
     nvmgr->update(tslf);
 }
 
@@ -185,23 +186,6 @@ void NavigationSystem::addObj(const char* mesh_name)
     }
 }
 
-void NavigationSystem::addGfxBody(GfxBodyPtr bd)
-{
-    delete geom;
-    geom = 0;
-
-    std::vector<GfxBodyPtr> yu;
-    yu.push_back(bd);
-
-    geom = new InputGeom;
-    if (!geom || !geom->loadGfxBody(&ctx, yu))
-    {
-        delete geom;
-        geom = 0;
-    }
-    nvmgr->changeMesh(geom);
-}
-
 void NavigationSystem::addGfxBodies(std::vector<GfxBodyPtr> bds)
 {
     delete geom;
@@ -233,21 +217,163 @@ void NavigationSystem::addRigidBody(RigidBody *bd)
     nvmgr->changeMesh(geom);
 }
 
-void NavigationSystem::addTempObstacle(Ogre::Vector3 pos)
+void NavigationSystem::ensureGeom()
+{
+    if (!geom)
+    {
+        geom = new InputGeom;
+        nvmgr->changeMesh(geom);
+    }
+}
+
+void NavigationSystem::sourceAdded(int id)
+{
+    float bmin[3], bmax[3];
+    if (geom->getSourceBounds(id, bmin, bmax))
+        nvmgr->markTilesDirty(bmin, bmax);
+}
+
+int NavigationSystem::addGfxBody(GfxBodyPtr bd)
+{
+    ensureGeom();
+    int id = geom->addGfxBody(&ctx, bd);
+    sourceAdded(id);
+    return id;
+}
+
+int NavigationSystem::addObjGeometry(const char* mesh_name)
+{
+    ensureGeom();
+    int id = geom->addMesh(&ctx, std::string("./") + mesh_name);
+    sourceAdded(id);
+    return id;
+}
+
+bool NavigationSystem::getGeometryBounds(int id, float* bmin, float* bmax)
+{
+    return geom && geom->getSourceBounds(id, bmin, bmax);
+}
+
+bool NavigationSystem::removeGeometry(int id)
+{
+    float bmin[3], bmax[3];
+    if (!geom || !geom->removeSource(id, bmin, bmax))
+        return false;
+    nvmgr->markTilesDirty(bmin, bmax);
+    return true;
+}
+
+int NavigationSystem::pendingTileCount()
+{
+    return nvmgr->getPendingTileCount();
+}
+
+void NavigationSystem::finishTileRebuilds()
+{
+    nvmgr->finishTileRebuilds();
+}
+
+int NavigationSystem::addTempObstacle(Ogre::Vector3 pos)
 {
     if (anyNavmeshLoaded())
     {
-        nvmgr->addTempObstacle(Vec3ToFloat(swap_yz(pos)));
+        Ogre::Vector3 p = swap_yz(pos);
+        return nvmgr->addTempObstacle(p.ptr());
     }
+    return 0;
 }
 
-// TODO
 void NavigationSystem::removeTempObstacle(Ogre::Vector3 pos)
 {
-    (void) pos;
     if (anyNavmeshLoaded())
     {
-        //nvmgr->removeTempObstacle(Vec3ToFloat(swap_yz(pos)));
+        // Remove the first obstacle on a vertical line through the point.
+        Ogre::Vector3 p = swap_yz(pos);
+        float sp[3] = { p.x, p.y + 100.0f, p.z };
+        float sq[3] = { p.x, p.y - 100.0f, p.z };
+        nvmgr->removeTempObstacle(sp, sq);
+    }
+}
+
+bool NavigationSystem::addBodyObstacle(RigidBody *body, bool box)
+{
+    for (unsigned i = 0; i < bodyObstacles.size(); ++i)
+    {
+        if (bodyObstacles[i].body == body)
+            return false;
+    }
+    body->incRefCount();
+    BodyObstacle ob;
+    ob.body = body;
+    ob.box = box;
+    ob.id = 0;
+    bodyObstacles.push_back(ob);
+    return true;
+}
+
+bool NavigationSystem::removeBodyObstacle(lua_State *L, RigidBody *body)
+{
+    for (unsigned i = 0; i < bodyObstacles.size(); ++i)
+    {
+        if (bodyObstacles[i].body != body)
+            continue;
+        if (bodyObstacles[i].id != 0)
+            nvmgr->removeObstacle(bodyObstacles[i].id);
+        bodyObstacles.erase(bodyObstacles.begin() + i);
+        body->decRefCount(L);
+        return true;
+    }
+    return false;
+}
+
+// Bodies that settle are still nudged by the solver, so small changes are ignored.
+static const float BODY_OBSTACLE_TOLERANCE = 0.1f;
+
+void NavigationSystem::updateBodyObstacles(lua_State *L)
+{
+    for (unsigned i = 0; i < bodyObstacles.size(); )
+    {
+        BodyObstacle &ob = bodyObstacles[i];
+
+        if (ob.body->destroyed())
+        {
+            if (ob.id != 0)
+                nvmgr->removeObstacle(ob.id);
+            RigidBody *body = ob.body;
+            bodyObstacles.erase(bodyObstacles.begin() + i);
+            body->decRefCount(L);
+            continue;
+        }
+        i++;
+
+        if (ob.body->isActive())
+        {
+            if (ob.id != 0)
+                nvmgr->removeObstacle(ob.id);
+            ob.id = 0;
+            continue;
+        }
+
+        Vector3 gmin, gmax;
+        ob.body->getBounds(gmin, gmax);
+        // swap_yz negates x, so the corners swap over in that axis.
+        Ogre::Vector3 min(-gmax.x, gmin.z, gmin.y);
+        Ogre::Vector3 max(-gmin.x, gmax.z, gmax.y);
+
+        if (ob.id != 0)
+        {
+            if (min.positionEquals(ob.min, BODY_OBSTACLE_TOLERANCE)
+                && max.positionEquals(ob.max, BODY_OBSTACLE_TOLERANCE))
+                continue;
+            nvmgr->moveObstacle(ob.id, min.ptr(), max.ptr());
+        }
+        else
+        {
+            // If there is no room, try again next time.
+            ob.id = nvmgr->addObstacle(ob.box ? NAV_OBSTACLE_BOX : NAV_OBSTACLE_CYLINDER, min.ptr(), max.ptr());
+        }
+        ob.min = min;
+        ob.max = max;
     }
 }
 
@@ -311,6 +437,36 @@ bool NavigationSystem::findNearestPointOnNavmesh(Ogre::Vector3 pos, dtPolyRef &t
     return false;
 }
 
+bool NavigationSystem::findPath(Ogre::Vector3 start, Ogre::Vector3 end, std::vector<Ogre::Vector3> &points)
+{
+    points.clear();
+    if (!anyNavmeshLoaded())
+        return false;
+
+    dtNavMeshQuery* navquery = nvmgr->getNavMeshQuery();
+    const dtQueryFilter* filter = nvmgr->getCrowd()->getFilter(0);
+    dtPolyRef start_ref, end_ref;
+    Ogre::Vector3 start_pos, end_pos;
+    if (!findNearestPointOnNavmesh(start, start_ref, start_pos))
+        return false;
+    if (!findNearestPointOnNavmesh(end, end_ref, end_pos))
+        return false;
+
+    static const int MAX_POLYS = 256;
+    dtPolyRef polys[MAX_POLYS];
+    int npolys = 0;
+    navquery->findPath(start_ref, end_ref, start_pos.ptr(), end_pos.ptr(), filter, polys, &npolys, MAX_POLYS);
+    if (npolys == 0)
+        return false;
+
+    float straight[MAX_POLYS * 3];
+    int nstraight = 0;
+    navquery->findStraightPath(start_pos.ptr(), end_pos.ptr(), polys, npolys, straight, NULL, NULL, &nstraight, MAX_POLYS);
+    for (int i = 0; i < nstraight; ++i)
+        points.push_back(Ogre::Vector3(&straight[i * 3]));
+    return nstraight > 0;
+}
+
 static float frand()
 {
     return (float)rand() / (float)RAND_MAX;
@@ -487,8 +643,13 @@ bool NavigationSystem::loadNavmesh(const char* path)
     }
 }
 
-void NavigationSystem::reset()
+void NavigationSystem::reset(lua_State *L)
 {
+    for (unsigned i = 0; i < bodyObstacles.size(); ++i)
+        bodyObstacles[i].body->decRefCount(L);
+    bodyObstacles.clear();
+    nvmgr->clearAllTempObstacles();
+
     delete geom;
     geom = 0;
     NavSysDebug::clearAllObjects();
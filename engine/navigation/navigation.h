@@ -33,22 +33,37 @@ public:
     ~NavigationSystem(void);
 
     void init();
-    void Update(const Ogre::Real tslf);
+    void Update(lua_State *L, const Ogre::Real tslf);
     void updateDebug(const Ogre::Real tslf);
 
-    void reset(void);
+    void reset(lua_State *L);
 
     void set_dest_pos(Ogre::Vector3 pos);
     void buildNavMesh();
 
     void addObj(const char* mesh_name);
-    void addGfxBody(GfxBodyPtr bd);
     void addGfxBodies(std::vector<GfxBodyPtr> bds);
     void addRigidBody(RigidBody *bd);
 
-    void addTempObstacle(Ogre::Vector3 pos);
+    // Add geometry to what is already there, returning an id for removeGeometry (0 on failure).
+    // If the navmesh is built, only the tiles the geometry touches are rebuilt.
+    int addGfxBody(GfxBodyPtr bd);
+    int addObjGeometry(const char* mesh_name);
+    bool removeGeometry(int id);
+    // The bounds of geometry that was added, in Recast coordinates.  False if there is no such id.
+    bool getGeometryBounds(int id, float* bmin, float* bmax);
+    int pendingTileCount(void);
+    void finishTileRebuilds(void);
+
+    int addTempObstacle(Ogre::Vector3 pos);
     void removeTempObstacle(Ogre::Vector3 pos);
 
+    // Make the body an obstacle (a box or a vertical cylinder filling its bounds) whenever it
+    // is at rest.  While it moves it is not an obstacle, so the navmesh is not rebuilt every
+    // frame.  Returns false if the body is already an obstacle.
+    bool addBodyObstacle(RigidBody *body, bool box);
+    bool removeBodyObstacle(lua_State *L, RigidBody *body);
+
     void addOffmeshConection(Ogre::Vector3 pos, Ogre::Vector3 pos2, bool bidir);
     void removeOffmeshConection(Ogre::Vector3 pos);
 
@@ -59,6 +74,9 @@ public:
     bool loadNavmesh(const char* path);
 
     bool findNearestPointOnNavmesh(Ogre::Vector3 pos, dtPolyRef& m_targetRef, Ogre::Vector3 &resultPoint);
+    // The corners of the shortest path between the points nearest to start and end, in Recast
+    // coordinates.  False if there is no path.
+    bool findPath(Ogre::Vector3 start, Ogre::Vector3 end, std::vector<Ogre::Vector3> &points);
     bool getRandomNavMeshPoint(Ogre::Vector3 &resultPoint);
     bool getRandomNavMeshPointInCircle(Ogre::Vector3 point, float radius, Ogre::Vector3 &resultPoint);
 
@@ -82,6 +100,21 @@ public:
 
     NavigationManager* getNavigationManager(void) { return nvmgr; };
 protected:
+    struct BodyObstacle
+    {
+        RigidBody *body;
+        bool box;
+        // 0 while the body is moving, or if there was no room for it.
+        int id;
+        // Recast space bounds when it was last added or moved.
+        Ogre::Vector3 min, max;
+    };
+    std::vector<BodyObstacle> bodyObstacles;
+
+    void updateBodyObstacles(lua_State *L);
+    void ensureGeom(void);
+    void sourceAdded(int id);
+
     NavigationManager* nvmgr;
     BuildContext ctx;
 
@@ -23,7 +23,11 @@
 #include <stdio.h>
 #include <string.h>
 #include <float.h>
+#include <atomic>
 #include <new>
+#include <thread>
+#include <vector>
+#include <sleep.h>
 #include "input_geom.h"
 #include "navigation_manager.h"
 #include "Recast.h"
@@ -34,10 +38,11 @@
 #include "DetourDebugDraw.h"
 #include "DetourCommon.h"
 #include "DetourTileCache.h"
+#include "DetourTileCacheBuilder.h"
 #include "crowd_manager.h"
 #include "RecastAlloc.h"
 #include "RecastAssert.h"
-#include "fastlz.h"
+#include "../fastlz.h"
 
 #include "DetourNavMeshQuery.h"
 #include "DetourCrowd.h"
@@ -167,6 +172,32 @@ struct LinearAllocator : public dtTileCacheAlloc
     }
 };
 
+// Update poly flags from areas.
+static void setPolyFlags(const struct dtNavMeshCreateParams* params,
+                         unsigned char* polyAreas, unsigned short* polyFlags)
+{
+    for (int i = 0; i < params->polyCount; ++i)
+    {
+        if (polyAreas[i] == DT_TILECACHE_WALKABLE_AREA)
+            polyAreas[i] = SAMPLE_POLYAREA_GROUND;
+
+        if (polyAreas[i] == SAMPLE_POLYAREA_GROUND ||
+            polyAreas[i] == SAMPLE_POLYAREA_GRASS ||
+            polyAreas[i] == SAMPLE_POLYAREA_ROAD)
+        {
+            polyFlags[i] = SAMPLE_POLYFLAGS_WALK;
+        }
+        else if (polyAreas[i] == SAMPLE_POLYAREA_WATER)
+        {
+            polyFlags[i] = SAMPLE_POLYFLAGS_SWIM;
+        }
+        else if (polyAreas[i] == SAMPLE_POLYAREA_DOOR)
+        {
+            polyFlags[i] = SAMPLE_POLYFLAGS_WALK | SAMPLE_POLYFLAGS_DOOR;
+        }
+    }
+}
+
 struct MeshProcess : public dtTileCacheMeshProcess
 {
     InputGeom* m_geom;
@@ -183,27 +214,7 @@ struct MeshProcess : public dtTileCacheMeshProcess
     virtual void process(struct dtNavMeshCreateParams* params,
                          unsigned char* polyAreas, unsigned short* polyFlags)
     {
-        // Update poly flags from areas.
-        for (int i = 0; i < params->polyCount; ++i)
-        {
-            if (polyAreas[i] == DT_TILECACHE_WALKABLE_AREA)
-                polyAreas[i] = SAMPLE_POLYAREA_GROUND;
-
-            if (polyAreas[i] == SAMPLE_POLYAREA_GROUND ||
-                polyAreas[i] == SAMPLE_POLYAREA_GRASS ||
-                polyAreas[i] == SAMPLE_POLYAREA_ROAD)
-            {
-                polyFlags[i] = SAMPLE_POLYFLAGS_WALK;
-            }
-            else if (polyAreas[i] == SAMPLE_POLYAREA_WATER)
-            {
-                polyFlags[i] = SAMPLE_POLYFLAGS_SWIM;
-            }
-            else if (polyAreas[i] == SAMPLE_POLYAREA_DOOR)
-            {
-                polyFlags[i] = SAMPLE_POLYFLAGS_WALK | SAMPLE_POLYFLAGS_DOOR;
-            }
-        }
+        setPolyFlags(params, polyAreas, polyFlags);
 
         // Pass in off-mesh connections.
         if (m_geom)
@@ -219,6 +230,47 @@ struct MeshProcess : public dtTileCacheMeshProcess
     }
 };
 
+/// Like MeshProcess, but with its own copy of the off-mesh connections, for building tiles on
+/// worker threads while the InputGeom changes.
+struct OffMeshSnapshot : public dtTileCacheMeshProcess
+{
+    std::vector<float> verts;
+    std::vector<float> rads;
+    std::vector<unsigned char> dirs;
+    std::vector<unsigned char> areas;
+    std::vector<unsigned short> flags;
+    std::vector<unsigned int> ids;
+
+    void init(const InputGeom* geom)
+    {
+        const int n = geom ? geom->getOffMeshConnectionCount() : 0;
+        if (n == 0)
+            return;
+        verts.assign(geom->getOffMeshConnectionVerts(), geom->getOffMeshConnectionVerts() + n*6);
+        rads.assign(geom->getOffMeshConnectionRads(), geom->getOffMeshConnectionRads() + n);
+        dirs.assign(geom->getOffMeshConnectionDirs(), geom->getOffMeshConnectionDirs() + n);
+        areas.assign(geom->getOffMeshConnectionAreas(), geom->getOffMeshConnectionAreas() + n);
+        flags.assign(geom->getOffMeshConnectionFlags(), geom->getOffMeshConnectionFlags() + n);
+        ids.assign(geom->getOffMeshConnectionId(), geom->getOffMeshConnectionId() + n);
+    }
+
+    virtual void process(struct dtNavMeshCreateParams* params,
+                         unsigned char* polyAreas, unsigned short* polyFlags)
+    {
+        setPolyFlags(params, polyAreas, polyFlags);
+
+        if (rads.empty())
+            return;
+        params->offMeshConVerts = &verts[0];
+        params->offMeshConRad = &rads[0];
+        params->offMeshConDir = &dirs[0];
+        params->offMeshConAreas = &areas[0];
+        params->offMeshConFlags = &flags[0];
+        params->offMeshConUserID = &ids[0];
+        params->offMeshConCount = (int)rads.size();
+    }
+};
+
 static const int MAX_LAYERS = 32;
 
 struct TileCacheData
@@ -260,41 +312,108 @@ struct RasterizationContext
     int ntiles;
 };
 
-static int rasterizeTileLayers(BuildContext* ctx, InputGeom* geom,
-                               const int tx, const int ty,
+/// Everything needed to rebuild a tile, copied so that it can be done on a worker thread while
+/// the InputGeom and obstacles change.  If the geometry has not changed, the tile is not
+/// rasterised again, and its navmesh is built from copies of the layers in the tile cache.
+struct TileInput
+{
+    int tx, ty;
+    bool rasterize;
+    std::vector<InputGeomSourcePtr> sources;
+    std::vector<ConvexVolume> volumes;
+    std::vector<TileCacheData> layers;
+    std::vector<NavObstacle> obstacles;
+
+    TileInput() : tx(0), ty(0), rasterize(false)
+    {
+    }
+};
+
+// The area rasterised for a tile, including the border shared with its neighbours.
+static void calcTileBounds(const rcConfig& cfg, const int tx, const int ty, float* bmin, float* bmax)
+{
+    const float tcs = cfg.tileSize * cfg.cs;
+    bmin[0] = cfg.bmin[0] + tx*tcs - cfg.borderSize*cfg.cs;
+    bmin[1] = cfg.bmin[1];
+    bmin[2] = cfg.bmin[2] + ty*tcs - cfg.borderSize*cfg.cs;
+    bmax[0] = cfg.bmin[0] + (tx+1)*tcs + cfg.borderSize*cfg.cs;
+    bmax[1] = cfg.bmax[1];
+    bmax[2] = cfg.bmin[2] + (ty+1)*tcs + cfg.borderSize*cfg.cs;
+}
+
+static void gatherTileInput(const InputGeom* geom, const rcConfig& cfg, const int tx, const int ty,
+                            TileInput& input)
+{
+    input.tx = tx;
+    input.ty = ty;
+    float bmin[3], bmax[3];
+    calcTileBounds(cfg, tx, ty, bmin, bmax);
+    geom->getSourcesOverlapping(bmin, bmax, input.sources);
+    const ConvexVolume* vols = geom->getConvexVolumes();
+    input.volumes.assign(vols, vols + geom->getConvexVolumeCount());
+}
+
+static void copyTileLayers(const dtTileCache* tc, const int tx, const int ty,
+                           std::vector<TileCacheData>& layers)
+{
+    dtCompressedTileRef refs[MAX_LAYERS];
+    const int n = tc->getTilesAt(tx, ty, refs, MAX_LAYERS);
+    for (int i = 0; i < n; ++i)
+    {
+        const dtCompressedTile* tile = tc->getTileByRef(refs[i]);
+        TileCacheData copy;
+        copy.dataSize = tile->dataSize;
+        copy.data = (unsigned char*)dtAlloc(copy.dataSize, DT_ALLOC_PERM);
+        if (!copy.data)
+            continue;
+        memcpy(copy.data, tile->data, copy.dataSize);
+        layers.push_back(copy);
+    }
+}
+
+// The obstacles over a tile, grown by the agent radius because the layers have already been
+// eroded.
+static void gatherTileObstacles(const std::map<int, NavObstacle>& obstacles,
+                                const dtTileCacheParams& params, const int tx, const int ty,
+                                std::vector<NavObstacle>& out)
+{
+    const float tcs = params.width * params.cs;
+    const float tbmin[2] = { params.orig[0] + tx*tcs, params.orig[2] + ty*tcs };
+    const float tbmax[2] = { tbmin[0] + tcs, tbmin[1] + tcs };
+    const float r = params.walkableRadius;
+    for (std::map<int, NavObstacle>::const_iterator i = obstacles.begin(); i != obstacles.end(); ++i)
+    {
+        NavObstacle ob = i->second;
+        ob.bmin[0] -= r;
+        ob.bmin[2] -= r;
+        ob.bmax[0] += r;
+        ob.bmax[2] += r;
+        if (ob.bmin[0] > tbmax[0] || ob.bmax[0] < tbmin[0] ||
+            ob.bmin[2] > tbmax[1] || ob.bmax[2] < tbmin[1])
+            continue;
+        out.push_back(ob);
+    }
+}
+
+static int rasterizeTileLayers(rcContext* ctx, const TileInput& input,
                                const rcConfig& cfg,
                                TileCacheData* tiles,
                                const int maxTiles)
 {
-    if (!geom || !geom->getMesh() || !geom->getChunkyMesh())
+    if (input.sources.empty())
     {
-        ctx->log(RC_LOG_ERROR, "buildTile: Input mesh is not specified.");
-        return 0;
+        return 0; // empty
     }
     
     FastLZCompressor comp;
     RasterizationContext rc;
     
-    const float* verts = geom->getMesh()->getVerts();
-    const int nverts = geom->getMesh()->getVertCount();
-    const rcChunkyTriMesh* chunkyMesh = geom->getChunkyMesh();
-    
-    // Tile bounds.
-    const float tcs = cfg.tileSize * cfg.cs;
+    const int tx = input.tx;
+    const int ty = input.ty;
     
     rcConfig tcfg;
     memcpy(&tcfg, &cfg, sizeof(tcfg));
-
-    tcfg.bmin[0] = cfg.bmin[0] + tx*tcs;
-    tcfg.bmin[1] = cfg.bmin[1];
-    tcfg.bmin[2] = cfg.bmin[2] + ty*tcs;
-    tcfg.bmax[0] = cfg.bmin[0] + (tx+1)*tcs;
-    tcfg.bmax[1] = cfg.bmax[1];
-    tcfg.bmax[2] = cfg.bmin[2] + (ty+1)*tcs;
-    tcfg.bmin[0] -= tcfg.borderSize*tcfg.cs;
-    tcfg.bmin[2] -= tcfg.borderSize*tcfg.cs;
-    tcfg.bmax[0] += tcfg.borderSize*tcfg.cs;
-    tcfg.bmax[2] += tcfg.borderSize*tcfg.cs;
+    calcTileBounds(cfg, tx, ty, tcfg.bmin, tcfg.bmax);
     
     // Allocate voxel heightfield where we rasterize our input data to.
     rc.solid = rcAllocHeightfield();
@@ -309,13 +428,14 @@ static int rasterizeTileLayers(BuildContext* ctx, InputGeom* geom,
         return 0;
     }
     
-    // Allocate array that can hold triangle flags.
-    // If you have multiple meshes you need to process, allocate
-    // and array which can hold the max number of triangles you need to process.
-    rc.triareas = new unsigned char[chunkyMesh->maxTrisPerChunk];
+    // Allocate array that can hold triangle flags, enough for the largest chunk of any source.
+    int maxTrisPerChunk = 0;
+    for (const auto& source : input.sources)
+        maxTrisPerChunk = rcMax(maxTrisPerChunk, source->chunkyMesh->maxTrisPerChunk);
+    rc.triareas = new unsigned char[maxTrisPerChunk];
     if (!rc.triareas)
     {
-        ctx->log(RC_LOG_ERROR, "buildNavigation: Out of memory 'm_triareas' (%d).", chunkyMesh->maxTrisPerChunk);
+        ctx->log(RC_LOG_ERROR, "buildNavigation: Out of memory 'm_triareas' (%d).", maxTrisPerChunk);
         return 0;
     }
     
@@ -324,25 +444,36 @@ static int rasterizeTileLayers(BuildContext* ctx, InputGeom* geom,
     tbmin[1] = tcfg.bmin[2];
     tbmax[0] = tcfg.bmax[0];
     tbmax[1] = tcfg.bmax[2];
-    int cid[512];// TODO: Make grow when returning too many items.
-    const int ncid = rcGetChunksOverlappingRect(chunkyMesh, tbmin, tbmax, cid, 512);
-    if (!ncid)
+    int totalChunks = 0;
+    for (const auto& source : input.sources)
     {
-        return 0; // empty
+        const float* verts = source->getVerts();
+        const int nverts = source->getVertCount();
+        const unsigned char* areas = source->getTriAreas();
+        const rcChunkyTriMesh* chunkyMesh = source->chunkyMesh;
+
+        int cid[512];// TODO: Make grow when returning too many items.
+        const int ncid = rcGetChunksOverlappingRect(chunkyMesh, tbmin, tbmax, cid, 512);
+        totalChunks += ncid;
+
+        for (int i = 0; i < ncid; ++i)
+        {
+            const rcChunkyTriMeshNode& node = chunkyMesh->nodes[cid[i]];
+            const int* tris = &chunkyMesh->tris[node.i*3];
+            const int ntris = node.n;
+            
+            // Start from the areas of the source, then clear those too steep to walk on.
+            memcpy(rc.triareas, &areas[node.i], ntris*sizeof(unsigned char));
+            rcClearUnwalkableTriangles(ctx, tcfg.walkableSlopeAngle,
+                                       verts, nverts, tris, ntris, rc.triareas);
+            
+            if (!rcRasterizeTriangles(ctx, verts, nverts, tris, rc.triareas, ntris, *rc.solid, tcfg.walkableClimb))
+                return 0;
+        }
     }
-    
-    for (int i = 0; i < ncid; ++i)
+    if (!totalChunks)
     {
-        const rcChunkyTriMeshNode& node = chunkyMesh->nodes[cid[i]];
-        const int* tris = &chunkyMesh->tris[node.i*3];
-        const int ntris = node.n;
-        
-        memset(rc.triareas, 0, ntris*sizeof(unsigned char));
-        rcMarkWalkableTriangles(ctx, tcfg.walkableSlopeAngle,
-                                verts, nverts, tris, ntris, rc.triareas);
-        
-        if (!rcRasterizeTriangles(ctx, verts, nverts, tris, rc.triareas, ntris, *rc.solid, tcfg.walkableClimb))
-            return 0;
+        return 0; // empty
     }
     
     // Once all geometry is rasterized, we do initial pass of filtering to
@@ -373,8 +504,8 @@ static int rasterizeTileLayers(BuildContext* ctx, InputGeom* geom,
     }
     
     // (Optional) Mark areas.
-    const ConvexVolume* vols = geom->getConvexVolumes();
-    for (int i  = 0; i < geom->getConvexVolumeCount(); ++i)
+    const ConvexVolume* vols = input.volumes.empty() ? 0 : &input.volumes[0];
+    for (int i  = 0; i < (int)input.volumes.size(); ++i)
     {
         rcMarkConvexPolyArea(ctx, vols[i].verts, vols[i].nverts,
                              vols[i].hmin, vols[i].hmax,
@@ -441,6 +572,217 @@ static int rasterizeTileLayers(BuildContext* ctx, InputGeom* geom,
     return n;
 }
 
+struct LayerBuildContext
+{
+    inline LayerBuildContext(struct dtTileCacheAlloc* a) : layer(0), lcset(0), lmesh(0), alloc(a) {}
+    inline ~LayerBuildContext()
+    {
+        dtFreeTileCacheLayer(alloc, layer);
+        dtFreeTileCacheContourSet(alloc, lcset);
+        dtFreeTileCachePolyMesh(alloc, lmesh);
+    }
+    struct dtTileCacheLayer* layer;
+    struct dtTileCacheContourSet* lcset;
+    struct dtTileCachePolyMesh* lmesh;
+    struct dtTileCacheAlloc* alloc;
+};
+
+/// Build the navmesh data for one compressed tile cache layer, cutting out the obstacles.  This
+/// is what dtTileCache::buildNavMeshTile does, but it only touches its arguments, so it can run
+/// on a worker thread.  The data is left null if the layer has no polygons.
+static dtStatus buildNavMeshLayer(dtTileCacheAlloc* alloc, dtTileCacheCompressor* comp,
+                                  const dtTileCacheParams& params, dtTileCacheMeshProcess* proc,
+                                  const TileCacheData& layer, const std::vector<NavObstacle>& obstacles,
+                                  TileCacheData& out)
+{
+    out.data = 0;
+    out.dataSize = 0;
+
+    alloc->reset();
+    LayerBuildContext bc(alloc);
+    const int walkableClimbVx = (int)(params.walkableClimb / params.ch);
+    dtStatus status;
+
+    status = dtDecompressTileCacheLayer(alloc, comp, layer.data, layer.dataSize, &bc.layer);
+    if (dtStatusFailed(status))
+        return status;
+    const dtTileCacheLayerHeader* header = bc.layer->header;
+
+    for (size_t i = 0; i < obstacles.size(); ++i)
+    {
+        const NavObstacle& ob = obstacles[i];
+        if (ob.bmin[0] > header->bmax[0] || ob.bmax[0] < header->bmin[0] ||
+            ob.bmin[1] > header->bmax[1] || ob.bmax[1] < header->bmin[1] ||
+            ob.bmin[2] > header->bmax[2] || ob.bmax[2] < header->bmin[2])
+            continue;
+        if (ob.type == NAV_OBSTACLE_BOX)
+        {
+            status = dtMarkBoxArea(*bc.layer, header->bmin, params.cs, params.ch, ob.bmin, ob.bmax, 0);
+        }
+        else
+        {
+            float pos[3];
+            pos[0] = (ob.bmin[0] + ob.bmax[0]) * 0.5f;
+            pos[1] = ob.bmin[1];
+            pos[2] = (ob.bmin[2] + ob.bmax[2]) * 0.5f;
+            const float radius = dtMax(ob.bmax[0] - ob.bmin[0], ob.bmax[2] - ob.bmin[2]) * 0.5f;
+            status = dtMarkCylinderArea(*bc.layer, header->bmin, params.cs, params.ch,
+                                        pos, radius, ob.bmax[1] - ob.bmin[1], 0);
+        }
+        if (dtStatusFailed(status))
+            return status;
+    }
+
+    status = dtBuildTileCacheRegions(alloc, *bc.layer, walkableClimbVx);
+    if (dtStatusFailed(status))
+        return status;
+
+    bc.lcset = dtAllocTileCacheContourSet(alloc);
+    if (!bc.lcset)
+        return DT_FAILURE | DT_OUT_OF_MEMORY;
+    status = dtBuildTileCacheContours(alloc, *bc.layer, walkableClimbVx,
+                                      params.maxSimplificationError, *bc.lcset);
+    if (dtStatusFailed(status))
+        return status;
+
+    bc.lmesh = dtAllocTileCachePolyMesh(alloc);
+    if (!bc.lmesh)
+        return DT_FAILURE | DT_OUT_OF_MEMORY;
+    status = dtBuildTileCachePolyMesh(alloc, *bc.lcset, *bc.lmesh);
+    if (dtStatusFailed(status))
+        return status;
+
+    if (bc.lmesh->npolys == 0)
+        return DT_SUCCESS;
+
+    dtNavMeshCreateParams cp;
+    memset(&cp, 0, sizeof(cp));
+    cp.verts = bc.lmesh->verts;
+    cp.vertCount = bc.lmesh->nverts;
+    cp.polys = bc.lmesh->polys;
+    cp.polyAreas = bc.lmesh->areas;
+    cp.polyFlags = bc.lmesh->flags;
+    cp.polyCount = bc.lmesh->npolys;
+    cp.nvp = DT_VERTS_PER_POLYGON;
+    cp.walkableHeight = params.walkableHeight;
+    cp.walkableRadius = params.walkableRadius;
+    cp.walkableClimb = params.walkableClimb;
+    cp.tileX = header->tx;
+    cp.tileY = header->ty;
+    cp.tileLayer = header->tlayer;
+    cp.cs = params.cs;
+    cp.ch = params.ch;
+    cp.buildBvTree = false;
+    dtVcopy(cp.bmin, header->bmin);
+    dtVcopy(cp.bmax, header->bmax);
+
+    proc->process(&cp, bc.lmesh->areas, bc.lmesh->flags);
+
+    if (!dtCreateNavMeshData(&cp, &out.data, &out.dataSize))
+        return DT_FAILURE;
+    return DT_SUCCESS;
+}
+
+/// Tiles being rebuilt on worker threads.  The main thread leaves the job alone until every
+/// worker has finished, then swaps all the results into the tile cache and navmesh at once, so
+/// the navmesh never has a mix of old and new tiles from one batch.
+struct TileRebuildJob
+{
+    rcConfig cfg;
+    dtTileCacheParams params;
+    OffMeshSnapshot offMesh;
+    int obstacleRequests;
+    std::vector<TileInput> inputs;
+    // New tile cache layers, for the inputs that were rasterised.
+    std::vector<std::vector<TileCacheData> > results;
+    // New navmesh tiles, for all the inputs.
+    std::vector<std::vector<TileCacheData> > meshes;
+    std::atomic<size_t> nextInput;
+    std::atomic<int> running;
+    std::vector<std::thread> workers;
+    unsigned long long started;
+
+    TileRebuildJob(const rcConfig& cfg, const dtTileCacheParams& params)
+      : cfg(cfg), params(params), obstacleRequests(0), nextInput(0), running(0), started(0)
+    {
+    }
+
+    ~TileRebuildJob()
+    {
+        wait();
+        freeAll(results);
+        freeAll(meshes);
+        for (size_t i = 0; i < inputs.size(); ++i)
+            for (size_t j = 0; j < inputs[i].layers.size(); ++j)
+                dtFree(inputs[i].layers[j].data);
+    }
+
+    static void freeAll(std::vector<std::vector<TileCacheData> >& v)
+    {
+        for (size_t i = 0; i < v.size(); ++i)
+            for (size_t j = 0; j < v[i].size(); ++j)
+                dtFree(v[i][j].data);
+    }
+
+    void start()
+    {
+        started = micros();
+        results.resize(inputs.size());
+        meshes.resize(inputs.size());
+        // Leave a core for the main thread.
+        size_t n = std::thread::hardware_concurrency();
+        n = n > 1 ? n - 1 : 1;
+        if (n > inputs.size()) n = inputs.size();
+        running = (int)n;
+        for (size_t i = 0; i < n; ++i)
+            workers.push_back(std::thread(&TileRebuildJob::work, this));
+    }
+
+    bool done() const { return running == 0; }
+
+    void wait()
+    {
+        for (size_t i = 0; i < workers.size(); ++i)
+            workers[i].join();
+        workers.clear();
+    }
+
+    void work()
+    {
+        // The build context is not thread safe, so errors on worker threads are not logged.
+        rcContext ctx(false);
+        FastLZCompressor comp;
+        LinearAllocator alloc(32000);
+        for (size_t i = nextInput++; i < inputs.size(); i = nextInput++)
+        {
+            if (inputs[i].rasterize)
+            {
+                TileCacheData tiles[MAX_LAYERS];
+                memset(tiles, 0, sizeof(tiles));
+                const int n = rasterizeTileLayers(&ctx, inputs[i], cfg, tiles, MAX_LAYERS);
+                results[i].assign(tiles, tiles + n);
+            }
+            const std::vector<TileCacheData>& layers = inputs[i].rasterize ? results[i] : inputs[i].layers;
+            for (size_t j = 0; j < layers.size(); ++j)
+            {
+                TileCacheData mesh;
+                dtStatus status = buildNavMeshLayer(&alloc, &comp, params, &offMesh, layers[j],
+                                                    inputs[i].obstacles, mesh);
+                // Busy tiles need more scratch memory than the tile cache's own allocator has.
+                while (dtStatusDetail(status, DT_OUT_OF_MEMORY) && alloc.capacity < 64*1024*1024)
+                {
+                    alloc.resize(alloc.capacity * 2);
+                    status = buildNavMeshLayer(&alloc, &comp, params, &offMesh, layers[j],
+                                               inputs[i].obstacles, mesh);
+                }
+                if (dtStatusSucceed(status) && mesh.data)
+                    meshes[i].push_back(mesh);
+            }
+        }
+        running--;
+    }
+};
+
 void drawTiles(duDebugDraw* dd, dtTileCache* tc)
 {
     unsigned int fcol[6];
@@ -606,51 +948,45 @@ void drawDetailOverlay(const dtTileCache* tc, const int tx, const int ty, double
     }
 }
         
-dtObstacleRef hitTestObstacle(const dtTileCache* tc, const float* sp, const float* sq)
+static int hitTestObstacle(const std::map<int, NavObstacle>& obstacles, const float* sp, const float* sq)
 {
     float tmin = FLT_MAX;
-    const dtTileCacheObstacle* obmin = 0;
-    for (int i = 0; i < tc->getObstacleCount(); ++i)
+    int idmin = 0;
+    for (std::map<int, NavObstacle>::const_iterator i = obstacles.begin(); i != obstacles.end(); ++i)
     {
-        const dtTileCacheObstacle* ob = tc->getObstacle(i);
-        if (ob->state == DT_OBSTACLE_EMPTY)
-            continue;
-        
-        float bmin[3], bmax[3], t0,t1;
-        tc->getObstacleBounds(ob, bmin,bmax);
-        
-        if (isectSegAABB(sp,sq, bmin,bmax, t0,t1))
+        float t0,t1;
+        if (isectSegAABB(sp,sq, i->second.bmin,i->second.bmax, t0,t1))
         {
             if (t0 < tmin)
             {
                 tmin = t0;
-                obmin = ob;
+                idmin = i->first;
             }
         }
     }
-    return tc->getObstacleRef(obmin);
+    return idmin;
 }
     
-void drawObstacles(duDebugDraw* dd, const dtTileCache* tc)
+static void drawObstacles(duDebugDraw* dd, const std::map<int, NavObstacle>& obstacles, bool pending)
 {
     // Draw obstacles
-    for (int i = 0; i < tc->getObstacleCount(); ++i)
+    const unsigned int col = pending ? duRGBA(255,255,0,128) : duRGBA(255,192,0,192);
+    for (std::map<int, NavObstacle>::const_iterator i = obstacles.begin(); i != obstacles.end(); ++i)
     {
-        const dtTileCacheObstacle* ob = tc->getObstacle(i);
-        if (ob->state == DT_OBSTACLE_EMPTY) continue;
-        float bmin[3], bmax[3];
-        tc->getObstacleBounds(ob, bmin,bmax);
-
-        unsigned int col = 0;
-        if (ob->state == DT_OBSTACLE_PROCESSING)
-            col = duRGBA(255,255,0,128);
-        else if (ob->state == DT_OBSTACLE_PROCESSED)
-            col = duRGBA(255,192,0,192);
-        else if (ob->state == DT_OBSTACLE_REMOVING)
-            col = duRGBA(220,0,0,128);
-
-        duDebugDrawCylinder(dd, bmin[0],bmin[1],bmin[2], bmax[0],bmax[1],bmax[2], col);
-        duDebugDrawCylinderWire(dd, bmin[0],bmin[1],bmin[2], bmax[0],bmax[1],bmax[2], duDarkenCol(col), 2);
+        const float* bmin = i->second.bmin;
+        const float* bmax = i->second.bmax;
+        if (i->second.type == NAV_OBSTACLE_BOX)
+        {
+            unsigned int fcol[6];
+            duCalcBoxColors(fcol, col, col);
+            duDebugDrawBox(dd, bmin[0],bmin[1],bmin[2], bmax[0],bmax[1],bmax[2], fcol);
+            duDebugDrawBoxWire(dd, bmin[0],bmin[1],bmin[2], bmax[0],bmax[1],bmax[2], duDarkenCol(col), 2);
+        }
+        else
+        {
+            duDebugDrawCylinder(dd, bmin[0],bmin[1],bmin[2], bmax[0],bmax[1],bmax[2], col);
+            duDebugDrawCylinderWire(dd, bmin[0],bmin[1],bmin[2], bmax[0],bmax[1],bmax[2], duDarkenCol(col), 2);
+        }
     }
 }
 
@@ -666,6 +1002,14 @@ NavigationManager::NavigationManager() :
     m_cacheRawSize(0),
     m_cacheLayerCount(0),
     m_cacheBuildMemUsage(0),
+    m_tileCountX(0),
+    m_tileCountY(0),
+    m_rebuildJob(0),
+    m_lastRebuildTileCount(0),
+    m_lastRebuildTimeMs(0),
+    m_nextObstacleId(1),
+    m_maxObstacles(128),
+    m_obstacleRequests(0),
     m_drawMode(DRAWMODE_NAVMESH),
     m_maxTiles(0),
     m_maxPolysPerTile(0),
@@ -683,10 +1027,14 @@ NavigationManager::NavigationManager() :
     m_tmproc = new MeshProcess;
 
     m_crowdTool = new CrowdTool();
+
+    memset(&m_cfg, 0, sizeof(m_cfg));
 }
 
 NavigationManager::~NavigationManager()
 {
+    cancelTileRebuild();
+
     dtFreeNavMeshQuery(m_navQuery);
     dtFreeNavMesh(m_navMesh);
     dtFreeCrowd(m_crowd);
@@ -849,7 +1197,7 @@ void NavigationManager::render()
 {
     // when loading from a navmesh file, no m_geom is loaded
     bool navmesh_from_disk = false;
-    if (!m_geom || !m_geom->getMesh())
+    if (!m_geom || !m_geom->hasGeometry())
     {
         navmesh_from_disk = true;
         //return;
@@ -903,9 +1251,9 @@ void NavigationManager::render()
     //if (m_tileCache && m_drawMode == DRAWMODE_CACHE_BOUNDS)
     //    drawTiles(&dd, m_tileCache);
 
-    if (m_tileCache && NavSysDebug::ShowObstacles)
+    if (NavSysDebug::ShowObstacles)
     {
-        drawObstacles(&dd, m_tileCache);
+        drawObstacles(&dd, m_obstacles, getPendingObstacleRequests() > 0);
     }
 
     if (NavSysDebug::ShowNavmesh)
@@ -951,6 +1299,8 @@ void NavigationManager::renderCachedTileOverlay(const int tx, const int ty, doub
 
 void NavigationManager::changeMesh(class InputGeom* geom)
 {
+    cancelTileRebuild();
+
     m_geom = geom;
 
     m_tmproc->init(m_geom);
@@ -962,46 +1312,115 @@ void NavigationManager::changeMesh(class InputGeom* geom)
     m_navMesh = 0;
 }
 
-void NavigationManager::addTempObstacle(const float* pos)
+int NavigationManager::addTempObstacle(const float* pos)
 {
-    if (!m_tileCache)
-        return;
-    float p[3];
-    dtVcopy(p, pos);
-    p[1] -= 0.5f;
-    m_tileCache->addObstacle(p, 1.0f, 2.0f, 0);
+    // A cylinder of radius 1 and height 2, from just below the point.
+    float bmin[3], bmax[3];
+    bmin[0] = pos[0] - 1.0f;
+    bmin[1] = pos[1] - 0.5f;
+    bmin[2] = pos[2] - 1.0f;
+    bmax[0] = pos[0] + 1.0f;
+    bmax[1] = pos[1] + 1.5f;
+    bmax[2] = pos[2] + 1.0f;
+    return addObstacle(NAV_OBSTACLE_CYLINDER, bmin, bmax);
 }
 
 void NavigationManager::removeTempObstacle(const float* sp, const float* sq)
 {
-    if (!m_tileCache)
-        return;
-    dtObstacleRef ref = hitTestObstacle(m_tileCache, sp, sq);
-    m_tileCache->removeObstacle(ref);
+    removeObstacle(hitTestObstacle(m_obstacles, sp, sq));
 }
 
 void NavigationManager::clearAllTempObstacles()
 {
-    if (!m_tileCache)
+    while (!m_obstacles.empty())
+        removeObstacle(m_obstacles.begin()->first);
+}
+
+void NavigationManager::markObstacleTilesDirty(const NavObstacle& ob)
+{
+    if (!m_tileCache || !m_navMesh)
         return;
-    for (int i = 0; i < m_tileCache->getObstacleCount(); ++i)
+
+    const dtTileCacheParams* params = m_tileCache->getParams();
+    const float tcs = params->width * params->cs;
+    const float r = params->walkableRadius;
+    const int minx = rcMax((int)floorf((ob.bmin[0] - r - params->orig[0]) / tcs), 0);
+    const int miny = rcMax((int)floorf((ob.bmin[2] - r - params->orig[2]) / tcs), 0);
+    int maxx = (int)floorf((ob.bmax[0] + r - params->orig[0]) / tcs);
+    int maxy = (int)floorf((ob.bmax[2] + r - params->orig[2]) / tcs);
+    // The grid is not known for a navmesh that was loaded, but missing tiles are skipped anyway.
+    if (m_tileCountX > 0)
     {
-        const dtTileCacheObstacle* ob = m_tileCache->getObstacle(i);
-        if (ob->state == DT_OBSTACLE_EMPTY) continue;
-        m_tileCache->removeObstacle(m_tileCache->getObstacleRef(ob));
+        maxx = rcMin(maxx, m_tileCountX-1);
+        maxy = rcMin(maxy, m_tileCountY-1);
     }
+
+    for (int y = miny; y <= maxy; ++y)
+        for (int x = minx; x <= maxx; ++x)
+            m_obstacleDirtyTiles.insert(std::make_pair(x, y));
+}
+
+int NavigationManager::addObstacle(NavObstacleType type, const float* bmin, const float* bmax)
+{
+    if ((int)m_obstacles.size() >= m_maxObstacles)
+        return 0;
+    const int id = m_nextObstacleId++;
+    NavObstacle& ob = m_obstacles[id];
+    ob.type = type;
+    rcVcopy(ob.bmin, bmin);
+    rcVcopy(ob.bmax, bmax);
+    markObstacleTilesDirty(ob);
+    if (m_tileCache)
+        m_obstacleRequests++;
+    return id;
+}
+
+bool NavigationManager::moveObstacle(int id, const float* bmin, const float* bmax)
+{
+    std::map<int, NavObstacle>::iterator i = m_obstacles.find(id);
+    if (i == m_obstacles.end())
+        return false;
+    markObstacleTilesDirty(i->second);
+    rcVcopy(i->second.bmin, bmin);
+    rcVcopy(i->second.bmax, bmax);
+    markObstacleTilesDirty(i->second);
+    if (m_tileCache)
+        m_obstacleRequests++;
+    return true;
+}
+
+bool NavigationManager::removeObstacle(int id)
+{
+    std::map<int, NavObstacle>::iterator i = m_obstacles.find(id);
+    if (i == m_obstacles.end())
+        return false;
+    markObstacleTilesDirty(i->second);
+    m_obstacles.erase(i);
+    if (m_tileCache)
+        m_obstacleRequests++;
+    return true;
+}
+
+int NavigationManager::getPendingObstacleRequests()
+{
+    int r = m_obstacleRequests;
+    if (m_rebuildJob)
+        r += m_rebuildJob->obstacleRequests;
+    return r;
 }
 
 bool NavigationManager::build()
 {
     dtStatus status;
 
-    if (!m_geom || !m_geom->getMesh())
+    if (!m_geom || !m_geom->hasGeometry())
     {
         m_ctx->log(RC_LOG_ERROR, "buildTiledNavigation: No vertices and triangles.");
         return false;
     }
 
+    cancelTileRebuild();
+
     m_tmproc->init(m_geom);
     
     // Init cache
@@ -1049,7 +1468,7 @@ bool NavigationManager::build()
     tcparams.walkableClimb = m_agentMaxClimb;
     tcparams.maxSimplificationError = m_edgeMaxError;
     tcparams.maxTiles = tw*th*EXPECTED_LAYERS_PER_TILE;
-    tcparams.maxObstacles = 128;
+    tcparams.maxObstacles = m_maxObstacles;
 
     dtFreeTileCache(m_tileCache);
     
@@ -1097,7 +1516,11 @@ bool NavigationManager::build()
         return false;
     }
 
-    // Preprocess tiles.
+    m_cfg = cfg;
+    m_tileCountX = tw;
+    m_tileCountY = th;
+
+    // Rasterise every tile on worker threads, then build the initial meshes.
     
     m_ctx->resetTimers();
     
@@ -1105,37 +1528,22 @@ bool NavigationManager::build()
     m_cacheCompressedSize = 0;
     m_cacheRawSize = 0;
     
+    m_ctx->startTimer(RC_TIMER_TOTAL);
+    TileRebuildJob job(cfg, tcparams);
+    job.offMesh.init(m_geom);
+    job.inputs.resize(tw*th);
     for (int y = 0; y < th; ++y)
     {
         for (int x = 0; x < tw; ++x)
         {
-            TileCacheData tiles[MAX_LAYERS];
-            memset(tiles, 0, sizeof(tiles));
-            int ntiles = rasterizeTileLayers(m_ctx, m_geom, x, y, cfg, tiles, MAX_LAYERS);
-
-            for (int i = 0; i < ntiles; ++i)
-            {
-                TileCacheData* tile = &tiles[i];
-                status = m_tileCache->addTile(tile->data, tile->dataSize, DT_COMPRESSEDTILE_FREE_DATA, 0);
-                if (dtStatusFailed(status))
-                {
-                    dtFree(tile->data);
-                    tile->data = 0;
-                    continue;
-                }
-                
-                m_cacheLayerCount++;
-                m_cacheCompressedSize += tile->dataSize;
-                m_cacheRawSize += calcLayerBufferSize(tcparams.width, tcparams.height);
-            }
+            TileInput& input = job.inputs[y*tw + x];
+            input.rasterize = true;
+            gatherTileInput(m_geom, cfg, x, y, input);
+            gatherTileObstacles(m_obstacles, tcparams, x, y, input.obstacles);
         }
     }
-
-    // Build initial meshes
-    m_ctx->startTimer(RC_TIMER_TOTAL);
-    for (int y = 0; y < th; ++y)
-        for (int x = 0; x < tw; ++x)
-            m_tileCache->buildNavMeshTilesAt(x,y, m_navMesh);
+    job.start();
+    applyTileRebuild(&job);
     m_ctx->stopTimer(RC_TIMER_TOTAL);
     
     m_cacheBuildTimeMs = m_ctx->getAccumulatedTime(RC_TIMER_TOTAL)/1000.0f;
@@ -1167,7 +1575,169 @@ void NavigationManager::update(const float dt)
     if (!m_tileCache)
         return;
     
-    m_tileCache->update(dt, m_navMesh);
+    updateTileRebuild(false);
+}
+
+void NavigationManager::markTilesDirty(const float* bmin, const float* bmax)
+{
+    // Tiles are rasterised again by the next full build anyway.
+    if (!m_tileCache || !m_navMesh)
+        return;
+
+    // Geometry in the border of a tile affects it too.
+    const float tcs = m_cfg.tileSize * m_cfg.cs;
+    const float border = m_cfg.borderSize * m_cfg.cs;
+    const int minx = rcMax((int)floorf((bmin[0] - border - m_cfg.bmin[0]) / tcs), 0);
+    const int miny = rcMax((int)floorf((bmin[2] - border - m_cfg.bmin[2]) / tcs), 0);
+    const int maxx = rcMin((int)floorf((bmax[0] + border - m_cfg.bmin[0]) / tcs), m_tileCountX-1);
+    const int maxy = rcMin((int)floorf((bmax[2] + border - m_cfg.bmin[2]) / tcs), m_tileCountY-1);
+
+    for (int y = miny; y <= maxy; ++y)
+        for (int x = minx; x <= maxx; ++x)
+            m_dirtyTiles.insert(std::make_pair(x, y));
+}
+
+void NavigationManager::finishTileRebuilds()
+{
+    updateTileRebuild(true);
+}
+
+int NavigationManager::getPendingTileCount()
+{
+    std::set<std::pair<int, int> > tiles = m_dirtyTiles;
+    tiles.insert(m_obstacleDirtyTiles.begin(), m_obstacleDirtyTiles.end());
+    int r = (int)tiles.size();
+    if (m_rebuildJob)
+        r += (int)m_rebuildJob->inputs.size();
+    return r;
+}
+
+void NavigationManager::updateTileRebuild(bool wait)
+{
+    if (!m_tileCache || !m_navMesh)
+        return;
+
+    while (true)
+    {
+        if (m_rebuildJob)
+        {
+            if (!wait && !m_rebuildJob->done())
+                return;
+            applyTileRebuild(m_rebuildJob);
+            m_lastRebuildTileCount = (int)m_rebuildJob->inputs.size();
+            m_lastRebuildTimeMs = (micros() - m_rebuildJob->started) / 1000.0f;
+            delete m_rebuildJob;
+            m_rebuildJob = 0;
+        }
+
+        if (!m_geom)
+            m_dirtyTiles.clear();
+        if (m_dirtyTiles.empty() && m_obstacleDirtyTiles.empty())
+            return;
+
+        // Tiles that become dirty while this batch is running wait for the next one.
+        const dtTileCacheParams* params = m_tileCache->getParams();
+        m_rebuildJob = new TileRebuildJob(m_cfg, *params);
+        m_rebuildJob->offMesh.init(m_geom);
+        std::set<std::pair<int, int> > tiles = m_dirtyTiles;
+        tiles.insert(m_obstacleDirtyTiles.begin(), m_obstacleDirtyTiles.end());
+        for (std::set<std::pair<int, int> >::iterator i = tiles.begin(); i != tiles.end(); ++i)
+        {
+            m_rebuildJob->inputs.push_back(TileInput());
+            TileInput& input = m_rebuildJob->inputs.back();
+            input.tx = i->first;
+            input.ty = i->second;
+            input.rasterize = m_dirtyTiles.count(*i) > 0;
+            if (input.rasterize)
+                gatherTileInput(m_geom, m_cfg, i->first, i->second, input);
+            else
+                copyTileLayers(m_tileCache, i->first, i->second, input.layers);
+            gatherTileObstacles(m_obstacles, *params, i->first, i->second, input.obstacles);
+        }
+        m_rebuildJob->obstacleRequests = m_obstacleRequests;
+        m_obstacleRequests = 0;
+        m_dirtyTiles.clear();
+        m_obstacleDirtyTiles.clear();
+        m_rebuildJob->start();
+
+        if (!wait)
+            return;
+    }
+}
+
+void NavigationManager::applyTileRebuild(TileRebuildJob* job)
+{
+    job->wait();
+
+    const int rawSize = calcLayerBufferSize((int)m_tileSize, (int)m_tileSize);
+
+    for (size_t i = 0; i < job->inputs.size(); ++i)
+    {
+        const int tx = job->inputs[i].tx;
+        const int ty = job->inputs[i].ty;
+
+        if (job->inputs[i].rasterize)
+        {
+            // Remove all the old layers first, the new tile may have fewer of them.
+            dtCompressedTileRef oldTiles[MAX_LAYERS];
+            const int nold = m_tileCache->getTilesAt(tx, ty, oldTiles, MAX_LAYERS);
+            for (int j = 0; j < nold; ++j)
+            {
+                const dtCompressedTile* tile = m_tileCache->getTileByRef(oldTiles[j]);
+                m_cacheLayerCount--;
+                m_cacheCompressedSize -= tile->dataSize;
+                m_cacheRawSize -= rawSize;
+                m_tileCache->removeTile(oldTiles[j], 0, 0);
+            }
+
+            std::vector<TileCacheData>& tiles = job->results[i];
+            for (size_t j = 0; j < tiles.size(); ++j)
+            {
+                TileCacheData* tile = &tiles[j];
+                dtStatus status = m_tileCache->addTile(tile->data, tile->dataSize, DT_COMPRESSEDTILE_FREE_DATA, 0);
+                if (dtStatusFailed(status))
+                {
+                    dtFree(tile->data);
+                    tile->data = 0;
+                    continue;
+                }
+                // The tile cache owns it now.
+                tile->data = 0;
+                
+                m_cacheLayerCount++;
+                m_cacheCompressedSize += tile->dataSize;
+                m_cacheRawSize += rawSize;
+            }
+        }
+
+        const dtMeshTile* meshTiles[MAX_LAYERS];
+        const int nmesh = m_navMesh->getTilesAt(tx, ty, meshTiles, MAX_LAYERS);
+        dtTileRef meshRefs[MAX_LAYERS];
+        for (int j = 0; j < nmesh; ++j)
+            meshRefs[j] = m_navMesh->getTileRef(meshTiles[j]);
+        for (int j = 0; j < nmesh; ++j)
+            m_navMesh->removeTile(meshRefs[j], 0, 0);
+
+        std::vector<TileCacheData>& meshes = job->meshes[i];
+        for (size_t j = 0; j < meshes.size(); ++j)
+        {
+            dtStatus status = m_navMesh->addTile(meshes[j].data, meshes[j].dataSize, DT_TILE_FREE_DATA, 0, 0);
+            if (dtStatusFailed(status))
+                dtFree(meshes[j].data);
+            // Either way, the job must not free it.
+            meshes[j].data = 0;
+        }
+    }
+}
+
+void NavigationManager::cancelTileRebuild()
+{
+    delete m_rebuildJob;
+    m_rebuildJob = 0;
+    m_dirtyTiles.clear();
+    // Without a navmesh there is nothing for obstacles to change, the next one is built with them.
+    m_obstacleDirtyTiles.clear();
+    m_obstacleRequests = 0;
 }
 
 void NavigationManager::getTilePos(const float* pos, int& tx, int& ty)
@@ -1349,18 +1919,27 @@ void NavigationManager::step()
 
 bool NavigationManager::load(const char* path)
 {
+    cancelTileRebuild();
     updateMaxTiles();
     dtFreeNavMesh(m_navMesh);
     dtFreeTileCache(m_tileCache);
     bool result = loadAll(path);
     m_navQuery->init(m_navMesh, 2048);
 
+    // The file has no geometry to rasterise, and its grid may not match the last build.
+    m_tileCountX = 0;
+    m_tileCountY = 0;
+    for (std::map<int, NavObstacle>::iterator i = m_obstacles.begin(); i != m_obstacles.end(); ++i)
+        markObstacleTilesDirty(i->second);
+
     m_crowdTool->init(this);
     return result;
 }
 
 void NavigationManager::freeNavmesh()
 {
+    cancelTileRebuild();
+
     dtFreeTileCache(m_tileCache);
     m_tileCache = 0;
 
@@ -1430,7 +2009,7 @@ static int pointInPoly(int nvert, const float* verts, const float* p)
 
 void NavigationManager::removeConvexVolume(float* p)
 {
-    if (!m_geom || !m_geom->getMesh())
+    if (!m_geom || !m_geom->hasGeometry())
     {
         return;
     }
@@ -1453,7 +2032,7 @@ void NavigationManager::removeConvexVolume(float* p)
 
 void NavigationManager::createConvexVolume(float* p)
 {
-    if (!m_geom || !m_geom->getMesh())
+    if (!m_geom || !m_geom->hasGeometry())
     {
         return;
     }
@@ -18,6 +18,9 @@
 
 #ifndef NAVIGATIONMANAGER_H
 #define NAVIGATIONMANAGER_H
+#include <map>
+#include <set>
+#include <utility>
 #include "navigation_interfaces.h"
 #include "DetourNavMesh.h"
 #include "Recast.h"
@@ -44,6 +47,21 @@ enum SamplePolyFlags
     SAMPLE_POLYFLAGS_ALL = 0xffff    // All abilities.
 };
 
+/// Shapes of the obstacles cut out of the navmesh.  A cylinder fills the horizontal bounds of
+/// its box, with its axis vertical.
+enum NavObstacleType
+{
+    NAV_OBSTACLE_CYLINDER,
+    NAV_OBSTACLE_BOX,
+};
+
+struct NavObstacle
+{
+    NavObstacleType type;
+    float bmin[3];
+    float bmax[3];
+};
+
 enum SamplePartitionType
 {
     SAMPLE_PARTITION_WATERSHED,
@@ -91,6 +109,30 @@ protected:
     int m_cacheRawSize;
     int m_cacheLayerCount;
     int m_cacheBuildMemUsage;
+
+    // The config and tile grid of the last full build, for rebuilding single tiles later.
+    rcConfig m_cfg;
+    int m_tileCountX;
+    int m_tileCountY;
+
+    // Tiles whose geometry changed since they were built, and the ones being rebuilt now.
+    std::set<std::pair<int, int> > m_dirtyTiles;
+    struct TileRebuildJob* m_rebuildJob;
+    int m_lastRebuildTileCount;
+    float m_lastRebuildTimeMs;
+
+    // Obstacles are not given to the tile cache.  Changing one marks the tiles it covers, and
+    // their navmesh is rebuilt from the cached layers on the worker threads, like geometry.
+    std::map<int, NavObstacle> m_obstacles;
+    int m_nextObstacleId;
+    int m_maxObstacles;
+    std::set<std::pair<int, int> > m_obstacleDirtyTiles;
+    int m_obstacleRequests;
+
+    void updateTileRebuild(bool wait);
+    void applyTileRebuild(struct TileRebuildJob* job);
+    void cancelTileRebuild();
+    void markObstacleTilesDirty(const NavObstacle& ob);
     
     enum DrawMode
     {
@@ -189,12 +231,35 @@ public:
     bool build();
     void update(const float dt);
 
+    /// Mark the tiles overlapping the box (e.g. the bounds of geometry that was added or
+    /// removed) as out of date.  They are rasterised again on worker threads, and update()
+    /// swaps each batch into the navmesh in one go once it is finished.
+    void markTilesDirty(const float* bmin, const float* bmax);
+    /// Rebuild all out of date tiles now, waiting for the worker threads.
+    void finishTileRebuilds();
+    /// The number of tiles out of date or being rebuilt.
+    int getPendingTileCount();
+    int getLastRebuildTileCount() { return m_lastRebuildTileCount; }
+    float getLastRebuildTimeMs() { return m_lastRebuildTimeMs; }
+
+    /// Add an obstacle covering the box, returning its id, or 0 if there are already as many as
+    /// allowed.  The navmesh changes once the tiles under it have been rebuilt in the background.
+    int addObstacle(NavObstacleType type, const float* bmin, const float* bmax);
+    bool moveObstacle(int id, const float* bmin, const float* bmax);
+    bool removeObstacle(int id);
+    int getObstacleCount() { return (int)m_obstacles.size(); }
+    /// Existing obstacles are kept even if there are more than this.
+    void setMaxObstacles(int val) { m_maxObstacles = val; }
+    int getMaxObstacles() { return m_maxObstacles; }
+    /// Obstacle additions, moves and removals not yet visible in the navmesh.
+    int getPendingObstacleRequests();
+
     void getTilePos(const float* pos, int& tx, int& ty);
     
     void renderCachedTile(const int tx, const int ty, const int type);
     void renderCachedTileOverlay(const int tx, const int ty, double* proj, double* model, int* view);
 
-    void addTempObstacle(const float* pos);
+    int addTempObstacle(const float* pos);
     void removeTempObstacle(const float* sp, const float* sq);
     void clearAllTempObstacles();
 
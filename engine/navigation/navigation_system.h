@@ -36,7 +36,7 @@ class NavigationSystem;
 extern NavigationSystem* nvsys;
 
 void navigation_init(void);
-void navigation_update(const float tslf);
+void navigation_update(lua_State *L, const float tslf);
 void navigation_update_debug(const float tslf);
 void navigation_shutdown(void);
 
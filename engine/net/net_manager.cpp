@@ -5,11 +5,28 @@
 #include <centralised_log.h>
 
 #include "../grit_lua_util.h"
+#include "../metrics.h"
 
 #include "net.h"
 #include "net_manager.h"
 #include "lua_wrappers_net.h"
 
+static MetricCounter *metric_packets_received =
+    metrics_counter("grit_net_packets_received_total", "", "UDP packets received.");
+static MetricCounter *metric_bytes_received =
+    metrics_counter("grit_net_bytes_received_total", "", "Bytes of UDP packets received.");
+static MetricCounter *metric_packets_sent =
+    metrics_counter("grit_net_packets_sent_total", "", "UDP packets sent.");
+static MetricCounter *metric_bytes_sent =
+    metrics_counter("grit_net_bytes_sent_total", "", "Bytes of UDP packets sent.");
+
+static void record_sent (int bytes)
+{
+    if (bytes < 0) return;
+    metric_packets_sent->inc();
+    metric_bytes_sent->inc(bytes);
+}
+
 NetManager::NetPacket::NetPacket(NetAddress& from, std::string& data_) {
     addr = from;
     data = data_;
@@ -146,6 +163,8 @@ void NetManager::process(lua_State* L)
         }
 
         if (bytes > 0) {
+            metric_packets_received->inc();
+            metric_bytes_received->inc(bytes);
             std::string data(buffer, bytes);
             NetAddress from((sockaddr*)&remoteEP, remoteEPLength);
 
@@ -203,7 +222,7 @@ void NetManager::sendPacket(NetChannel channel, NetAddress& address, std::string
 
             address.getSockAddr(&to, &toLen);
 
-            sendto(netSocket, data.c_str(), data.size(), 0, (sockaddr*)&to, toLen);
+            record_sent(sendto(netSocket, data.c_str(), data.size(), 0, (sockaddr*)&to, toLen));
         }
     }
 }
@@ -215,7 +234,7 @@ void NetManager::sendPacketInternal(NetAddress& netAddress, std::string& packet)
 
     netAddress.getSockAddr(&to, &toLen);
 
-    sendto(netSocket, packet.c_str(), packet.size(), 0, (sockaddr*)&to, toLen);
+    record_sent(sendto(netSocket, packet.c_str(), packet.size(), 0, (sockaddr*)&to, toLen));
 }
 
 void NetManager::sendLoopbackPacket(NetChannel channel, std::string& packet)
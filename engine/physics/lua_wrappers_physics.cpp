@@ -688,10 +688,10 @@ TRY_START
                 push_string(L, self.colMesh->getName());
 
         } else if (!::strcmp(key, "owner")) {
-                if (self.owner.isNull()) {
+                if (self.getOwner().isNull()) {
                         lua_pushnil(L);
                 } else {
-                        push_gritobj(L, self.owner);
+                        push_gritobj(L, self.getOwner());
                 }
 
         } else if (!::strcmp(key, "updateCallback")) {
@@ -761,10 +761,10 @@ TRY_START
                 self.setInertia(v);
         } else if (!::strcmp(key, "owner")) {
                 if (lua_isnil(L, 3)) {
-                        self.owner.setNull();
+                        self.setOwner(GritObjectPtr());
                 } else {
                         GET_UD_MACRO(GritObjectPtr, v, 3, GRITOBJ_TAG);
-                        self.owner = v;
+                        self.setOwner(v);
                 }
 
         } else {
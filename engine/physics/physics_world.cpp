@@ -22,11 +22,19 @@
 #include <BulletCollision/CollisionShapes/btTriangleShape.h>
 #include <BulletCollision/CollisionDispatch/btInternalEdgeUtility.h>
 
+#include <set>
+
+#include <sleep.h>
+
+#include "../error_aggregate.h"
+#include "../frame_allocator.h"
 #include "../grit_object.h"
 #include "../main.h"
+#include "../metrics.h"
 #include <centralised_log.h>
 #include "../option.h"
 #include "../grit_lua_util.h"
+#include "../log_sink.h"
 
 #include "physics_world.h"
 #include "lua_wrappers_physics.h"
@@ -255,6 +263,31 @@ void physics_option_from_string (const std::string &s,
 
 
 
+/** The debug drawer is made after the graphics are initialised, which may be after (or
+ * concurrently with) the physics, so it is not touched until physics_init_debug_drawer. */
+static bool debug_drawer_attached = false;
+
+static void update_debug_drawer_mode (void)
+{
+    if (!debug_drawer_attached) return;
+    debug_drawer->setDebugMode(0
+        | (physics_option(PHYSICS_DEBUG_WIREFRAME) ? BulletDebugDrawer::DBG_DrawWireframe : 0)
+        | (physics_option(PHYSICS_DEBUG_AABB) ? BulletDebugDrawer::DBG_DrawAabb : 0)
+        | (physics_option(PHYSICS_DEBUG_FEATURES_TEXT) ? BulletDebugDrawer::DBG_DrawFeaturesText : 0)
+        | (physics_option(PHYSICS_DEBUG_CONTACT_POINTS) ? BulletDebugDrawer::DBG_DrawContactPoints : 0)
+        | (physics_option(PHYSICS_DEBUG_NO_DEACTIVATION) ? BulletDebugDrawer::DBG_NoDeactivation : 0)
+        | (physics_option(PHYSICS_DEBUG_NO_HELP_TEXT) ? BulletDebugDrawer::DBG_NoHelpText : 0)
+        | (physics_option(PHYSICS_DEBUG_DRAW_TEXT) ? BulletDebugDrawer::DBG_DrawText : 0)
+        | (physics_option(PHYSICS_DEBUG_PROFILE_TIMINGS) ? BulletDebugDrawer::DBG_ProfileTimings : 0)
+//            | (physics_option(PHYSICS_DEBUG_ENABLE_SET_COMPARISON) ? BulletDebugDrawer::DBG_EnableSetComparison : 0)
+        | (physics_option(PHYSICS_DEBUG_DISABLE_BULLET_LCP) ? BulletDebugDrawer::DBG_DisableBulletLCP : 0)
+        | (physics_option(PHYSICS_DEBUG_ENABLE_CCD) ? BulletDebugDrawer::DBG_EnableCCD : 0)
+        | (physics_option(PHYSICS_DEBUG_CONSTRAINTS) ? BulletDebugDrawer::DBG_DrawConstraints : 0)
+        | (physics_option(PHYSICS_DEBUG_CONSTRAINTS_LIMITS) ? BulletDebugDrawer::DBG_DrawConstraintLimits : 0)
+        | (physics_option(PHYSICS_DEBUG_FAST_WIREFRAME) ? BulletDebugDrawer::DBG_FastWireframe : 0)
+    );
+}
+
 static void options_update (bool flush)
 {
     bool reset_gravity = flush;
@@ -390,24 +423,7 @@ static void options_update (bool flush)
           | (physics_option(PHYSICS_SOLVER_CACHE_FRIENDLY) ? SOLVER_CACHE_FRIENDLY : 0);
     }
     
-    if (reset_debug_drawer) {
-        debug_drawer->setDebugMode(0
-            | (physics_option(PHYSICS_DEBUG_WIREFRAME) ? BulletDebugDrawer::DBG_DrawWireframe : 0)
-            | (physics_option(PHYSICS_DEBUG_AABB) ? BulletDebugDrawer::DBG_DrawAabb : 0)
-            | (physics_option(PHYSICS_DEBUG_FEATURES_TEXT) ? BulletDebugDrawer::DBG_DrawFeaturesText : 0)
-            | (physics_option(PHYSICS_DEBUG_CONTACT_POINTS) ? BulletDebugDrawer::DBG_DrawContactPoints : 0)
-            | (physics_option(PHYSICS_DEBUG_NO_DEACTIVATION) ? BulletDebugDrawer::DBG_NoDeactivation : 0)
-            | (physics_option(PHYSICS_DEBUG_NO_HELP_TEXT) ? BulletDebugDrawer::DBG_NoHelpText : 0)
-            | (physics_option(PHYSICS_DEBUG_DRAW_TEXT) ? BulletDebugDrawer::DBG_DrawText : 0)
-            | (physics_option(PHYSICS_DEBUG_PROFILE_TIMINGS) ? BulletDebugDrawer::DBG_ProfileTimings : 0)
-//            | (physics_option(PHYSICS_DEBUG_ENABLE_SET_COMPARISON) ? BulletDebugDrawer::DBG_EnableSetComparison : 0)
-            | (physics_option(PHYSICS_DEBUG_DISABLE_BULLET_LCP) ? BulletDebugDrawer::DBG_DisableBulletLCP : 0)
-            | (physics_option(PHYSICS_DEBUG_ENABLE_CCD) ? BulletDebugDrawer::DBG_EnableCCD : 0)
-            | (physics_option(PHYSICS_DEBUG_CONSTRAINTS) ? BulletDebugDrawer::DBG_DrawConstraints : 0)
-            | (physics_option(PHYSICS_DEBUG_CONSTRAINTS_LIMITS) ? BulletDebugDrawer::DBG_DrawConstraintLimits : 0)
-            | (physics_option(PHYSICS_DEBUG_FAST_WIREFRAME) ? BulletDebugDrawer::DBG_FastWireframe : 0)
-        );
-    }
+    if (reset_debug_drawer) update_debug_drawer_mode();
 }
 
 void physics_option_reset (void)
@@ -587,7 +603,8 @@ static std::ostream &operator << (std::ostream &o, const btVector3 &v)
     return o << "("<<v.x()<<", "<<v.y()<<", "<<v.z()<<")";
 }
 
-static std::string shape_str (int s)
+/** A short name for the shape type, or "?" if it has none. */
+static const char *shape_name (int s)
 {
     switch (s) {
         case BOX_SHAPE_PROXYTYPE: return "box";
@@ -601,12 +618,18 @@ static std::string shape_str (int s)
         case GIMPACT_SHAPE_PROXYTYPE: return "gim";
         case STATIC_PLANE_PROXYTYPE: return "pla";
         case COMPOUND_SHAPE_PROXYTYPE: return "com";
-        default:
-        std::stringstream ss;
-        ss << s;
-        return ss.str();
     }
-    return "";
+    return "?";
+}
+
+/** The short name of the shape type, or its number. */
+static std::string shape_str (int s)
+{
+    const char *name = shape_name(s);
+    if (name[0] != '?') return name;
+    std::stringstream ss;
+    ss << s;
+    return ss.str();
 }
 
 /* bullet does not support putting a gimpact triangle mesh in a compound shape so I am hacking the parent in this case to be the triangle mesh instead of the compound shape
@@ -655,7 +678,7 @@ static int get_material (const CollisionMesh *cmesh, const btCollisionShape *sha
         || shape->getShapeType()==TRIANGLE_MESH_SHAPE_PROXYTYPE) {
         int max = cmesh->faceMaterials.size();
         if (id < 0 || id >= max) {
-            if (verb) {
+            if (verb && error_aggregate("Garbage index from bullet", cmesh->getName())) {
                 CERR << "index from bullet was garbage: " << id
                      << " >= " << max
                      << " cmesh: \"" << cmesh->getName() << "\""
@@ -668,7 +691,7 @@ static int get_material (const CollisionMesh *cmesh, const btCollisionShape *sha
     } else {
         int max = cmesh->partMaterials.size();
         if (id < 0 || id >= max) {
-            if (verb) {
+            if (verb && error_aggregate("Garbage index from bullet", cmesh->getName())) {
                 CERR << "index from bullet was garbage: " << id
                      << " >= " << max
                      << " cmesh: \"" << cmesh->getName() << "\""
@@ -728,17 +751,17 @@ bool contact_added_callback (btManifoldPoint& cp,
     phys_mats.getFrictionRestitution(mat0, mat1, cp.m_combinedFriction, cp.m_combinedRestitution);
 
     if (err || verb_contacts) {
-        CLOG << mat0 << "[" << shape_str(shape0->getShapeType()) << "]"
-             << "(" << shape_str(parent0->getShapeType()) << ")"
-             << " " << part0 << " " << index0
-             << "  AGAINST  " << mat1 << "[" << shape_str(shape1->getShapeType()) << "]"
-             << "(" << shape_str(parent1->getShapeType()) << ")"
-             << " " << part1 << " " << index1 << std::endl;
-        CLOG << cp.m_lifeTime << " " << cp.m_positionWorldOnA
-                      << " " << cp.m_positionWorldOnB
-             << " " << cp.m_normalWorldOnB << " " << cp.m_distance1
-             << " *" << cp.m_appliedImpulse << "* |" << cp.m_combinedFriction
-             << "| >" << cp.m_combinedRestitution << "<" << std::endl;
+        // Called for every contact, so do not format (or build strings) here.
+        LOG_SINK(LOG_SINK_LOG, "%[%](%) % %  AGAINST  %[%](%) % %",
+                 mat0, shape_name(shape0->getShapeType()), shape_name(parent0->getShapeType()),
+                 part0, index0,
+                 mat1, shape_name(shape1->getShapeType()), shape_name(parent1->getShapeType()),
+                 part1, index1);
+        LOG_SINK(LOG_SINK_LOG, "% % % % % *%* |%| >%<",
+                 cp.m_lifeTime, from_bullet(cp.m_positionWorldOnA),
+                 from_bullet(cp.m_positionWorldOnB), from_bullet(cp.m_normalWorldOnB),
+                 cp.m_distance1, cp.m_appliedImpulse, cp.m_combinedFriction,
+                 cp.m_combinedRestitution);
         /*
         bool    m_lateralFrictionInitialized
         btScalar    m_appliedImpulseLateral1
@@ -766,11 +789,11 @@ bool contact_added_callback (btManifoldPoint& cp,
         if (physics_option(PHYSICS_USE_TRIANGLE_EDGE_INFO)) {
             btAdjustInternalEdgeContacts(cp,sta_body, dyn_body, part1,index1);
             if (verb_contacts) {
-                CLOG << cp.m_lifeTime << " " << cp.m_positionWorldOnA
-                              << " " << cp.m_positionWorldOnB
-                     << " " << cp.m_normalWorldOnB << " " << cp.m_distance1
-                     << " *" << cp.m_appliedImpulse << "* |" << cp.m_combinedFriction
-                     << "| >" << cp.m_combinedRestitution << "<   (CORRECTION)" << std::endl;
+                LOG_SINK(LOG_SINK_LOG, "% % % % % *%* |%| >%<   (CORRECTION)",
+                         cp.m_lifeTime, from_bullet(cp.m_positionWorldOnA),
+                         from_bullet(cp.m_positionWorldOnB), from_bullet(cp.m_normalWorldOnB),
+                         cp.m_distance1, cp.m_appliedImpulse, cp.m_combinedFriction,
+                         cp.m_combinedRestitution);
                 /*
                 bool    m_lateralFrictionInitialized
                 btScalar    m_appliedImpulseLateral1
@@ -852,14 +875,27 @@ namespace {
     };
 }
 
+static MetricHistogram *metric_step_time =
+    metrics_histogram("grit_physics_step_seconds", "",
+                      "Time spent in the physics engine per step, not counting callbacks.",
+                      metrics_latency_bounds());
+static MetricGauge *metric_bodies =
+    metrics_gauge("grit_physics_bodies", "", "Rigid bodies in the physics world.");
+static MetricCounter *metric_contacts =
+    metrics_counter("grit_physics_contacts_total", "",
+                    "Contact points found, each giving a pair of collision callbacks.");
+
 void physics_update (lua_State *L)
 {
     float step_size = physics_option(PHYSICS_STEP_SIZE);
+    unsigned long long before = micros();
     world->internalStepSimulation(step_size);
+    metric_step_time->observe((micros() - before) / 1E6);
+    metric_bodies->set(world->getNumCollisionObjects());
 
     // NAN CHECKS
     // check whether NaN has crept in anywhere
-    std::vector<RigidBody*> nan_bodies;
+    FrameVector<RigidBody*> nan_bodies;
     for (int i=0 ; i<world->getNumCollisionObjects() ; ++i) {
 
         btCollisionObject* victim = world->getCollisionObjectArray()[i];
@@ -875,7 +911,12 @@ void physics_update (lua_State *L)
         float qw=quat.w(), qx=quat.x(), qy=quat.y(), qz=quat.z();
         if (std::isnan(x) || std::isnan(y) || std::isnan(z) ||
             std::isnan(qw) || std::isnan(qx) || std::isnan(qy) || std::isnan(qz)) {
-            CERR << "NaN from physics engine position update." << std::endl;
+            // Objects are keyed by class, as a broken class will keep making broken bodies.
+            const GritObjectPtr &owner = rb->getOwner();
+            GritClass *gc = owner.isNull() ? NULL : owner->getClass();
+            std::string key = gc != NULL ? gc->name : rb->colMesh->getName();
+            if (error_aggregate("NaN from physics engine position update", key))
+                CERR << "NaN from physics engine position update: " << key << std::endl;
             nan_bodies.push_back(rb);
         }
     }
@@ -885,7 +926,7 @@ void physics_update (lua_State *L)
     }
 
     // COLLISION CALLBACKS
-    std::vector<Info> infos;
+    FrameVector<Info> infos;
     // first, check for collisions
     unsigned num_manifolds = world->getDispatcher()->getNumManifolds();
     for (unsigned i=0 ; i<num_manifolds; ++i) {
@@ -929,6 +970,7 @@ void physics_update (lua_State *L)
             infos.push_back(infoB);
         }
     }
+    metric_contacts->inc(infos.size() / 2);
     for (unsigned i=0 ; i<infos.size(); ++i) {
         Info &info = infos[i];
         if (info.body->destroyed()) continue;
@@ -1214,7 +1256,7 @@ void physics_draw (void)
 RigidBody::RigidBody (const std::string &col_mesh,
                       const Vector3 &pos,
                       const Quaternion &quat)
-      : lastXform(to_bullet(quat),to_bullet(pos)), refCount(0)
+      : suspended(false), lastXform(to_bullet(quat),to_bullet(pos)), refCount(0)
 {
     DiskResource *dr = disk_resource_get_or_make(col_mesh);
     colMesh = dynamic_cast<CollisionMesh*>(dr);
@@ -1244,6 +1286,9 @@ static btCompoundShape *clone_compound (btCompoundShape *master)
 
 // Another exception:  When it has been polluted by a NaN and must be pulled out
 
+// And another:  While it is suspended, because its owner is parked.  Then it has a body, but the
+// body is not in the world.
+
 void RigidBody::addToWorld (void)
 {
     shape = clone_compound(colMesh->getMasterShape());
@@ -1270,7 +1315,7 @@ void RigidBody::addToWorld (void)
     APP_ASSERT(body==NULL);
     body = new btRigidBody(info);
 
-    world->addRigidBody(body);
+    if (!suspended) world->addRigidBody(body);
 
     // Only do CCD if speed of body exceeeds this
     body->setCcdMotionThreshold(colMesh->getCCDMotionThreshold());
@@ -1283,17 +1328,58 @@ void RigidBody::addToWorld (void)
 void RigidBody::removeFromWorld (void)
 {
     lastXform = body->getCenterOfMassTransform();
-    world->removeRigidBody(body);
+    if (!suspended) world->removeRigidBody(body);
     delete body;
     delete shape;
     body = NULL;
 }
 
+/** The bodies of each object, so they can be suspended while it is parked. */
+typedef std::map<const GritObject*, std::set<RigidBody*>> OwnedBodies;
+static OwnedBodies owned_bodies;
+
+static void unlist_owned_body (const GritObjectPtr &owner, RigidBody *body)
+{
+    if (owner.isNull()) return;
+    OwnedBodies::iterator i = owned_bodies.find(&*owner);
+    i->second.erase(body);
+    if (i->second.empty()) owned_bodies.erase(i);
+}
+
+void RigidBody::setOwner (const GritObjectPtr &v)
+{
+    unlist_owned_body(owner, this);
+    owner = v;
+    if (!owner.isNull()) owned_bodies[&*owner].insert(this);
+    setSuspended(!owner.isNull() && owner->isParked());
+}
+
+void RigidBody::setSuspended (bool v)
+{
+    if (suspended == v) return;
+    suspended = v;
+    if (body==NULL) return; // deactivated
+    if (v) {
+        world->removeRigidBody(body);
+    } else {
+        world->addRigidBody(body);
+        updateCollisionFlags();
+    }
+}
+
+void physics_suspend_owned_bodies (const GritObject *owner, bool v)
+{
+    OwnedBodies::iterator i = owned_bodies.find(owner);
+    if (i == owned_bodies.end()) return;
+    for (RigidBody *b : i->second) b->setSuspended(v);
+}
+
 void RigidBody::destroy (lua_State *L)
 {
     colMesh->unregisterReloadWatcher(this);
     if (body==NULL) return;
     removeFromWorld();
+    setOwner(GritObjectPtr());
     stepCallbackPtr.setNil(L);
     updateCallbackPtr.setNil(L);
     collisionCallbackPtr.setNil(L);
@@ -1321,6 +1407,7 @@ void RigidBody::decRefCount (lua_State *L)
 RigidBody::~RigidBody (void)
 {
     colMesh->unregisterReloadWatcher(this);
+    unlist_owned_body(owner, this);
     if (body==NULL) return;
     CERR << "destructing RigidBody: destroy() was not called" << std::endl;
     // just leak stuff, this is not meant to happen
@@ -1609,6 +1696,26 @@ void RigidBody::deactivate (void)
     body->setActivationState( WANTS_DEACTIVATION );
 }
 
+bool RigidBody::isActive (void) const
+{
+    if (body==NULL) return false;
+    // Bullet considers static bodies active, but they never move.
+    if (body->isStaticObject()) return false;
+    return body->isActive();
+}
+
+void RigidBody::getBounds (Vector3 &min, Vector3 &max) const
+{
+    if (body==NULL) {
+        min = max = from_bullet(lastXform.getOrigin());
+        return;
+    }
+    btVector3 bmin, bmax;
+    body->getAabb(bmin, bmax);
+    min = from_bullet(bmin);
+    max = from_bullet(bmax);
+}
+
 Vector3 RigidBody::getLinearVelocity (void) const
 {
     if (body==NULL) return Vector3(0,0,0);
@@ -1699,8 +1806,9 @@ void RigidBody::setElementEnabled (int i, bool v)
         shape->addChildShape(t,s);
     } else {
         int i2 = get_child_index(shape, colMesh->getMasterShape()->getChildShape(i));
-        world->getBroadphase()->getOverlappingPairCache()
-            ->cleanProxyFromPairs(body->getBroadphaseHandle(), world->getDispatcher());
+        if (!suspended)
+            world->getBroadphase()->getOverlappingPairCache()
+                ->cleanProxyFromPairs(body->getBroadphaseHandle(), world->getDispatcher());
         shape->removeChildShapeByIndex(i2);
     }
 }
@@ -1772,7 +1880,7 @@ void RigidBody::setPosition (const Vector3 &v)
     if (body==NULL) return; // deactivated
     body->setCenterOfMassTransform(
         btTransform(body->getOrientation(), to_bullet(v)));
-    world->updateSingleAabb(body);
+    if (!suspended) world->updateSingleAabb(body);
     body->activate();
 }
 
@@ -1781,7 +1889,7 @@ void RigidBody::setOrientation (const Quaternion &q)
     if (body==NULL) return; // deactivated
     body->setCenterOfMassTransform(
          btTransform(to_bullet(q),body->getCenterOfMassPosition()));
-    world->updateSingleAabb(body);
+    if (!suspended) world->updateSingleAabb(body);
     body->activate();
 }
 
@@ -1813,11 +1921,16 @@ void physics_init (void)
 
     gContactAddedCallback = contact_added_callback;
     
-    world->setDebugDrawer(debug_drawer);
-
     init_options();
 }
 
+void physics_init_debug_drawer (void)
+{
+    world->setDebugDrawer(debug_drawer);
+    debug_drawer_attached = true;
+    update_debug_drawer_mode();
+}
+
 void physics_shutdown (void)
 {
     // they should probably all be gone by now but just in case some
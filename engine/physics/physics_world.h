@@ -170,6 +170,9 @@ void physics_test_sphere (float rad, const Vector3 &pos, bool dyn_only, TestCall
 
 void physics_draw (void);
 
+/** Suspend (or resume) every body owned by the given object, see RigidBody::setSuspended. */
+void physics_suspend_owned_bodies (const GritObject *owner, bool v);
+
 void physics_update_graphics (lua_State *L, float extrapolate);
 
 
@@ -213,6 +216,13 @@ class RigidBody : public btMotionState, public CollisionMesh::ReloadWatcher {
     void activate (void);
     void deactivate (void);
 
+    /** False once the body has come to rest and is no longer simulated, and for static or
+     * destroyed bodies. */
+    bool isActive (void) const;
+
+    /** The world space axis aligned bounding box. */
+    void getBounds (Vector3 &min, Vector3 &max) const;
+
     void force (const Vector3 &force);
     void force (const Vector3 &force,
             const Vector3 &rel_pos);
@@ -256,7 +266,13 @@ class RigidBody : public btMotionState, public CollisionMesh::ReloadWatcher {
 
     CollisionMesh * colMesh;
 
-    GritObjectPtr owner;
+    const GritObjectPtr &getOwner (void) const { return owner; }
+    void setOwner (const GritObjectPtr &v);
+
+    /** A suspended body is taken out of the world, so it neither collides nor gets callbacks, but
+     * keeps its state until it is resumed.  The bodies of a parked object are suspended. */
+    bool getSuspended (void) const { return suspended; }
+    void setSuspended (bool v);
 
     void notifyReloaded (const DiskResource *r)
     {
@@ -284,8 +300,11 @@ class RigidBody : public btMotionState, public CollisionMesh::ReloadWatcher {
 
     protected:
 
+    GritObjectPtr owner;
+
     float mass;
     bool ghost;
+    bool suspended;
 
     btTransform lastXform;
 
@@ -310,7 +329,10 @@ class RigidBody : public btMotionState, public CollisionMesh::ReloadWatcher {
     void updateCollisionFlags (void);
 };
 
+/** Does not need the graphics, so may run in parallel with gfx_init. */
 void physics_init (void);
+/** Call once both physics_init has completed and the debug_drawer exists. */
+void physics_init_debug_drawer (void);
 void physics_shutdown (void);
 
 #endif
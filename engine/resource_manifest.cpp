@@ -0,0 +1,295 @@
+/* Copyright (c) The Grit Game Engine authors 2016
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifndef WIN32
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+
+#include <centralised_log.h>
+
+#include "async_io.h"
+#include "host_cache.h"
+#include "metrics.h"
+#include "resource_manifest.h"
+
+static MetricCounter *metric_recorded =
+    metrics_counter("grit_resource_manifest_recorded_total", "",
+                    "Resource manifests recorded after loading a demand.");
+static MetricCounter *metric_stale =
+    metrics_counter("grit_resource_manifest_stale_total", "",
+                    "Resource manifests dropped because a file changed size.");
+static MetricCounter *metric_prefetch_files =
+    metrics_counter("grit_resource_manifest_prefetch_files_total", "",
+                    "Files prefetched because they were in the manifest of a queued demand.");
+static MetricCounter *metric_prefetch_bytes =
+    metrics_counter("grit_resource_manifest_prefetch_bytes_total", "",
+                    "Size of the files prefetched.");
+
+typedef std::map<std::string, ResourceManifest> ManifestMap;
+
+static ManifestMap manifests;
+static std::mutex manifests_mutex;
+
+// Resources are files relative to the game directory, which is the current directory.
+static bool file_stat (const std::string &name, struct stat &st)
+{
+    return stat(name.substr(1).c_str(), &st) == 0;
+}
+
+std::vector<std::string> resource_manifest_names (const DiskResources &resources)
+{
+    std::vector<std::string> r;
+    r.reserve(resources.size());
+    for (DiskResource *dr : resources) r.push_back(dr->getName());
+    return r;
+}
+
+bool resource_manifest_get (const std::string &key, ResourceManifest &m)
+{
+    std::lock_guard<std::mutex> lock(manifests_mutex);
+    auto it = manifests.find(key);
+    if (it == manifests.end()) return false;
+    m = it->second;
+    return true;
+}
+
+bool resource_manifest_matches (const std::string &key, const std::vector<std::string> &roots)
+{
+    std::lock_guard<std::mutex> lock(manifests_mutex);
+    auto it = manifests.find(key);
+    return it != manifests.end() && it->second.roots == roots;
+}
+
+void resource_manifest_record (const std::string &key, const DiskResources &roots)
+{
+    ResourceManifest m;
+    m.roots = resource_manifest_names(roots);
+
+    // Breadth first, so the roots come first.
+    std::set<DiskResource*> seen;
+    DiskResources todo;
+    for (DiskResource *dr : roots) {
+        if (seen.insert(dr).second) todo.push_back(dr);
+    }
+    for (unsigned i=0 ; i<todo.size() ; ++i) {
+        DiskResource *dr = todo[i];
+        struct stat st;
+        ResourceManifest::File f = { dr->getName(), 0 };
+        if (file_stat(f.name, st)) f.size = st.st_size;
+        m.files.push_back(f);
+        for (DiskResource *dep : dr->getDependencies()) {
+            if (seen.insert(dep).second) todo.push_back(dep);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(manifests_mutex);
+    manifests[key] = m;
+    metric_recorded->inc();
+}
+
+namespace {
+    struct Prefetch {
+        std::string name;
+        dev_t dev;
+        ino_t ino;
+        // Index of the request.
+        unsigned request;
+        // Is this the first time the file appears in any of the requests?
+        bool first;
+    };
+}
+
+unsigned resource_manifest_prefetch (const std::vector<ResourceManifestRequest> &requests)
+{
+    // Collect the files under the lock, then stat and read them without it.
+    std::vector<std::vector<ResourceManifest::File>> files(requests.size());
+    {
+        std::lock_guard<std::mutex> lock(manifests_mutex);
+        for (unsigned i=0 ; i<requests.size() ; ++i) {
+            const ResourceManifestRequest &req = requests[i];
+            auto it = manifests.find(req.key);
+            if (it == manifests.end() || it->second.roots != req.roots) continue;
+            files[i] = it->second.files;
+        }
+    }
+
+    bool async = async_io_enabled();
+    std::set<std::string> stale;
+    std::set<std::string> done;
+    std::vector<Prefetch> order;
+    unsigned count = 0;
+    unsigned long long bytes = 0;
+    for (unsigned i=0 ; i<requests.size() ; ++i) {
+        const ResourceManifestRequest &req = requests[i];
+        std::vector<Prefetch> mine;
+        for (const ResourceManifest::File &f : files[i]) {
+            struct stat st;
+            if (!file_stat(f.name, st) || (unsigned long long)st.st_size != f.size) {
+                stale.insert(req.key);
+                mine.clear();
+                break;
+            }
+            Prefetch p = { f.name, st.st_dev, st.st_ino, i, false };
+            mine.push_back(p);
+        }
+        if (mine.empty()) {
+            // Without a manifest, at least the resources themselves can be read.
+            if (async) {
+                for (const std::string &root : req.roots) {
+                    if (host_cache_has(root)) continue;
+                    async_io_read(root, req.priority, req.owner);
+                }
+            }
+            continue;
+        }
+        for (unsigned j=0 ; j<mine.size() ; ++j) {
+            // Classes often share textures.
+            mine[j].first = done.insert(mine[j].name).second;
+            if (!mine[j].first) continue;
+            count++;
+            bytes += files[i][j].size;
+        }
+        order.insert(order.end(), mine.begin(), mine.end());
+    }
+
+    if (!stale.empty()) {
+        std::lock_guard<std::mutex> lock(manifests_mutex);
+        for (const std::string &key : stale) {
+            manifests.erase(key);
+            metric_stale->inc();
+        }
+    }
+
+    // Nearest demand first, then in inode order as an approximation of the order on disk.
+    std::sort(order.begin(), order.end(), [&] (const Prefetch &a, const Prefetch &b) {
+        float pa = requests[a.request].priority, pb = requests[b.request].priority;
+        if (pa != pb) return pa < pb;
+        if (a.dev != b.dev) return a.dev < b.dev;
+        return a.ino < b.ino;
+    });
+    for (const Prefetch &p : order) {
+        // It will be opened from memory.
+        if (host_cache_has(p.name)) continue;
+        if (async) {
+            // Every demand that needs a file owns the read, so it is kept until they all have
+            // been loaded.
+            const ResourceManifestRequest &req = requests[p.request];
+            async_io_read(p.name, req.priority, req.owner);
+            continue;
+        }
+        #ifdef POSIX_FADV_WILLNEED
+        // This only queues the reads, so all the files are read at once.
+        if (!p.first) continue;
+        int fd = open(p.name.substr(1).c_str(), O_RDONLY);
+        if (fd < 0) continue;
+        posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+        close(fd);
+        #endif
+    }
+
+    metric_prefetch_files->inc(count);
+    metric_prefetch_bytes->inc(bytes);
+    return count;
+}
+
+void resource_manifest_clear (void)
+{
+    std::lock_guard<std::mutex> lock(manifests_mutex);
+    manifests.clear();
+}
+
+size_t resource_manifest_count (void)
+{
+    std::lock_guard<std::mutex> lock(manifests_mutex);
+    return manifests.size();
+}
+
+// The format is a line per class, root and file:
+//
+// class /path/to/Class
+// root /path/to/resource.mesh
+// file /path/to/resource.mesh 123456
+//
+// Paths cannot contain spaces or newlines, as with other Grit resources.
+
+void resource_manifest_save (const std::string &filename)
+{
+    ManifestMap copy;
+    {
+        std::lock_guard<std::mutex> lock(manifests_mutex);
+        copy = manifests;
+    }
+    std::ofstream f(filename.c_str());
+    if (!f.good()) EXCEPT << "Could not open manifest file: \"" << filename << "\"" << ENDL;
+    for (const auto &m : copy) {
+        f << "class " << m.first << "\n";
+        for (const std::string &r : m.second.roots) f << "root " << r << "\n";
+        for (const ResourceManifest::File &file : m.second.files)
+            f << "file " << file.name << " " << file.size << "\n";
+    }
+    f.close();
+    if (!f.good()) EXCEPT << "Could not write manifest file: \"" << filename << "\"" << ENDL;
+}
+
+void resource_manifest_load (const std::string &filename)
+{
+    std::ifstream f(filename.c_str());
+    if (!f.good()) EXCEPT << "Could not open manifest file: \"" << filename << "\"" << ENDL;
+    ManifestMap loaded;
+    ResourceManifest *current = NULL;
+    std::string line;
+    for (unsigned line_num = 1 ; std::getline(f, line) ; ++line_num) {
+        if (line.empty()) continue;
+        std::istringstream ss(line);
+        std::string kind, name;
+        ss >> kind >> name;
+        if (kind == "class" && !name.empty()) {
+            current = &loaded[name];
+            *current = ResourceManifest();
+            continue;
+        }
+        if (current == NULL)
+            EXCEPT << filename << ":" << line_num << ": Expected class" << ENDL;
+        if (kind == "root" && !name.empty()) {
+            current->roots.push_back(name);
+        } else if (kind == "file" && !name.empty()) {
+            ResourceManifest::File file = { name, 0 };
+            if (!(ss >> file.size))
+                EXCEPT << filename << ":" << line_num << ": Expected file size" << ENDL;
+            current->files.push_back(file);
+        } else {
+            EXCEPT << filename << ":" << line_num << ": Could not parse: " << line << ENDL;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(manifests_mutex);
+    for (const auto &m : loaded) manifests[m.first] = m.second;
+}
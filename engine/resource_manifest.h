@@ -0,0 +1,103 @@
+/* Copyright (c) The Grit Game Engine authors 2016
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef ResourceManifest_h
+#define ResourceManifest_h
+
+#include <string>
+#include <vector>
+
+#include "disk_resource.h"
+
+/** \file
+ *
+ * A manifest lists every file that a class's objects need: the resources they ask for with
+ * addDiskResource, and transitively the dependencies those discover while loading (e.g. a
+ * mesh's textures), with the size of each file.  Without one, a texture is not read until the
+ * mesh that uses it has been loaded.
+ *
+ * A manifest is recorded the first time a class's resources are loaded, or read from a file
+ * made offline with resource_manifest_save.  When demands are queued, the background loader
+ * prefetches all of their files in one go before loading any of them, so the reads proceed in
+ * parallel while the resources are loaded one at a time.  Prefetching asks the OS to read the
+ * files into its cache (posix_fadvise), in inode order as an approximation of their order on
+ * disk.  On platforms without posix_fadvise, it only checks the manifests are up to date.
+ * When async_io is enabled, the files are read into memory with it instead, nearest demand
+ * first, and demands without a manifest have their resources read.  Files in the host cache
+ * are not read at all.
+ *
+ * A manifest only applies to a demand with exactly the same resources, and is dropped if one of
+ * the files has changed size.  Either way, a new one is recorded when the demand is loaded.
+ * All the functions can be called from any thread.
+ */
+
+struct ResourceManifest {
+    struct File {
+        std::string name;
+        unsigned long long size;
+    };
+    /** The resources the demand asked for. */
+    std::vector<std::string> roots;
+    /** The roots and then their dependencies, without duplicates. */
+    std::vector<File> files;
+};
+
+/** What a demand needs prefetched: its manifest key (the class name) and resources.  When files
+ * are read with async_io, they are read on behalf of the owner (the demand), with its priority
+ * (the distance). */
+struct ResourceManifestRequest {
+    ResourceManifestRequest (void) : owner(nullptr), priority(0) { }
+    std::string key;
+    std::vector<std::string> roots;
+    const void *owner;
+    float priority;
+};
+
+/** The names of the resources. */
+std::vector<std::string> resource_manifest_names (const DiskResources &resources);
+
+/** Get the manifest for the key, returning false if there is none. */
+bool resource_manifest_get (const std::string &key, ResourceManifest &m);
+
+/** Does the key have a manifest that applies to these resources? */
+bool resource_manifest_matches (const std::string &key, const std::vector<std::string> &roots);
+
+/** Record the (loaded) resources and their dependencies as the key's manifest. */
+void resource_manifest_record (const std::string &key, const DiskResources &roots);
+
+/** Prefetch every file of the requests that have a matching manifest, all together.  Returns
+ * the number of files in manifests. */
+unsigned resource_manifest_prefetch (const std::vector<ResourceManifestRequest> &requests);
+
+/** Forget all the manifests. */
+void resource_manifest_clear (void);
+
+/** Number of manifests. */
+size_t resource_manifest_count (void);
+
+/** Write all the manifests to a text file. */
+void resource_manifest_save (const std::string &filename);
+
+/** Add the manifests in the file, replacing any with the same key. */
+void resource_manifest_load (const std::string &filename);
+
+#endif
@@ -0,0 +1,209 @@
+/* Copyright (c) The Grit Game Engine authors 2016
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include <algorithm>
+#include <deque>
+#include <map>
+
+#include <sleep.h>
+
+#include "ldbglue.h"
+#include "lua_ptr.h"
+#include "script_tasks.h"
+
+namespace {
+
+    struct ScriptTask {
+        unsigned id;
+        ScriptTaskStats stats;
+        LuaPtr thread;  // Keeps the coroutine from being collected.
+        lua_State *co;
+        bool dead;
+    };
+
+    typedef std::deque<ScriptTask*> TaskQueue;
+
+}
+
+static std::map<unsigned, ScriptTask*> tasks;
+static TaskQueue queues[SCRIPT_TASK_PRIORITIES];
+static unsigned next_id = 1;
+
+static const char *priority_names[] = { "CRITICAL", "NORMAL", "BACKGROUND" };
+
+std::string script_task_priority_to_string (ScriptTaskPriority p)
+{
+    return priority_names[p];
+}
+
+bool script_task_priority_from_string (const std::string &s, ScriptTaskPriority &p)
+{
+    for (unsigned i=0 ; i<SCRIPT_TASK_PRIORITIES ; ++i) {
+        if (s == priority_names[i]) {
+            p = ScriptTaskPriority(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+unsigned script_task_spawn (lua_State *L, const std::string &name, ScriptTaskPriority priority)
+{
+    ScriptTask *t = new ScriptTask();
+    t->id = next_id++;
+    t->stats.name = name;
+    t->stats.priority = priority;
+    t->stats.cpuTime = 0;
+    t->stats.maxSlice = 0;
+    t->stats.resumes = 0;
+    t->stats.starvedFrames = 0;
+    t->stats.maxStarvedFrames = 0;
+    t->dead = false;
+
+    // stack: func
+    t->co = lua_newthread(L);
+    // stack: func, thread
+    t->thread.set(L);
+    // stack: func
+    lua_xmove(L, t->co, 1);
+    // stack is empty
+
+    tasks[t->id] = t;
+    queues[priority].push_back(t);
+    return t->id;
+}
+
+static void free_task (lua_State *L, ScriptTask *t)
+{
+    t->thread.setNil(L);
+    delete t;
+}
+
+bool script_task_kill (unsigned id)
+{
+    auto it = tasks.find(id);
+    if (it == tasks.end()) return false;
+    // The task is still in a queue (and may even be running, so its coroutine must not be
+    // collected yet), so it is only freed by script_tasks_do_frame.
+    it->second->dead = true;
+    tasks.erase(it);
+    return true;
+}
+
+void script_task_kill_all (void)
+{
+    while (!tasks.empty()) script_task_kill(tasks.begin()->first);
+}
+
+std::vector<unsigned> script_task_all (void)
+{
+    std::vector<unsigned> r;
+    r.reserve(tasks.size());
+    for (const auto &pair : tasks) r.push_back(pair.first);
+    return r;
+}
+
+bool script_task_stats (unsigned id, ScriptTaskStats &stats)
+{
+    auto it = tasks.find(id);
+    if (it == tasks.end()) return false;
+    stats = it->second->stats;
+    return true;
+}
+
+/** Returns false if the task is finished, either by returning or raising an error. */
+static bool resume (lua_State *L, ScriptTask *t)
+{
+    unsigned long long before = micros();
+    ldb_resume_begin(t->co);
+    int status = lua_resume(t->co, 0);
+    ldb_resume_end(L);
+    unsigned long long slice = micros() - before;
+
+    ScriptTaskStats &s = t->stats;
+    s.cpuTime += slice;
+    s.maxSlice = std::max(s.maxSlice, slice);
+    s.resumes++;
+    s.starvedFrames = 0;
+
+    if (status == LUA_YIELD) {
+        // Whatever was passed to coroutine.yield() is ignored.
+        lua_settop(t->co, 0);
+        return true;
+    }
+    if (status != 0) {
+        const char *msg = lua_tostring(t->co, -1);
+        CERR << "Task \"" << s.name << "\" raised an error, so killing it: "
+             << (msg == NULL ? "(error object is not a string)" : msg) << std::endl;
+    }
+    return false;
+}
+
+void script_tasks_do_frame (lua_State *L, float budget)
+{
+    const unsigned long long deadline = micros() + (unsigned long long)(budget * 1E6);
+
+    for (unsigned p=0 ; p<SCRIPT_TASK_PRIORITIES ; ++p) {
+        TaskQueue &queue = queues[p];
+
+        // Tasks left waiting keep their place at the front, so within a priority every task
+        // eventually gets a turn.
+        TaskQueue waiting, resumed;
+
+        // Only look at the tasks that were already queued.  Those spawned by the tasks being
+        // resumed here wait for the next frame.
+        for (size_t n=queue.size() ; n > 0 ; --n) {
+            ScriptTask *t = queue.front();
+            queue.pop_front();
+
+            if (t->dead) {
+                free_task(L, t);
+                continue;
+            }
+
+            if (p != SCRIPT_TASK_CRITICAL && micros() >= deadline) {
+                ScriptTaskStats &s = t->stats;
+                s.starvedFrames++;
+                s.maxStarvedFrames = std::max(s.maxStarvedFrames, s.starvedFrames);
+                waiting.push_back(t);
+                continue;
+            }
+
+            bool alive = resume(L, t);
+
+            // The task may have killed itself while running.
+            if (t->dead) {
+                free_task(L, t);
+            } else if (alive) {
+                resumed.push_back(t);
+            } else {
+                tasks.erase(t->id);
+                free_task(L, t);
+            }
+        }
+
+        // Tasks spawned while running the others are still in the queue.
+        waiting.insert(waiting.end(), queue.begin(), queue.end());
+        waiting.insert(waiting.end(), resumed.begin(), resumed.end());
+        queue.swap(waiting);
+    }
+}
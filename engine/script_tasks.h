@@ -0,0 +1,93 @@
+/* Copyright (c) The Grit Game Engine authors 2016
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef ScriptTasks_h
+#define ScriptTasks_h
+
+#include <string>
+#include <vector>
+
+extern "C" {
+    #include <lua.h>
+}
+
+/** \file
+ *
+ * Long-running script work (AI planning, procedural generation, etc) can be written as a Lua
+ * function that calls coroutine.yield() whenever it is a good time to stop.  Such a function is
+ * run as a task, in its own coroutine, and is resumed once per frame until it returns.  All
+ * tasks share a per-frame time budget.  Tasks are resumed in order of priority, and in a round
+ * robin within each priority.  Once the budget is spent, the remaining tasks wait for the next
+ * frame, except critical ones, which are always resumed.  Each task records how much CPU time it
+ * has used and how many frames it has been left waiting (starved).
+ *
+ * A task cannot yield from inside a pcall or a C function (e.g. a callback invoked by the
+ * engine), as usual for Lua coroutines.
+ */
+
+enum ScriptTaskPriority {
+    SCRIPT_TASK_CRITICAL,
+    SCRIPT_TASK_NORMAL,
+    SCRIPT_TASK_BACKGROUND,
+    SCRIPT_TASK_PRIORITIES
+};
+
+std::string script_task_priority_to_string (ScriptTaskPriority p);
+
+/** Returns false if the string is not a priority. */
+bool script_task_priority_from_string (const std::string &s, ScriptTaskPriority &p);
+
+struct ScriptTaskStats {
+    std::string name;
+    ScriptTaskPriority priority;
+    /** Total time spent running the task, in microseconds. */
+    unsigned long long cpuTime;
+    /** The longest single resume, in microseconds. */
+    unsigned long long maxSlice;
+    unsigned resumes;
+    /** Frames since the task was last resumed, and the most there have ever been. */
+    unsigned starvedFrames, maxStarvedFrames;
+};
+
+/** Create a task from the function at the top of the stack, which is popped.  Returns the
+ * task's id.  The task is first resumed at the next call of script_tasks_do_frame. */
+unsigned script_task_spawn (lua_State *L, const std::string &name, ScriptTaskPriority priority);
+
+/** Stop the task from being resumed again.  Its coroutine is released at the next call of
+ * script_tasks_do_frame.  Returns false if there is no such task (e.g. because it already
+ * finished). */
+bool script_task_kill (unsigned id);
+
+/** Kill all tasks. */
+void script_task_kill_all (void);
+
+/** Ids of all tasks that have not yet finished. */
+std::vector<unsigned> script_task_all (void);
+
+/** Returns false if there is no such task. */
+bool script_task_stats (unsigned id, ScriptTaskStats &stats);
+
+/** Resume tasks until the budget (in seconds) has been used.  Tasks that finish or raise an
+ * error are removed.  Call once per frame. */
+void script_tasks_do_frame (lua_State *L, float budget);
+
+#endif
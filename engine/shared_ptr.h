@@ -24,6 +24,35 @@
 
 #include <cstdlib>
 #include <functional>
+#include <utility>
+
+template<class T> class SharedPtr;
+
+/** Base class for objects that keep their own SharedPtr reference count.
+ *
+ * SharedPtr normally allocates the counter separately, so copying a handle touches both the
+ * counter and (usually, soon after) the object, in different cache lines, and every new
+ * object costs an extra allocation.  Engine types that are handled through SharedPtr and copied
+ * often derive from this instead, and the counter is then the one inside the object.
+ *
+ * Since the counter belongs to the object, wrapping a raw pointer to an object that is already
+ * referenced by a SharedPtr is safe for these types (it just adds a reference).
+ */
+class SharedPtrCounted {
+
+    unsigned int sharedPtrCount;
+
+    template<class T> friend class SharedPtr;
+
+    protected:
+
+    SharedPtrCounted (void) : sharedPtrCount(0) { }
+
+    /** A copy of the object is not referenced by anything yet. */
+    SharedPtrCounted (const SharedPtrCounted &) : sharedPtrCount(0) { }
+
+    SharedPtrCounted &operator= (const SharedPtrCounted &) { return *this; }
+};
 
 /** A smart pointer that does reference counting and calls delete on the target
  * when the number of references hits zero.  Note that unlike Ogre::SharedPtr,
@@ -35,10 +64,19 @@ template<class T> class SharedPtr {
     T *ptr;
 
     /** The number of references to the target.  Note that to allow a general
-     * T, we allocate the counter separately.  It would also be possible to require
-     * a counter inside the T object. */
+     * T, we allocate the counter separately, unless T extends SharedPtrCounted in
+     * which case this points at the counter inside the target.  Keeping the pointer
+     * in both cases means copying, casting and destroying a SharedPtr does not need
+     * the complete T. */
     unsigned int *cnt;
 
+    /** Overload resolution prefers the conversion to a base class over void*. */
+    static unsigned int *newCounter (const SharedPtrCounted *p)
+    { return &const_cast<SharedPtrCounted*>(p)->sharedPtrCount; }
+    static unsigned int *newCounter (const void *) { return new unsigned int(0); }
+    static void deleteCounter (const SharedPtrCounted *, unsigned int *) { }
+    static void deleteCounter (const void *, unsigned int *c) { delete c; }
+
     public:
 
     /** Deference to the target. */
@@ -55,7 +93,9 @@ template<class T> class SharedPtr {
         if (isNull()) return;
         useCount()--;
         if (useCount()==0) {
-            delete cnt;
+            // Otherwise the overloads above could not tell whether the counter is ours.
+            static_assert(sizeof(T) > 0, "SharedPtr target deleted while its type is incomplete");
+            deleteCounter(ptr, cnt);
             delete ptr;
         }
         ptr = NULL;
@@ -72,11 +112,14 @@ template<class T> class SharedPtr {
      * used only through the SharedPtr from this point onwards, as it can be
      * difficult to know when raw pointers to reference-counted memory become
      * dangling. */
-    explicit SharedPtr (T *p) : ptr(p), cnt(p==NULL?NULL:new unsigned int(1)) { }
+    explicit SharedPtr (T *p) : ptr(p), cnt(p==NULL?NULL:newCounter(p)) { if (!isNull()) useCount()++; }
 
     /** Make a new reference to an existing SharedPtr (incrementing the reference counter). */
     SharedPtr (const SharedPtr<T> &p) : ptr(p.ptr), cnt(p.cnt) { if (!isNull()) useCount()++; }
 
+    /** Take the reference held by p, leaving it NULL.  The counter is not touched. */
+    SharedPtr (SharedPtr<T> &&p) : ptr(p.ptr), cnt(p.cnt) { p.ptr = NULL; p.cnt = NULL; }
+
     /** Destructor (decrements the reference counter). */
     ~SharedPtr (void) { setNull(); }
 
@@ -98,6 +141,24 @@ template<class T> class SharedPtr {
         return *this;
     }
 
+    /** Take the reference held by p, leaving it NULL.
+     *
+     * Our old target (if any) is released only after p has been emptied, in case releasing it
+     * destroys the object that holds p.
+     */
+    SharedPtr &operator= (SharedPtr<T> &&p) {
+        SharedPtr<T> old;
+        old.swap(*this);
+        swap(p);
+        return *this;
+    }
+
+    /** Exchange targets with p, without touching the counters. */
+    void swap (SharedPtr<T> &p) {
+        std::swap(ptr, p.ptr);
+        std::swap(cnt, p.cnt);
+    }
+
     /** Return a SharedPtr to the same object that has a supertype.
      *
      * Follows C++ static_cast rules.
@@ -19,16 +19,23 @@
  * THE SOFTWARE.
  */
 
+#include <sleep.h>
+
 #include "cache_friendly_range_space_simd.h"
 #include "core_option.h"
+#include "frame_allocator.h"
 #include "grit_class.h"
 #include "main.h"
+#include "metrics.h"
 #include "streamer.h"
 
 float streamer_visibility;
 float streamer_prepare_distance_factor;
 float streamer_fade_out_factor;
 float streamer_fade_overlap_factor;
+float streamer_deactivation_hysteresis;
+float streamer_warm_deactivation_time;
+float streamer_thrash_window;
 
 typedef CacheFriendlyRangeSpace<GritObjectPtr> Space;
 static Space rs;
@@ -40,6 +47,37 @@ static GObjPtrs fresh; // just been added - skip the queue for activation
 typedef std::vector<StreamerCallback*> StreamerCallbacks;
 StreamerCallbacks streamer_callbacks;
 
+static MetricCounter *metric_activations =
+    metrics_counter("grit_streamer_activations_total", "", "Objects activated by the streamer.");
+static MetricCounter *metric_deactivations =
+    metrics_counter("grit_streamer_deactivations_total", "",
+                    "Objects deactivated by the streamer.");
+static MetricCounter *metric_pop_ins =
+    metrics_counter("grit_streamer_pop_ins_total", "",
+                    "Objects activated too late to fade in, because their resources were not "
+                    "loaded in time.");
+static MetricHistogram *metric_activation_latency =
+    metrics_histogram("grit_streamer_activation_latency_seconds", "",
+                      "Time from an object's resources being requested to its activation.",
+                      metrics_latency_bounds());
+static MetricHistogram *metric_centre_time =
+    metrics_histogram("grit_streamer_centre_seconds", "",
+                      "Time spent in streamer_centre per frame.", metrics_latency_bounds());
+static MetricGauge *metric_activated =
+    metrics_gauge("grit_streamer_activated_objects", "", "Objects currently activated.");
+static MetricGauge *metric_loading =
+    metrics_gauge("grit_streamer_loading_objects", "",
+                  "Objects whose resources are loading or loaded.");
+static MetricGauge *metric_queue_depth =
+    metrics_gauge("grit_background_loader_queue_depth", "",
+                  "Demands waiting for the background loader.");
+static MetricGauge *metric_unused_host =
+    metrics_gauge("grit_disk_resource_unused_loaded", "memory=\"host\"",
+                  "Loaded resources no longer in use, which can be unloaded if memory is needed.");
+static MetricGauge *metric_unused_gpu =
+    metrics_gauge("grit_disk_resource_unused_loaded", "memory=\"gpu\"",
+                  "Loaded resources no longer in use, which can be unloaded if memory is needed.");
+
 static void remove_if_exists (GObjPtrs &list, const GritObjectPtr &o)
 {
     GObjPtrs::iterator iter = find(list.begin(), list.end(), o);
@@ -59,8 +97,8 @@ void streamer_centre (lua_State *L, const Vector3 &new_pos, bool everything)
 {
     int step_size = everything ? INT_MAX : core_option(CORE_STEP_SIZE);
 
-    Space::Cargo fnd = fresh;
-    fresh.clear();
+    Space::Cargo fnd;
+    fnd.swap(fresh);
 
     const float visibility = streamer_visibility;
 
@@ -68,7 +106,13 @@ void streamer_centre (lua_State *L, const Vector3 &new_pos, bool everything)
     const float tpF = pF * visibility; // prepare and visibility factors
     const float vis2 = visibility * visibility;
 
-    typedef GObjPtrs::iterator I;
+    // Activated objects stay activated until they are this far away (as range2).
+    const float hyst = 1 + streamer_deactivation_hysteresis;
+    const float deactivate_range2 = hyst * hyst;
+    const unsigned long long warm_time = streamer_warm_deactivation_time * 1E6;
+    const unsigned long long now = micros();
+
+    typedef FrameVector<GritObjectPtr>::iterator I;
 
     // iterate through, deactivating things
 
@@ -78,7 +122,7 @@ void streamer_centre (lua_State *L, const Vector3 &new_pos, bool everything)
     ////////////////////////////////////////////////////////////////////////
     // use victims because deactivate() changes the 'activated' list
     // and so does notifyRange2 if the callback raises an error
-    GObjPtrs victims = activated;
+    FrameVector<GritObjectPtr> victims(activated.begin(), activated.end());
     for (I i=victims.begin(), i_=victims.end() ; i!=i_ ; ++i) {
         const GritObjectPtr &o = *i;
          //note we use vis2 not visibility
@@ -95,19 +139,29 @@ void streamer_centre (lua_State *L, const Vector3 &new_pos, bool everything)
             float range2 = the_far->range2(new_pos) / vis2;
             the_far->notifyRange2(L, the_far, range2);
         }
-        if (range2 > 1) {
+        if (range2 > deactivate_range2) {
             // now out of range
             const GritObjectPtr &o = *i;
             const GritObjectPtr &the_far = o->getFarObj();
-            bool killme = o->deactivate(L, o);
-            if (!the_far.isNull()) {
-                // we're deactivating and we have a far,
+            bool was_parked = o->isParked();
+            if (!the_far.isNull() && !was_parked) {
+                // we're leaving and we have a far,
                 // so make sure it gets considered this frame
                 fnd.push_back(the_far);
             }
-            if (killme) {
-                object_del(L, o);
+            if (warm_time > 0 && !was_parked) {
+                // keep it around (it is already faded out) in case it comes back
+                o->park(now);
+            } else if (!was_parked || now - o->getParkedSince() >= warm_time) {
+                metric_deactivations->inc();
+                bool killme = o->deactivate(L, o);
+                if (killme) {
+                    object_del(L, o);
+                }
             }
+        } else if (range2 <= 1 && o->isParked()) {
+            // back in range before it was deactivated, the fade is already restored
+            o->revive();
         }
     }
 
@@ -118,7 +172,8 @@ void streamer_centre (lua_State *L, const Vector3 &new_pos, bool everything)
         // Iteration should be fast for removal of significant number of
         // elements.  Don't do this if it ever stops being a vector.
         const GritObjectPtr &o = loaded[i];
-        if (!o->withinRange(new_pos, tpF)) {
+        // objects still activated beyond this range (hysteresis or parked) keep their resources
+        if (!o->withinRange(new_pos, tpF) && !o->isActivated()) {
             // unregister demand...
             // we deactivated first so this should
             // unload any resources we were using
@@ -132,7 +187,7 @@ void streamer_centre (lua_State *L, const Vector3 &new_pos, bool everything)
     }
 
 
-    GObjPtrs must_kill;
+    FrameVector<GritObjectPtr> must_kill;
 
     ////////////////////////////////////////////////////////////////////////
     // LOAD RESOURCES FOR APPROACHING GRIT OBJECTS /////////////////////////
@@ -198,6 +253,12 @@ void streamer_centre (lua_State *L, const Vector3 &new_pos, bool everything)
       
 
         // ok there wasn't so activate
+        metric_activations->inc();
+        if (o->getLoadRequestTime() != 0)
+            metric_activation_latency->observe((micros() - o->getLoadRequestTime()) / 1E6);
+        // should have been activated earlier, while still fading in
+        if (range2 < streamer_fade_out_factor * streamer_fade_out_factor)
+            metric_pop_ins->inc();
         o->activate(L, o);
 
         // activation can result in a lua error which triggers the destruction of the
@@ -209,7 +270,7 @@ void streamer_centre (lua_State *L, const Vector3 &new_pos, bool everything)
         skip:;
     }
 
-    for (GObjPtrs::iterator i=must_kill.begin(), i_=must_kill.end() ; i!=i_ ; ++i) {
+    for (I i=must_kill.begin(), i_=must_kill.end() ; i!=i_ ; ++i) {
         CERR << "Object: \"" << (*i)->name << "\" raised an error while background loading "
              << "resources, so destroying it." << std::endl;
         object_del(L, *i);
@@ -223,6 +284,12 @@ void streamer_centre (lua_State *L, const Vector3 &new_pos, bool everything)
         (*i)->update(new_pos);
     }
 
+    metric_activated->set(activated.size());
+    metric_loading->set(loaded.size());
+    metric_queue_depth->set(bgl->size());
+    metric_unused_host->set(bgl->getLRUQueueSizeHost());
+    metric_unused_gpu->set(bgl->getLRUQueueSizeGPU());
+    metric_centre_time->observe((micros() - now) / 1E6);
 }
 
 void streamer_update_sphere (size_t index, const Vector3 &pos, float d)
@@ -243,7 +310,8 @@ int streamer_object_activated_count (void)
 
 void streamer_list(const GritObjectPtr &o)
 {
-    rs.add(o);
+    // Only called by object_add, with an object that was just created.
+    rs.addNew(o);
     fresh.push_back(o);
 }
 
@@ -253,6 +321,12 @@ void streamer_unlist(const GritObjectPtr &o)
     remove_if_exists(fresh, o);
 }
 
+void streamer_reserve (size_t n)
+{
+    rs.reserve(n);
+    fresh.reserve(n);
+}
+
 void streamer_list_as_activated (const GritObjectPtr &o)
 {
     GObjPtrs::iterator begin = activated.begin(), end = activated.end();
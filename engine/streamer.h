@@ -47,6 +47,15 @@ extern float streamer_fade_out_factor;
 /** Single var cache of CORE_FADE_OVERLAP_FACTOR. */
 extern float streamer_fade_overlap_factor;
 
+/** Single var cache of CORE_DEACTIVATION_HYSTERESIS. */
+extern float streamer_deactivation_hysteresis;
+
+/** Single var cache of CORE_WARM_DEACTIVATION_TIME. */
+extern float streamer_warm_deactivation_time;
+
+/** Single var cache of CORE_THRASH_WINDOW. */
+extern float streamer_thrash_window;
+
 /** Call before anything else.  Sets up internal state of the subsystem. */
 void streamer_init();
 
@@ -69,6 +78,10 @@ void streamer_list (const GritObjectPtr &o);
 /** Remove an object from the map. */
 void streamer_unlist (const GritObjectPtr &o);
 
+/** Make room for this many objects in the map, so that adding them in bulk does not repeatedly
+ * grow the streamer's internal arrays. */
+void streamer_reserve (size_t n);
+
 /** Add to the list of activated objects.  These are not streamed in when they
  * come into range, and are streamed out when they go out of range. */
 void streamer_list_as_activated (const GritObjectPtr &o);
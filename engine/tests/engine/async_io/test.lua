@@ -0,0 +1,85 @@
+-- Reads a few thousand small files from a cold page cache, first one after another as the
+-- background loader used to, then all at once with each async I/O backend.  Then loads a resource
+-- through a demand, which opens the file from the buffer the loader had read for it.
+
+local count = 3000
+local files = {}
+local bytes = 0
+for i = 1, count do
+    local name = string.format("async_io_%04d.bin", i)
+    local size = 1024 + (i * 37) % 8192
+    local f = assert(io.open(name, "wb"))
+    f:write(string.rep(string.char(i % 256), size))
+    f:close()
+    files[i] = "/" .. name
+    bytes = bytes + size
+end
+
+-- Returns false if the OS cannot drop files from its cache, in which case the reads are warm.
+local function drop_cache()
+    local cold = true
+    for _, name in ipairs(files) do
+        cold = async_io_drop_cache(name) and cold
+    end
+    return cold
+end
+
+local original = async_io_get_backend()
+print("default backend: " .. original)
+
+local cold = drop_cache()
+local before = seconds()
+local read = 0
+for _, name in ipairs(files) do
+    local f = assert(io.open(name:sub(2), "rb"))
+    read = read + #f:read("*a")
+    f:close()
+end
+assert(read == bytes)
+print(string.format("%d files, %d bytes, %s page cache", count, bytes, cold and "cold" or "warm"))
+print(string.format("one at a time: %.1f ms", (seconds() - before) * 1000))
+
+for _, backend in ipairs({"threads", "io_uring"}) do
+    if async_io_set_backend(backend) then
+        drop_cache()
+        local before = seconds()
+        assert(async_io_read_all(files) == bytes)
+        print(string.format("%s, depth %d: %.1f ms", backend, async_io_get_depth(),
+                            (seconds() - before) * 1000))
+        -- The buffers were freed.
+        local queued, in_flight, done, held = async_io_stats()
+        assert(queued == 0 and in_flight == 0 and done == 0 and held == 0)
+    else
+        print(backend .. ": not available")
+    end
+end
+
+for _, name in ipairs(files) do
+    os.remove(name:sub(2))
+end
+
+-- The loader reads the resource before loading it.
+assert(async_io_set_backend(original))
+if original ~= "off" then
+    local lut = `neutral.lut.png`
+    class_add(`AsyncGraded`, {}, {
+        renderingDistance = 100,
+        init = function (persistent)
+            persistent:addDiskResource(lut)
+        end,
+        activate = function (persistent, instance)
+        end,
+        deactivate = function (persistent)
+        end,
+    })
+    if disk_resource_loaded(lut) then disk_resource_unload(lut) end
+    local hits = metrics_value("grit_async_io_hits_total")
+    local obj = object_add(`AsyncGraded`, vec(0, 0, 0))
+    obj:activate()
+    assert(obj.activated)
+    assert(metrics_value("grit_async_io_hits_total") > hits)
+    object_all_del()
+    class_del(`AsyncGraded`)
+    -- Nothing is held once the demand has been loaded.
+    assert(select(4, async_io_stats()) == 0)
+end
@@ -0,0 +1,32 @@
+-- Times loading the env cube and colour grade LUT, whose images are rearranged on load, and the
+-- env cube converted to a cube map DDS, which is uploaded as it is.
+
+local function time_loads(name, n)
+    local before = seconds()
+    for i = 1, n do
+        disk_resource_load(name)
+        disk_resource_unload(name)
+    end
+    return (seconds() - before) / n
+end
+
+local iterations = 20
+
+local strip = `env_cube_noon.envcube.tiff`
+local cube = `env_cube_noon.envcube.dds`
+gfx_env_cube_convert(strip, cube)
+
+local strip_time = time_loads(strip, iterations)
+local cube_time = time_loads(cube, iterations)
+local lut_time = time_loads(`neutral.lut.png`, iterations)
+
+print(string.format("env cube strip: %.2f ms, cube dds: %.2f ms, colour grade LUT: %.2f ms",
+                    strip_time * 1000, cube_time * 1000, lut_time * 1000))
+
+-- The neutral LUT maps every colour to itself, so the slices must be in the right places.
+gfx_colour_grade(`neutral.lut.png`)
+for _, c in ipairs({ vec(0, 0, 0), vec(1, 1, 1), vec(0.25, 0.5, 0.75), vec(1, 0, 0.5) }) do
+    assert(#(gfx_colour_grade_look_up(c) - c) < 0.02)
+end
+
+os.remove(cube:sub(2))
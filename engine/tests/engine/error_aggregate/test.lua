@@ -0,0 +1,62 @@
+-- A Lua callback that fails every time it is called, like the per-frame callback of one broken
+-- object.  The first few errors are reported in full, the rest are only counted and summarised,
+-- so a storm of errors costs little more per error than the pcall.
+
+local function broken()
+    error("broken callback")
+end
+
+-- Returns the time per error.
+local function storm(n)
+    local before = seconds()
+    for i = 1, n do
+        assert(not xpcall(broken, error_handler))
+    end
+    return (seconds() - before) / n
+end
+
+local function find()
+    for _, e in ipairs(error_aggregate_all()) do
+        if e.site == "Lua error" and e.key:find("broken callback") then return e end
+    end
+end
+
+local burst = core_option("ERROR_BURST")
+
+-- Every error reported in full, with its traceback.
+error_aggregate_clear()
+core_option("ERROR_BURST", 1000000)
+local full = storm(200)
+assert(find().suppressed == 0)
+
+error_aggregate_clear()
+core_option("ERROR_BURST", 5)
+local n = 100000
+local aggregated = storm(n)
+local e = find()
+assert(e.count == n and e.suppressed == n - 5)
+assert(e.sinceFirst >= e.sinceLast)
+print(string.format("per error: %.1f us reported in full, %.1f us aggregated",
+                    full * 1E6, aggregated * 1E6))
+
+-- Writes the summary.
+error_aggregate_flush()
+assert(find() ~= nil)
+
+-- A key that is quiet for a whole period is forgotten, making room for others.
+local period = core_option("ERROR_SUMMARY_PERIOD")
+core_option("ERROR_SUMMARY_PERIOD", 0.1)
+sleep_seconds(0.2)
+error_aggregate_flush()
+assert(find() == nil)
+core_option("ERROR_SUMMARY_PERIOD", period)
+
+-- Errors typed at the console are always reported in full, and not counted.
+for i = 1, 10 do
+    assert(not xpcall(broken, console_error_handler))
+end
+assert(find() == nil)
+
+error_aggregate_clear()
+assert(#error_aggregate_all() == 0)
+core_option("ERROR_BURST", burst)
@@ -0,0 +1,82 @@
+-- Runs the per-frame object and physics work for a while, then checks that once the frame arena
+-- has grown to fit, further frames make no heap allocations.
+
+local activations = 0
+
+class_add(`Ticker`, {}, {
+    renderingDistance = 100,
+    activate = function (self)
+        activations = activations + 1
+        self.needsFrameCallbacks = true
+        self.needsStepCallbacks = true
+    end,
+    deactivate = function (self)
+        self.needsFrameCallbacks = false
+        self.needsStepCallbacks = false
+    end,
+    frameCallback = function (self, elapsed)
+    end,
+    stepCallback = function (self, elapsed)
+    end,
+})
+
+for i = 1, 2000 do
+    object_add(`Ticker`, vec(i % 50, math.floor(i / 50), 0), {})
+end
+
+local function frame(streamer)
+    if streamer then
+        streamer_centre(vec(25, 20, 0))
+    end
+    object_do_frame_callbacks(0.01)
+    object_do_step_callbacks(0.01)
+    physics_update()
+    frame_arena_end_frame()
+end
+
+-- Warm up: activates everything and grows the arena.
+for i = 1, 10 do
+    frame(true)
+end
+assert(activations > 0)
+
+local capacity, used, high_water, max_high_water, overflows = frame_arena_stats()
+print(string.format("frame arena: %d bytes, used %d, high water %d (max %d), %d overflows",
+                    capacity, used, high_water, max_high_water, overflows))
+assert(used == 0)
+assert(high_water > 0)
+assert(capacity >= high_water)
+
+-- Heap allocations are only counted in builds with USE_HEAP_COUNT, otherwise this is nil and
+-- the allocation checks are skipped.
+local counted = heap_allocations() ~= nil
+if not counted then
+    print("heap allocations are not counted in this build, skipping the allocation checks")
+end
+
+local frames = 100
+local before = counted and heap_allocations()
+for i = 1, frames do
+    frame(false)
+end
+if counted then
+    local allocs = heap_allocations() - before
+    print(string.format("callbacks and physics: %d heap allocations in %d frames", allocs, frames))
+    assert(allocs == 0)
+end
+
+local _, _, _, _, overflows2 = frame_arena_stats()
+assert(overflows2 == overflows)
+
+-- The streamer also notifies other subsystems (graphics etc.), so report it separately.
+before = counted and heap_allocations()
+for i = 1, frames do
+    frame(true)
+end
+if counted then
+    print(string.format("with streamer: %.1f heap allocations per frame",
+                        (heap_allocations() - before) / frames))
+end
+
+object_all_del()
+class_all_del()
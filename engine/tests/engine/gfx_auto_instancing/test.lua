@@ -0,0 +1,95 @@
+gfx_colour_grade(`neutral.lut.png`)
+gfx_fade_dither_map `stipple.png`
+
+
+gfx_register_shader(`Money`, {
+    tex = {
+        uniformKind = "TEXTURE2D",
+    },
+    vertexCode = [[
+        var normal_ws = rotate_to_world(vert.normal.xyz);
+    ]],
+    dangsCode = [[
+        out.diffuse = sample(mat.tex, vert.coord0.xy).rgb;
+        out.gloss = 0;
+        out.specular = 0;
+        out.normal = normal_ws;
+    ]],
+    additionalCode = [[
+    ]],
+})
+
+-- Used by Money.mesh.
+register_material(`Money`, {
+    shader = `Money`,
+    tex = `Money_d.dds`,
+    additionalLighting = false,
+})
+
+
+print "Loading Money_d.dds"
+disk_resource_load(`Money_d.dds`)
+print "Loading Money.mesh"
+disk_resource_load(`Money.mesh`)
+
+
+gfx_sunlight_direction(vec(0, 0, -1))
+gfx_sunlight_diffuse(vec(1, 1, 1))
+gfx_sunlight_specular(vec(1, 1, 1))
+
+
+-- A grid of identical bodies, all in view.
+bodies = {}
+for x = 0, 3 do
+    for y = 0, 3 do
+        local b = gfx_body_make(`Money.mesh`)
+        b.castShadows = false
+        b.localPosition = vec(x * 0.2, y * 0.2, 0)
+        bodies[#bodies + 1] = b
+    end
+end
+
+function render_and_count()
+    gfx_render(0.1, vec(0.3, -1.5, 0.8), quat(0.9800102, -0.1631184, 0.01870036, -0.1123512))
+    return gfx_auto_instancing_stats()
+end
+
+gfx_option('AUTO_INSTANCING', false)
+render_and_count()
+local before, after = render_and_count()
+print("Without merging: " .. before .. " draws offered, " .. after .. " queued")
+if after ~= before then
+    error("Draws were merged with AUTO_INSTANCING disabled.")
+end
+if before < 2 then
+    error("Expected several bodies to be drawn, got " .. before)
+end
+
+gfx_option('AUTO_INSTANCING', true)
+render_and_count()
+local before2, after2 = render_and_count()
+print("With merging: " .. before2 .. " draws offered, " .. after2 .. " queued")
+if before2 ~= before then
+    error("Enabling AUTO_INSTANCING changed the number of draws offered.")
+end
+-- One draw per submesh of Money.mesh.
+local submeshes = before / #bodies
+if after2 ~= submeshes then
+    error("Expected all bodies to be merged into " .. submeshes .. " draws, got " .. after2)
+end
+
+-- A body with a different material is not merged with the others.
+register_material(`Money2`, {
+    shader = `Money`,
+    tex = `Money_d.dds`,
+    additionalLighting = false,
+})
+bodies[1]:setAllMaterials(`Money2`)
+render_and_count()
+local before3, after3 = render_and_count()
+print("With one different material: " .. before3 .. " draws offered, " .. after3 .. " queued")
+if after3 ~= 2 * submeshes then
+    error("Expected " .. 2 * submeshes .. " draws, got " .. after3)
+end
+
+gfx_screenshot('output.png')
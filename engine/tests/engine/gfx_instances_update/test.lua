@@ -0,0 +1,102 @@
+gfx_colour_grade(`neutral.lut.png`)
+gfx_fade_dither_map `stipple.png`
+
+
+gfx_register_shader(`Money`, {
+    tex = {
+        uniformKind = "TEXTURE2D",
+    },
+    vertexCode = [[
+        var normal_ws = rotate_to_world(vert.normal.xyz);
+    ]],
+    dangsCode = [[
+        out.diffuse = sample(mat.tex, vert.coord0.xy).rgb;
+        out.gloss = 0;
+        out.specular = 0;
+        out.normal = normal_ws;
+    ]],
+    additionalCode = [[
+    ]],
+})
+
+-- Used by Money.mesh.
+register_material(`Money`, {
+    shader = `Money`,
+    tex = `Money_d.dds`,
+    additionalLighting = false,
+})
+
+
+print "Loading Money_d.dds"
+disk_resource_load(`Money_d.dds`)
+print "Loading Money.mesh"
+disk_resource_load(`Money.mesh`)
+
+
+-- Compares the throughput of updating instances one at a time against updating them in bulk.
+
+local count = 5000
+local frames = 10
+
+b = gfx_instances_make(`Money.mesh`)
+b.castShadows = false
+local ids = {}
+for i = 1, count do
+    ids[i] = b:add(vec(i % 100, math.floor(i / 100), 0), quat(1, 0, 0, 0), 1)
+end
+assert(b.instances == count)
+
+local cam_pos = vec(50, -80, 40)
+local cam_dir = quat(1, 0, 0, 0)
+
+local before = micros()
+for f = 1, frames do
+    for i = 1, count do
+        b:update(ids[i], vec(i % 100, math.floor(i / 100), f), quat(1, 0, 0, 0), 1)
+    end
+    gfx_render(0.1, cam_pos, cam_dir)
+end
+local single_us = micros() - before
+
+local data = {}
+local before = micros()
+for f = 1, frames do
+    for i = 1, count do
+        local o = (i - 1) * 8
+        data[o + 1] = i % 100
+        data[o + 2] = math.floor(i / 100)
+        data[o + 3] = f
+        data[o + 4] = 1
+        data[o + 5] = 0
+        data[o + 6] = 0
+        data[o + 7] = 0
+        data[o + 8] = 1
+    end
+    b:updateMany(ids, data)
+    gfx_render(0.1, cam_pos, cam_dir)
+end
+local many_us = micros() - before
+
+print(string.format("update: %.1f instances/ms", count * frames * 1000 / single_us))
+print(string.format("updateMany: %.1f instances/ms", count * frames * 1000 / many_us))
+
+-- A few instances changing uploads only their part of the buffer.
+b:updateMany({ids[10], ids[20]}, {
+    0, 0, 0,  1, 0, 0, 0,  0.5,
+    1, 0, 0,  1, 0, 0, 0,  0.5,
+})
+gfx_render(0.1, cam_pos, cam_dir)
+
+-- Bad indexes are rejected before anything is updated.
+b:del(ids[count])
+local ok = pcall(function()
+    b:updateMany({ids[1], ids[count]}, {
+        0, 0, 0,  1, 0, 0, 0,  1,
+        0, 0, 0,  1, 0, 0, 0,  1,
+    })
+end)
+assert(not ok)
+local ok = pcall(function() b:updateMany({ids[1]}, {0, 0, 0}) end)
+assert(not ok)
+
+b:destroy()
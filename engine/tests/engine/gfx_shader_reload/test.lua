@@ -0,0 +1,122 @@
+-- Changes a shader that is in use.  The permutations it was using are recompiled in the
+-- background, and the old programs are drawn with until the new ones are swapped in.
+
+gfx_colour_grade(`neutral.lut.png`)
+gfx_fade_dither_map `stipple.png`
+
+-- With tint, the shader has a uniform that the first versions do not.
+local function register(colour, tint)
+    local uniforms = {
+        tex = {
+            uniformKind = "TEXTURE2D",
+        },
+        vertexCode = [[
+            var normal_ws = rotate_to_world(vert.normal.xyz);
+        ]],
+        dangsCode = [[
+            out.diffuse = sample(mat.tex, vert.coord0.xy).rgb * ]] .. colour .. [[;
+            out.gloss = 0;
+            out.specular = 0;
+            out.normal = normal_ws;
+        ]],
+        additionalCode = [[
+        ]],
+    }
+    if tint then
+        uniforms.tint = { uniformKind = "PARAM", valueKind = "FLOAT", 1, 1, 1 }
+        uniforms.dangsCode = [[
+            out.diffuse = sample(mat.tex, vert.coord0.xy).rgb * ]] .. colour .. [[ * mat.tint;
+            out.gloss = 0;
+            out.specular = 0;
+            out.normal = normal_ws;
+        ]]
+    end
+    gfx_register_shader(`Money`, uniforms)
+end
+
+register("Float3(1, 1, 1)")
+
+-- Used by Money.mesh.
+register_material(`Money`, {
+    shader = `Money`,
+    tex = `Money_d.dds`,
+    additionalLighting = false,
+})
+
+disk_resource_load(`Money_d.dds`)
+disk_resource_load(`Money.mesh`)
+
+gfx_sunlight_direction(vec(0, 0, -1))
+gfx_sunlight_diffuse(vec(1, 1, 1))
+gfx_sunlight_specular(vec(1, 1, 1))
+
+b = gfx_body_make(`Money.mesh`)
+b.castShadows = false
+
+local function render()
+    local before = seconds()
+    gfx_render(0.1, vec(0.04362189, -0.9296255, 0.5302261),
+               quat(0.9800102, -0.1631184, 0.01870036, -0.1123512))
+    return seconds() - before
+end
+
+-- Builds the programs the first time.
+render()
+render()
+
+local function count()
+    return metrics_value("grit_gfx_shader_reload_permutations_total")
+end
+local permutations = count()
+
+-- Nothing waits for the new code to compile.
+register("Float3(1, 0, 0)")
+assert(gfx_shader_resets_pending() == 1)
+local frames, longest = 0, 0
+while gfx_shader_resets_pending() > 0 do
+    longest = math.max(longest, render())
+    frames = frames + 1
+end
+assert(count() > permutations)
+print(string.format("reload: %d permutations, %d frames, longest %.1f ms",
+                    count() - permutations, frames, longest * 1000))
+render()
+gfx_screenshot('output.png')
+
+-- Code that does not type check is refused before anything is compiled.
+local ok = pcall(register, "no_such_variable")
+assert(not ok)
+assert(gfx_shader_resets_pending() == 0)
+
+-- A second change before the first is done replaces it.
+register("Float3(0, 1, 0)")
+register("Float3(0, 0, 1)")
+assert(gfx_shader_resets_pending() == 1)
+while gfx_shader_resets_pending() > 0 do render() end
+
+-- The new uniform can be bound while the old programs are still drawn with.
+register("Float3(1, 1, 1)", true)
+assert(gfx_shader_resets_pending() == 1)
+register_material(`Money`, {
+    shader = `Money`,
+    tex = `Money_d.dds`,
+    tint = vec(1, 0.5, 0),
+    additionalLighting = false,
+})
+while gfx_shader_resets_pending() > 0 do render() end
+render()
+
+-- A permutation that the old code was never built for (here, the material has no texture) is
+-- added to the reset, which then finishes, instead of being built from the old code.
+register("Float3(1, 1, 1)")
+assert(gfx_shader_resets_pending() == 1)
+permutations = count()
+register_material(`Money`, {
+    shader = `Money`,
+    additionalLighting = false,
+})
+assert(gfx_shader_resets_pending() == 0)
+assert(count() > permutations)
+render()
+
+b:destroy()
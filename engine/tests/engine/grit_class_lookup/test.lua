@@ -0,0 +1,84 @@
+-- Reads class fields and runs class callbacks through objects, timing the lookups, and checks
+-- that redefining the class and overriding fields on the object both take effect.
+
+local count = 1000
+local iterations = 100
+
+local class_frames = 0
+
+class_add(`Lamp`, {}, {
+    renderingDistance = 50,
+    colour = vec(1, 0.5, 0),
+    brightness = 3,
+    frameCallback = function (self, elapsed)
+        class_frames = class_frames + 1
+    end,
+})
+
+local objs = {}
+for i = 1, count do
+    local o = object_add(`Lamp`, vec(i, 0, 0), {})
+    o.needsFrameCallbacks = true
+    objs[i] = o
+end
+
+local before = micros()
+local total = 0
+for j = 1, iterations do
+    for i = 1, count do
+        total = total + objs[i].brightness
+    end
+end
+assert(total == 3 * count * iterations)
+print(string.format("class field lookup: %.3f us per lookup",
+                    (micros() - before) / (count * iterations)))
+
+before = micros()
+for j = 1, iterations do
+    object_do_frame_callbacks(0.01)
+end
+assert(class_frames == count * iterations)
+print(string.format("frame callback dispatch: %.3f us per object",
+                    (micros() - before) / (count * iterations)))
+
+-- Redefining the class is seen by existing objects.
+local redefined_frames = 0
+class_add(`Lamp`, {}, {
+    renderingDistance = 80,
+    colour = vec(1, 0.5, 0),
+    brightness = 4,
+    frameCallback = function (self, elapsed)
+        redefined_frames = redefined_frames + 1
+    end,
+})
+assert(objs[1].brightness == 4)
+assert(objs[1].renderingDistance == 80)
+object_do_frame_callbacks(0.01)
+assert(redefined_frames == count)
+assert(class_frames == count * iterations)
+
+-- Fields on the object take precedence over the class, until they are removed.
+local own_frames = 0
+objs[1].frameCallback = function (self, elapsed)
+    own_frames = own_frames + 1
+end
+objs[1].brightness = 10
+assert(objs[1].brightness == 10)
+assert(objs[2].brightness == 4)
+object_do_frame_callbacks(0.01)
+assert(own_frames == 1)
+assert(redefined_frames == 2 * count - 1)
+
+objs[1].frameCallback = nil
+objs[1].brightness = nil
+assert(objs[1].brightness == 4)
+object_do_frame_callbacks(0.01)
+assert(own_frames == 1)
+assert(redefined_frames == 3 * count - 1)
+
+-- Setting a field on the class directly is seen too.
+class_get(`Lamp`).brightness = 5
+assert(objs[1].brightness == 5)
+
+object_all_del()
+class_all_del()
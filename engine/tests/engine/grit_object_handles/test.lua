@@ -0,0 +1,47 @@
+-- Times the engine paths that copy GritObject handles the most: per-frame callbacks, the
+-- streamer's pass over activated objects, and pushing objects to Lua.
+
+local count = 2000
+local iterations = 100
+
+local frame_callbacks = 0
+
+class_add(`Bench`, {}, {
+    renderingDistance = 1000,
+    activate = function (persistent, instance)
+        persistent.needsFrameCallbacks = true
+    end,
+    deactivate = function (persistent)
+        persistent.needsFrameCallbacks = false
+    end,
+    frameCallback = function (persistent, elapsed)
+        frame_callbacks = frame_callbacks + 1
+    end,
+})
+
+for i = 1, count do
+    object_add(`Bench`, vec(i % 50, math.floor(i / 50), 0), { name = "Bench" .. i })
+end
+streamer_centre_full(vec(0, 0, 0))
+assert(object_count_activated() == count)
+
+local function time (name, f)
+    local before = micros()
+    for i = 1, iterations do
+        f()
+    end
+    local us = micros() - before
+    print(string.format("%s: %.2f us per object", name, us / iterations / count))
+end
+
+time("object_do_frame_callbacks", function () object_do_frame_callbacks(0.01) end)
+assert(frame_callbacks == count * iterations)
+
+time("streamer_centre", function () streamer_centre(vec(0, 0, 0)) end)
+assert(object_count_activated() == count)
+
+time("object_all", function () object_all() end)
+
+object_all_del()
+assert(object_count() == 0)
+class_del(`Bench`)
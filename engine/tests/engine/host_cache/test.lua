@@ -0,0 +1,132 @@
+-- Drives back and forth past a row of objects, each with a texture of its own.  The GPU RAM
+-- budget is 0, so each texture is unloaded as soon as it is passed, which adds its file to the
+-- host cache, and has to be loaded again on the way back: from the disk without the host cache,
+-- and from memory with it.  The page cache is dropped before each pass, as if the disk were slow.
+
+local count = 40
+local size = 256
+
+local function u32(v)
+    return string.char(v % 256, math.floor(v / 256) % 256, math.floor(v / 65536) % 256,
+                       math.floor(v / 16777216) % 256)
+end
+
+-- An uncompressed 32 bit DDS without mipmaps, filled with noise so that it does not compress
+-- much and a few files are enough to go over a small budget.
+local function write_dds(filename, seed)
+    local header = {
+        "DDS ", u32(124), u32(0x100f), u32(size), u32(size), u32(size * 4), u32(0), u32(0),
+        string.rep(u32(0), 11),
+        u32(32), u32(0x41), u32(0), u32(32),
+        u32(0x00ff0000), u32(0x0000ff00), u32(0x000000ff), u32(0xff000000),
+        u32(0x1000), u32(0), u32(0), u32(0), u32(0),
+    }
+    -- Park-Miller, which is exact in doubles.
+    local x = seed
+    local char, floor = string.char, math.floor
+    local rows = {}
+    for y = 0, size - 1 do
+        local row = {}
+        for px = 1, size do
+            x = x * 16807 % 2147483647
+            row[px] = char(x % 256, floor(x / 256) % 256, floor(x / 65536) % 256, 255)
+        end
+        rows[#rows + 1] = table.concat(row)
+    end
+    local f = assert(io.open(filename, "wb"))
+    f:write(table.concat(header))
+    f:write(table.concat(rows))
+    f:close()
+end
+
+local files = {}
+local classes = {}
+for i = 1, count do
+    local name = string.format("host_cache_%02d.dds", i)
+    write_dds(name, i)
+    files[i] = "/" .. name
+    classes[i] = string.format("/HostCache%02d", i)
+    class_add(classes[i], {}, {
+        renderingDistance = 100,
+        init = function (persistent)
+            persistent:addDiskResource(files[i])
+        end,
+        activate = function (persistent, instance)
+        end,
+        deactivate = function (persistent)
+        end,
+    })
+end
+
+local gpu_ram = gfx_option("RAM")
+local cache_ram = core_option("HOST_CACHE_RAM")
+gfx_option("RAM", 0)
+
+-- Returns the time taken by each pass.
+local function drive(passes)
+    local times = {}
+    for pass = 1, passes do
+        -- The files unloaded in the last pass are added in the background.
+        host_cache_flush()
+        for _, name in ipairs(files) do
+            async_io_drop_cache(name)
+        end
+        local from, to, step = 1, count, 1
+        if pass % 2 == 0 then from, to, step = count, 1, -1 end
+        local before = seconds()
+        for i = from, to, step do
+            local obj = object_add(classes[i], vec(i * 200, 0, 0))
+            obj:activate()
+            assert(obj.activated)
+            obj:destroy()
+            check_ram_gpu()
+            assert(not disk_resource_loaded(files[i]))
+        end
+        times[pass] = seconds() - before
+    end
+    host_cache_flush()
+    return times
+end
+
+local function report(label, times)
+    local parts = {}
+    for i, t in ipairs(times) do
+        parts[i] = string.format("%.1f", t * 1000)
+    end
+    print(string.format("%s: %s ms", label, table.concat(parts, ", ")))
+end
+
+core_option("HOST_CACHE_RAM", 0)
+report("without host cache", drive(4))
+
+core_option("HOST_CACHE_RAM", 64)
+local hits = metrics_value("grit_host_cache_hits_total")
+report("with host cache", drive(4))
+-- Only the first pass went to the disk.
+assert(metrics_value("grit_host_cache_hits_total") - hits >= 3 * count)
+local cached, compressed, raw = host_cache_stats()
+assert(cached == count)
+print(string.format("host cache: %d files, %d bytes compressed from %d", cached, compressed, raw))
+-- Otherwise the 1MB budget below would not drop anything.
+assert(compressed > 2 * 1024 * 1024)
+
+-- A file that changes on disk is not taken from the cache.
+write_dds(files[1]:sub(2), 100)
+local misses = metrics_value("grit_host_cache_misses_total")
+drive(1)
+assert(metrics_value("grit_host_cache_misses_total") > misses)
+
+-- Below the size of the files, the least recently used are dropped.
+core_option("HOST_CACHE_RAM", 1)
+cached, compressed = host_cache_stats()
+assert(cached < count and compressed <= 1024 * 1024)
+host_cache_clear()
+assert(host_cache_stats() == 0)
+
+gfx_option("RAM", gpu_ram)
+core_option("HOST_CACHE_RAM", cache_ram)
+object_all_del()
+for i = 1, count do
+    class_del(classes[i])
+    os.remove(files[i]:sub(2))
+end
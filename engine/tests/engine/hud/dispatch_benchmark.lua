@@ -0,0 +1,97 @@
+gfx_colour_grade(`neutral.lut.png`)
+gfx_option('POST_PROCESSING', false)
+
+-- Measures HUD event dispatch and hit testing with many widgets, of which only a few want
+-- callbacks, and checks that hud_ray follows changes to the layout.
+
+local moves, frames = 0, 0
+
+gfx_hud_class_add(`Widget`, {
+    mouseMoveCallback = function (self, local_pos, screen_pos, inside)
+        moves = moves + 1
+    end,
+    buttonCallback = function (self, ev)
+    end,
+    frameCallback = function (self, elapsed)
+        frames = frames + 1
+    end,
+})
+
+local cols, rows = 100, 50
+local widgets = {}
+for y = 0, rows - 1 do
+    for x = 0, cols - 1 do
+        local w = gfx_hud_object_add(`Widget`)
+        w.position = vec(x * 10 + 5, y * 10 + 5)
+        w.size = vec(8, 8)
+        widgets[#widgets + 1] = w
+    end
+end
+local count = #widgets
+
+-- One in 50 takes input, one in 100 wants frame callbacks.
+local input_count, frame_count = 0, 0
+for i, w in ipairs(widgets) do
+    if i % 50 == 0 then
+        w.needsInputCallbacks = true
+        input_count = input_count + 1
+    end
+    if i % 100 == 0 then
+        w.needsFrameCallbacks = true
+        frame_count = frame_count + 1
+    end
+end
+
+local iterations = 100
+
+local before = micros()
+for i = 1, iterations do
+    input_filter_trickle_mouse_move(vec(1, 0), vec(i % 1000, 250))
+end
+local us = micros() - before
+print(string.format("%d widgets, mouse move: %.1f us", count, us / iterations))
+assert(moves == input_count * iterations)
+
+before = micros()
+for i = 1, iterations do
+    hud_ray(vec(i * 7 % 1000, i * 3 % 500))
+end
+us = micros() - before
+print(string.format("%d widgets, hud_ray: %.2f us", count, us / iterations))
+
+before = micros()
+for i = 1, iterations do
+    gfx_render(0.01, vec(0, 0, 0), quat(1, 0, 0, 0))
+end
+us = micros() - before
+print(string.format("%d widgets, frame (including render): %.1f us", count, us / iterations))
+assert(frames == frame_count * iterations)
+
+-- Widget 50 is at column 49, row 0.
+local target = widgets[50]
+assert(hud_ray(vec(495, 5)) == target)
+assert(hud_ray(vec(485, 5)) == nil)
+target.position = vec(485, 5)
+assert(hud_ray(vec(485, 5)) == target)
+assert(hud_ray(vec(495, 5)) == nil)
+target.enabled = false
+assert(hud_ray(vec(485, 5)) == nil)
+target.enabled = true
+target.needsInputCallbacks = false
+assert(hud_ray(vec(485, 5)) == nil)
+
+-- Children are hit before their parents.
+local parent = widgets[100]
+parent.size = vec(30, 30)
+local child = gfx_hud_object_add(`Widget`)
+child.parent = parent
+child.size = vec(4, 4)
+assert(hud_ray(parent.position) == parent)
+child.needsInputCallbacks = true
+assert(hud_ray(parent.position) == child)
+child:destroy()
+assert(hud_ray(parent.position) == parent)
+
+for _, w in ipairs(widgets) do
+    w:destroy()
+end
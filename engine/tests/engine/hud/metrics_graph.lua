@@ -0,0 +1,77 @@
+gfx_colour_grade(`neutral.lut.png`)
+gfx_option('POST_PROCESSING', false)
+
+-- A lightweight overlay graphing the recent history of a metric, one rectangle per frame.
+
+gfx_hud_class_add(`MetricGraphBar`, {
+})
+
+gfx_hud_class_add(`MetricGraph`, {
+    init = function (self)
+        self.needsFrameCallbacks = true
+        self.colour = vec(0, 0, 0)
+        self.alpha = 0.5
+        self.bars = {}
+        local n = #metrics_history(self.metric, self.labels or "")
+        local width = self.size.x / n
+        for i = 1, n do
+            local bar = gfx_hud_object_add(`MetricGraphBar`)
+            bar.parent = self
+            bar.colour = vec(0, 1, 0)
+            bar.size = vec(width, 0)
+            self.bars[i] = bar
+        end
+    end,
+    destroy = function (self)
+        for _, bar in ipairs(self.bars) do
+            bar:destroy()
+        end
+    end,
+    frameCallback = function (self, elapsed)
+        local history = metrics_history(self.metric, self.labels or "")
+        local biggest = 0
+        for _, v in ipairs(history) do
+            biggest = math.max(biggest, v)
+        end
+        self.biggest = biggest
+        local w, h = self.size.x, self.size.y
+        local width = w / #history
+        for i, v in ipairs(history) do
+            local bar_h = biggest > 0 and v / biggest * h or 0
+            local bar = self.bars[i]
+            bar.size = vec(width, bar_h)
+            bar.position = vec((i - 0.5) * width - w / 2, bar_h / 2 - h / 2)
+        end
+    end,
+})
+
+class_add(`Thing`, {}, {
+    renderingDistance = 50,
+    activate = function (self)
+    end,
+    deactivate = function (self)
+    end,
+})
+for i = 1, 100 do
+    object_add(`Thing`, vec(i, 0, 0), {})
+end
+
+local graph = gfx_hud_object_add(`MetricGraph`, {
+    metric = "grit_streamer_activated_objects",
+    size = vec(256, 64),
+    position = vec(200, 100),
+})
+assert(#graph.bars == #metrics_history("grit_streamer_activated_objects"))
+
+-- Walk past the objects, so the number activated goes up and down.
+for i = 1, 20 do
+    streamer_centre(vec(i * 10 - 50, 0, 0))
+    gfx_render(0.1, vec(0, 0, 0), quat(1, 0, 0, 0))
+end
+assert(graph.biggest > 0)
+local last = graph.bars[#graph.bars]
+assert(last.size.y >= 0 and last.size.y <= graph.size.y)
+
+graph:destroy()
+object_all_del()
+class_all_del()
@@ -0,0 +1,43 @@
+include `font_impact50.lua`
+gfx_colour_grade(`neutral.lut.png`)
+gfx_option('POST_PROCESSING', false)
+
+-- Measures the throughput of glyph lookup and text layout, and checks that repeated layout of the
+-- same text is stable.
+
+local line = "The quick brown fox jumps over the lazy dog. 0123456789 \t!?\n"
+local text = string.rep(line, 200)
+local letters = #text
+
+local iterations = 100
+
+local before = micros()
+local width
+for i = 1, iterations do
+    width = gfx_font_text_width(`Impact50`, text)
+end
+local us = micros() - before
+print(string.format("gfx_font_text_width: %.1f letters/us", letters * iterations / us))
+assert(width > 0)
+
+local t = gfx_hud_text_add(`Impact50`)
+t.text = text
+t.position = vec(200, 100)
+
+local before = micros()
+for i = 1, iterations do
+    -- Changing the wrap lays out the whole buffer again.
+    t.textWrap = vec(400 + i % 2, 0)
+end
+local us = micros() - before
+print(string.format("GfxTextBuffer layout: %.1f letters/us", letters * iterations / us))
+
+t.textWrap = vec(400, 0)
+local height = t.bufferHeight
+for i = 1, 10 do
+    t.textWrap = vec(400, 0)
+    assert(t.bufferHeight == height)
+end
+
+gfx_render(0.1, vec(0, 0, 0), quat(1, 0, 0, 0))
+t:destroy()
@@ -0,0 +1,133 @@
+-- Times a script workload detached, with a debugger attached, and while sampling, and checks
+-- that breakpoints, stepping and the folded stack output work, also inside tasks.
+
+local function leaf(x)
+    return x * 2 + 1
+end
+
+local function middle(n)
+    local total = 0
+    for i = 1, n do
+        total = total + leaf(i)
+    end
+    return total
+end
+
+local function workload()
+    local total = 0
+    for i = 1, 200 do
+        total = total + middle(1000)
+    end
+    return total
+end
+
+local function time(what)
+    debugger_stats_reset()
+    local before = micros()
+    workload()
+    local us = micros() - before
+    local hook_calls, hook_micros = debugger_stats()
+    print(string.format("%s: %d us, %d hook calls, %d us in hook", what, us, hook_calls, hook_micros))
+    return us
+end
+
+assert(not debugger_attached())
+assert(not lua_profiler_running())
+time("detached")
+local hook_calls = debugger_stats()
+assert(hook_calls == 0)
+
+-- Attached with no breakpoints installs no hooks either.
+local hits = {}
+debugger_attach(function (source, line)
+    hits[#hits + 1] = line
+end)
+assert(debugger_attached())
+time("attached, no breakpoints")
+hook_calls = debugger_stats()
+assert(hook_calls == 0)
+
+-- A breakpoint on a line that is never reached makes every line pay for the line hook.
+local source = debug.getinfo(1, "S").short_src
+debugger_break_add(source, 100000)
+time("attached, line hooks")
+
+-- Hitting a breakpoint calls the client, and "step" stops again at the next line.
+debugger_break_clear()
+local leaf_line = debug.getinfo(leaf, "S").linedefined + 1
+debugger_break_add(source, leaf_line)
+leaf(1)
+assert(#hits == 1 and hits[1] == leaf_line)
+assert(debugger_break_del(source, leaf_line))
+assert(not debugger_break_del(source, leaf_line))
+leaf(1)
+assert(#hits == 1)
+
+local stepped = {}
+debugger_attach(function (source, line)
+    stepped[#stepped + 1] = line
+    if #stepped < 3 then return "step" end
+end)
+debugger_break_add(source, leaf_line)
+leaf(1)
+debugger_break_clear()
+assert(#stepped == 3)
+assert(stepped[1] == leaf_line)
+
+-- Tasks run in their own coroutines, which get the hooks whenever they are resumed, even if
+-- the breakpoint was added after they were spawned.
+hits = {}
+debugger_attach(function (source, line)
+    hits[#hits + 1] = line
+end)
+local task = task_spawn(function ()
+    coroutine.yield()
+    leaf(1)
+end)
+do_tasks(1)
+debugger_break_add(source, leaf_line)
+do_tasks(1)
+debugger_break_clear()
+assert(#hits == 1 and hits[1] == leaf_line)
+
+debugger_detach()
+assert(not debugger_attached())
+
+-- Sampling every millisecond.
+lua_profiler_start(0.001, 1000)
+assert(lua_profiler_running())
+time("sampling")
+lua_profiler_stop()
+local _, _, _, samples, overwritten = debugger_stats()
+print(string.format("sampling: %d samples, %d overwritten", samples, overwritten))
+assert(samples > 0)
+
+local filename = "ldb_profiler_test.folded"
+local stacks = lua_profiler_dump(filename)
+assert(stacks > 0)
+local found = false
+for line in io.lines(filename) do
+    assert(line:match("^.+ %d+$"))
+    if line:find("middle") then found = true end
+end
+assert(found)
+os.remove(filename)
+
+-- A task is sampled while it runs.
+lua_profiler_start(0.001, 1000)
+task = task_spawn(function ()
+    workload()
+end)
+do_tasks(100)
+lua_profiler_stop()
+lua_profiler_dump(filename)
+found = false
+for line in io.lines(filename) do
+    if line:find("middle") then found = true end
+end
+assert(found)
+os.remove(filename)
+
+time("detached again")
+hook_calls = debugger_stats()
+assert(hook_calls == 0)
@@ -0,0 +1,41 @@
+-- With disk_resource_verbose_incs on, every hold on a resource logs a message when it is made and
+-- another when it is collected.  The messages are formatted and written by the log sink's thread,
+-- so the holds cost little more than they do with the verbose mode off.
+
+local lut = `neutral.lut.png`
+local n = 20000
+
+-- Returns the time taken to make n holds and then collect them.
+local function churn()
+    local before = seconds()
+    local holds = {}
+    for i = 1, n do
+        holds[i] = disk_resource_hold_make(lut)
+    end
+    holds = nil
+    collectgarbage()
+    return seconds() - before
+end
+
+local function messages()
+    log_sink_flush()
+    local queued, written, dropped = log_sink_stats()
+    assert(queued == 0)
+    return written + dropped
+end
+
+disk_resource_set_verbose_incs(false)
+churn()
+local quiet = churn()
+
+local before = messages()
+disk_resource_set_verbose_incs(true)
+local verbose = churn()
+disk_resource_set_verbose_incs(false)
+-- Every message is either written or counted as dropped.
+assert(messages() - before >= 2 * n)
+
+local queued, written, dropped = log_sink_stats()
+print(string.format("%d holds: %.1f ms quiet, %.1f ms verbose (%d messages written, %d dropped)",
+                    n, quiet * 1000, verbose * 1000, written, dropped))
+assert(metrics_value("grit_log_sink_dropped_total") == dropped)
@@ -12,3 +12,7 @@ print "Loading Test.08.mesh"
 disk_resource_load(`Test.10.mesh`)
 print "Using Test.08.mesh"
 b10 = gfx_body_make(`Test.10.mesh`)
+
+-- The unused parts of the shared geometry buffers count towards the GPU memory used.
+local _, vbytes, vused, _, ibytes, iused = gfx_mesh_geometry_stats()
+assert(gfx_gpu_ram_used() * 1024 * 1024 >= (vbytes - vused) + (ibytes - iused))
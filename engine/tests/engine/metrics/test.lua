@@ -0,0 +1,57 @@
+-- Streams some objects in, then checks the streaming metrics and the exported file.
+
+class_add(`Thing`, {}, {
+    renderingDistance = 50,
+    activate = function (self)
+    end,
+    deactivate = function (self)
+    end,
+})
+
+for i = 1, 100 do
+    object_add(`Thing`, vec(i, 0, 0), {})
+end
+
+local activations_before = metrics_value("grit_streamer_activations_total")
+for i = 1, 5 do
+    streamer_centre(vec(50, 0, 0))
+    metrics_frame()
+end
+assert(metrics_value("grit_streamer_activations_total") > activations_before)
+assert(metrics_value("grit_streamer_activated_objects") == object_count_activated())
+
+local count, sum = metrics_value("grit_streamer_centre_seconds")
+assert(count >= 5)
+assert(sum >= 0)
+
+-- Counters are graphed as their increase per frame, gauges as their value.
+local history = metrics_history("grit_streamer_activated_objects")
+assert(#history > 0)
+assert(history[#history] == object_count_activated())
+
+local found = false
+for _, m in ipairs(metrics_all()) do
+    if m[1] == "grit_disk_resource_evictions_total" and m[2] == 'memory="host"' then
+        assert(m[3] == "COUNTER")
+        found = true
+    end
+end
+assert(found)
+
+local filename = "metrics_test.prom"
+metrics_write(filename)
+local text = {}
+for line in io.lines(filename) do
+    text[#text + 1] = line
+end
+os.remove(filename)
+local all = table.concat(text, "\n")
+assert(all:find("# TYPE grit_streamer_activations_total counter", 1, true))
+assert(all:find("# TYPE grit_streamer_centre_seconds histogram", 1, true))
+local inf = all:match('grit_streamer_centre_seconds_bucket{le="%+Inf"} (%d+)')
+local total = all:match('grit_streamer_centre_seconds_count (%d+)')
+assert(inf ~= nil and inf == total)
+assert(all:find('grit_disk_resource_evictions_total{memory="host"}', 1, true))
+
+object_all_del()
+class_all_del()
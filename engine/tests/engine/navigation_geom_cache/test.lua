@@ -0,0 +1,73 @@
+-- Loads the same obj file with the geometry cache off, then twice with it on: the first time
+-- writes the cache file, the second maps it instead of parsing and partitioning the file.
+--
+-- The ground is written to an obj file, which is in Recast coordinates (y is up).
+
+local filename = "nav_geom_cache_ground.obj"
+local cache_dir = "nav_geom_cache"
+
+-- A bumpy square of n by n quads, facing up.
+local function write_ground(size, n)
+    local f = assert(io.open(filename, "w"))
+    local step = size / n
+    for i = 0, n do
+        for j = 0, n do
+            local h = math.sin(i * 0.3) * math.cos(j * 0.3)
+            f:write(string.format("v %f %f %f\n", -size / 2 + i * step, h, -size / 2 + j * step))
+        end
+    end
+    local function idx(i, j) return i * (n + 1) + j + 1 end
+    for i = 0, n - 1 do
+        for j = 0, n - 1 do
+            f:write(string.format("f %d %d %d\n", idx(i, j), idx(i, j + 1), idx(i + 1, j)))
+            f:write(string.format("f %d %d %d\n", idx(i + 1, j), idx(i, j + 1), idx(i + 1, j + 1)))
+        end
+    end
+    f:close()
+end
+
+local function hits()
+    return metrics_value("grit_navigation_geom_cache_hits_total")
+end
+
+-- Returns the time taken to add the geometry and build the navmesh.
+local function load()
+    navigation_reset()
+    local before = seconds()
+    assert(navigation_add_obj_geometry(filename) > 0)
+    local loaded = seconds()
+    navigation_build_nav_mesh()
+    local built = seconds()
+    assert(navigation_navmesh_loaded())
+    local p = navigation_nearest_point_on_navmesh(vec(0, 0, 1))
+    assert(p ~= nil and #vec(p.x, p.y, 0) < 0.5)
+    return loaded - before, built - loaded
+end
+
+write_ground(256, 256)
+
+navigation_set_geometry_cache("")
+local parse, build = load()
+print(string.format("no cache: load %.1f ms, build %.1f ms", parse * 1000, build * 1000))
+
+-- Files left by an earlier run would make the first load warm.
+navigation_set_geometry_cache(cache_dir)
+navigation_clear_geometry_cache()
+local hits_before = hits()
+local cold = load()
+assert(hits() == hits_before)
+local warm, warm_build = load()
+assert(hits() == hits_before + 1)
+print(string.format("cache: cold load %.1f ms, warm load %.1f ms, build %.1f ms",
+                    cold * 1000, warm * 1000, warm_build * 1000))
+
+-- A changed file has a different hash, so it is not confused with the cached one.
+write_ground(256, 128)
+load()
+assert(hits() == hits_before + 1)
+
+assert(navigation_clear_geometry_cache() == 2)
+navigation_set_geometry_cache("")
+os.remove(cache_dir)
+navigation_reset()
+os.remove(filename)
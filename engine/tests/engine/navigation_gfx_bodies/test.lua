@@ -0,0 +1,70 @@
+-- Builds a navmesh from graphics bodies whose meshes share vertex and index buffers.  Each body
+-- must only contribute its own triangles, wherever its mesh is in the shared buffers.
+
+gfx_register_shader(`Plain`, {
+    tex = {
+        uniformKind = "TEXTURE2D",
+    },
+    vertexCode = [[
+        var normal_ws = rotate_to_world(vert.normal.xyz);
+    ]],
+    dangsCode = [[
+        out.diffuse = sample(mat.tex, vert.coord0.xy).rgb;
+        out.gloss = 0;
+        out.specular = 0;
+        out.normal = normal_ws;
+    ]],
+    additionalCode = [[
+    ]],
+})
+
+-- Used by Money.mesh and Ball.mesh.
+register_material(`Money`, { shader = `Plain`, tex = `Money_d.dds` })
+register_material(`Ball`, { shader = `Plain`, tex = `Money_d.dds` })
+
+disk_resource_load(`Money_d.dds`)
+
+local function size(id)
+    local lo, hi = navigation_geometry_bounds(id)
+    assert(lo ~= nil)
+    return hi - lo, lo, hi
+end
+
+local function near(a, b)
+    return #(a - b) < 0.001
+end
+
+-- The ball on its own, so it is at the start of the shared buffers.
+navigation_reset()
+disk_resource_load(`Ball.mesh`)
+local b = gfx_body_make(`Ball.mesh`)
+local ball_size = size(navigation_add_gfx_body(b))
+b:destroy()
+disk_resource_unload(`Ball.mesh`)
+
+-- Now after the money, which is loaded first.
+navigation_reset()
+disk_resource_load(`Money.mesh`)
+local buffers_before = gfx_mesh_geometry_stats()
+disk_resource_load(`Ball.mesh`)
+print(string.format("Ball.mesh shares a vertex buffer with Money.mesh: %s",
+                    tostring(gfx_mesh_geometry_stats() == buffers_before)))
+
+local money = gfx_body_make(`Money.mesh`)
+local ball = gfx_body_make(`Ball.mesh`)
+ball.localPosition = vec(100, 0, 0)
+local money_id = navigation_add_gfx_body(money)
+local ball_id = navigation_add_gfx_body(ball)
+assert(money_id > 0 and ball_id > 0)
+
+local s, lo, hi = size(ball_id)
+assert(near(s, ball_size))
+assert(lo.x > 50 and hi.x > 50)
+local money_lo, money_hi = select(2, size(money_id))
+assert(money_lo.x < 50 and money_hi.x < 50)
+
+navigation_build_nav_mesh()
+
+money:destroy()
+ball:destroy()
+navigation_reset()
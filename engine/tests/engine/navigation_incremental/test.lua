@@ -0,0 +1,130 @@
+-- Benchmark for adding and removing a single building in a large navmesh.  Only the tiles under
+-- the building should be rebuilt, so it should take a small fraction of the full build.
+--
+-- The world is written to obj files, which are in Recast coordinates (y is up).
+
+local files = {}
+
+local function write_obj(filename, verts, faces)
+    local f = assert(io.open(filename, "w"))
+    for _, v in ipairs(verts) do
+        f:write(string.format("v %f %f %f\n", v[1], v[2], v[3]))
+    end
+    for _, t in ipairs(faces) do
+        f:write(string.format("f %d %d %d\n", t[1], t[2], t[3]))
+    end
+    f:close()
+    files[#files + 1] = filename
+end
+
+-- A flat square of n by n quads, facing up.
+local function write_ground(filename, size, n)
+    local verts, faces = {}, {}
+    local step = size / n
+    for i = 0, n do
+        for j = 0, n do
+            verts[#verts + 1] = { -size / 2 + i * step, 0, -size / 2 + j * step }
+        end
+    end
+    local function idx(i, j) return i * (n + 1) + j + 1 end
+    for i = 0, n - 1 do
+        for j = 0, n - 1 do
+            faces[#faces + 1] = { idx(i, j), idx(i, j + 1), idx(i + 1, j) }
+            faces[#faces + 1] = { idx(i + 1, j), idx(i, j + 1), idx(i + 1, j + 1) }
+        end
+    end
+    write_obj(filename, verts, faces)
+end
+
+-- A box with a roof, centred on x, z.
+local function write_building(filename, x, z, w, h)
+    local x0, x1, z0, z1 = x - w / 2, x + w / 2, z - w / 2, z + w / 2
+    local verts = {
+        { x0, 0, z0 }, { x0, 0, z1 }, { x1, 0, z1 }, { x1, 0, z0 },
+        { x0, h, z0 }, { x0, h, z1 }, { x1, h, z1 }, { x1, h, z0 },
+    }
+    local faces = {
+        { 5, 6, 8 }, { 8, 6, 7 },  -- roof
+        { 1, 5, 4 }, { 4, 5, 8 },
+        { 2, 3, 6 }, { 6, 3, 7 },
+        { 1, 2, 5 }, { 5, 2, 6 },
+        { 4, 8, 3 }, { 3, 8, 7 },
+    }
+    write_obj(filename, verts, faces)
+end
+
+local size = 480
+local height = 6
+
+navigation_reset()
+
+write_ground("nav_bench_ground.obj", size, 48)
+assert(navigation_add_obj_geometry("nav_bench_ground.obj") > 0)
+for i = 0, 9 do
+    for j = 0, 9 do
+        local name = string.format("nav_bench_building_%d_%d.obj", i, j)
+        write_building(name, -180 + i * 40, -180 + j * 40, 12, height)
+        assert(navigation_add_obj_geometry(name) > 0)
+    end
+end
+-- Goes between the others.
+local cx, cz = 0, 0
+write_building("nav_bench_extra.obj", cx, cz, 12, height)
+
+local before = seconds()
+navigation_build_nav_mesh()
+local full_time = seconds() - before
+assert(navigation_navmesh_loaded())
+assert(navigation_pending_tiles() == 0)
+print(string.format("full build: %.1f ms", full_time * 1000))
+
+-- Recast (x, y, z) is (-x, z, y) in the world.
+local above = vec(-cx, cz, height)
+local function surface_height()
+    local p = navigation_nearest_point_on_navmesh(above)
+    assert(p ~= nil)
+    return p.z
+end
+assert(math.abs(surface_height()) < 1)
+
+local iterations = 10
+local add_time, remove_time, tiles = 0, 0, 0
+for i = 1, iterations do
+    before = seconds()
+    local id = navigation_add_obj_geometry("nav_bench_extra.obj")
+    assert(id > 0)
+    local rebuilt = navigation_finish_tile_rebuilds()
+    add_time = add_time + seconds() - before
+    tiles = rebuilt
+    assert(navigation_pending_tiles() == 0)
+    assert(math.abs(surface_height() - height) < 1)
+
+    before = seconds()
+    assert(navigation_remove_geometry(id))
+    navigation_finish_tile_rebuilds()
+    remove_time = remove_time + seconds() - before
+    assert(math.abs(surface_height()) < 1)
+end
+assert(not navigation_remove_geometry(-1))
+
+print(string.format("add one building: %.2f ms, remove: %.2f ms, %d tiles each",
+                    add_time / iterations * 1000, remove_time / iterations * 1000, tiles))
+assert(tiles > 0)
+assert(add_time / iterations < full_time)
+
+-- Without waiting, the rebuild happens in the background and navigation_update swaps it in.
+local id = navigation_add_obj_geometry("nav_bench_extra.obj")
+assert(navigation_pending_tiles() > 0)
+local frames = 0
+while navigation_pending_tiles() > 0 do
+    navigation_update(0.01)
+    frames = frames + 1
+end
+print(string.format("background rebuild: %d frames", frames))
+assert(math.abs(surface_height() - height) < 1)
+navigation_remove_geometry(id)
+
+navigation_reset()
+for _, name in ipairs(files) do
+    os.remove(name)
+end
@@ -0,0 +1,143 @@
+-- Adds and removes obstacles on a built navmesh.  The tiles under them are rebuilt in the
+-- background and swapped in by navigation_update, so the frames while that happens stay short.
+--
+-- The ground is written to an obj file, which is in Recast coordinates (y is up).
+
+local filename = "nav_obstacles_ground.obj"
+
+-- A flat square of n by n quads, facing up.
+local function write_ground(size, n)
+    local f = assert(io.open(filename, "w"))
+    local step = size / n
+    for i = 0, n do
+        for j = 0, n do
+            f:write(string.format("v %f 0 %f\n", -size / 2 + i * step, -size / 2 + j * step))
+        end
+    end
+    local function idx(i, j) return i * (n + 1) + j + 1 end
+    for i = 0, n - 1 do
+        for j = 0, n - 1 do
+            f:write(string.format("f %d %d %d\n", idx(i, j), idx(i, j + 1), idx(i + 1, j)))
+            f:write(string.format("f %d %d %d\n", idx(i + 1, j), idx(i, j + 1), idx(i + 1, j + 1)))
+        end
+    end
+    f:close()
+end
+
+navigation_reset()
+write_ground(96, 12)
+assert(navigation_add_obj_geometry(filename) > 0)
+navigation_build_nav_mesh()
+assert(navigation_navmesh_loaded())
+
+local centre = vec(0, 0, 0)
+local function distance_to_navmesh()
+    local p = navigation_nearest_point_on_navmesh(centre + vec(0, 0, 1))
+    assert(p ~= nil)
+    return #(vec(p.x, p.y, 0) - centre)
+end
+assert(distance_to_navmesh() < 0.5)
+
+-- Wait for the background rebuild, returning the number of frames and the longest one.
+local function settle()
+    local frames, longest = 0, 0
+    while select(3, navigation_obstacle_stats()) > 0 do
+        local before = seconds()
+        navigation_update(0.01)
+        longest = math.max(longest, seconds() - before)
+        frames = frames + 1
+    end
+    local count, capacity, requests, tiles = navigation_obstacle_stats()
+    assert(requests == 0 and tiles == 0)
+    return frames, longest
+end
+
+local id = navigation_add_obstacle(centre)
+assert(id > 0)
+local count, capacity, requests, tiles = navigation_obstacle_stats()
+assert(count == 1 and capacity == 128)
+assert(requests == 1 and tiles > 0)
+local frames, longest = settle()
+print(string.format("add obstacle: %d frames, longest %.2f ms", frames, longest * 1000))
+-- The obstacle has a radius of 1, and the agent has to keep clear of it.
+assert(distance_to_navmesh() > 1)
+
+navigation_remove_obstacle(centre)
+assert(navigation_obstacle_stats() == 0)
+settle()
+assert(distance_to_navmesh() < 0.5)
+
+-- Beyond the capacity, obstacles are refused.
+navigation_set_max_obstacles(3)
+for i = 1, 3 do
+    assert(navigation_add_obstacle(vec(i * 10, 0, 0)) > 0)
+end
+assert(navigation_add_obstacle(vec(40, 0, 0)) == 0)
+count, capacity = navigation_obstacle_stats()
+assert(count == 3 and capacity == 3)
+settle()
+navigation_set_max_obstacles(128)
+
+-- A physics body is an obstacle while it is at rest.  Paths go around it, and follow it when it
+-- is moved and settles again.
+local function path(from, to)
+    local p = navigation_find_path(from, to)
+    assert(p ~= nil)
+    local len = 0
+    for i = 2, #p do
+        len = len + #(p[i] - p[i - 1])
+    end
+    return #p, len
+end
+
+-- Step the physics (which puts resting bodies to sleep) until the obstacles are as expected and
+-- their tiles have been rebuilt.
+local function wait_for_obstacles(count)
+    for i = 1, 2000 do
+        physics_update()
+        navigation_update(0.01)
+        local c, _, requests, tiles = navigation_obstacle_stats()
+        if c == count and requests == 0 and tiles == 0 then return end
+    end
+    error("Obstacles did not settle")
+end
+
+physics_option("GRAVITY_Z", 0)
+physics_set_material(`/common/pmat/Stone`, 4)
+local gcol = `box.gcol`
+local hold = disk_resource_hold_make(gcol)
+disk_resource_ensure_loaded(gcol)
+
+local west, east = vec(-20, 0, 0), vec(20, 0, 0)
+local far_west, far_east = vec(-20, 20, 0), vec(20, 20, 0)
+assert(path(west, east) == 2)
+assert(path(far_west, far_east) == 2)
+
+local body = physics_body_make(gcol, vec(0, 0, 1), quat(1, 0, 0, 0))
+assert(navigation_add_body_obstacle(body, "BOX"))
+assert(not navigation_add_body_obstacle(body, "BOX"))
+wait_for_obstacles(1)
+local corners, len = path(west, east)
+assert(corners > 2 and len > 40)
+assert(path(far_west, far_east) == 2)
+
+-- While it moves it is not an obstacle, then it is one where it comes to rest.
+body.worldPosition = vec(0, 20, 1)
+navigation_update(0.01)
+assert(navigation_obstacle_stats() == 0)
+wait_for_obstacles(1)
+assert(path(west, east) == 2)
+corners, len = path(far_west, far_east)
+assert(corners > 2 and len > 40)
+
+assert(navigation_remove_body_obstacle(body))
+wait_for_obstacles(0)
+assert(path(far_west, far_east) == 2)
+
+body:destroy()
+hold = nil
+physics_option_reset()
+
+navigation_reset()
+assert(navigation_obstacle_stats() == 0)
+os.remove(filename)
@@ -0,0 +1,55 @@
+-- The first time an object of a class loads its resources, the class's manifest is recorded.
+-- The next time they are loaded, every file in the manifest is prefetched first.
+
+local lut = `neutral.lut.png`
+local filename = "resource_manifest_test.txt"
+
+class_add(`Graded`, {}, {
+    renderingDistance = 100,
+    init = function (persistent)
+        persistent:addDiskResource(lut)
+    end,
+    activate = function (persistent, instance)
+    end,
+    deactivate = function (persistent)
+    end,
+})
+
+local function prefetched()
+    return metrics_value("grit_resource_manifest_prefetch_files_total")
+end
+
+resource_manifest_clear()
+if disk_resource_loaded(lut) then disk_resource_unload(lut) end
+
+local obj = object_add(`Graded`, vec(0, 0, 0))
+obj:activate()
+assert(obj.activated)
+
+local m = resource_manifest_get(`Graded`)
+assert(m ~= nil and #m == 1)
+assert(m[1][1] == lut and m[1][2] > 0)
+print(string.format("manifest: %s, %d bytes", m[1][1], m[1][2]))
+
+-- Offline manifests are written and read in the same format.
+resource_manifest_save(filename)
+resource_manifest_clear()
+assert(resource_manifest_get(`Graded`) == nil)
+resource_manifest_load(filename)
+assert(resource_manifest_count() == 1)
+local m2 = resource_manifest_get(`Graded`)
+assert(m2[1][1] == m[1][1] and m2[1][2] == m[1][2])
+os.remove(filename)
+
+-- Loading again prefetches the file.
+obj:destroy()
+disk_resource_unload(lut)
+local before = prefetched()
+obj = object_add(`Graded`, vec(0, 0, 0))
+obj:activate()
+assert(obj.activated)
+assert(prefetched() == before + 1)
+
+object_all_del()
+class_del(`Graded`)
+resource_manifest_clear()
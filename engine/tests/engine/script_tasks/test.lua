@@ -0,0 +1,85 @@
+-- Tasks yield to spread their work over several frames, sharing a per-frame budget.
+
+local steps = 0
+local worker = task_spawn(function ()
+    for i = 1, 5 do
+        steps = steps + 1
+        coroutine.yield()
+    end
+end, "NORMAL", "worker")
+
+assert(steps == 0)
+do_tasks(0.01)
+assert(steps == 1)
+local name, priority, cpu, max_slice, resumes, starved, max_starved = task_stats(worker)
+assert(name == "worker")
+assert(priority == "NORMAL")
+assert(resumes == 1)
+assert(starved == 0)
+
+for i = 1, 5 do
+    do_tasks(0.01)
+end
+assert(steps == 5)
+-- Returned from the function, so it is gone.
+assert(task_stats(worker) == nil)
+assert(#task_all() == 0)
+
+-- With no budget, only critical tasks run, and the others starve.
+local critical_runs, background_runs = 0, 0
+local critical = task_spawn(function ()
+    while true do
+        critical_runs = critical_runs + 1
+        coroutine.yield()
+    end
+end, "CRITICAL")
+local background = task_spawn(function ()
+    while true do
+        background_runs = background_runs + 1
+        coroutine.yield()
+    end
+end, "BACKGROUND")
+
+for i = 1, 3 do
+    do_tasks(0)
+end
+assert(critical_runs == 3)
+assert(background_runs == 0)
+local _, _, _, _, _, starved, max_starved = task_stats(background)
+assert(starved == 3 and max_starved == 3)
+
+do_tasks(1)
+assert(background_runs == 1)
+_, _, _, _, _, starved, max_starved = task_stats(background)
+assert(starved == 0 and max_starved == 3)
+
+-- Errors kill the task but not the frame.
+local erroring = task_spawn(function () error("expected error") end)
+do_tasks(1)
+assert(task_stats(erroring) == nil)
+assert(critical_runs == 5)
+
+assert(task_kill(background))
+assert(not task_kill(background))
+do_tasks(1)
+assert(background_runs == 2)
+
+-- A heavy job is spread over many frames.
+local sum = 0
+local heavy = task_spawn(function ()
+    for i = 1, 1000000 do
+        sum = sum + i
+        if i % 1000 == 0 then coroutine.yield() end
+    end
+end, "BACKGROUND", "heavy")
+local frames = 0
+while task_stats(heavy) do
+    do_tasks(0.002)
+    frames = frames + 1
+end
+assert(sum == 500000500000)
+print(string.format("heavy task: %d frames", frames))
+
+clear_tasks()
+do_tasks(1)
+assert(#task_all() == 0)
@@ -0,0 +1,120 @@
+-- An object at the edge of its rendering distance should not be activated and deactivated
+-- every time the player moves a little.
+
+local activations = 0
+local deactivations = 0
+
+class_add(`Edge`, {}, {
+    renderingDistance = 100,
+    activate = function (persistent, instance)
+        activations = activations + 1
+    end,
+    deactivate = function (persistent)
+        deactivations = deactivations + 1
+    end,
+})
+
+core_option("VISIBILITY", 1)
+core_option("DEACTIVATION_HYSTERESIS", 0.1)
+core_option("WARM_DEACTIVATION_TIME", 0)
+
+local obj = object_add(`Edge`, vec(0, 0, 0))
+
+streamer_centre_full(vec(99, 0, 0))
+assert(obj.activated)
+assert(activations == 1)
+
+-- Wobbling just outside the rendering distance does not deactivate.
+for i = 1, 10 do
+    streamer_centre_full(vec(105, 0, 0))
+    streamer_centre_full(vec(99, 0, 0))
+end
+assert(obj.activated)
+assert(activations == 1 and deactivations == 0)
+
+-- Beyond the hysteresis band it does.
+streamer_centre_full(vec(111, 0, 0))
+assert(not obj.activated)
+assert(deactivations == 1)
+
+-- With warm deactivation, leaving and coming back does not call the callbacks.
+core_option("WARM_DEACTIVATION_TIME", 60)
+streamer_centre_full(vec(99, 0, 0))
+assert(activations == 2)
+for i = 1, 10 do
+    streamer_centre_full(vec(200, 0, 0))
+    assert(obj.activated)
+    streamer_centre_full(vec(99, 0, 0))
+end
+assert(activations == 2 and deactivations == 1)
+
+local acts, deacts, parks, revivals, thrashes = class_streaming_stats(`Edge`)
+print("activations", acts, "deactivations", deacts, "parks", parks, "revivals", revivals,
+      "thrashes", thrashes)
+assert(acts == 2 and deacts == 1)
+assert(parks == 10 and revivals == 10)
+-- The second activation came straight after the deactivation.
+assert(thrashes == 1)
+
+-- Reactivation within THRASH_WINDOW of the deactivation counts as thrashing, later does not.
+core_option("WARM_DEACTIVATION_TIME", 0)
+core_option("THRASH_WINDOW", 0)
+streamer_centre_full(vec(111, 0, 0))
+streamer_centre_full(vec(99, 0, 0))
+assert(activations == 3 and deactivations == 2)
+acts, deacts, parks, revivals, thrashes = class_streaming_stats(`Edge`)
+assert(thrashes == 1)
+
+object_all_del()
+class_del(`Edge`)
+
+-- A parked object is neither felt nor called back until it is revived.
+physics_option("GRAVITY_Z", 0)
+physics_set_material(`/common/pmat/Stone`, 4)
+local gcol = `box.gcol`
+local hold = disk_resource_hold_make(gcol)
+disk_resource_ensure_loaded(gcol)
+
+local steps = 0
+class_add(`Crate`, {}, {
+    renderingDistance = 100,
+    activate = function (self, instance)
+        instance.body = physics_body_make(gcol, self.spawnPos, quat(1, 0, 0, 0))
+        instance.body.owner = self
+        self.needsStepCallbacks = true
+    end,
+    deactivate = function (self)
+        self.instance.body:destroy()
+    end,
+    stepCallback = function (self, elapsed)
+        steps = steps + 1
+    end,
+})
+
+core_option("WARM_DEACTIVATION_TIME", 60)
+local crate = object_add(`Crate`, vec(0, 0, 0))
+local function felt()
+    return physics_cast(vec(0, 0, 10), vec(0, 0, -20), true, 0) ~= nil
+end
+
+streamer_centre_full(vec(50, 0, 0))
+assert(crate.activated and felt())
+object_do_step_callbacks(0.01)
+assert(steps == 1)
+
+streamer_centre_full(vec(200, 0, 0))
+assert(crate.activated and not felt())
+physics_update()
+object_do_step_callbacks(0.01)
+assert(steps == 1)
+
+streamer_centre_full(vec(50, 0, 0))
+assert(felt())
+object_do_step_callbacks(0.01)
+assert(steps == 2)
+
+object_all_del()
+class_del(`Crate`)
+hold = nil
+physics_option_reset()
+core_option_reset()
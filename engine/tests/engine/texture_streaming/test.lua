@@ -0,0 +1,112 @@
+-- A streamed texture is loaded with only its small mips, grows to full resolution when drawn up
+-- close, and shrinks again under GPU memory pressure, whether drawn by a body or by instances.
+
+gfx_colour_grade(`neutral.lut.png`)
+gfx_fade_dither_map `stipple.png`
+
+gfx_register_shader(`Money`, {
+    tex = {
+        uniformKind = "TEXTURE2D",
+    },
+    vertexCode = [[
+        var normal_ws = rotate_to_world(vert.normal.xyz);
+    ]],
+    dangsCode = [[
+        out.diffuse = sample(mat.tex, vert.coord0.xy).rgb;
+        out.gloss = 0;
+        out.specular = 0;
+        out.normal = normal_ws;
+    ]],
+    additionalCode = [[
+    ]],
+})
+
+-- Used by Money.mesh.
+register_material(`Money`, {
+    shader = `Money`,
+    tex = `Money_d.dds`,
+    additionalLighting = false,
+})
+
+gfx_sunlight_direction(vec(0, 0, -1))
+gfx_sunlight_diffuse(vec(1, 1, 1))
+gfx_sunlight_specular(vec(1, 1, 1))
+
+local gpu_ram = gfx_option("RAM")
+local initial_size = gfx_option("TEXTURE_STREAMING_INITIAL_SIZE")
+local mip_bias = gfx_option("TEXTURE_STREAMING_MIP_BIAS")
+gfx_option("TEXTURE_STREAMING_INITIAL_SIZE", 16)
+-- So that up close is always close enough for the largest mip, whatever the size of the window.
+gfx_option("TEXTURE_STREAMING_MIP_BIAS", -4)
+
+-- Money_d.dds is 128x128 with a full mip chain.  Loading the mesh loads it as a texture of the
+-- material, so it can be streamed.
+local hold = disk_resource_hold_make(`Money.mesh`)
+disk_resource_load(`Money.mesh`)
+
+-- The size of the largest resident mip of the texture, and the number of reads in flight.
+local function resident()
+    local histogram, pending = gfx_texture_residency_histogram()
+    local size, count = nil, 0
+    for k, v in pairs(histogram) do
+        size = k
+        count = count + v
+    end
+    assert(count == 1)
+    return size, pending
+end
+
+local function render(pos)
+    gfx_render(0.1, pos or vec(0.04362189, -0.9296255, 0.5302261),
+               quat(0.9800102, -0.1631184, 0.01870036, -0.1123512))
+end
+
+-- Renders until the texture has the given size, failing if it takes too long.
+local function render_until(size, pos)
+    for frame = 1, 100 do
+        render(pos)
+        if resident() == size then return frame end
+    end
+    error("Texture did not reach " .. size .. ", still " .. resident())
+end
+
+assert(resident() == 16)
+
+b = gfx_body_make(`Money.mesh`)
+b.castShadows = false
+render_until(128)
+
+-- Not drawn, and over budget, so the top mips are dropped a frame at a time.  They are copied from
+-- the GPU rather than read from the file, so nothing is ever pending.
+b.enabled = false
+gfx_option("RAM", 0)
+for frame = 1, 100 do
+    render()
+    local size, pending = resident()
+    assert(pending == 0)
+    if size == 16 then break end
+end
+assert(resident() == 16)
+gfx_option("RAM", gpu_ram)
+b:destroy()
+
+-- Instances far away only need the small mips.
+local inst = gfx_instances_make(`Money.mesh`)
+inst.castShadows = false
+inst:add(vec(0, 1000, 0), quat(1, 0, 0, 0), 1)
+for frame = 1, 10 do render() end
+assert(resident() == 16)
+
+-- Close up, they need the whole texture.
+inst:add(vec(0, 0, 0), quat(1, 0, 0, 0), 1)
+render_until(128)
+
+-- Seen from far away while memory is short, the texture shrinks even though it is still drawn.
+gfx_option("RAM", 0)
+render_until(16, vec(0, 1000, 5000))
+gfx_option("RAM", gpu_ram)
+
+inst:destroy()
+hold = nil
+gfx_option("TEXTURE_STREAMING_INITIAL_SIZE", initial_size)
+gfx_option("TEXTURE_STREAMING_MIP_BIAS", mip_bias)
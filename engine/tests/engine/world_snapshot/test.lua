@@ -0,0 +1,73 @@
+-- Saves a large map to a snapshot and restores it, checking that the objects come back intact
+-- and timing both directions.
+
+local count = 200000
+local filename = "world_snapshot_test.snap"
+
+local inits = 0
+
+class_add(`Crate`, {}, {
+    renderingDistance = 50,
+    init = function (persistent)
+        inits = inits + 1
+    end,
+})
+
+class_add(`CrateLod`, {}, {
+    renderingDistance = 500,
+    init = function (persistent)
+        inits = inits + 1
+    end,
+})
+
+local before = micros()
+for i = 1, count do
+    object_add(`Crate`, vec(i % 1000, math.floor(i / 1000), 0), {
+        name = "Crate" .. i,
+        health = i,
+        rot = quat(1, 0, 0, 0),
+        tags = { "wooden", i },
+    })
+end
+local far = object_add(`CrateLod`, vec(1, 2, 3), { renderingDistance = 700 })
+far.near = object_get("Crate1")
+print(string.format("object_add: %.2f us per object", (micros() - before) / count))
+
+before = micros()
+local bytes = world_snapshot_save(filename)
+print(string.format("world_snapshot_save: %d bytes, %.2f us per object",
+                    bytes, (micros() - before) / count))
+
+object_all_del()
+assert(object_count() == 0)
+inits = 0
+
+before = micros()
+assert(world_snapshot_load(filename) == count + 1)
+print(string.format("world_snapshot_load: %.2f us per object", (micros() - before) / count))
+
+assert(object_count() == count + 1)
+assert(inits == count + 1)
+
+local o = object_get("Crate1234")
+assert(o.className == "Crate")
+assert(o.pos == vec(234, 1, 0))
+assert(o.renderingDistance == 50)
+assert(o.health == 1234)
+assert(o.rot == quat(1, 0, 0, 0))
+assert(o.tags[1] == "wooden")
+assert(o.tags[2] == 1234)
+assert(not o.activated)
+
+local restored_far = object_get(far.name)
+assert(restored_far.renderingDistance == 700)
+assert(restored_far.near == object_get("Crate1"))
+assert(object_get("Crate1").far == restored_far)
+
+-- Restored objects stream in like any other.
+streamer_centre_full(vec(0, 0, 0))
+assert(object_get("Crate1").activated)
+
+object_all_del()
+class_del(`Crate`)
+class_del(`CrateLod`)
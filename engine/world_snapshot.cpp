@@ -0,0 +1,458 @@
+/* Copyright (c) The Grit Game Engine authors 2016
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+#include <vector>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <sleep.h>
+
+#include "grit_class.h"
+#include "grit_object.h"
+#include "main.h"
+#include "streamer.h"
+#include "world_snapshot.h"
+
+// Layout of the file (all integers and floats in the byte order of the writer):
+//
+// Header
+// classes * (string name)
+// objects * (u32 class, string name, u8 anonymous, float x y z r, i32 near, table userValues)
+//
+// string: u32 length, then the bytes
+// table: u32 n, n * (string key, value), u32 m, m * (double key, value)
+// value: u8 type (as in ExternalTable::Value), then the payload for that type
+
+namespace {
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t classes;
+        uint32_t objects;
+        uint32_t padding;
+        uint64_t size;
+    };
+
+    const char snapshot_magic[8] = { 'G', 'R', 'I', 'T', 'W', 'L', 'D', '\0' };
+
+    /** Read-only view of a whole file, mapped into memory where possible. */
+    class MappedFile {
+
+        public:
+
+        MappedFile (const std::string &filename)
+          : data(NULL), size(0)
+        {
+            #ifdef WIN32
+            std::ifstream f(filename.c_str(), std::ios::binary);
+            if (!f.good()) EXCEPT << "Could not open snapshot: \"" << filename << "\"" << ENDL;
+            f.seekg(0, std::ios::end);
+            storage.resize(f.tellg());
+            f.seekg(0, std::ios::beg);
+            f.read(&storage[0], storage.size());
+            if (!f.good()) EXCEPT << "Could not read snapshot: \"" << filename << "\"" << ENDL;
+            data = &storage[0];
+            size = storage.size();
+            #else
+            int fd = open(filename.c_str(), O_RDONLY);
+            if (fd == -1)
+                EXCEPT << "Could not open snapshot: \"" << filename << "\" ("
+                       << strerror(errno) << ")" << ENDL;
+            struct stat st;
+            if (fstat(fd, &st) == -1 || st.st_size < off_t(sizeof(Header))) {
+                close(fd);
+                EXCEPT << "Not a snapshot: \"" << filename << "\"" << ENDL;
+            }
+            void *m = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            close(fd);
+            if (m == MAP_FAILED)
+                EXCEPT << "Could not map snapshot: \"" << filename << "\" ("
+                       << strerror(errno) << ")" << ENDL;
+            data = static_cast<const char*>(m);
+            size = st.st_size;
+            #endif
+        }
+
+        ~MappedFile (void)
+        {
+            #ifndef WIN32
+            munmap(const_cast<char*>(data), size);
+            #endif
+        }
+
+        const char *data;
+        size_t size;
+
+        private:
+
+        #ifdef WIN32
+        std::vector<char> storage;
+        #endif
+    };
+
+    /** Bounds-checked cursor over the mapped snapshot. */
+    struct Reader {
+        const char *p, *end;
+        const std::string &filename;
+
+        Reader (const char *p, size_t sz, const std::string &filename)
+          : p(p), end(p + sz), filename(filename)
+        { }
+
+        void need (size_t n)
+        {
+            if (size_t(end - p) < n) EXCEPT << "Snapshot is truncated: \"" << filename << "\"" << ENDL;
+        }
+
+        template<class T> T get (void)
+        {
+            need(sizeof(T));
+            T v;
+            memcpy(&v, p, sizeof(T));
+            p += sizeof(T);
+            return v;
+        }
+
+        float getFloat (void) { return get<float>(); }
+
+        std::string getString (void)
+        {
+            uint32_t len = get<uint32_t>();
+            need(len);
+            std::string s(p, len);
+            p += len;
+            return s;
+        }
+
+        void corrupt (void)
+        {
+            EXCEPT << "Snapshot is corrupt: \"" << filename << "\"" << ENDL;
+        }
+    };
+
+}
+
+template<class T> static void put (std::string &buf, const T &v)
+{
+    buf.append(reinterpret_cast<const char*>(&v), sizeof(T));
+}
+
+static void put_string (std::string &buf, const std::string &s)
+{
+    put(buf, uint32_t(s.length()));
+    buf.append(s);
+}
+
+static void put_table (std::string &buf, const ExternalTable &t, const std::string &obj);
+
+static void put_value (std::string &buf, const ExternalTable::Value &v, const std::string &obj)
+{
+    put(buf, uint8_t(v.type));
+    switch (v.type) {
+        case 0:
+        put(buf, double(v.real));
+        break;
+        case 1:
+        put_string(buf, v.str);
+        break;
+        case 2:
+        put(buf, v.v3.x); put(buf, v.v3.y); put(buf, v.v3.z);
+        break;
+        case 3:
+        put(buf, v.q.w); put(buf, v.q.x); put(buf, v.q.y); put(buf, v.q.z);
+        break;
+        case 4:
+        put(buf, uint8_t(v.b));
+        break;
+        case 5:
+        put_table(buf, *v.t, obj);
+        break;
+        case 6: {
+            const Plot::Map &points = v.plot.getPoints();
+            put(buf, uint32_t(points.size()));
+            for (const auto &pt : points) {
+                put(buf, float(pt.first));
+                put(buf, float(pt.second));
+            }
+        }
+        break;
+        case 7: {
+            const PlotV3::Map &points = v.plot_v3.getPoints();
+            put(buf, uint32_t(points.size()));
+            for (const auto &pt : points) {
+                put(buf, float(pt.first));
+                put(buf, pt.second.x); put(buf, pt.second.y); put(buf, pt.second.z);
+            }
+        }
+        break;
+        case 8:
+        EXCEPT << "Object \"" << obj << "\" has a function in its user values, which cannot be "
+               << "saved in a snapshot." << ENDL;
+        break;
+        case 9:
+        put(buf, v.v2.x); put(buf, v.v2.y);
+        break;
+        case 10:
+        put(buf, v.v4.x); put(buf, v.v4.y); put(buf, v.v4.z); put(buf, v.v4.w);
+        break;
+        default:
+        EXCEPT << "Unhandled ExternalTable type: " << v.type << ENDL;
+    }
+}
+
+static void put_table (std::string &buf, const ExternalTable &t, const std::string &obj)
+{
+    uint32_t fields = 0;
+    for (auto i=t.begin(), i_=t.end() ; i != i_ ; ++i) fields++;
+    put(buf, fields);
+    for (auto i=t.begin(), i_=t.end() ; i != i_ ; ++i) {
+        put_string(buf, i->first);
+        put_value(buf, i->second, obj);
+    }
+
+    uint32_t elements = 0;
+    for (auto i=t.elementsBegin(), i_=t.elementsEnd() ; i != i_ ; ++i) elements++;
+    put(buf, elements);
+    for (auto i=t.elementsBegin(), i_=t.elementsEnd() ; i != i_ ; ++i) {
+        put(buf, double(i->first));
+        put_value(buf, i->second, obj);
+    }
+}
+
+static void get_table (Reader &r, ExternalTable &t);
+
+template<class K> static void get_value (Reader &r, ExternalTable &t, K key)
+{
+    uint8_t type = r.get<uint8_t>();
+    switch (type) {
+        case 0:
+        t.set(key, lua_Number(r.get<double>()));
+        break;
+        case 1:
+        t.set(key, r.getString());
+        break;
+        case 2: {
+            float x = r.getFloat(), y = r.getFloat(), z = r.getFloat();
+            t.set(key, Vector3(x, y, z));
+        }
+        break;
+        case 3: {
+            float w = r.getFloat(), x = r.getFloat(), y = r.getFloat(), z = r.getFloat();
+            t.set(key, Quaternion(w, x, y, z));
+        }
+        break;
+        case 4:
+        t.set(key, r.get<uint8_t>() != 0);
+        break;
+        case 5: {
+            SharedPtr<ExternalTable> sub(new ExternalTable());
+            get_table(r, *sub);
+            t.set(key, sub);
+        }
+        break;
+        case 6: {
+            Plot plot;
+            uint32_t n = r.get<uint32_t>();
+            for (uint32_t i=0 ; i<n ; ++i) {
+                float x = r.getFloat(), y = r.getFloat();
+                plot.addPoint(x, y);
+            }
+            plot.commit();
+            t.set(key, plot);
+        }
+        break;
+        case 7: {
+            PlotV3 plot;
+            uint32_t n = r.get<uint32_t>();
+            for (uint32_t i=0 ; i<n ; ++i) {
+                float x = r.getFloat();
+                float vx = r.getFloat(), vy = r.getFloat(), vz = r.getFloat();
+                plot.addPoint(x, Vector3(vx, vy, vz));
+            }
+            plot.commit();
+            t.set(key, plot);
+        }
+        break;
+        case 9: {
+            float x = r.getFloat(), y = r.getFloat();
+            t.set(key, Vector2(x, y));
+        }
+        break;
+        case 10: {
+            float x = r.getFloat(), y = r.getFloat(), z = r.getFloat(), w = r.getFloat();
+            t.set(key, Vector4(x, y, z, w));
+        }
+        break;
+        default:
+        r.corrupt();
+    }
+}
+
+static void get_table (Reader &r, ExternalTable &t)
+{
+    uint32_t fields = r.get<uint32_t>();
+    for (uint32_t i=0 ; i<fields ; ++i) {
+        std::string key = r.getString();
+        get_value(r, t, key);
+    }
+    uint32_t elements = r.get<uint32_t>();
+    for (uint32_t i=0 ; i<elements ; ++i) {
+        lua_Number key = r.get<double>();
+        get_value(r, t, key);
+    }
+}
+
+size_t world_snapshot_save (const std::string &filename)
+{
+    unsigned long long before = micros();
+
+    GObjMap::iterator begin, end;
+    object_all(begin, end);
+
+    GObjPtrs objs;
+    objs.reserve(object_count());
+    std::unordered_map<const GritObject*, int32_t> obj_indexes;
+    std::vector<std::string> class_names;
+    std::unordered_map<const GritClass*, uint32_t> class_indexes;
+    for (GObjMap::iterator i=begin ; i != end ; ++i) {
+        const GritObjectPtr &o = i->second;
+        obj_indexes[&*o] = objs.size();
+        objs.push_back(o);
+        GritClass *gc = o->getClass();
+        if (class_indexes.find(gc) == class_indexes.end()) {
+            class_indexes[gc] = class_names.size();
+            class_names.push_back(gc->name);
+        }
+    }
+
+    std::string buf;
+    buf.reserve(sizeof(Header) + objs.size() * 128);
+
+    Header h;
+    memcpy(h.magic, snapshot_magic, sizeof h.magic);
+    h.version = WORLD_SNAPSHOT_VERSION;
+    h.classes = class_names.size();
+    h.objects = objs.size();
+    h.padding = 0;
+    h.size = 0;  // filled in below
+    put(buf, h);
+
+    for (const auto &name : class_names) put_string(buf, name);
+
+    for (const auto &o : objs) {
+        put(buf, class_indexes[o->getClass()]);
+        put_string(buf, o->name);
+        put(buf, uint8_t(o->anonymous));
+        Vector3 pos = o->getPos();
+        put(buf, pos.x); put(buf, pos.y); put(buf, pos.z);
+        put(buf, o->getR());
+        const GritObjectPtr &near_obj = o->getNearObj();
+        put(buf, near_obj.isNull() ? int32_t(-1) : obj_indexes[&*near_obj]);
+        put_table(buf, o->userValues, o->name);
+    }
+
+    h.size = buf.size();
+    memcpy(&buf[0], &h, sizeof h);
+
+    std::ofstream f(filename.c_str(), std::ios::binary);
+    f.write(buf.data(), buf.size());
+    f.close();
+    if (!f.good()) EXCEPT << "Could not write snapshot: \"" << filename << "\"" << ENDL;
+
+    CVERB << "Saved " << objs.size() << " objects to \"" << filename << "\" in "
+          << (micros() - before) / 1000 << "ms" << std::endl;
+    return buf.size();
+}
+
+unsigned world_snapshot_load (lua_State *L, const std::string &filename)
+{
+    unsigned long long before = micros();
+
+    MappedFile file(filename);
+    Reader r(file.data, file.size, filename);
+
+    Header h = r.get<Header>();
+    if (memcmp(h.magic, snapshot_magic, sizeof h.magic))
+        EXCEPT << "Not a snapshot: \"" << filename << "\"" << ENDL;
+    if (h.version != WORLD_SNAPSHOT_VERSION)
+        EXCEPT << "Snapshot \"" << filename << "\" has version " << h.version
+               << " but version " << WORLD_SNAPSHOT_VERSION << " is required." << ENDL;
+    if (h.size != file.size) r.corrupt();
+
+    // Look up every class before touching the existing objects, so a snapshot that needs a
+    // missing class does not leave an empty map behind.
+    std::vector<GritClass*> classes(h.classes);
+    for (auto &gc : classes) gc = class_get(r.getString());
+
+    object_all_del(L);
+    streamer_reserve(h.objects);
+
+    GObjPtrs objs;
+    objs.reserve(h.objects);
+    std::vector<int32_t> nears;
+    nears.reserve(h.objects);
+    for (uint32_t i=0 ; i<h.objects ; ++i) {
+        uint32_t cls = r.get<uint32_t>();
+        if (cls >= classes.size()) r.corrupt();
+        std::string name = r.getString();
+        bool anonymous = r.get<uint8_t>() != 0;
+        float x = r.getFloat(), y = r.getFloat(), z = r.getFloat();
+        float rad = r.getFloat();
+        int32_t near_index = r.get<int32_t>();
+        if (near_index >= int32_t(h.objects)) r.corrupt();
+
+        GritObjectPtr o = object_add(L, name, classes[cls]);
+        o->anonymous = anonymous;
+        o->updateSphere(Vector3(x, y, z), rad);
+        get_table(r, o->userValues);
+        objs.push_back(o);
+        nears.push_back(near_index);
+    }
+    if (r.p != r.end) r.corrupt();
+
+    // Setting the near companion also sets the far companion of the other object.
+    for (uint32_t i=0 ; i<h.objects ; ++i) {
+        if (nears[i] < 0) continue;
+        objs[i]->setNearObj(objs[i], objs[nears[i]]);
+    }
+
+    for (const auto &o : objs) {
+        // An earlier init callback may have destroyed this object.
+        if (o->getClass() == NULL) continue;
+        o->init(L, o);
+    }
+
+    CVERB << "Restored " << h.objects << " objects from \"" << filename << "\" in "
+          << (micros() - before) / 1000 << "ms" << std::endl;
+    return h.objects;
+}
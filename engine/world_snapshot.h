@@ -0,0 +1,61 @@
+/* Copyright (c) The Grit Game Engine authors 2016
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef WorldSnapshot_h
+#define WorldSnapshot_h
+
+#include <cstdlib>
+#include <string>
+
+extern "C" {
+    #include <lua.h>
+}
+
+/** \file
+ *
+ * A snapshot of every object in the map, written to a single binary file, for fast saving,
+ * loading, and restarting of levels without going through Lua.  For each object, the snapshot
+ * records its name, class, position, rendering distance, near / far lod companion, and
+ * persistent user values (its ExternalTable).  The lua state of activated objects is not
+ * recorded, so they come back deactivated and the streamer activates them again as usual.
+ *
+ * The file is a header followed by the class names and then the objects, all in one
+ * contiguous buffer with no pointers, so it is read by mapping it into memory.  The header holds
+ * a version number, and snapshots from other versions are rejected.  The byte order is that of
+ * the machine that wrote the snapshot.
+ */
+
+/** Bumped whenever the layout of the snapshot changes. */
+static const unsigned WORLD_SNAPSHOT_VERSION = 1;
+
+/** Write every object to the given file, returning its size in bytes.  Throws if an object's
+ * user values hold a Lua function, which cannot be saved. */
+size_t world_snapshot_save (const std::string &filename);
+
+/** Replace every object with those in the given file.  The classes of the objects must already
+ * exist.  The snapshot is checked and its classes are looked up before any existing objects are
+ * destroyed, but a snapshot that is found to be corrupt after that point leaves the map partially
+ * restored.  The init callbacks of the new objects are called once they all exist and are linked
+ * to their lod companions.  Returns the number of objects created. */
+unsigned world_snapshot_load (lua_State *L, const std::string &filename);
+
+#endif